@@ -23,6 +23,7 @@
 
 #if defined(CONF_FAMILY_UNIX)
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -61,6 +62,7 @@
 #include <direct.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <io.h>
 #include <process.h>
 #include <shellapi.h>
 #include <wincrypt.h>
@@ -303,7 +305,7 @@ unsigned io_skip(IOHANDLE io, int size)
 	return size;
 }
 
-int io_seek(IOHANDLE io, int offset, int origin)
+int io_seek(IOHANDLE io, int64_t offset, int origin)
 {
 	int real_origin;
 
@@ -322,17 +324,26 @@ int io_seek(IOHANDLE io, int offset, int origin)
 		return -1;
 	}
 
-	return fseek((FILE *)io, offset, real_origin);
+	// files can be larger than what long holds on windows
+#if defined(CONF_FAMILY_WINDOWS)
+	return _fseeki64((FILE *)io, offset, real_origin);
+#else
+	return fseeko((FILE *)io, offset, real_origin);
+#endif
 }
 
-long int io_tell(IOHANDLE io)
+int64_t io_tell(IOHANDLE io)
 {
-	return ftell((FILE *)io);
+#if defined(CONF_FAMILY_WINDOWS)
+	return _ftelli64((FILE *)io);
+#else
+	return ftello((FILE *)io);
+#endif
 }
 
-long int io_length(IOHANDLE io)
+int64_t io_length(IOHANDLE io)
 {
-	long int length;
+	int64_t length;
 	io_seek(io, 0, IOSEEK_END);
 	length = io_tell(io);
 	io_seek(io, 0, IOSEEK_START);
@@ -368,6 +379,39 @@ int io_flush(IOHANDLE io)
 	return fflush((FILE *)io);
 }
 
+void *io_map(IOHANDLE io, unsigned *size)
+{
+	long int length = io_length(io);
+	if(length <= 0)
+		return 0;
+#if defined(CONF_FAMILY_UNIX)
+	void *data = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+		return 0;
+#elif defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(!mapping)
+		return 0;
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if(!data)
+		return 0;
+#else
+	return 0;
+#endif
+	*size = length;
+	return data;
+}
+
+void io_unmap(void *data, unsigned size)
+{
+#if defined(CONF_FAMILY_UNIX)
+	munmap(data, size);
+#elif defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#endif
+}
+
 #define ASYNC_BUFSIZE 8 * 1024
 #define ASYNC_LOCAL_BUFSIZE 64 * 1024
 
@@ -889,6 +933,7 @@ void sphore_init(SEMAPHORE *sem)
 	*sem = CreateSemaphore(0, 0, 10000, 0);
 }
 void sphore_wait(SEMAPHORE *sem) { WaitForSingleObject((HANDLE)*sem, INFINITE); }
+bool sphore_timedwait(SEMAPHORE *sem, int milliseconds) { return WaitForSingleObject((HANDLE)*sem, milliseconds) == WAIT_OBJECT_0; }
 void sphore_signal(SEMAPHORE *sem) { ReleaseSemaphore((HANDLE)*sem, 1, NULL); }
 void sphore_destroy(SEMAPHORE *sem) { CloseHandle((HANDLE)*sem); }
 #elif defined(CONF_PLATFORM_MACOS)
@@ -899,6 +944,18 @@ void sphore_init(SEMAPHORE *sem)
 	*sem = sem_open(aBuf, O_CREAT | O_EXCL, S_IRWXU | S_IRWXG, 0);
 }
 void sphore_wait(SEMAPHORE *sem) { sem_wait(*sem); }
+bool sphore_timedwait(SEMAPHORE *sem, int milliseconds)
+{
+	// there is no sem_timedwait on macOS
+	int64_t end = time_get() + time_freq() * milliseconds / 1000;
+	while(sem_trywait(*sem) != 0)
+	{
+		if(time_get() >= end)
+			return false;
+		thread_sleep(1000);
+	}
+	return true;
+}
 void sphore_signal(SEMAPHORE *sem) { sem_post(*sem); }
 void sphore_destroy(SEMAPHORE *sem)
 {
@@ -920,6 +977,28 @@ void sphore_wait(SEMAPHORE *sem)
 		dbg_msg("sphore", "wait failed: %d", errno);
 }
 
+bool sphore_timedwait(SEMAPHORE *sem, int milliseconds)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += milliseconds / 1000;
+	ts.tv_nsec += (milliseconds % 1000) * 1000000L;
+	if(ts.tv_nsec >= 1000000000L)
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	while(sem_timedwait(sem, &ts) != 0)
+	{
+		if(errno == EINTR)
+			continue;
+		if(errno != ETIMEDOUT)
+			dbg_msg("sphore", "timedwait failed: %d", errno);
+		return false;
+	}
+	return true;
+}
+
 void sphore_signal(SEMAPHORE *sem)
 {
 	if(sem_post(sem) != 0)
@@ -1548,6 +1627,41 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	/* queue it if it doesn't need special handling */
+	if(sock.send_mmsgs && size <= PACKETSIZE &&
+		((addr->type == NETTYPE_IPV4 && sock.ipv4sock >= 0) || (addr->type == NETTYPE_IPV6 && sock.ipv6sock >= 0)))
+	{
+		SEND_MMSGS *m = sock.send_mmsgs;
+		if(m->size == VLEN)
+			net_udp_flush(sock);
+
+		if(addr->type == NETTYPE_IPV4)
+		{
+			struct sockaddr_in sa;
+			netaddr_to_sockaddr_in(addr, &sa);
+			mem_copy(m->sockaddrs[m->size], &sa, sizeof(sa));
+			m->msgs[m->size].msg_hdr.msg_namelen = sizeof(sa);
+			m->socks[m->size] = sock.ipv4sock;
+		}
+		else
+		{
+			struct sockaddr_in6 sa;
+			netaddr_to_sockaddr_in6(addr, &sa);
+			mem_copy(m->sockaddrs[m->size], &sa, sizeof(sa));
+			m->msgs[m->size].msg_hdr.msg_namelen = sizeof(sa);
+			m->socks[m->size] = sock.ipv6sock;
+		}
+		mem_copy(m->bufs[m->size], data, size);
+		m->iovecs[m->size].iov_len = size;
+		m->size++;
+
+		network_stats.sent_bytes += size;
+		network_stats.sent_packets++;
+		return size;
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock.ipv4sock >= 0)
@@ -1564,6 +1678,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 
 			d = sendto((int)sock.ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_calls++;
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1602,6 +1717,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 
 			d = sendto((int)sock.ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_calls++;
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1648,6 +1764,48 @@ void net_init_mmsgs(MMSGS *m)
 #endif
 }
 
+void net_udp_set_send_queue(NETSOCKET *sock, SEND_MMSGS *m)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	int i;
+	m->size = 0;
+	mem_zero(m->msgs, sizeof(m->msgs));
+	mem_zero(m->iovecs, sizeof(m->iovecs));
+	for(i = 0; i < VLEN; ++i)
+	{
+		m->iovecs[i].iov_base = m->bufs[i];
+		m->msgs[i].msg_hdr.msg_iov = &(m->iovecs[i]);
+		m->msgs[i].msg_hdr.msg_iovlen = 1;
+		m->msgs[i].msg_hdr.msg_name = &(m->sockaddrs[i]);
+	}
+	sock->send_mmsgs = m;
+#endif
+}
+
+void net_udp_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	SEND_MMSGS *m = sock.send_mmsgs;
+	int i = 0;
+	if(!m)
+		return;
+
+	/* one call per run of packets for the same socket */
+	while(i < m->size)
+	{
+		int num = 1;
+		int sent;
+		while(i + num < m->size && m->socks[i + num] == m->socks[i])
+			num++;
+		sent = sendmmsg(m->socks[i], &m->msgs[i], num, 0);
+		network_stats.send_calls++;
+		/* skip a packet that can't be sent, like sendto would drop it */
+		i += sent > 0 ? sent : 1;
+	}
+	m->size = 0;
+#endif
+}
+
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS *m, unsigned char **data)
 {
 	char sockaddrbuf[128];
@@ -2005,7 +2163,8 @@ int fs_listdir_info(const char *dir, FS_LISTDIR_INFO_CALLBACK cb, int type, void
 	do
 	{
 		str_copy(buffer + length, finddata.cFileName, (int)sizeof(buffer) - length);
-		if(cb(finddata.cFileName, fs_getmtime(buffer), fs_is_dir(buffer), type, user))
+		int64_t size = ((int64_t)finddata.nFileSizeHigh << 32) | finddata.nFileSizeLow;
+		if(cb(finddata.cFileName, fs_getmtime(buffer), size, fs_is_dir(buffer), type, user))
 			break;
 	} while(FindNextFileA(handle, &finddata));
 
@@ -2026,7 +2185,11 @@ int fs_listdir_info(const char *dir, FS_LISTDIR_INFO_CALLBACK cb, int type, void
 	while((entry = readdir(d)) != NULL)
 	{
 		str_copy(buffer + length, entry->d_name, (int)sizeof(buffer) - length);
-		if(cb(entry->d_name, fs_getmtime(buffer), fs_is_dir(buffer), type, user))
+		// one stat for the date, the size and the type
+		struct stat sb;
+		if(stat(buffer, &sb) == -1)
+			mem_zero(&sb, sizeof(sb));
+		if(cb(entry->d_name, sb.st_mtime, sb.st_size, S_ISDIR(sb.st_mode), type, user))
 			break;
 	}
 
@@ -260,7 +260,7 @@ unsigned io_write_newline(IOHANDLE io);
 	Returns:
 		Returns 0 on success.
 */
-int io_seek(IOHANDLE io, int offset, int origin);
+int io_seek(IOHANDLE io, int64_t offset, int origin);
 
 /*
 	Function: io_tell
@@ -272,7 +272,7 @@ int io_seek(IOHANDLE io, int offset, int origin);
 	Returns:
 		Returns the current position. -1L if an error occurred.
 */
-long int io_tell(IOHANDLE io);
+int64_t io_tell(IOHANDLE io);
 
 /*
 	Function: io_length
@@ -284,7 +284,7 @@ long int io_tell(IOHANDLE io);
 	Returns:
 		Returns the total size. -1L if an error occurred.
 */
-long int io_length(IOHANDLE io);
+int64_t io_length(IOHANDLE io);
 
 /*
 	Function: io_close
@@ -310,6 +310,34 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps a whole file into memory.
+
+	Parameters:
+		io - Handle to the file.
+		size - Pointer to an unsigned that receives the size of the file.
+
+	Returns:
+		Returns the mapped memory on success and 0 on failure.
+
+	Remarks:
+		- The mapping is private, writes to it don't end up in the file.
+		- The mapping stays valid until <io_unmap> is called, even if the
+		  file gets closed.
+*/
+void *io_map(IOHANDLE io, unsigned *size);
+
+/*
+	Function: io_unmap
+		Releases memory mapped with <io_map>.
+
+	Parameters:
+		data - The mapped memory.
+		size - The size <io_map> returned.
+*/
+void io_unmap(void *data, unsigned size);
+
 /*
 	Function: io_error
 		Checks whether an error occurred during I/O with the file.
@@ -624,6 +652,8 @@ typedef sem_t SEMAPHORE;
 
 void sphore_init(SEMAPHORE *sem);
 void sphore_wait(SEMAPHORE *sem);
+// returns true if signaled within the given milliseconds
+bool sphore_timedwait(SEMAPHORE *sem, int milliseconds);
 void sphore_signal(SEMAPHORE *sem);
 void sphore_destroy(SEMAPHORE *sem);
 
@@ -709,12 +739,16 @@ Current value of the timer in microseconds.
 int64_t time_get_microseconds();
 
 /* Group: Network General */
+typedef struct SEND_MMSGS SEND_MMSGS;
+
 typedef struct
 {
 	int type;
 	int ipv4sock;
 	int ipv6sock;
 	int web_ipv4sock;
+	/* queue for outgoing packets, see net_udp_set_send_queue */
+	SEND_MMSGS *send_mmsgs;
 } NETSOCKET;
 
 enum
@@ -871,6 +905,43 @@ typedef struct
 
 void net_init_mmsgs(MMSGS *m);
 
+struct SEND_MMSGS
+{
+#ifdef CONF_PLATFORM_LINUX
+	int size;
+	int socks[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	char sockaddrs[VLEN][128];
+#else
+	int dummy;
+#endif
+};
+
+/*
+	Function: net_udp_set_send_queue
+		Makes net_udp_send queue the packets of the socket until
+		net_udp_flush is called or the queue is full. They are then
+		sent with as few system calls as possible. Only supported on
+		Linux, other platforms keep sending every packet right away.
+
+	Parameters:
+		sock - Socket to queue the packets of, copies of the socket
+			made before don't queue.
+		m - Queue to use, must stay valid while the socket is used.
+*/
+void net_udp_set_send_queue(NETSOCKET *sock, SEND_MMSGS *m);
+
+/*
+	Function: net_udp_flush
+		Sends the packets queued for an UDP socket.
+
+	Parameters:
+		sock - Socket to send the queued packets of.
+*/
+void net_udp_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -1601,9 +1672,13 @@ void str_escape(char **dst, const char *src, const char *end);
 
 	Returns:
 		Always returns 0.
+
+	Remarks:
+		- fs_listdir_info also gives the modification date and the size
+		  of each entry.
 */
 typedef int (*FS_LISTDIR_CALLBACK)(const char *name, int is_dir, int dir_type, void *user);
-typedef int (*FS_LISTDIR_INFO_CALLBACK)(const char *name, time_t date, int is_dir, int dir_type, void *user);
+typedef int (*FS_LISTDIR_INFO_CALLBACK)(const char *name, time_t date, int64_t size, int is_dir, int dir_type, void *user);
 int fs_listdir(const char *dir, FS_LISTDIR_CALLBACK cb, int type, void *user);
 int fs_listdir_info(const char *dir, FS_LISTDIR_INFO_CALLBACK cb, int type, void *user);
 
@@ -1816,6 +1891,8 @@ typedef struct
 	int sent_bytes;
 	int recv_packets;
 	int recv_bytes;
+	/* system calls for sent_packets, fewer if they were queued */
+	int send_calls;
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
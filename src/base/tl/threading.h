@@ -12,6 +12,7 @@ public:
 	~CSemaphore() { sphore_destroy(&m_Sem); }
 	CSemaphore(const CSemaphore &) = delete;
 	void Wait() { sphore_wait(&m_Sem); }
+	bool TimedWait(int Milliseconds) { return sphore_timedwait(&m_Sem, Milliseconds); }
 	void Signal() { sphore_signal(&m_Sem); }
 };
 
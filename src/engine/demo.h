@@ -76,12 +76,20 @@ public:
 		DEMOTYPE_SERVER,
 	};
 
+	enum ETickOffset
+	{
+		TICK_CURRENT, // update the current tick again
+		TICK_PREVIOUS, // go to the previous tick
+		TICK_NEXT, // go to the next tick
+	};
+
 	~IDemoPlayer() {}
 	virtual void SetSpeed(float Speed) = 0;
 	virtual void SetSpeedIndex(int Offset) = 0;
 	virtual int SeekPercent(float Percent) = 0;
 	virtual int SeekTime(float Seconds) = 0;
 	virtual int SetPos(int WantedTick) = 0;
+	virtual int SeekTick(ETickOffset TickOffset) = 0;
 	virtual void Pause() = 0;
 	virtual void Unpause() = 0;
 	virtual bool IsPlaying() const = 0;
@@ -1,7 +1,9 @@
 #include "connection_pool.h"
 #include "connection.h"
 
+#include <base/math.h>
 #include <engine/console.h>
+#include <engine/shared/config.h>
 
 // helper struct to hold thread data
 struct CSqlExecData
@@ -14,17 +16,23 @@ struct CSqlExecData
 		CDbConnectionPool::FWrite pFunc,
 		std::unique_ptr<const ISqlData> pThreadData,
 		const char *pName);
+	CSqlExecData(
+		CDbConnectionPool::FWriteBatch pFunc,
+		std::unique_ptr<const ISqlData> pThreadData,
+		const char *pName);
 	~CSqlExecData() {}
 
 	enum
 	{
 		READ_ACCESS,
 		WRITE_ACCESS,
+		WRITE_BATCH_ACCESS,
 	} m_Mode;
 	union
 	{
 		CDbConnectionPool::FRead m_pReadFunc;
 		CDbConnectionPool::FWrite m_pWriteFunc;
+		CDbConnectionPool::FWriteBatch m_pWriteBatchFunc;
 	} m_Ptr;
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
@@ -53,12 +61,30 @@ CSqlExecData::CSqlExecData(
 	m_Ptr.m_pWriteFunc = pFunc;
 }
 
+CSqlExecData::CSqlExecData(
+	CDbConnectionPool::FWriteBatch pFunc,
+	std::unique_ptr<const ISqlData> pThreadData,
+	const char *pName) :
+	m_Mode(WRITE_BATCH_ACCESS),
+	m_pThreadData(std::move(pThreadData)),
+	m_pName(pName)
+{
+	m_Ptr.m_pWriteBatchFunc = pFunc;
+}
+
+CDbConnectionPool::CQueue::CQueue() :
+	m_FirstElem(0),
+	m_NumTasks(0),
+	m_NumRejected(0)
+{
+}
+
 CDbConnectionPool::CDbConnectionPool() :
-	m_NumElem(),
-	FirstElem(0),
-	LastElem(0)
+	m_NumRunningWorkers(0),
+	m_Shutdown(false),
+	m_NumBatches(0),
+	m_NumBatchedTasks(0)
 {
-	thread_init_and_detach(CDbConnectionPool::Worker, this, "database worker thread");
 }
 
 CDbConnectionPool::~CDbConnectionPool()
@@ -68,9 +94,33 @@ CDbConnectionPool::~CDbConnectionPool()
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
 	const char *ModeDesc[] = {"Read", "Write", "WriteBackup"};
-	for(unsigned int i = 0; i < m_aapDbConnections[DatabaseMode].size(); i++)
 	{
-		m_aapDbConnections[DatabaseMode][i]->Print(pConsole, ModeDesc[DatabaseMode]);
+		CScopeLock Lock(&m_DbConnectionsLock);
+		for(unsigned int i = 0; i < m_aapDbConnections[DatabaseMode].size(); i++)
+		{
+			m_aapDbConnections[DatabaseMode][i]->Print(pConsole, ModeDesc[DatabaseMode]);
+		}
+	}
+
+	if(DatabaseMode == Mode::WRITE_BACKUP)
+		return;
+	CQueue *pQueue = &m_aQueues[DatabaseMode == Mode::READ ? QUEUE_READ : QUEUE_WRITE];
+	int NumTasks;
+	{
+		CScopeLock Lock(&pQueue->m_Lock);
+		NumTasks = pQueue->m_NumTasks;
+	}
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "%s queue: %d/%d pending, %d rejected",
+		ModeDesc[DatabaseMode], NumTasks, (int)MAX_TASKS, pQueue->m_NumRejected.load());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	if(DatabaseMode == Mode::WRITE)
+	{
+		int NumBatches = m_NumBatches.load();
+		str_format(aBuf, sizeof(aBuf), "%d batches, %.1f writes per batch",
+			NumBatches, NumBatches ? m_NumBatchedTasks.load() / (float)NumBatches : 0.0f);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	}
 }
 
@@ -78,17 +128,64 @@ void CDbConnectionPool::RegisterDatabase(std::unique_ptr<IDbConnection> pDatabas
 {
 	if(DatabaseMode < 0 || NUM_MODES <= DatabaseMode)
 		return;
+	CScopeLock Lock(&m_DbConnectionsLock);
 	m_aapDbConnections[DatabaseMode].push_back(std::move(pDatabase));
 }
 
+void CDbConnectionPool::Start(int NumReadWorkers, int NumWriteWorkers)
+{
+	if(!m_vpWorkers.empty())
+		return;
+
+	int aNumWorkers[NUM_QUEUES];
+	aNumWorkers[QUEUE_READ] = clamp(NumReadWorkers, 1, (int)MAX_WORKERS);
+	aNumWorkers[QUEUE_WRITE] = clamp(NumWriteWorkers, 1, (int)MAX_WORKERS);
+	for(int Queue = 0; Queue < NUM_QUEUES; Queue++)
+	{
+		for(int i = 0; i < aNumWorkers[Queue]; i++)
+		{
+			std::unique_ptr<CWorker> pWorker(new CWorker());
+			pWorker->m_pPool = this;
+			pWorker->m_Queue = Queue;
+			pWorker->m_ReadServer = 0;
+			pWorker->m_WriteServer = 0;
+			m_vpWorkers.push_back(std::move(pWorker));
+		}
+	}
+
+	m_NumRunningWorkers.store(m_vpWorkers.size());
+	for(auto &pWorker : m_vpWorkers)
+		thread_init_and_detach(CDbConnectionPool::Worker, pWorker.get(), pWorker->m_Queue == QUEUE_READ ? "database read thread" : "database write thread");
+}
+
+void CDbConnectionPool::AddTask(int Queue, std::unique_ptr<CSqlExecData> pTask)
+{
+	CQueue *pQueue = &m_aQueues[Queue];
+	pQueue->m_Lock.Take();
+	if(pQueue->m_NumTasks == MAX_TASKS)
+	{
+		pQueue->m_Lock.Release();
+		pQueue->m_NumRejected++;
+		dbg_msg("sql", "%s rejected, too many pending requests", pTask->m_pName);
+		if(pTask->m_pThreadData->m_pResult != nullptr)
+		{
+			pTask->m_pThreadData->m_pResult->m_Success = false;
+			pTask->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
+		return;
+	}
+	pQueue->m_aTasks[(pQueue->m_FirstElem + pQueue->m_NumTasks) % MAX_TASKS] = std::move(pTask);
+	pQueue->m_NumTasks++;
+	pQueue->m_Lock.Release();
+	pQueue->m_NumElem.Signal();
+}
+
 void CDbConnectionPool::Execute(
 	FRead pFunc,
 	std::unique_ptr<const ISqlData> pThreadData,
 	const char *pName)
 {
-	m_aTasks[FirstElem++].reset(new CSqlExecData(pFunc, std::move(pThreadData), pName));
-	FirstElem %= sizeof(m_aTasks) / sizeof(m_aTasks[0]);
-	m_NumElem.Signal();
+	AddTask(QUEUE_READ, std::unique_ptr<CSqlExecData>(new CSqlExecData(pFunc, std::move(pThreadData), pName)));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -96,17 +193,25 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pThreadData,
 	const char *pName)
 {
-	m_aTasks[FirstElem++].reset(new CSqlExecData(pFunc, std::move(pThreadData), pName));
-	FirstElem %= sizeof(m_aTasks) / sizeof(m_aTasks[0]);
-	m_NumElem.Signal();
+	AddTask(QUEUE_WRITE, std::unique_ptr<CSqlExecData>(new CSqlExecData(pFunc, std::move(pThreadData), pName)));
+}
+
+void CDbConnectionPool::ExecuteWriteBatch(
+	FWriteBatch pFunc,
+	std::unique_ptr<const ISqlData> pThreadData,
+	const char *pName)
+{
+	AddTask(QUEUE_WRITE, std::unique_ptr<CSqlExecData>(new CSqlExecData(pFunc, std::move(pThreadData), pName)));
 }
 
 void CDbConnectionPool::OnShutdown()
 {
+	// one wakeup per worker that finds its queue empty
 	m_Shutdown.store(true);
-	m_NumElem.Signal();
+	for(auto &pWorker : m_vpWorkers)
+		m_aQueues[pWorker->m_Queue].m_NumElem.Signal();
 	int i = 0;
-	while(m_Shutdown.load())
+	while(m_NumRunningWorkers.load() > 0)
 	{
 		if(i > 600)
 		{
@@ -124,74 +229,200 @@ void CDbConnectionPool::OnShutdown()
 
 void CDbConnectionPool::Worker(void *pUser)
 {
-	CDbConnectionPool *pThis = (CDbConnectionPool *)pUser;
-	pThis->Worker();
+	CWorker *pWorker = (CWorker *)pUser;
+	pWorker->m_pPool->Worker(pWorker);
 }
 
-void CDbConnectionPool::Worker()
+void CDbConnectionPool::Worker(CWorker *pWorker)
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	int WriteServer = 0;
+	CQueue *pQueue = &m_aQueues[pWorker->m_Queue];
 	while(1)
 	{
-		m_NumElem.Wait();
-		auto pThreadData = std::move(m_aTasks[LastElem++]);
-		// work through all database jobs after OnShutdown is called before exiting the thread
+		pQueue->m_NumElem.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		pQueue->m_Lock.Take();
+		if(pQueue->m_NumTasks > 0)
+		{
+			pThreadData = std::move(pQueue->m_aTasks[pQueue->m_FirstElem]);
+			pQueue->m_FirstElem = (pQueue->m_FirstElem + 1) % MAX_TASKS;
+			pQueue->m_NumTasks--;
+		}
+		pQueue->m_Lock.Release();
+		// batches take tasks without their wakeup, so an empty queue only
+		// means that all database jobs are done after OnShutdown
 		if(pThreadData == nullptr)
 		{
-			m_Shutdown.store(false);
-			return;
+			if(m_Shutdown.load())
+				break;
+			continue;
 		}
-		LastElem %= sizeof(m_aTasks) / sizeof(m_aTasks[0]);
-		bool Success = false;
-		switch(pThreadData->m_Mode)
+		UpdateConnections(pWorker);
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_BATCH_ACCESS)
 		{
-		case CSqlExecData::READ_ACCESS:
+			std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+			vpBatch.push_back(std::move(pThreadData));
+			CollectBatch(pQueue, vpBatch);
+			ProcessBatch(pWorker, vpBatch);
+		}
+		else
 		{
-			for(int i = 0; i < (int)m_aapDbConnections[Mode::READ].size(); i++)
+			ProcessTask(pWorker, pThreadData.get());
+		}
+	}
+	m_NumRunningWorkers--;
+}
+
+void CDbConnectionPool::UpdateConnections(CWorker *pWorker)
+{
+	// databases can be added at runtime
+	CScopeLock Lock(&m_DbConnectionsLock);
+	for(int Mode = 0; Mode < NUM_MODES; Mode++)
+	{
+		for(unsigned i = pWorker->m_aapDbConnections[Mode].size(); i < m_aapDbConnections[Mode].size(); i++)
+			pWorker->m_aapDbConnections[Mode].emplace_back(m_aapDbConnections[Mode][i]->Copy());
+	}
+}
+
+void CDbConnectionPool::ProcessTask(CWorker *pWorker, CSqlExecData *pThreadData)
+{
+	auto &aapDbConnections = pWorker->m_aapDbConnections;
+	bool Success = false;
+	switch(pThreadData->m_Mode)
+	{
+	case CSqlExecData::READ_ACCESS:
+	{
+		for(int i = 0; i < (int)aapDbConnections[Mode::READ].size(); i++)
+		{
+			int CurServer = (pWorker->m_ReadServer + i) % (int)aapDbConnections[Mode::READ].size();
+			if(ExecSqlFunc(aapDbConnections[Mode::READ][CurServer].get(), pThreadData, false))
 			{
-				int CurServer = (ReadServer + i) % (int)m_aapDbConnections[Mode::READ].size();
-				if(ExecSqlFunc(m_aapDbConnections[Mode::READ][CurServer].get(), pThreadData.get(), false))
-				{
-					ReadServer = CurServer;
-					dbg_msg("sql", "%s done on read database %d", pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
+				pWorker->m_ReadServer = CurServer;
+				dbg_msg("sql", "%s done on read database %d", pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
 			}
 		}
-		break;
-		case CSqlExecData::WRITE_ACCESS:
+	}
+	break;
+	case CSqlExecData::WRITE_ACCESS:
+	{
+		for(int i = 0; i < (int)aapDbConnections[Mode::WRITE].size(); i++)
 		{
-			for(int i = 0; i < (int)m_aapDbConnections[Mode::WRITE].size(); i++)
+			int CurServer = (pWorker->m_WriteServer + i) % (int)aapDbConnections[Mode::WRITE].size();
+			if(ExecSqlFunc(aapDbConnections[Mode::WRITE][CurServer].get(), pThreadData, false))
 			{
-				int CurServer = (WriteServer + i) % (int)m_aapDbConnections[Mode::WRITE].size();
-				if(ExecSqlFunc(m_aapDbConnections[Mode::WRITE][i].get(), pThreadData.get(), false))
+				pWorker->m_WriteServer = CurServer;
+				dbg_msg("sql", "%s done on write database %d", pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			for(int i = 0; i < (int)aapDbConnections[Mode::WRITE_BACKUP].size(); i++)
+			{
+				if(ExecSqlFunc(aapDbConnections[Mode::WRITE_BACKUP][i].get(), pThreadData, true))
 				{
-					WriteServer = CurServer;
-					dbg_msg("sql", "%s done on write database %d", pThreadData->m_pName, CurServer);
+					dbg_msg("sql", "%s done on write backup database %d", pThreadData->m_pName, i);
 					Success = true;
 					break;
 				}
 			}
-			if(!Success)
+		}
+	}
+	break;
+	case CSqlExecData::WRITE_BATCH_ACCESS:
+		dbg_assert(false, "write batches are processed by ProcessBatch");
+		break;
+	}
+	if(!Success)
+		dbg_msg("sql", "%s failed on all databases", pThreadData->m_pName);
+	if(pThreadData->m_pThreadData->m_pResult != nullptr)
+	{
+		pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+		pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+	}
+}
+
+void CDbConnectionPool::CollectBatch(CQueue *pQueue, std::vector<std::unique_ptr<CSqlExecData>> &vpBatch)
+{
+	FWriteBatch pFunc = vpBatch[0]->m_Ptr.m_pWriteBatchFunc;
+	int MaxSize = clamp(g_Config.m_SvSqlBatchSize, 1, (int)MAX_BATCH_SIZE);
+	int64_t Deadline = time_get() + time_freq() * g_Config.m_SvSqlBatchDelay / 1000;
+	bool Woken = false;
+	while(1)
+	{
+		bool Blocked = false;
+		int NumTaken = 0;
+		pQueue->m_Lock.Take();
+		while((int)vpBatch.size() < MaxSize && pQueue->m_NumTasks > 0)
+		{
+			std::unique_ptr<CSqlExecData> &pNext = pQueue->m_aTasks[pQueue->m_FirstElem];
+			// keep the order of the writes
+			if(pNext->m_Mode != CSqlExecData::WRITE_BATCH_ACCESS || pNext->m_Ptr.m_pWriteBatchFunc != pFunc)
 			{
-				for(int i = 0; i < (int)m_aapDbConnections[Mode::WRITE_BACKUP].size(); i++)
-				{
-					if(ExecSqlFunc(m_aapDbConnections[Mode::WRITE_BACKUP][i].get(), pThreadData.get(), true))
-					{
-						dbg_msg("sql", "%s done on write backup database %d", pThreadData->m_pName, i);
-						Success = true;
-						break;
-					}
-				}
+				Blocked = true;
+				break;
 			}
+			vpBatch.push_back(std::move(pNext));
+			pQueue->m_FirstElem = (pQueue->m_FirstElem + 1) % MAX_TASKS;
+			pQueue->m_NumTasks--;
+			NumTaken++;
 		}
-		break;
+		pQueue->m_Lock.Release();
+
+		// a wakeup of a task that isn't part of the batch or of the
+		// shutdown is left for the worker loop, others belong to tasks that
+		// were already taken
+		if(Woken && NumTaken == 0 && (Blocked || m_Shutdown.load()))
+		{
+			pQueue->m_NumElem.Signal();
+			break;
 		}
-		if(!Success)
-			dbg_msg("sql", "%s failed on all databases", pThreadData->m_pName);
+		int64_t Left = Deadline - time_get();
+		if(Blocked || (int)vpBatch.size() >= MaxSize || m_Shutdown.load() || Left <= 0)
+			break;
+		Woken = pQueue->m_NumElem.TimedWait((Left * 1000 + time_freq() - 1) / time_freq());
+		if(!Woken)
+			break;
+	}
+}
+
+void CDbConnectionPool::ProcessBatch(CWorker *pWorker, std::vector<std::unique_ptr<CSqlExecData>> &vpBatch)
+{
+	auto &aapDbConnections = pWorker->m_aapDbConnections;
+	const char *pName = vpBatch[0]->m_pName;
+	bool Success = false;
+	for(int i = 0; i < (int)aapDbConnections[Mode::WRITE].size(); i++)
+	{
+		int CurServer = (pWorker->m_WriteServer + i) % (int)aapDbConnections[Mode::WRITE].size();
+		if(ExecSqlBatchFunc(aapDbConnections[Mode::WRITE][CurServer].get(), vpBatch, false))
+		{
+			pWorker->m_WriteServer = CurServer;
+			dbg_msg("sql", "%s (%d) done on write database %d", pName, (int)vpBatch.size(), CurServer);
+			Success = true;
+			break;
+		}
+	}
+	if(!Success)
+	{
+		for(int i = 0; i < (int)aapDbConnections[Mode::WRITE_BACKUP].size(); i++)
+		{
+			if(ExecSqlBatchFunc(aapDbConnections[Mode::WRITE_BACKUP][i].get(), vpBatch, true))
+			{
+				dbg_msg("sql", "%s (%d) done on write backup database %d", pName, (int)vpBatch.size(), i);
+				Success = true;
+				break;
+			}
+		}
+	}
+	if(!Success)
+		dbg_msg("sql", "%s (%d) failed on all databases", pName, (int)vpBatch.size());
+
+	m_NumBatches++;
+	m_NumBatchedTasks += vpBatch.size();
+	for(auto &pThreadData : vpBatch)
+	{
 		if(pThreadData->m_pThreadData->m_pResult != nullptr)
 		{
 			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
@@ -200,6 +431,38 @@ void CDbConnectionPool::Worker()
 	}
 }
 
+bool CDbConnectionPool::ExecSqlBatchFunc(IDbConnection *pConnection, std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool Failure)
+{
+	char aError[256] = "error message not initialized";
+	if(pConnection->Connect(aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed connecting to db: %s", aError);
+		return false;
+	}
+	std::vector<const ISqlData *> vpData;
+	for(auto &pThreadData : vpBatch)
+		vpData.push_back(pThreadData->m_pThreadData.get());
+
+	bool Success = false;
+	if(!pConnection->BeginTransaction(aError, sizeof(aError)))
+	{
+		Success = !vpBatch[0]->m_Ptr.m_pWriteBatchFunc(pConnection, vpData.data(), vpData.size(), Failure, aError, sizeof(aError)) &&
+			  !pConnection->CommitTransaction(aError, sizeof(aError));
+		if(!Success)
+		{
+			char aRollbackError[256];
+			if(pConnection->RollbackTransaction(aRollbackError, sizeof(aRollbackError)))
+				dbg_msg("sql", "rollback failed: %s", aRollbackError);
+		}
+	}
+	pConnection->Disconnect();
+	if(!Success)
+	{
+		dbg_msg("sql", "%s failed: %s", vpBatch[0]->m_pName, aError);
+	}
+	return Success;
+}
+
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, bool Failure)
 {
 	char aError[256] = "error message not initialized";
@@ -217,6 +480,9 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	case CSqlExecData::WRITE_ACCESS:
 		Success = !pData->m_Ptr.m_pWriteFunc(pConnection, pData->m_pThreadData.get(), Failure, aError, sizeof(aError));
 		break;
+	case CSqlExecData::WRITE_BATCH_ACCESS:
+		dbg_assert(false, "write batches are processed by ExecSqlBatchFunc");
+		break;
 	}
 	pConnection->Disconnect();
 	if(!Success)
@@ -43,6 +43,7 @@ public:
 	// Returns false on success.
 	typedef bool (*FRead)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize);
 	typedef bool (*FWrite)(IDbConnection *, const ISqlData *, bool, char *pError, int ErrorSize);
+	typedef bool (*FWriteBatch)(IDbConnection *, const ISqlData *const *, int NumData, bool, char *pError, int ErrorSize);
 
 	enum Mode
 	{
@@ -56,6 +57,10 @@ public:
 
 	void RegisterDatabase(std::unique_ptr<IDbConnection> pDatabase, Mode DatabaseMode);
 
+	// starts the worker threads, requests added before wait until then
+	void Start(int NumReadWorkers, int NumWriteWorkers);
+
+	// requests are rejected as failed when their queue is full
 	void Execute(
 		FRead pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
@@ -65,21 +70,77 @@ public:
 		FWrite pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
 		const char *pName);
+	// like ExecuteWrite, but consecutive requests with the same function
+	// are passed to it together and written in one transaction. waits up
+	// to sv_sql_batch_delay ms for sv_sql_batch_size requests
+	void ExecuteWriteBatch(
+		FWriteBatch pFunc,
+		std::unique_ptr<const ISqlData> pSqlRequestData,
+		const char *pName);
 
 	void OnShutdown();
 
 private:
+	enum
+	{
+		// reads and writes are queued separately, so a slow read never
+		// delays a write
+		QUEUE_READ = 0,
+		QUEUE_WRITE,
+		NUM_QUEUES,
+
+		MAX_TASKS = 512,
+		MAX_WORKERS = 16,
+		MAX_BATCH_SIZE = 64,
+	};
+
+	class CQueue
+	{
+	public:
+		CQueue();
+
+		CLock m_Lock;
+		CSemaphore m_NumElem;
+		int m_FirstElem;
+		int m_NumTasks;
+		std::unique_ptr<struct CSqlExecData> m_aTasks[MAX_TASKS];
+		std::atomic_int m_NumRejected;
+	};
+
+	class CWorker
+	{
+	public:
+		CDbConnectionPool *m_pPool;
+		int m_Queue;
+		// own copies of the registered databases
+		std::vector<std::unique_ptr<IDbConnection>> m_aapDbConnections[NUM_MODES];
+		// remember last working server and try to connect to it first
+		int m_ReadServer;
+		int m_WriteServer;
+	};
+
+	// only used to create the copies of the workers and to print them
+	CLock m_DbConnectionsLock;
 	std::vector<std::unique_ptr<IDbConnection>> m_aapDbConnections[NUM_MODES];
 
+	CQueue m_aQueues[NUM_QUEUES];
+	std::vector<std::unique_ptr<CWorker>> m_vpWorkers;
+	std::atomic_int m_NumRunningWorkers;
+	std::atomic_bool m_Shutdown;
+
+	std::atomic_int m_NumBatches;
+	std::atomic_int m_NumBatchedTasks;
+
+	void AddTask(int Queue, std::unique_ptr<struct CSqlExecData> pTask);
 	static void Worker(void *pUser);
-	void Worker();
+	void Worker(CWorker *pWorker);
+	void UpdateConnections(CWorker *pWorker);
+	void ProcessTask(CWorker *pWorker, struct CSqlExecData *pTask);
 	bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, bool Failure);
-
-	std::atomic_bool m_Shutdown;
-	CSemaphore m_NumElem;
-	int FirstElem;
-	int LastElem;
-	std::unique_ptr<struct CSqlExecData> m_aTasks[512];
+	// takes the following tasks of the same batch from the queue
+	void CollectBatch(CQueue *pQueue, std::vector<std::unique_ptr<struct CSqlExecData>> &vpBatch);
+	void ProcessBatch(CWorker *pWorker, std::vector<std::unique_ptr<struct CSqlExecData>> &vpBatch);
+	bool ExecSqlBatchFunc(IDbConnection *pConnection, std::vector<std::unique_ptr<struct CSqlExecData>> &vpBatch, bool Failure);
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
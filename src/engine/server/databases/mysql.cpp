@@ -1,10 +1,13 @@
 #include "connection.h"
 
 #if defined(CONF_SQL)
+#include "statement_cache.h"
+
 #include <mysql.h>
 
 #include <base/tl/threading.h>
 #include <engine/console.h>
+#include <engine/shared/config.h>
 
 #include <atomic>
 #include <memory>
@@ -77,6 +80,10 @@ public:
 	virtual bool Connect(char *pError, int ErrorSize);
 	virtual void Disconnect();
 
+	virtual bool BeginTransaction(char *pError, int ErrorSize);
+	virtual bool CommitTransaction(char *pError, int ErrorSize);
+	virtual bool RollbackTransaction(char *pError, int ErrorSize);
+
 	virtual bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize);
 
 	virtual void BindString(int Idx, const char *pString);
@@ -108,6 +115,7 @@ private:
 	void StoreErrorStmt(const char *pContext);
 	bool ConnectImpl();
 	bool PrepareAndExecuteStatement(const char *pStmt);
+	bool EndStatement(char *pError, int ErrorSize);
 	//static void DeleteResult(MYSQL_RES *pResult);
 
 	union UParameterExtra
@@ -120,7 +128,14 @@ private:
 	bool m_NewQuery = false;
 	bool m_HaveConnection = false;
 	MYSQL m_Mysql;
-	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pStmt = nullptr;
+	// statements belong to the server thread of the connection, they are
+	// dropped when it changes on reconnects
+	unsigned long m_ThreadID = 0;
+	CStatementCache<std::unique_ptr<MYSQL_STMT, CStmtDeleter>> m_StmtCache;
+	// for the statements while connecting
+	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pSetupStmt = nullptr;
+	// current statement, owned by m_StmtCache or m_pSetupStmt
+	MYSQL_STMT *m_pStmt = nullptr;
 	std::vector<MYSQL_BIND> m_aStmtParameters;
 	std::vector<UParameterExtra> m_aStmtParameterExtras;
 
@@ -168,6 +183,9 @@ CMysqlConnection::CMysqlConnection(
 
 CMysqlConnection::~CMysqlConnection()
 {
+	m_pStmt = nullptr;
+	m_StmtCache.Clear();
+	m_pSetupStmt = nullptr;
 	mysql_close(&m_Mysql);
 	g_MysqlNumConnections -= 1;
 }
@@ -179,17 +197,17 @@ void CMysqlConnection::StoreErrorMysql(const char *pContext)
 
 void CMysqlConnection::StoreErrorStmt(const char *pContext)
 {
-	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt.get()), mysql_stmt_error(m_pStmt.get()));
+	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt), mysql_stmt_error(m_pStmt));
 }
 
 bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
 	{
 		StoreErrorStmt("prepare");
 		return true;
 	}
-	if(mysql_stmt_execute(m_pStmt.get()))
+	if(mysql_stmt_execute(m_pStmt))
 	{
 		StoreErrorStmt("execute");
 		return true;
@@ -201,14 +219,16 @@ void CMysqlConnection::Print(IConsole *pConsole, const char *Mode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d",
-		Mode, m_aDatabase, GetPrefix(), m_aUser, m_aIp, m_Port);
+		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d Statement cache: %d hits, %d misses",
+		Mode, m_aDatabase, GetPrefix(), m_aUser, m_aIp, m_Port, m_StmtCache.Hits(), m_StmtCache.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
 CMysqlConnection *CMysqlConnection::Copy()
 {
-	return new CMysqlConnection(m_aDatabase, GetPrefix(), m_aUser, m_aPass, m_aIp, m_Port, m_Setup);
+	CMysqlConnection *pCopy = new CMysqlConnection(m_aDatabase, GetPrefix(), m_aUser, m_aPass, m_aIp, m_Port, m_Setup);
+	pCopy->m_StmtCache.ShareCounters(m_StmtCache);
+	return pCopy;
 }
 
 void CMysqlConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsigned int BufferSize)
@@ -237,24 +257,36 @@ bool CMysqlConnection::ConnectImpl()
 {
 	if(m_HaveConnection)
 	{
-		if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+		if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 		{
 			StoreErrorStmt("free_result");
 			dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
 		}
 		if(!mysql_select_db(&m_Mysql, m_aDatabase))
 		{
-			// Success.
+			// Success, MYSQL_OPT_RECONNECT might have reconnected though
+			if(mysql_thread_id(&m_Mysql) != m_ThreadID)
+			{
+				dbg_msg("mysql", "reconnected, dropping %d prepared statements", m_StmtCache.Num());
+				m_pStmt = nullptr;
+				m_StmtCache.Clear();
+				m_ThreadID = mysql_thread_id(&m_Mysql);
+			}
 			return false;
 		}
 		StoreErrorMysql("select_db");
 		dbg_msg("mysql", "ping error, trying to reconnect %s", m_aErrorDetail);
+		m_pStmt = nullptr;
+		m_StmtCache.Clear();
+		m_pSetupStmt = nullptr;
 		mysql_close(&m_Mysql);
 		mem_zero(&m_Mysql, sizeof(m_Mysql));
 		mysql_init(&m_Mysql);
 	}
 
 	m_pStmt = nullptr;
+	m_StmtCache.Clear();
+	m_pSetupStmt = nullptr;
 	unsigned int OptConnectTimeout = 60;
 	unsigned int OptReadTimeout = 60;
 	unsigned int OptWriteTimeout = 120;
@@ -271,8 +303,10 @@ bool CMysqlConnection::ConnectImpl()
 		return true;
 	}
 	m_HaveConnection = true;
+	m_ThreadID = mysql_thread_id(&m_Mysql);
 
-	m_pStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_pSetupStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_pStmt = m_pSetupStmt.get();
 
 	// Apparently MYSQL_SET_CHARSET_NAME is not enough
 	if(PrepareAndExecuteStatement("SET CHARACTER SET utf8mb4"))
@@ -330,16 +364,93 @@ void CMysqlConnection::Disconnect()
 	m_InUse.store(false);
 }
 
-bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+bool CMysqlConnection::EndStatement(char *pError, int ErrorSize)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	// the connection is out of sync for other queries while a result is pending
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 	{
-		StoreErrorStmt("prepare");
+		StoreErrorStmt("free_result");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	m_NewQuery = false;
+	return false;
+}
+
+bool CMysqlConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	if(EndStatement(pError, ErrorSize))
+	{
+		return true;
+	}
+	if(mysql_query(&m_Mysql, "START TRANSACTION"))
+	{
+		StoreErrorMysql("start_transaction");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	return false;
+}
+
+bool CMysqlConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	if(EndStatement(pError, ErrorSize))
+	{
+		return true;
+	}
+	if(mysql_commit(&m_Mysql))
+	{
+		StoreErrorMysql("commit");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	return false;
+}
+
+bool CMysqlConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	if(EndStatement(pError, ErrorSize))
+	{
+		return true;
+	}
+	if(mysql_rollback(&m_Mysql))
+	{
+		StoreErrorMysql("rollback");
 		str_copy(pError, m_aErrorDetail, ErrorSize);
 		return true;
 	}
+	return false;
+}
+
+bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+{
+	if(EndStatement(pError, ErrorSize))
+	{
+		return true;
+	}
+	auto *pCached = m_StmtCache.Find(pStmt);
+	if(pCached == nullptr)
+	{
+		std::unique_ptr<MYSQL_STMT, CStmtDeleter> pNewStmt(mysql_stmt_init(&m_Mysql));
+		m_pStmt = pNewStmt.get();
+		if(m_pStmt == nullptr)
+		{
+			StoreErrorMysql("stmt_init");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return true;
+		}
+		if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
+		{
+			StoreErrorStmt("prepare");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			m_pStmt = nullptr;
+			return true;
+		}
+		pCached = m_StmtCache.Add(pStmt, std::move(pNewStmt), g_Config.m_SvSqlStatementCache);
+	}
+	m_pStmt = pCached->get();
 	m_NewQuery = true;
-	unsigned NumParameters = mysql_stmt_param_count(m_pStmt.get());
+	unsigned NumParameters = mysql_stmt_param_count(m_pStmt);
 	m_aStmtParameters.resize(NumParameters);
 	m_aStmtParameterExtras.resize(NumParameters);
 	mem_zero(&m_aStmtParameters[0], sizeof(m_aStmtParameters[0]) * m_aStmtParameters.size());
@@ -421,20 +532,20 @@ bool CMysqlConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_aStmtParameters[0]))
+		if(mysql_stmt_bind_param(m_pStmt, &m_aStmtParameters[0]))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
 	}
-	int Result = mysql_stmt_fetch(m_pStmt.get());
+	int Result = mysql_stmt_fetch(m_pStmt);
 	if(Result == 1)
 	{
 		StoreErrorStmt("fetch");
@@ -452,19 +563,19 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_aStmtParameters[0]))
+		if(mysql_stmt_bind_param(m_pStmt, &m_aStmtParameters[0]))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt.get());
+		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt);
 		return false;
 	}
 	str_copy(pError, "tried to execute update without query", ErrorSize);
@@ -485,7 +596,7 @@ bool CMysqlConnection::IsNull(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:null");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -509,7 +620,7 @@ float CMysqlConnection::GetFloat(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:float");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -537,7 +648,7 @@ int CMysqlConnection::GetInt(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -571,7 +682,7 @@ void CMysqlConnection::GetString(int Col, char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:string");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -603,7 +714,7 @@ int CMysqlConnection::GetBlob(int Col, unsigned char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:blob");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -1,11 +1,15 @@
 #include "connection.h"
+#include "statement_cache.h"
 
 #include <sqlite3.h>
 
 #include <base/math.h>
 #include <engine/console.h>
+#include <engine/shared/config.h>
 
 #include <atomic>
+#include <limits>
+#include <memory>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -27,6 +31,10 @@ public:
 	virtual bool Connect(char *pError, int ErrorSize);
 	virtual void Disconnect();
 
+	virtual bool BeginTransaction(char *pError, int ErrorSize);
+	virtual bool CommitTransaction(char *pError, int ErrorSize);
+	virtual bool RollbackTransaction(char *pError, int ErrorSize);
+
 	virtual bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize);
 
 	virtual void BindString(int Idx, const char *pString);
@@ -48,13 +56,23 @@ public:
 	virtual bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize);
 
 private:
+	class CStmtDeleter
+	{
+	public:
+		void operator()(sqlite3_stmt *pStmt) const { sqlite3_finalize(pStmt); }
+	};
+
 	// copy of config vars
 	char m_aFilename[512];
 	bool m_Setup;
 
 	sqlite3 *m_pDb;
+	// owned by m_StmtCache
 	sqlite3_stmt *m_pStmt;
 	bool m_Done; // no more rows available for Step
+	CStatementCache<std::unique_ptr<sqlite3_stmt, CStmtDeleter>> m_StmtCache;
+	// resets the statement for the next use and unbinds the parameters
+	void EndStatement();
 	// returns false, if the query succeeded
 	bool Execute(const char *pQuery, char *pError, int ErrorSize);
 
@@ -78,8 +96,9 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 
 CSqliteConnection::~CSqliteConnection()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	// statements have to be finalized before closing
+	m_pStmt = nullptr;
+	m_StmtCache.Clear();
 	sqlite3_close(m_pDb);
 	m_pDb = nullptr;
 }
@@ -88,8 +107,8 @@ void CSqliteConnection::Print(IConsole *pConsole, const char *Mode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"SQLite-%s: DB: '%s'",
-		Mode, m_aFilename);
+		"SQLite-%s: DB: '%s' Statement cache: %d hits, %d misses",
+		Mode, m_aFilename, m_StmtCache.Hits(), m_StmtCache.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -100,7 +119,9 @@ void CSqliteConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsi
 
 CSqliteConnection *CSqliteConnection::Copy()
 {
-	return new CSqliteConnection(m_aFilename, m_Setup);
+	CSqliteConnection *pCopy = new CSqliteConnection(m_aFilename, m_Setup);
+	pCopy->m_StmtCache.ShareCounters(m_StmtCache);
+	return pCopy;
 }
 
 bool CSqliteConnection::Connect(char *pError, int ErrorSize)
@@ -122,8 +143,9 @@ bool CSqliteConnection::Connect(char *pError, int ErrorSize)
 		return true;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors,
+	// a negative timeout would disable waiting
+	sqlite3_busy_timeout(m_pDb, std::numeric_limits<int>::max());
 
 	if(m_Setup)
 	{
@@ -150,27 +172,62 @@ bool CSqliteConnection::Connect(char *pError, int ErrorSize)
 
 void CSqliteConnection::Disconnect()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
-	m_pStmt = nullptr;
+	EndStatement();
 	m_InUse.store(false);
 }
 
-bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+void CSqliteConnection::EndStatement()
 {
+	// a statement that is still running keeps its locks until reset
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	{
+		sqlite3_reset(m_pStmt);
+		sqlite3_clear_bindings(m_pStmt);
+	}
 	m_pStmt = nullptr;
-	int Result = sqlite3_prepare_v2(
-		m_pDb,
-		pStmt,
-		-1, // pStmt can be any length
-		&m_pStmt,
-		NULL);
-	if(FormatError(Result, pError, ErrorSize))
+	m_Done = true;
+}
+
+bool CSqliteConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	EndStatement();
+	// take the write lock right away, other connections might write in between otherwise
+	return Execute("BEGIN IMMEDIATE", pError, ErrorSize);
+}
+
+bool CSqliteConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	EndStatement();
+	return Execute("COMMIT", pError, ErrorSize);
+}
+
+bool CSqliteConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	EndStatement();
+	return Execute("ROLLBACK", pError, ErrorSize);
+}
+
+bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+{
+	EndStatement();
+	auto *pCached = m_StmtCache.Find(pStmt);
+	if(pCached == nullptr)
 	{
-		return true;
+		sqlite3_stmt *pNewStmt = nullptr;
+		int Result = sqlite3_prepare_v2(
+			m_pDb,
+			pStmt,
+			-1, // pStmt can be any length
+			&pNewStmt,
+			NULL);
+		if(FormatError(Result, pError, ErrorSize))
+		{
+			sqlite3_finalize(pNewStmt);
+			return true;
+		}
+		pCached = m_StmtCache.Add(pStmt, std::unique_ptr<sqlite3_stmt, CStmtDeleter>(pNewStmt), g_Config.m_SvSqlStatementCache);
 	}
+	m_pStmt = pCached->get();
 	m_Done = false;
 	return false;
 }
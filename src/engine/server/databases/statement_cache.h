@@ -0,0 +1,79 @@
+#ifndef ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+#define ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// prepared statements of a connection by query text, least recently used
+// are dropped first. TStmt owns the statement, e.g. a std::unique_ptr
+// with a deleter freeing it
+template<typename TStmt>
+class CStatementCache
+{
+public:
+	CStatementCache() :
+		m_pCounters(std::make_shared<CCounters>())
+	{
+	}
+
+	// counts the hits and misses of this cache together with Other's, for
+	// connections copied to the workers
+	void ShareCounters(const CStatementCache &Other) { m_pCounters = Other.m_pCounters; }
+
+	// returns nullptr if the statement has to be prepared and added
+	TStmt *Find(const char *pQuery)
+	{
+		auto Entry = m_Entries.find(pQuery);
+		if(Entry == m_Entries.end())
+		{
+			m_pCounters->m_Misses++;
+			return nullptr;
+		}
+		m_pCounters->m_Hits++;
+		m_Lru.splice(m_Lru.begin(), m_Lru, Entry->second);
+		return &Entry->second->second;
+	}
+
+	// frees the least recently used statements if more than Capacity are
+	// cached, never the added one
+	TStmt *Add(const char *pQuery, TStmt Stmt, int Capacity)
+	{
+		m_Lru.emplace_front(pQuery, std::move(Stmt));
+		m_Entries[m_Lru.front().first] = m_Lru.begin();
+		while((int)m_Lru.size() > Capacity && m_Lru.size() > 1)
+		{
+			m_Entries.erase(m_Lru.back().first);
+			m_Lru.pop_back();
+		}
+		return &m_Lru.front().second;
+	}
+
+	void Clear()
+	{
+		m_Entries.clear();
+		m_Lru.clear();
+	}
+
+	int Num() const { return m_Lru.size(); }
+	int Hits() const { return m_pCounters->m_Hits.load(); }
+	int Misses() const { return m_pCounters->m_Misses.load(); }
+
+private:
+	typedef std::list<std::pair<std::string, TStmt>> CLru;
+	CLru m_Lru;
+	std::unordered_map<std::string, typename CLru::iterator> m_Entries;
+
+	// read when printing the connections
+	struct CCounters
+	{
+		std::atomic<int> m_Hits{0};
+		std::atomic<int> m_Misses{0};
+	};
+	std::shared_ptr<CCounters> m_pCounters;
+};
+
+#endif // ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
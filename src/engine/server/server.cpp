@@ -291,6 +291,11 @@ CServer::CServer() :
 		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
 	m_aDemoRecorder[MAX_CLIENTS] = CDemoRecorder(&m_SnapshotDelta, false);
 
+	m_EmptySnapshot.Clear();
+	m_NumSnapshotWorkers = 0;
+	m_NumSnapshotClients = 0;
+	m_NextSnapshotClient = 0;
+
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
@@ -853,6 +858,17 @@ void CServer::DoSnapshot()
 		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	// the cached deltas point into the snapshot storages of the clients,
+	// they are only valid until the next snapshot is stored
+	m_SnapshotDeltaCache.Clear();
+
+	if(g_Config.m_SvSnapshotThreads > 0)
+	{
+		DoSnapshotParallel();
+		GameServer()->OnPostSnap();
+		return;
+	}
+
 	// create snapshots for all clients
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -875,11 +891,8 @@ void CServer::DoSnapshot()
 			char aCompData[CSnapshot::MAX_SIZE];
 			int SnapshotSize;
 			int Crc;
-			static CSnapshot s_EmptySnap;
-			CSnapshot *pDeltashot = &s_EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
+			int DeltaTick;
+			bool Recover;
 
 			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
 
@@ -896,83 +909,222 @@ void CServer::DoSnapshot()
 
 			Crc = pData->Crc();
 
-			// remove old snapshos
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
+			CSnapshot *pFrom, *pTo;
+			StoreSnapshot(i, pData, SnapshotSize, &pFrom, &pTo, &DeltaTick, &Recover);
 
-			// save it the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+			// no acked package found, force client to recover rate
+			if(Recover)
+				m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
 
-			// find snapshot that we can perform delta against
-			s_EmptySnap.Clear();
+			// clients with the same snapshot and delta base get the same delta
+			CSnapshotDeltaCache::CEntry *pEntry = nullptr;
+			unsigned FromCrc = 0;
+			if(g_Config.m_SvSnapshotDeltaCache)
+			{
+				FromCrc = pFrom->Crc();
+				pEntry = m_SnapshotDeltaCache.Find(pFrom, FromCrc, pTo, Crc, m_aClients[i].m_Sixup);
+			}
 
+			if(pEntry)
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
+				SendSnapshot(i, pEntry->m_vCompData.data(), pEntry->m_CompSize, Crc, DeltaTick);
 			}
+			else
+			{
+				int CompSize = CreateSnapshotDelta(pFrom, pTo, m_aClients[i].m_Sixup, &m_SnapshotDelta, aDeltaData, aCompData, sizeof(aCompData));
+				if(g_Config.m_SvSnapshotDeltaCache)
+					m_SnapshotDeltaCache.SetCompData(m_SnapshotDeltaCache.Add(pFrom, FromCrc, pTo, Crc, m_aClients[i].m_Sixup, i), aCompData, CompSize);
+				SendSnapshot(i, aCompData, CompSize, Crc, DeltaTick);
+			}
+		}
+	}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	GameServer()->OnPostSnap();
+}
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+void CServer::StoreSnapshot(int ClientID, CSnapshot *pData, int SnapshotSize, CSnapshot **ppFrom, CSnapshot **ppTo, int *pDeltaTick, bool *pRecover)
+{
+	CClient *pClient = &m_aClients[ClientID];
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+	// remove old snapshos
+	// keep 3 seconds worth of snapshots
+	pClient->m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	// save it the snapshot
+	pClient->m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+	*ppTo = pClient->m_Snapshots.m_pLast->m_pSnap;
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+	// find snapshot that we can perform delta against
+	*ppFrom = &m_EmptySnapshot;
+	*pDeltaTick = -1;
+	*pRecover = false;
+	if(pClient->m_Snapshots.Get(pClient->m_LastAckedSnapshot, 0, ppFrom, 0) >= 0)
+		*pDeltaTick = pClient->m_LastAckedSnapshot;
+	else if(pClient->m_SnapRate == CClient::SNAPRATE_FULL)
+		*pRecover = true;
+}
+
+int CServer::CreateSnapshotDelta(CSnapshot *pFrom, CSnapshot *pTo, bool Sixup, CSnapshotDelta *pSnapshotDelta, char *pDeltaData, char *pCompData, int CompDataSize)
+{
+	// create delta
+	pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Sixup);
+	pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Sixup);
+	int DeltaSize = pSnapshotDelta->CreateDelta(pFrom, pTo, pDeltaData);
+	if(!DeltaSize)
+		return 0;
+
+	// compress it
+	return CVariableInt::Compress(pDeltaData, DeltaSize, pCompData, CompDataSize);
+}
+
+void CServer::SendSnapshot(int ClientID, const char *pCompData, int CompSize, int Crc, int DeltaTick)
+{
+	if(CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets = (CompSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = CompSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+				CMsgPacker Msg(NETMSG_SNAP, true);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
 			}
 		}
 	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+	}
+}
 
-	GameServer()->OnPostSnap();
+void CServer::CSnapshotJob::Run()
+{
+	CServer *pServer = m_pServer;
+	while(true)
+	{
+		int Index = pServer->m_NextSnapshotClient.fetch_add(1);
+		if(Index >= pServer->m_NumSnapshotClients)
+			break;
+
+		int ClientID = pServer->m_aSnapshotClients[Index];
+		CClientSnapshot *pSnap = pServer->m_apClientSnapshots[ClientID].get();
+		if(pSnap->m_DeltaClientID != ClientID)
+			continue;
+		pSnap->m_CompSize = pServer->CreateSnapshotDelta(pSnap->m_pDeltaFrom, pSnap->m_pDeltaTo, pServer->m_aClients[ClientID].m_Sixup, &m_pWorker->m_SnapshotDelta, m_pWorker->m_aDeltaData, pSnap->m_aCompData, sizeof(pSnap->m_aCompData));
+	}
+}
+
+void CServer::DoSnapshotParallel()
+{
+	// the thread count can't be changed once the workers are running
+	if(!m_NumSnapshotWorkers)
+	{
+		m_NumSnapshotWorkers = minimum((int)g_Config.m_SvSnapshotThreads, (int)CJobPool::MAX_THREADS);
+		for(int i = 0; i < m_NumSnapshotWorkers; i++)
+			m_apSnapshotWorkers[i].reset(new CSnapshotWorker(m_SnapshotDelta));
+		m_SnapshotJobPool.Init(m_NumSnapshotWorkers);
+	}
+
+	// build the snapshots on the main thread, the game state is not thread-safe
+	m_NumSnapshotClients = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		// client must be ingame to receive snapshots
+		if(m_aClients[i].m_State != CClient::STATE_INGAME)
+			continue;
+
+		// this client is trying to recover, don't spam snapshots
+		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_RECOVER && (Tick() % 50) != 0)
+			continue;
+
+		// this client is trying to recover, don't spam snapshots
+		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
+			continue;
+
+		if(!m_apClientSnapshots[i])
+			m_apClientSnapshots[i].reset(new CClientSnapshot());
+		CClientSnapshot *pSnap = m_apClientSnapshots[i].get();
+		CSnapshot *pData = (CSnapshot *)pSnap->m_aData;
+
+		m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+
+		GameServer()->OnSnap(i);
+
+		// finish snapshot
+		pSnap->m_SnapshotSize = m_SnapshotBuilder.Finish(pData);
+
+		if(m_aDemoRecorder[i].IsRecording())
+		{
+			// write snapshot
+			m_aDemoRecorder[i].RecordSnapshot(Tick(), pSnap->m_aData, pSnap->m_SnapshotSize);
+		}
+
+		// the demo recorders share m_SnapshotDelta, keep its sizes in sync with the serial path
+		m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
+		m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
+
+		pSnap->m_Crc = pData->Crc();
+		StoreSnapshot(i, pData, pSnap->m_SnapshotSize, &pSnap->m_pDeltaFrom, &pSnap->m_pDeltaTo, &pSnap->m_DeltaTick, &pSnap->m_Recover);
+
+		// clients sharing a delta get the one of the first of them
+		pSnap->m_DeltaClientID = i;
+		if(g_Config.m_SvSnapshotDeltaCache)
+		{
+			unsigned FromCrc = pSnap->m_pDeltaFrom->Crc();
+			CSnapshotDeltaCache::CEntry *pEntry = m_SnapshotDeltaCache.Find(pSnap->m_pDeltaFrom, FromCrc, pSnap->m_pDeltaTo, pSnap->m_Crc, m_aClients[i].m_Sixup);
+			if(pEntry)
+				pSnap->m_DeltaClientID = pEntry->m_Owner;
+			else
+				m_SnapshotDeltaCache.Add(pSnap->m_pDeltaFrom, FromCrc, pSnap->m_pDeltaTo, pSnap->m_Crc, m_aClients[i].m_Sixup, i);
+		}
+		m_aSnapshotClients[m_NumSnapshotClients++] = i;
+	}
+
+	// create the deltas and compress them on the workers
+	int NumJobs = minimum(m_NumSnapshotWorkers, m_NumSnapshotClients);
+	m_NextSnapshotClient = 0;
+	for(int i = 0; i < NumJobs; i++)
+		m_SnapshotJobPool.Add(std::make_shared<CSnapshotJob>(this, m_apSnapshotWorkers[i].get()), CJobPool::PRIORITY_NORMAL, &m_SnapshotJobs);
+	m_SnapshotJobs.Wait();
+
+	// send them in client order
+	for(int i = 0; i < m_NumSnapshotClients; i++)
+	{
+		int ClientID = m_aSnapshotClients[i];
+		CClientSnapshot *pSnap = m_apClientSnapshots[ClientID].get();
+
+		// no acked package found, force client to recover rate
+		if(pSnap->m_Recover)
+			m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_RECOVER;
+
+		CClientSnapshot *pDelta = m_apClientSnapshots[pSnap->m_DeltaClientID].get();
+		SendSnapshot(ClientID, pDelta->m_aCompData, pDelta->m_CompSize, pSnap->m_Crc, pSnap->m_DeltaTick);
+	}
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -1742,15 +1894,16 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 	}
 }
 
+// called with m_ServerInfoLock taken
 bool CServer::RateLimitServerInfoConnless()
 {
 	bool SendClients = true;
 	if(g_Config.m_SvServerInfoPerSecond)
 	{
 		SendClients = m_ServerInfoNumRequests <= g_Config.m_SvServerInfoPerSecond;
-		const int64_t Now = Tick();
+		const int64_t Now = time_get();
 
-		if(Now <= m_ServerInfoFirstRequest + TickSpeed())
+		if(Now <= m_ServerInfoFirstRequest + time_freq())
 		{
 			m_ServerInfoNumRequests++;
 		}
@@ -1764,9 +1917,55 @@ bool CServer::RateLimitServerInfoConnless()
 	return SendClients;
 }
 
-void CServer::SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type)
+bool CServer::ConnlessCallback(NETSOCKET Socket, const CNetChunk *pPacket, SECURITY_TOKEN ResponseToken, void *pUser)
+{
+	return ((CServer *)pUser)->ProcessServerInfoRequest(Socket, pPacket, ResponseToken);
+}
+
+// runs on the network thread if there is one, only uses the caches
+bool CServer::ProcessServerInfoRequest(NETSOCKET Socket, const CNetChunk *pPacket, SECURITY_TOKEN ResponseToken)
 {
-	SendServerInfo(pAddr, Token, Type, RateLimitServerInfoConnless());
+	int ExtraToken = 0;
+	int Type = -1;
+	if(pPacket->m_DataSize >= (int)sizeof(SERVERBROWSE_GETINFO) + 1 &&
+		mem_comp(pPacket->m_pData, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO)) == 0)
+	{
+		if(pPacket->m_Flags & NETSENDFLAG_EXTENDED)
+		{
+			Type = SERVERINFO_EXTENDED;
+			ExtraToken = (pPacket->m_aExtraData[0] << 8) | pPacket->m_aExtraData[1];
+		}
+		else
+			Type = SERVERINFO_VANILLA;
+	}
+	else if(pPacket->m_DataSize >= (int)sizeof(SERVERBROWSE_GETINFO_64_LEGACY) + 1 &&
+		mem_comp(pPacket->m_pData, SERVERBROWSE_GETINFO_64_LEGACY, sizeof(SERVERBROWSE_GETINFO_64_LEGACY)) == 0)
+	{
+		Type = SERVERINFO_64_LEGACY;
+	}
+	if(Type == -1)
+		return false;
+
+	if(Type == SERVERINFO_VANILLA && ResponseToken != NET_SECURITY_TOKEN_UNKNOWN && g_Config.m_SvSixup)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset((unsigned char *)pPacket->m_pData + sizeof(SERVERBROWSE_GETINFO), pPacket->m_DataSize - sizeof(SERVERBROWSE_GETINFO));
+		int SrvBrwsToken = Unpacker.GetInt();
+		if(!Unpacker.Error())
+			SendServerInfoSixupConnless(Socket, &pPacket->m_Address, SrvBrwsToken, ResponseToken);
+	}
+	else
+	{
+		int Token = ((unsigned char *)pPacket->m_pData)[sizeof(SERVERBROWSE_GETINFO)];
+		Token |= ExtraToken << 8;
+		bool SendClients;
+		{
+			CScopeLock Lock(&m_ServerInfoLock);
+			SendClients = RateLimitServerInfoConnless();
+		}
+		SendServerInfo(Socket, &pPacket->m_Address, Token, Type, SendClients);
+	}
+	return true;
 }
 
 static inline int GetCacheIndex(int Type, bool SendClient)
@@ -1779,33 +1978,37 @@ static inline int GetCacheIndex(int Type, bool SendClient)
 	return Type * 2 + SendClient;
 }
 
-CServer::CCache::CCache()
+// puts the connless header and the response type in front of the cached
+// chunks, so a request only has to fill in its token
+static void SetServerInfoPrefix(CServerInfoCache *pCache, int Type)
 {
-	m_Cache.clear();
-}
-
-CServer::CCache::~CCache()
-{
-	Clear();
-}
-
-CServer::CCache::CCacheChunk::CCacheChunk(const void *pData, int Size)
-{
-	mem_copy(m_aData, pData, Size);
-	m_DataSize = Size;
-}
-
-void CServer::CCache::AddChunk(const void *pData, int Size)
-{
-	m_Cache.emplace_back(pData, Size);
-}
+	const unsigned char *pFirst;
+	const unsigned char *pMore;
+	switch(Type)
+	{
+	case SERVERINFO_EXTENDED:
+		pFirst = SERVERBROWSE_INFO_EXTENDED;
+		pMore = SERVERBROWSE_INFO_EXTENDED_MORE;
+		break;
+	case SERVERINFO_64_LEGACY:
+		pFirst = pMore = SERVERBROWSE_INFO_64_LEGACY;
+		break;
+	case SERVERINFO_VANILLA:
+		pFirst = pMore = SERVERBROWSE_INFO;
+		break;
+	default: dbg_assert(false, "unknown serverinfo type"); return;
+	}
 
-void CServer::CCache::Clear()
-{
-	m_Cache.clear();
+	unsigned char aFirst[6 + sizeof(SERVERBROWSE_INFO)];
+	unsigned char aMore[6 + sizeof(SERVERBROWSE_INFO)];
+	for(int i = 0; i < 6; i++)
+		aFirst[i] = aMore[i] = 0xff;
+	mem_copy(aFirst + 6, pFirst, sizeof(SERVERBROWSE_INFO));
+	mem_copy(aMore + 6, pMore, sizeof(SERVERBROWSE_INFO));
+	pCache->SetPrefix(aFirst, sizeof(aFirst), aMore, sizeof(aMore));
 }
 
-void CServer::CacheServerInfo(CCache *pCache, int Type, bool SendClients)
+void CServer::CacheServerInfo(CServerInfoCache *pCache, int Type, bool SendClients)
 {
 	pCache->Clear();
 
@@ -2001,7 +2204,7 @@ void CServer::CacheServerInfo(CCache *pCache, int Type, bool SendClients)
 #undef ADD_INT
 }
 
-void CServer::CacheServerInfoSixup(CCache *pCache, bool SendClients)
+void CServer::CacheServerInfoSixup(CServerInfoCache *pCache, bool SendClients)
 {
 	pCache->Clear();
 
@@ -2065,58 +2268,50 @@ void CServer::CacheServerInfoSixup(CCache *pCache, bool SendClients)
 
 void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
 {
-	CPacker p;
-	char aBuf[128];
-	p.Reset();
-
-	CCache *pCache = &m_aServerInfoCache[GetCacheIndex(Type, SendClients)];
+	SendServerInfo(m_NetServer.Socket(), pAddr, Token, Type, SendClients);
+}
 
-#define ADD_RAW(p, x) (p).AddRaw(x, sizeof(x))
-#define ADD_INT(p, x) \
-	do \
-	{ \
-		str_format(aBuf, sizeof(aBuf), "%d", x); \
-		(p).AddString(aBuf, 0); \
-	} while(0)
+void CServer::SendServerInfo(NETSOCKET Socket, const NETADDR *pAddr, int Token, int Type, bool SendClients)
+{
+	// the packets are put together in the cache
+	CScopeLock Lock(&m_ServerInfoLock);
+	CServerInfoCache *pCache = &m_aServerInfoCache[GetCacheIndex(Type, SendClients)];
 
-	CNetChunk Packet;
-	Packet.m_ClientID = -1;
-	Packet.m_Address = *pAddr;
-	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	char aToken[16];
+	str_format(aToken, sizeof(aToken), "%d", Token);
+	int TokenSize = str_length(aToken) + 1;
 
-	for(const auto &Chunk : pCache->m_Cache)
+	for(auto &Chunk : pCache->m_Cache)
 	{
-		p.Reset();
-		if(Type == SERVERINFO_EXTENDED)
-		{
-			if(&Chunk == &pCache->m_Cache.front())
-				p.AddRaw(SERVERBROWSE_INFO_EXTENDED, sizeof(SERVERBROWSE_INFO_EXTENDED));
-			else
-				p.AddRaw(SERVERBROWSE_INFO_EXTENDED_MORE, sizeof(SERVERBROWSE_INFO_EXTENDED_MORE));
-			ADD_INT(p, Token);
-		}
-		else if(Type == SERVERINFO_64_LEGACY)
-		{
-			ADD_RAW(p, SERVERBROWSE_INFO_64_LEGACY);
-			ADD_INT(p, Token);
-		}
-		else if(Type == SERVERINFO_VANILLA || Type == SERVERINFO_INGAME)
-		{
-			ADD_RAW(p, SERVERBROWSE_INFO);
-			ADD_INT(p, Token);
-		}
-		else
+		int Size;
+		unsigned char *pPacket = Chunk.Packet(aToken, TokenSize, &Size);
+		if(Size - 6 >= NET_MAX_PAYLOAD)
 		{
-			dbg_assert(false, "unknown serverinfo type");
+			dbg_msg("server", "serverinfo packet too big. %d. dropping packet", Size);
+			continue;
 		}
-
-		p.AddRaw(Chunk.m_aData, Chunk.m_DataSize);
-		Packet.m_pData = p.Data();
-		Packet.m_DataSize = p.Size();
-		m_NetServer.Send(&Packet);
+		m_NetServer.SendConnlessRaw(Socket, pAddr, pPacket, Size);
 	}
 }
 
+void CServer::SendServerInfoSixupConnless(NETSOCKET Socket, const NETADDR *pAddr, int Token, SECURITY_TOKEN ResponseToken)
+{
+	CScopeLock Lock(&m_ServerInfoLock);
+	CServerInfoCache *pCache = &m_aSixupServerInfoCache[RateLimitServerInfoConnless()];
+	// requests can come in before the first map is loaded
+	if(pCache->m_Cache.empty())
+		return;
+	CServerInfoCache::CChunk &Chunk = pCache->m_Cache.front();
+
+	unsigned char aToken[8];
+	int TokenSize = CVariableInt::Pack(aToken, Token) - aToken;
+	int Size;
+	unsigned char *pPacket = Chunk.Packet(aToken, TokenSize, &Size);
+	if(Size > NET_MAX_PACKETSIZE)
+		return;
+	m_NetServer.SendConnlessSixupRaw(Socket, pAddr, pPacket, Size, ResponseToken);
+}
+
 void CServer::GetServerInfoSixup(CPacker *pPacker, int Token, bool SendClients)
 {
 	if(Token != -1)
@@ -2128,8 +2323,8 @@ void CServer::GetServerInfoSixup(CPacker *pPacker, int Token, bool SendClients)
 
 	SendClients = SendClients && Token != -1;
 
-	CCache::CCacheChunk &FirstChunk = m_aSixupServerInfoCache[SendClients].m_Cache.front();
-	pPacker->AddRaw(FirstChunk.m_aData, FirstChunk.m_DataSize);
+	CServerInfoCache::CChunk &FirstChunk = m_aSixupServerInfoCache[SendClients].m_Cache.front();
+	pPacker->AddRaw(FirstChunk.Data(), FirstChunk.m_DataSize);
 }
 
 void CServer::ExpireServerInfo()
@@ -2142,12 +2337,26 @@ void CServer::UpdateServerInfo(bool Resend)
 	if(m_RunServer == UNINITIALIZED)
 		return;
 
-	for(int i = 0; i < 3; i++)
-		for(int j = 0; j < 2; j++)
-			CacheServerInfo(&m_aServerInfoCache[i * 2 + j], i, j);
+	{
+		CScopeLock Lock(&m_ServerInfoLock);
+		for(int i = 0; i < 3; i++)
+		{
+			for(int j = 0; j < 2; j++)
+			{
+				CacheServerInfo(&m_aServerInfoCache[i * 2 + j], i, j);
+				SetServerInfoPrefix(&m_aServerInfoCache[i * 2 + j], i);
+			}
+		}
 
-	for(int i = 0; i < 2; i++)
-		CacheServerInfoSixup(&m_aSixupServerInfoCache[i], i);
+		// 0.7 connless header with room for the security tokens
+		unsigned char aSixupPrefix[1 + 8 + sizeof(SERVERBROWSE_INFO)] = {NET_PACKETFLAG_CONNLESS << 2 | 1};
+		mem_copy(aSixupPrefix + 9, SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
+		for(int i = 0; i < 2; i++)
+		{
+			CacheServerInfoSixup(&m_aSixupServerInfoCache[i], i);
+			m_aSixupServerInfoCache[i].SetPrefix(aSixupPrefix, sizeof(aSixupPrefix), aSixupPrefix, sizeof(aSixupPrefix));
+		}
+	}
 
 	if(Resend)
 	{
@@ -2191,58 +2400,11 @@ void CServer::PumpNetwork(bool PacketWaiting)
 					continue;
 				}
 
-				if(ResponseToken != NET_SECURITY_TOKEN_UNKNOWN && g_Config.m_SvSixup &&
-					m_RegSixup.RegisterProcessPacket(&Packet, ResponseToken))
-					continue;
-				if(ResponseToken == NET_SECURITY_TOKEN_UNKNOWN && m_Register.RegisterProcessPacket(&Packet))
-					continue;
-
-				{
-					int ExtraToken = 0;
-					int Type = -1;
-					if(Packet.m_DataSize >= (int)sizeof(SERVERBROWSE_GETINFO) + 1 &&
-						mem_comp(Packet.m_pData, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO)) == 0)
-					{
-						if(Packet.m_Flags & NETSENDFLAG_EXTENDED)
-						{
-							Type = SERVERINFO_EXTENDED;
-							ExtraToken = (Packet.m_aExtraData[0] << 8) | Packet.m_aExtraData[1];
-						}
-						else
-							Type = SERVERINFO_VANILLA;
-					}
-					else if(Packet.m_DataSize >= (int)sizeof(SERVERBROWSE_GETINFO_64_LEGACY) + 1 &&
-						mem_comp(Packet.m_pData, SERVERBROWSE_GETINFO_64_LEGACY, sizeof(SERVERBROWSE_GETINFO_64_LEGACY)) == 0)
-					{
-						Type = SERVERINFO_64_LEGACY;
-					}
-					if(Type == SERVERINFO_VANILLA && ResponseToken != NET_SECURITY_TOKEN_UNKNOWN && g_Config.m_SvSixup)
-					{
-						CUnpacker Unpacker;
-						Unpacker.Reset((unsigned char *)Packet.m_pData + sizeof(SERVERBROWSE_GETINFO), Packet.m_DataSize - sizeof(SERVERBROWSE_GETINFO));
-						int SrvBrwsToken = Unpacker.GetInt();
-						if(Unpacker.Error())
-							continue;
-
-						CPacker Packer;
-						CNetChunk Response;
-
-						GetServerInfoSixup(&Packer, SrvBrwsToken, RateLimitServerInfoConnless());
-
-						Response.m_ClientID = -1;
-						Response.m_Address = Packet.m_Address;
-						Response.m_Flags = NETSENDFLAG_CONNLESS;
-						Response.m_pData = Packer.Data();
-						Response.m_DataSize = Packer.Size();
-						m_NetServer.SendConnlessSixup(&Response, ResponseToken);
-					}
-					else if(Type != -1)
-					{
-						int Token = ((unsigned char *)Packet.m_pData)[sizeof(SERVERBROWSE_GETINFO)];
-						Token |= ExtraToken << 8;
-						SendServerInfoConnless(&Packet.m_Address, Token, Type);
-					}
-				}
+				// server info requests were answered by ConnlessCallback
+				if(ResponseToken != NET_SECURITY_TOKEN_UNKNOWN && g_Config.m_SvSixup)
+					m_RegSixup.RegisterProcessPacket(&Packet, ResponseToken);
+				else if(ResponseToken == NET_SECURITY_TOKEN_UNKNOWN)
+					m_Register.RegisterProcessPacket(&Packet);
 			}
 			else
 			{
@@ -2428,6 +2590,7 @@ int CServer::Run()
 			DbPool()->RegisterDatabase(std::move(pCopy), CDbConnectionPool::WRITE);
 		}
 	}
+	DbPool()->Start(g_Config.m_SvSqlReadThreads, g_Config.m_SvSqlWriteThreads);
 
 	// start server
 	NETADDR BindAddr;
@@ -2456,6 +2619,9 @@ int CServer::Run()
 #endif
 
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
+	m_NetServer.SetConnlessCallback(ConnlessCallback);
+	if(g_Config.m_SvNetThread)
+		m_NetServer.StartRecvThread();
 
 	m_Econ.Init(Config(), Console(), &m_ServerBan);
 
@@ -2540,7 +2706,6 @@ int CServer::Run()
 
 					m_GameStartTime = time_get();
 					m_CurrentGameTick = 0;
-					m_ServerInfoFirstRequest = 0;
 					Kernel()->ReregisterInterface(GameServer());
 					GameServer()->OnInit();
 					if(ErrorShutdown())
@@ -2660,6 +2825,8 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			m_NetServer.SendQueued();
+
 			NonActive = true;
 
 			for(auto &Client : m_aClients)
@@ -2683,7 +2850,7 @@ int CServer::Run()
 				if(g_Config.m_SvShutdownWhenEmpty)
 					m_RunServer = STOPPING;
 				else
-					PacketWaiting = net_socket_read_wait(m_NetServer.Socket(), 1000000);
+					PacketWaiting = m_NetServer.WaitForPackets(1000000);
 			}
 			else
 			{
@@ -2693,7 +2860,7 @@ int CServer::Run()
 				int64_t t = time_get();
 				int x = (TickStartTime(m_CurrentGameTick + 1) - t) * 1000000 / time_freq() + 1;
 
-				PacketWaiting = x > 0 ? net_socket_read_wait(m_NetServer.Socket(), x) : true;
+				PacketWaiting = x > 0 ? m_NetServer.WaitForPackets(x) : true;
 			}
 		}
 	}
@@ -2709,6 +2876,8 @@ int CServer::Run()
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			m_NetServer.Drop(i, pDisconnectReason);
 	}
+	m_NetServer.SendQueued();
+	m_NetServer.StopRecvThread();
 
 	m_Econ.Shutdown();
 
@@ -2814,6 +2983,14 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 		}
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	}
+
+	if(g_Config.m_Debug)
+	{
+		NETSTATS Stats;
+		net_stats(&Stats);
+		str_format(aBuf, sizeof(aBuf), "sent %d packets in %d system calls, received %d packets", Stats.sent_packets, Stats.send_calls, Stats.recv_packets);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
 }
 
 static int GetAuthLevel(const char *pLevel)
@@ -3280,6 +3457,17 @@ void CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CServer::ConDumpSnapshotDeltaCache(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	int64_t Hits = pSelf->m_SnapshotDeltaCache.Hits();
+	int64_t Misses = pSelf->m_SnapshotDeltaCache.Misses();
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "snapshot deltas: %lld shared, %lld created, %.1f%% shared, %d distinct last tick",
+		(long long)Hits, (long long)Misses, Hits + Misses ? Hits * 100.0 / (Hits + Misses) : 0.0, pSelf->m_SnapshotDeltaCache.Num());
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CServer::ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	pfnCallback(pResult, pCallbackUserData);
@@ -3482,6 +3670,7 @@ void CServer::RegisterCommands()
 
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("dump_sqlservers", "s['r'|'w']", CFGFLAG_SERVER, ConDumpSqlServers, this, "dumps all sqlservers readservers = r, writeservers = w");
+	Console()->Register("dump_snapshot_deltas", "", CFGFLAG_SERVER, ConDumpSnapshotDeltaCache, this, "Print how many snapshot deltas were shared between clients");
 
 	Console()->Register("auth_add", "s[ident] s[level] r[pw]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAdd, this, "Add a rcon key");
 	Console()->Register("auth_add_p", "s[ident] s[level] s[hash] s[salt]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAddHashed, this, "Add a prehashed rcon key");
@@ -3537,6 +3726,8 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	for(int i = 0; i < m_NumSnapshotWorkers; i++)
+		m_apSnapshotWorkers[i]->m_SnapshotDelta.SetStaticsize(ItemType, Size);
 }
 
 static CServer *CreateServer() { return new CServer(); }
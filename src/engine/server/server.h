@@ -15,6 +15,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
@@ -23,11 +24,13 @@
 
 #include <base/tl/array.h>
 
-#include <list>
+#include <atomic>
+#include <memory>
 
 #include "antibot.h"
 #include "authmanager.h"
 #include "name_ban.h"
+#include "server_info_cache.h"
 
 #if defined(CONF_UPNP)
 #include "upnp.h"
@@ -204,6 +207,61 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	CSnapshotDeltaCache m_SnapshotDeltaCache;
+	CSnapshot m_EmptySnapshot;
+
+	// parallel snapshot pipeline, enabled by sv_snapshot_threads
+	class CSnapshotWorker
+	{
+	public:
+		CSnapshotWorker(const CSnapshotDelta &SnapshotDelta) :
+			m_SnapshotDelta(SnapshotDelta) {}
+
+		CSnapshotDelta m_SnapshotDelta;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+	};
+
+	class CClientSnapshot
+	{
+	public:
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+		int m_SnapshotSize;
+		int m_CompSize;
+		int m_Crc;
+		int m_DeltaTick;
+		bool m_Recover;
+		CSnapshot *m_pDeltaFrom;
+		CSnapshot *m_pDeltaTo;
+		// client whose delta is sent, this one if it isn't shared
+		int m_DeltaClientID;
+	};
+
+	class CSnapshotJob : public IJob
+	{
+		CServer *m_pServer;
+		CSnapshotWorker *m_pWorker;
+		virtual void Run();
+
+	public:
+		CSnapshotJob(CServer *pServer, CSnapshotWorker *pWorker) :
+			m_pServer(pServer), m_pWorker(pWorker) {}
+	};
+
+	CJobGroup m_SnapshotJobs;
+	CJobPool m_SnapshotJobPool;
+	int m_NumSnapshotWorkers;
+	std::unique_ptr<CSnapshotWorker> m_apSnapshotWorkers[CJobPool::MAX_THREADS];
+	std::unique_ptr<CClientSnapshot> m_apClientSnapshots[MAX_CLIENTS];
+	int m_aSnapshotClients[MAX_CLIENTS];
+	int m_NumSnapshotClients;
+	std::atomic<int> m_NextSnapshotClient;
+
+	// stores the snapshot and finds the one to create the delta against
+	void StoreSnapshot(int ClientID, CSnapshot *pData, int SnapshotSize, CSnapshot **ppFrom, CSnapshot **ppTo, int *pDeltaTick, bool *pRecover);
+	int CreateSnapshotDelta(CSnapshot *pFrom, CSnapshot *pTo, bool Sixup, CSnapshotDelta *pSnapshotDelta, char *pDeltaData, char *pCompData, int CompDataSize);
+	void SendSnapshot(int ClientID, const char *pCompData, int CompSize, int Crc, int DeltaTick);
+	void DoSnapshotParallel();
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -312,6 +370,7 @@ public:
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
 
 	static int ClientRejoinCallback(int ClientID, void *pUser);
+	static bool ConnlessCallback(NETSOCKET Socket, const CNetChunk *pPacket, SECURITY_TOKEN ResponseToken, void *pUser);
 
 	void SendRconType(int ClientID, bool UsernameReq);
 	void SendCapabilities(int ClientID);
@@ -327,38 +386,22 @@ public:
 
 	void ProcessClientPacket(CNetChunk *pPacket);
 
-	class CCache
-	{
-	public:
-		class CCacheChunk
-		{
-		public:
-			CCacheChunk(const void *pData, int Size);
-			CCacheChunk(const CCacheChunk &) = delete;
-
-			int m_DataSize;
-			unsigned char m_aData[NET_MAX_PAYLOAD];
-		};
-
-		std::list<CCacheChunk> m_Cache;
-
-		CCache();
-		~CCache();
-
-		void AddChunk(const void *pData, int Size);
-		void Clear();
-	};
-	CCache m_aServerInfoCache[3 * 2];
-	CCache m_aSixupServerInfoCache[2];
+	CServerInfoCache m_aServerInfoCache[3 * 2];
+	CServerInfoCache m_aSixupServerInfoCache[2];
 	bool m_ServerInfoNeedsUpdate;
+	// the caches and the connless rate limit are used by the network
+	// thread too
+	CLock m_ServerInfoLock;
 
 	void ExpireServerInfo();
-	void CacheServerInfo(CCache *pCache, int Type, bool SendClients);
-	void CacheServerInfoSixup(CCache *pCache, bool SendClients);
+	void CacheServerInfo(CServerInfoCache *pCache, int Type, bool SendClients);
+	void CacheServerInfoSixup(CServerInfoCache *pCache, bool SendClients);
 	void SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients);
+	void SendServerInfo(NETSOCKET Socket, const NETADDR *pAddr, int Token, int Type, bool SendClients);
 	void GetServerInfoSixup(CPacker *pPacker, int Token, bool SendClients);
 	bool RateLimitServerInfoConnless();
-	void SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type);
+	bool ProcessServerInfoRequest(NETSOCKET Socket, const CNetChunk *pPacket, SECURITY_TOKEN ResponseToken);
+	void SendServerInfoSixupConnless(NETSOCKET Socket, const NETADDR *pAddr, int Token, SECURITY_TOKEN ResponseToken);
 	void UpdateServerInfo(bool Resend = false);
 
 	void PumpNetwork(bool PacketWaiting);
@@ -399,6 +442,7 @@ public:
 	// console commands for sqlmasters
 	static void ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpSnapshotDeltaCache(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -461,7 +505,7 @@ public:
 	bool ErrorShutdown() const { return m_aErrorShutdownReason[0] != 0; }
 	void SetErrorShutdown(const char *pReason);
 
-	bool IsSixup(int ClientID) const { return m_aClients[ClientID].m_Sixup; }
+	bool IsSixup(int ClientID) const { return ClientID >= 0 && m_aClients[ClientID].m_Sixup; }
 
 #ifdef CONF_FAMILY_UNIX
 	enum CONN_LOGGING_CMD
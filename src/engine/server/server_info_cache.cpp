@@ -0,0 +1,56 @@
+#include "server_info_cache.h"
+
+CServerInfoCache::CChunk::CChunk(const void *pData, int Size)
+{
+	mem_copy(m_aPacket + MAX_HEADER_SIZE, pData, Size);
+	m_DataSize = Size;
+	m_PrefixSize = 0;
+}
+
+void CServerInfoCache::CChunk::SetPrefix(const void *pPrefix, int Size)
+{
+	dbg_assert(Size <= (int)sizeof(m_aPrefix), "server info prefix too big");
+	mem_copy(m_aPrefix, pPrefix, Size);
+	m_PrefixSize = Size;
+}
+
+unsigned char *CServerInfoCache::CChunk::Packet(const void *pToken, int TokenSize, int *pSize)
+{
+	dbg_assert(m_PrefixSize + TokenSize <= MAX_HEADER_SIZE, "server info token too big");
+	unsigned char *pPacket = m_aPacket + MAX_HEADER_SIZE - TokenSize - m_PrefixSize;
+	mem_copy(pPacket, m_aPrefix, m_PrefixSize);
+	mem_copy(pPacket + m_PrefixSize, pToken, TokenSize);
+	*pSize = m_PrefixSize + TokenSize + m_DataSize;
+	return pPacket;
+}
+
+CServerInfoCache::CServerInfoCache()
+{
+	m_Cache.clear();
+}
+
+CServerInfoCache::~CServerInfoCache()
+{
+	Clear();
+}
+
+void CServerInfoCache::AddChunk(const void *pData, int Size)
+{
+	m_Cache.emplace_back(pData, Size);
+}
+
+void CServerInfoCache::Clear()
+{
+	m_Cache.clear();
+}
+
+void CServerInfoCache::SetPrefix(const void *pFirst, int FirstSize, const void *pMore, int MoreSize)
+{
+	for(auto &Chunk : m_Cache)
+	{
+		if(&Chunk == &m_Cache.front())
+			Chunk.SetPrefix(pFirst, FirstSize);
+		else
+			Chunk.SetPrefix(pMore, MoreSize);
+	}
+}
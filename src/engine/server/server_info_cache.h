@@ -0,0 +1,50 @@
+#ifndef ENGINE_SERVER_SERVER_INFO_CACHE_H
+#define ENGINE_SERVER_SERVER_INFO_CACHE_H
+
+#include <base/system.h>
+#include <engine/shared/network.h>
+
+#include <list>
+
+// server info responses, split into the packets they are sent in
+class CServerInfoCache
+{
+public:
+	class CChunk
+	{
+	public:
+		enum
+		{
+			// room for the packet header, the response type and the token
+			MAX_HEADER_SIZE = 32,
+		};
+
+		CChunk(const void *pData, int Size);
+		CChunk(const CChunk &) = delete;
+
+		const unsigned char *Data() const { return m_aPacket + MAX_HEADER_SIZE; }
+		void SetPrefix(const void *pPrefix, int Size);
+		// writes the prefix and the token right in front of the data,
+		// returns the finished packet
+		unsigned char *Packet(const void *pToken, int TokenSize, int *pSize);
+
+		int m_DataSize;
+
+	private:
+		int m_PrefixSize;
+		unsigned char m_aPrefix[MAX_HEADER_SIZE];
+		unsigned char m_aPacket[MAX_HEADER_SIZE + NET_MAX_PAYLOAD];
+	};
+
+	std::list<CChunk> m_Cache;
+
+	CServerInfoCache();
+	~CServerInfoCache();
+
+	void AddChunk(const void *pData, int Size);
+	void Clear();
+	// sets the same prefix for all chunks but the first
+	void SetPrefix(const void *pFirst, int FirstSize, const void *pMore, int MoreSize);
+};
+
+#endif // ENGINE_SERVER_SERVER_INFO_CACHE_H
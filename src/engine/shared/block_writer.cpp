@@ -0,0 +1,214 @@
+#include "block_writer.h"
+
+#include <base/math.h>
+
+#include <utility>
+
+const unsigned char CBlockWriter::ms_aFrameMarker[4] = {'Z', 'F', 'R', 'M'};
+
+CBlockWriter::CBlockWriter(IOHANDLE File, int Compression) :
+	m_File(File),
+	m_Compression(Compression),
+	m_Shutdown(false),
+	m_Error(0),
+	m_Sync(false),
+	m_OpenTime(time_get()),
+	m_BytesIn(0),
+	m_BlocksIn(0),
+	m_MaxBacklogBytes(0),
+	m_NumStalls(0),
+	m_FrameSize(0),
+	m_FrameDataSize(0),
+	m_BytesDone(0),
+	m_BlocksDone(0),
+	m_BytesOut(0),
+	m_WriteTime(0),
+	m_NumFrames(0)
+{
+	mem_zero(&m_Stream, sizeof(m_Stream));
+	if(m_Compression == COMPRESSION_ZLIB && deflateInit(&m_Stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		dbg_msg("block_writer", "failed to initialize zlib, writing uncompressed");
+		m_Compression = COMPRESSION_NONE;
+	}
+
+	sphore_init(&m_Semaphore);
+	sphore_init(&m_SpaceSemaphore);
+	m_pThread = thread_init(Run, this, "block writer");
+}
+
+CBlockWriter::~CBlockWriter()
+{
+	if(m_File)
+		Close();
+	sphore_destroy(&m_Semaphore);
+	sphore_destroy(&m_SpaceSemaphore);
+	if(m_Compression == COMPRESSION_ZLIB)
+		deflateEnd(&m_Stream);
+}
+
+void CBlockWriter::Write(const void *pData, int Size)
+{
+	m_vBlock.insert(m_vBlock.end(), (const unsigned char *)pData, (const unsigned char *)pData + Size);
+	m_BytesIn += Size;
+}
+
+void CBlockWriter::Flush(bool Sync)
+{
+	m_Sync = m_Sync || Sync;
+	int64_t Backlog = m_BytesIn - m_BytesDone.load();
+	m_MaxBacklogBytes = maximum(m_MaxBacklogBytes, Backlog);
+	if(m_vBlock.empty() && !m_Sync)
+		return;
+
+	// the writer thread is behind, try again next time unless the block
+	// got too large, then wait for it
+	CBlock *pBlock = m_Queue.Back();
+	if(!pBlock && (int)m_vBlock.size() >= MAX_BLOCK_SIZE)
+	{
+		if(!m_NumStalls++)
+			dbg_msg("block_writer", "writing can't keep up, waiting with %d bytes", (int)m_vBlock.size());
+		pBlock = WaitForSpace();
+	}
+	if(!pBlock)
+		return;
+
+	// the block gets the buffer, the buffer of the written block is reused
+	std::swap(pBlock->m_vData, m_vBlock);
+	pBlock->m_Sync = m_Sync;
+	m_Sync = false;
+	m_BlocksIn++;
+	m_Queue.Push();
+	sphore_signal(&m_Semaphore);
+}
+
+CBlockWriter::CBlock *CBlockWriter::WaitForSpace()
+{
+	CBlock *pBlock;
+	while(!(pBlock = m_Queue.Back()))
+		sphore_wait(&m_SpaceSemaphore);
+	return pBlock;
+}
+
+int CBlockWriter::Close()
+{
+	// the thread only needs a free slot for the last block
+	WaitForSpace();
+	Flush(true);
+
+	m_Shutdown = true;
+	sphore_signal(&m_Semaphore);
+	thread_wait(m_pThread);
+
+	if(io_close(m_File) != 0)
+		m_Error = 1;
+	m_File = 0;
+	return m_Error;
+}
+
+void CBlockWriter::GetStats(CStats *pStats) const
+{
+	pStats->m_Time = time_get() - m_OpenTime;
+	pStats->m_BytesIn = m_BytesIn;
+	pStats->m_BytesOut = m_BytesOut;
+	pStats->m_WriteTime = m_WriteTime;
+	pStats->m_BacklogBytes = m_BytesIn - m_BytesDone.load();
+	pStats->m_MaxBacklogBytes = m_MaxBacklogBytes;
+	pStats->m_BacklogBlocks = m_BlocksIn - m_BlocksDone.load();
+	pStats->m_NumFrames = m_NumFrames;
+	pStats->m_NumStalls = m_NumStalls;
+}
+
+void CBlockWriter::Run(void *pUser)
+{
+	CBlockWriter *pThis = (CBlockWriter *)pUser;
+	while(true)
+	{
+		CBlock *pBlock = pThis->m_Queue.Front();
+		if(!pBlock)
+		{
+			// Close only shuts down after its last block was pushed
+			if(pThis->m_Shutdown)
+				break;
+			sphore_wait(&pThis->m_Semaphore);
+			continue;
+		}
+
+		int64_t Start = time_get();
+		pThis->WriteBlock(pBlock);
+		pThis->m_WriteTime += time_get() - Start;
+
+		pThis->m_BytesDone += pBlock->m_vData.size();
+		pThis->m_BlocksDone++;
+		pBlock->m_vData.clear();
+		pThis->m_Queue.Pop();
+		sphore_signal(&pThis->m_SpaceSemaphore);
+	}
+}
+
+void CBlockWriter::WriteBlock(const CBlock *pBlock)
+{
+	if(m_Compression == COMPRESSION_NONE)
+	{
+		if(!pBlock->m_vData.empty())
+			WriteFile(pBlock->m_vData.data(), pBlock->m_vData.size());
+		if(pBlock->m_Sync)
+			io_flush(m_File);
+		return;
+	}
+
+	Deflate(pBlock->m_vData.data(), pBlock->m_vData.size(), Z_NO_FLUSH);
+	m_FrameDataSize += pBlock->m_vData.size();
+	if(m_FrameDataSize >= FRAME_SIZE || (pBlock->m_Sync && m_FrameDataSize > 0))
+		FinishFrame();
+}
+
+void CBlockWriter::Deflate(const unsigned char *pData, int Size, int Flush)
+{
+	m_Stream.next_in = (Bytef *)pData;
+	m_Stream.avail_in = Size;
+	int Result;
+	do
+	{
+		// leave room for the header in front of the stream
+		if((int)m_vFrame.size() - FRAME_HEADER_SIZE - m_FrameSize < 16 * 1024)
+			m_vFrame.resize(maximum((int)m_vFrame.size() * 2, FRAME_HEADER_SIZE + 64 * 1024));
+		m_Stream.next_out = m_vFrame.data() + FRAME_HEADER_SIZE + m_FrameSize;
+		m_Stream.avail_out = m_vFrame.size() - FRAME_HEADER_SIZE - m_FrameSize;
+		Result = deflate(&m_Stream, Flush);
+		m_FrameSize = m_vFrame.size() - FRAME_HEADER_SIZE - m_Stream.avail_out;
+	} while(Result == Z_OK && (m_Stream.avail_in || m_Stream.avail_out == 0 || Flush == Z_FINISH));
+
+	if(Result != Z_OK && Result != Z_STREAM_END && Result != Z_BUF_ERROR)
+	{
+		dbg_msg("block_writer", "failed to compress, err=%d", Result);
+		m_Error = 1;
+	}
+}
+
+void CBlockWriter::FinishFrame()
+{
+	Deflate(0, 0, Z_FINISH);
+
+	unsigned char *pHeader = m_vFrame.data();
+	mem_copy(pHeader, ms_aFrameMarker, sizeof(ms_aFrameMarker));
+	for(int i = 0; i < 4; i++)
+	{
+		pHeader[4 + i] = (m_FrameSize >> (i * 8)) & 0xff;
+		pHeader[8 + i] = (m_FrameDataSize >> (i * 8)) & 0xff;
+	}
+	WriteFile(pHeader, FRAME_HEADER_SIZE + m_FrameSize);
+	io_flush(m_File);
+	m_NumFrames++;
+
+	deflateReset(&m_Stream);
+	m_FrameSize = 0;
+	m_FrameDataSize = 0;
+}
+
+void CBlockWriter::WriteFile(const void *pData, int Size)
+{
+	if(io_write(m_File, pData, Size) != (unsigned)Size)
+		m_Error = 1;
+	m_BytesOut += Size;
+}
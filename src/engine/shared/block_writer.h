@@ -0,0 +1,118 @@
+#ifndef ENGINE_SHARED_BLOCK_WRITER_H
+#define ENGINE_SHARED_BLOCK_WRITER_H
+
+#include <base/system.h>
+
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <vector>
+
+#include <zlib.h>
+
+// Writes a file on a thread of its own. Write only appends to a block in
+// memory, Flush hands the whole block to the thread at once, e.g. once per
+// tick, so the writing thread never takes a lock. If the thread falls
+// behind, the block keeps growing until the queue has room again, or
+// until MAX_BLOCK_SIZE, then Flush waits for the thread.
+//
+// With compression, the file is a sequence of frames, each an independent
+// zlib stream behind a FRAME_HEADER_SIZE header: the marker, the
+// compressed and the uncompressed size as little endian ints. A frame
+// ends at a block boundary after FRAME_SIZE bytes or at a sync point, so
+// a reader can start at any frame.
+class CBlockWriter
+{
+public:
+	enum
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_ZLIB,
+	};
+
+	enum
+	{
+		FRAME_HEADER_SIZE = 12,
+		FRAME_SIZE = 256 * 1024,
+		QUEUE_SIZE = 64,
+		// Flush waits for the thread instead of growing the block further
+		MAX_BLOCK_SIZE = 16 * 1024 * 1024,
+	};
+
+	static const unsigned char ms_aFrameMarker[4];
+
+	struct CStats
+	{
+		int64_t m_Time; // since opening the file, time_freq units
+		int64_t m_BytesIn; // handed to Write
+		int64_t m_BytesOut; // written to the file
+		int64_t m_WriteTime; // spent compressing and writing, time_freq units
+		int64_t m_BacklogBytes; // not written yet
+		int64_t m_MaxBacklogBytes;
+		int m_BacklogBlocks;
+		int m_NumFrames;
+		int m_NumStalls; // times Flush waited for the thread
+	};
+
+private:
+	struct CBlock
+	{
+		std::vector<unsigned char> m_vData;
+		bool m_Sync;
+	};
+
+	IOHANDLE m_File;
+	int m_Compression;
+	void *m_pThread;
+	SEMAPHORE m_Semaphore;
+	// signaled by the thread for every block it's done with
+	SEMAPHORE m_SpaceSemaphore;
+	CSpscQueue<CBlock, QUEUE_SIZE> m_Queue;
+	std::atomic<bool> m_Shutdown;
+	std::atomic<int> m_Error;
+
+	// only touched by the thread calling Write
+	std::vector<unsigned char> m_vBlock;
+	bool m_Sync;
+	int64_t m_OpenTime;
+	int64_t m_BytesIn;
+	int64_t m_BlocksIn;
+	int64_t m_MaxBacklogBytes;
+	int m_NumStalls;
+
+	// only touched by the writer thread
+	z_stream m_Stream;
+	std::vector<unsigned char> m_vFrame;
+	int m_FrameSize;
+	int m_FrameDataSize;
+
+	// written by the writer thread
+	std::atomic<int64_t> m_BytesDone;
+	std::atomic<int64_t> m_BlocksDone;
+	std::atomic<int64_t> m_BytesOut;
+	std::atomic<int64_t> m_WriteTime;
+	std::atomic<int> m_NumFrames;
+
+	CBlock *WaitForSpace();
+	static void Run(void *pUser);
+	void WriteBlock(const CBlock *pBlock);
+	void Deflate(const unsigned char *pData, int Size, int Flush);
+	void FinishFrame();
+	void WriteFile(const void *pData, int Size);
+
+public:
+	CBlockWriter(IOHANDLE File, int Compression);
+	~CBlockWriter();
+
+	void Write(const void *pData, int Size);
+	// hands the written data to the writer thread, Sync ends the current
+	// frame after it
+	void Flush(bool Sync = false);
+	// writes everything and closes the file, returns the error
+	int Close();
+	// non-zero if writing failed
+	int Error() const { return m_Error.load(); }
+	void GetStats(CStats *pStats) const;
+};
+
+#endif
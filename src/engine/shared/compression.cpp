@@ -4,6 +4,50 @@
 
 #include "compression.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// packs the ints from -64 to 63 at the start of 16 ints into single bytes,
+// always writes 16 bytes, returns the number of ints packed
+static int PackSmall16(const int *pSrc, unsigned char *pDst)
+{
+	const __m128i Min = _mm_set1_epi32(-65);
+	const __m128i Max = _mm_set1_epi32(64);
+	const __m128i Data = _mm_set1_epi32(0x3F);
+	const __m128i SignBit = _mm_set1_epi32(0x40);
+	__m128i aBytes[4];
+	__m128i aSmall[4];
+	for(int i = 0; i < 4; i++)
+	{
+		__m128i Value = _mm_loadu_si128((const __m128i *)(pSrc + i * 4));
+		__m128i Sign = _mm_srai_epi32(Value, 31);
+		aSmall[i] = _mm_and_si128(_mm_cmpgt_epi32(Value, Min), _mm_cmplt_epi32(Value, Max));
+		aBytes[i] = _mm_or_si128(_mm_and_si128(_mm_xor_si128(Value, Sign), Data), _mm_and_si128(Sign, SignBit));
+	}
+	__m128i Bytes = _mm_packus_epi16(_mm_packs_epi32(aBytes[0], aBytes[1]), _mm_packs_epi32(aBytes[2], aBytes[3]));
+	__m128i Small = _mm_packs_epi16(_mm_packs_epi32(aSmall[0], aSmall[1]), _mm_packs_epi32(aSmall[2], aSmall[3]));
+	_mm_storeu_si128((__m128i *)pDst, Bytes);
+	return __builtin_ctz(~_mm_movemask_epi8(Small));
+}
+
+// unpacks the single byte ints at the start of 16 bytes, always writes
+// 16 ints, returns the number of ints unpacked
+static int UnpackSmall16(const unsigned char *pSrc, int *pDst)
+{
+	const __m128i Data = _mm_set1_epi32(0x3F);
+	const __m128i SignBit = _mm_set1_epi32(0x40);
+	__m128i Bytes = _mm_loadu_si128((const __m128i *)pSrc);
+	__m128i aWords[2] = {_mm_unpacklo_epi8(Bytes, _mm_setzero_si128()), _mm_unpackhi_epi8(Bytes, _mm_setzero_si128())};
+	for(int i = 0; i < 4; i++)
+	{
+		__m128i Value = i % 2 ? _mm_unpackhi_epi16(aWords[i / 2], _mm_setzero_si128()) : _mm_unpacklo_epi16(aWords[i / 2], _mm_setzero_si128());
+		__m128i Sign = _mm_cmpeq_epi32(_mm_and_si128(Value, SignBit), SignBit);
+		_mm_storeu_si128((__m128i *)(pDst + i * 4), _mm_xor_si128(_mm_and_si128(Value, Data), Sign));
+	}
+	return __builtin_ctz(_mm_movemask_epi8(Bytes) | 0x10000);
+}
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 {
@@ -71,9 +115,26 @@ long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_, int DstS
 	int *pDstEnd = pDst + DstSize / 4;
 	while(pSrc < pEnd)
 	{
+#if defined(__SSE2__)
+		// most ints are single bytes, unpack them 16 at a time
+		if(pEnd - pSrc >= 16 && pDstEnd - pDst >= 16)
+		{
+			int Num = UnpackSmall16(pSrc, pDst);
+			pSrc += Num;
+			pDst += Num;
+			if(Num == 16)
+				continue;
+		}
+#endif
 		if(pDst >= pDstEnd)
 			return -1;
-		pSrc = CVariableInt::Unpack(pSrc, pDst);
+		if(!(*pSrc & 0x80))
+		{
+			*pDst = (*pSrc & 0x3F) ^ -((*pSrc >> 6) & 1);
+			pSrc++;
+		}
+		else
+			pSrc = CVariableInt::Unpack(pSrc, pDst);
 		pDst++;
 	}
 	return (unsigned char *)pDst - (unsigned char *)pDst_;
@@ -87,9 +148,24 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_, int DstSiz
 	Size /= 4;
 	while(Size)
 	{
+#if defined(__SSE2__)
+		// most ints are small, pack them 16 at a time
+		if(Size >= 16 && pDstEnd - pDst >= 16 + 6)
+		{
+			int Num = PackSmall16(pSrc, pDst);
+			pSrc += Num;
+			pDst += Num;
+			Size -= Num;
+			if(Num == 16)
+				continue;
+		}
+#endif
 		if(pDstEnd - pDst < 6)
 			return -1;
-		pDst = CVariableInt::Pack(pDst, *pSrc);
+		if((unsigned)*pSrc + 64 < 128)
+			*pDst++ = ((*pSrc >> 25) & 0x40) | ((*pSrc ^ (*pSrc >> 31)) & 0x3F);
+		else
+			pDst = CVariableInt::Pack(pDst, *pSrc);
 		Size--;
 		pSrc++;
 	}
@@ -101,6 +101,18 @@ struct CDatafileInfo
 	char *m_pDataStart;
 };
 
+struct CDatafileLoadedData
+{
+	char *m_pData;
+	int m_Size;
+	// false if it points into the mapped file
+	bool m_Owned;
+	bool m_Swapped;
+	// GetData calls without UnloadData, unused data stays cached
+	int m_Users;
+	int64_t m_LastUse;
+};
+
 struct CDatafile
 {
 	IOHANDLE m_File;
@@ -109,11 +121,20 @@ struct CDatafile
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
 	int m_DataStartOffset;
-	char **m_ppDataPtrs;
+	CDatafileLoadedData *m_pLoadedData;
 	char *m_pData;
+
+	// the whole file if it was asked for and could be mapped, data blocks
+	// are read from it, uncompressed ones are used directly
+	char *m_pMapped;
+	unsigned m_MappedSize;
+
+	int m_DataCacheSize;
+	int m_CachedSize;
+	int64_t m_UseCounter;
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MapData)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
 
@@ -124,9 +145,22 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// map the file if possible, the data doesn't have to be read then
+	unsigned MappedSize = 0;
+	char *pMapped = MapData ? (char *)io_map(File, &MappedSize) : 0;
+
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pMapped)
+	{
+		Crc = crc32(0, (const Bytef *)pMapped, MappedSize); // ignore_convention
+		SHA256_CTX Sha256Ctxt;
+		sha256_init(&Sha256Ctxt);
+		sha256_update(&Sha256Ctxt, pMapped, MappedSize);
+		Sha256 = sha256_finish(&Sha256Ctxt);
+	}
+	else
 	{
 		enum
 		{
@@ -155,6 +189,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
 	{
 		dbg_msg("datafile", "couldn't load header");
+		if(pMapped)
+			io_unmap(pMapped, MappedSize);
+		io_close(File);
 		return 0;
 	}
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
@@ -162,6 +199,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			if(pMapped)
+				io_unmap(pMapped, MappedSize);
+			io_close(File);
 			return 0;
 		}
 	}
@@ -172,6 +212,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		if(pMapped)
+			io_unmap(pMapped, MappedSize);
+		io_close(File);
 		return 0;
 	}
 
@@ -185,24 +228,32 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	unsigned AllocSize = Size;
 	AllocSize += sizeof(CDatafile); // add space for info structure
-	AllocSize += Header.m_NumRawData * sizeof(void *); // add space for data pointers
+	AllocSize += Header.m_NumRawData * sizeof(CDatafileLoadedData); // add space for the loaded data
 
 	CDatafile *pTmpDataFile = (CDatafile *)malloc(AllocSize);
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
-	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile + 1) + Header.m_NumRawData * sizeof(char *);
+	pTmpDataFile->m_pLoadedData = (CDatafileLoadedData *)(pTmpDataFile + 1);
+	pTmpDataFile->m_pData = (char *)(pTmpDataFile + 1) + Header.m_NumRawData * sizeof(CDatafileLoadedData);
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pMapped = pMapped;
+	pTmpDataFile->m_MappedSize = MappedSize;
+	pTmpDataFile->m_DataCacheSize = 0;
+	pTmpDataFile->m_CachedSize = 0;
+	pTmpDataFile->m_UseCounter = 0;
 
 	// clear the data pointers
-	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
+	mem_zero(pTmpDataFile->m_pLoadedData, Header.m_NumRawData * sizeof(CDatafileLoadedData));
 
-	// read types, offsets, sizes and item data
+	// read types, offsets, sizes and item data, they are always copied so
+	// only data blocks can be read from the mapping
 	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
 	if(ReadSize != Size)
 	{
+		if(pMapped)
+			io_unmap(pMapped, MappedSize);
 		io_close(pTmpDataFile->m_File);
 		free(pTmpDataFile);
 		pTmpDataFile = 0;
@@ -220,7 +271,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	//if(DEBUG)
 	{
 		dbg_msg("datafile", "allocsize=%d", AllocSize);
-		dbg_msg("datafile", "readsize=%d", ReadSize);
+		dbg_msg("datafile", "readsize=%d mapped=%d", ReadSize, pMapped != 0);
 		dbg_msg("datafile", "swaplen=%d", Header.m_Swaplen);
 		dbg_msg("datafile", "item_size=%d", m_pDataFile->m_Header.m_ItemSize);
 	}
@@ -313,6 +364,44 @@ int CDataFileReader::GetDataSize(int Index)
 		return GetFileDataSize(Index);
 }
 
+// returns the raw data in the file if it is inside the mapping
+static const char *MappedFileData(const CDatafile *pDataFile, int Offset, int Size)
+{
+	if(!pDataFile->m_pMapped || Offset < 0 || Size < 0 || (unsigned)Offset > pDataFile->m_MappedSize || (unsigned)Size > pDataFile->m_MappedSize - Offset)
+		return 0;
+	return pDataFile->m_pMapped + Offset;
+}
+
+static void FreeLoadedData(CDatafile *pDataFile, CDatafileLoadedData *pLoaded)
+{
+	if(pLoaded->m_Owned)
+	{
+		if(!pLoaded->m_Users)
+			pDataFile->m_CachedSize -= pLoaded->m_Size;
+		free(pLoaded->m_pData);
+	}
+	pLoaded->m_pData = 0;
+	pLoaded->m_Users = 0;
+}
+
+// frees the least recently used data nobody uses until the cache is small enough again
+static void EvictLoadedData(CDatafile *pDataFile)
+{
+	while(pDataFile->m_CachedSize > pDataFile->m_DataCacheSize)
+	{
+		CDatafileLoadedData *pOldest = 0;
+		for(int i = 0; i < pDataFile->m_Header.m_NumRawData; i++)
+		{
+			CDatafileLoadedData *pLoaded = &pDataFile->m_pLoadedData[i];
+			if(pLoaded->m_pData && pLoaded->m_Owned && !pLoaded->m_Users && (!pOldest || pLoaded->m_LastUse < pOldest->m_LastUse))
+				pOldest = pLoaded;
+		}
+		if(!pOldest)
+			break;
+		FreeLoadedData(pDataFile, pOldest);
+	}
+}
+
 void *CDataFileReader::GetDataImpl(int Index, int Swap)
 {
 	if(!m_pDataFile)
@@ -323,11 +412,20 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return 0;
 
+	CDatafileLoadedData *pLoaded = &m_pDataFile->m_pLoadedData[Index];
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	// cached data that was swapped differently has to be loaded again
+	if(pLoaded->m_pData && !pLoaded->m_Users && pLoaded->m_Swapped != (Swap != 0))
+		FreeLoadedData(m_pDataFile, pLoaded);
+#endif
+
 	// load it if needed
-	if(!m_pDataFile->m_ppDataPtrs[Index])
+	if(!pLoaded->m_pData)
 	{
 		// fetch the data size
 		int DataSize = GetFileDataSize(Index);
+		int FileOffset = m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+		const char *pFileData = MappedFileData(m_pDataFile, FileOffset, DataSize);
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		int SwapSize = DataSize;
 #endif
@@ -335,20 +433,27 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = malloc(DataSize);
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
 
 			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
+			pLoaded->m_pData = (char *)malloc(UncompressedSize);
+			pLoaded->m_Size = UncompressedSize;
+			pLoaded->m_Owned = true;
 
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			// read the compressed data if it isn't mapped
+			void *pTemp = 0;
+			if(!pFileData)
+			{
+				pTemp = malloc(DataSize);
+				io_seek(m_pDataFile->m_File, FileOffset, IOSEEK_START);
+				io_read(m_pDataFile->m_File, pTemp, DataSize);
+				pFileData = (const char *)pTemp;
+			}
 
 			// decompress the data, TODO: check for errors
 			s = UncompressedSize;
-			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef *)pTemp, DataSize); // ignore_convention
+			uncompress((Bytef *)pLoaded->m_pData, &s, (const Bytef *)pFileData, DataSize); // ignore_convention
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			SwapSize = s;
 #endif
@@ -360,18 +465,43 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		{
 			// load the data
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			pLoaded->m_Size = DataSize;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+			if(pFileData)
+			{
+				// uncompressed data is used from the mapping directly
+				pLoaded->m_pData = (char *)pFileData;
+				pLoaded->m_Owned = false;
+			}
+			else
+#endif
+			{
+				pLoaded->m_pData = (char *)malloc(DataSize);
+				pLoaded->m_Owned = true;
+				if(pFileData)
+					mem_copy(pLoaded->m_pData, pFileData, DataSize);
+				else
+				{
+					io_seek(m_pDataFile->m_File, FileOffset, IOSEEK_START);
+					io_read(m_pDataFile->m_File, pLoaded->m_pData, DataSize);
+				}
+			}
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		if(Swap && SwapSize)
-			swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize / sizeof(int));
+			swap_endian(pLoaded->m_pData, sizeof(int), SwapSize / sizeof(int));
 #endif
+		pLoaded->m_Swapped = Swap != 0;
+	}
+	else if(!pLoaded->m_Users && pLoaded->m_Owned)
+	{
+		// in use again, it doesn't count towards the cache anymore
+		m_pDataFile->m_CachedSize -= pLoaded->m_Size;
 	}
 
-	return m_pDataFile->m_ppDataPtrs[Index];
+	pLoaded->m_Users++;
+	return pLoaded->m_pData;
 }
 
 void *CDataFileReader::GetData(int Index)
@@ -386,12 +516,35 @@ void *CDataFileReader::GetDataSwapped(int Index)
 
 void CDataFileReader::UnloadData(int Index)
 {
-	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+	if(!m_pDataFile || Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+		return;
+
+	CDatafileLoadedData *pLoaded = &m_pDataFile->m_pLoadedData[Index];
+	if(!pLoaded->m_pData || !pLoaded->m_Users)
+		return;
+	pLoaded->m_Users--;
+	if(pLoaded->m_Users)
+		return;
+
+	if(!pLoaded->m_Owned)
+	{
+		// nothing to keep, the data stays in the mapping
+		pLoaded->m_pData = 0;
 		return;
+	}
 
-	//
-	free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
+	// keep the inflated data around in case it's needed again
+	pLoaded->m_LastUse = ++m_pDataFile->m_UseCounter;
+	m_pDataFile->m_CachedSize += pLoaded->m_Size;
+	EvictLoadedData(m_pDataFile);
+}
+
+void CDataFileReader::SetDataCacheSize(int Size)
+{
+	if(!m_pDataFile)
+		return;
+	m_pDataFile->m_DataCacheSize = Size;
+	EvictLoadedData(m_pDataFile);
 }
 
 int CDataFileReader::GetItemSize(int Index) const
@@ -531,10 +684,11 @@ bool CDataFileReader::Close()
 		return true;
 
 	// free the data that is loaded
-	int i;
-	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		free(m_pDataFile->m_ppDataPtrs[i]);
+	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+		FreeLoadedData(m_pDataFile, &m_pDataFile->m_pLoadedData[i]);
 
+	if(m_pDataFile->m_pMapped)
+		io_unmap(m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = 0;
@@ -576,9 +730,60 @@ IOHANDLE CDataFileReader::File()
 	return m_pDataFile->m_File;
 }
 
+static void CompressData(void *pDst, int *pDstSize, const void *pSrc, int SrcSize, int CompressionLevel)
+{
+	unsigned long s = *pDstSize;
+	int Result = compress2((Bytef *)pDst, &s, (const Bytef *)pSrc, SrcSize, CompressionLevel); // ignore_convention
+	if(Result != Z_OK)
+	{
+		dbg_msg("datafile", "compression error %d", Result);
+		dbg_assert(0, "zlib error");
+	}
+	*pDstSize = (int)s;
+}
+
+CDataFileWriter::CCompressJob::CCompressJob(CDataInfo *pInfo, const void *pData, int Size, int CompressionLevel, CSemaphore *pDone) :
+	m_pInfo(pInfo),
+	m_CompressionLevel(CompressionLevel),
+	m_pDone(pDone),
+	m_Claimed(false)
+{
+	m_pData = malloc(Size);
+	mem_copy(m_pData, pData, Size);
+}
+
+CDataFileWriter::CCompressJob::~CCompressJob()
+{
+	free(m_pData);
+}
+
+bool CDataFileWriter::CCompressJob::Compress()
+{
+	if(m_Claimed.exchange(true))
+		return false;
+
+	int Size = compressBound(m_pInfo->m_UncompressedSize);
+	void *pCompData = malloc(Size);
+	CompressData(pCompData, &Size, m_pData, m_pInfo->m_UncompressedSize, m_CompressionLevel);
+	m_pInfo->m_CompressedSize = Size;
+	m_pInfo->m_pCompressedData = realloc(pCompData, Size);
+	free(m_pData);
+	m_pData = 0;
+	return true;
+}
+
+void CDataFileWriter::CCompressJob::Run()
+{
+	// the writer may be gone if it compressed the data itself
+	if(Compress())
+		m_pDone->Signal();
+}
+
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_pJobPool = 0;
+	m_CompressionLevel = Z_DEFAULT_COMPRESSION;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(calloc(MAX_ITEM_TYPES, sizeof(CItemTypeInfo)));
 	m_pItems = static_cast<CItemInfo *>(calloc(MAX_ITEMS, sizeof(CItemInfo)));
 	m_pDatas = static_cast<CDataInfo *>(calloc(MAX_DATAS, sizeof(CDataInfo)));
@@ -586,6 +791,9 @@ CDataFileWriter::CDataFileWriter()
 
 CDataFileWriter::~CDataFileWriter()
 {
+	// the jobs write into m_pDatas
+	FinishCompressJobs();
+
 	free(m_pItemTypes);
 	m_pItemTypes = 0;
 	for(int i = 0; i < m_NumItems; i++)
@@ -693,22 +901,30 @@ int CDataFileWriter::AddData(int Size, void *pData, int CompressionLevel)
 {
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
-	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = malloc(s); // temporary buffer that we use during compression
+	if(CompressionLevel == COMPRESSION_LEVEL_WRITER)
+		CompressionLevel = m_CompressionLevel;
 
-	int Result = compress2((Bytef *)pCompData, &s, (Bytef *)pData, Size, CompressionLevel); // ignore_convention
-	if(Result != Z_OK)
+	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
+	pInfo->m_UncompressedSize = Size;
+	if(m_pJobPool && Size >= MIN_JOB_DATA_SIZE)
 	{
-		dbg_msg("datafile", "compression error %d", Result);
-		dbg_assert(0, "zlib error");
+		pInfo->m_CompressedSize = 0;
+		pInfo->m_pCompressedData = 0;
+		std::shared_ptr<CCompressJob> pJob = std::make_shared<CCompressJob>(pInfo, pData, Size, CompressionLevel, &m_CompressDone);
+		m_vpCompressJobs.push_back(pJob);
+		m_pJobPool->Add(pJob);
+	}
+	else
+	{
+		int CompSize = compressBound(Size);
+		void *pCompData = malloc(CompSize); // temporary buffer that we use during compression
+		CompressData(pCompData, &CompSize, pData, Size, CompressionLevel);
+
+		pInfo->m_CompressedSize = CompSize;
+		pInfo->m_pCompressedData = malloc(pInfo->m_CompressedSize);
+		mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
+		free(pCompData);
 	}
-
-	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = malloc(pInfo->m_CompressedSize);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	free(pCompData);
 
 	m_NumDatas++;
 	return m_NumDatas - 1;
@@ -730,6 +946,19 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 #endif
 }
 
+void CDataFileWriter::FinishCompressJobs()
+{
+	int NumRunning = 0;
+	for(auto &pJob : m_vpCompressJobs)
+		if(!pJob->Compress())
+			NumRunning++;
+	m_vpCompressJobs.clear();
+
+	// only the jobs a worker started are waited for
+	while(NumRunning--)
+		m_CompressDone.Wait();
+}
+
 int CDataFileWriter::Finish()
 {
 	if(!m_File)
@@ -740,6 +969,9 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	// the data sizes are only known once everything is compressed
+	FinishCompressJobs();
+
 	// we should now write this file!
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
@@ -3,10 +3,16 @@
 #ifndef ENGINE_SHARED_DATAFILE_H
 #define ENGINE_SHARED_DATAFILE_H
 
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 #include <base/hash.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 #include <zlib.h>
 
@@ -32,13 +38,19 @@ public:
 
 	bool IsOpen() const { return m_pDataFile != 0; }
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// MapData maps the file and uses the data blocks from it, only for files
+	// that can't be truncated while they are open (a read would crash then)
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MapData = false);
 	bool Close();
 
+	// the data is shared between all callers and must not be modified, every
+	// GetData has to be paired with an UnloadData so it can be evicted again
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index);
 	void UnloadData(int Index);
+	// bytes of inflated data that are kept after unloading it, none by default
+	void SetDataCacheSize(int Size);
 	void *GetItem(int Index, int *pType, int *pID);
 	int GetItemSize(int Index) const;
 	void GetType(int Type, int *pStart, int *pNum);
@@ -64,6 +76,27 @@ class CDataFileWriter
 		void *m_pCompressedData;
 	};
 
+	// compresses one data block on the job pool, owns a copy of the data.
+	// Finish compresses the blocks no worker got to yet itself, so it
+	// doesn't wait behind the other jobs of a busy pool
+	class CCompressJob : public IJob
+	{
+		CDataInfo *m_pInfo;
+		void *m_pData;
+		int m_CompressionLevel;
+		// signaled once a worker compressed the data
+		CSemaphore *m_pDone;
+		std::atomic<bool> m_Claimed;
+
+		void Run() override;
+
+	public:
+		CCompressJob(CDataInfo *pInfo, const void *pData, int Size, int CompressionLevel, CSemaphore *pDone);
+		~CCompressJob();
+		// returns false if it was already claimed by someone else
+		bool Compress();
+	};
+
 	struct CItemInfo
 	{
 		int m_Type;
@@ -87,6 +120,8 @@ class CDataFileWriter
 		MAX_ITEMS = 1024,
 		MAX_DATAS = 1024,
 		MAX_EXTENDED_ITEM_TYPES = 64,
+		// smaller data is compressed right away
+		MIN_JOB_DATA_SIZE = 16 * 1024,
 	};
 
 	IOHANDLE m_File;
@@ -99,15 +134,32 @@ class CDataFileWriter
 	CDataInfo *m_pDatas;
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
 
+	CJobPool *m_pJobPool;
+	std::vector<std::shared_ptr<CCompressJob>> m_vpCompressJobs;
+	CSemaphore m_CompressDone;
+	int m_CompressionLevel;
+
 	int GetExtendedItemTypeIndex(int Type);
+	void FinishCompressJobs();
 
 public:
+	enum
+	{
+		// use the level set with SetCompressionLevel
+		COMPRESSION_LEVEL_WRITER = -2,
+	};
+
 	CDataFileWriter();
 	~CDataFileWriter();
 	void Init();
 	bool OpenFile(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
-	int AddData(int Size, void *pData, int CompressionLevel = Z_DEFAULT_COMPRESSION);
+	// compress data on the pool instead of in AddData, Finish waits for it
+	// and compresses what is still queued itself
+	void SetJobPool(CJobPool *pJobPool) { m_pJobPool = pJobPool; }
+	// zlib level, e.g. Z_BEST_SPEED for temporary files
+	void SetCompressionLevel(int CompressionLevel) { m_CompressionLevel = CompressionLevel; }
+	int AddData(int Size, void *pData, int CompressionLevel = COMPRESSION_LEVEL_WRITER);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
 	int Finish();
@@ -42,7 +42,7 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapDat
 }
 
 // Record
-int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, SHA256_DIGEST *pSha256, unsigned Crc, const char *pType, unsigned int MapSize, unsigned char *pMapData, IOHANDLE MapFile, DEMOFUNC_FILTER pfnFilter, void *pUser)
+int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, SHA256_DIGEST *pSha256, unsigned Crc, const char *pType, unsigned int MapSize, unsigned char *pMapData, IOHANDLE MapFile, DEMOFUNC_FILTER pfnFilter, void *pUser, int StorageType)
 {
 	m_pfnFilter = pfnFilter;
 	m_pUser = pUser;
@@ -50,7 +50,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_pMapData = pMapData;
 	m_pConsole = pConsole;
 
-	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, StorageType);
 	if(!DemoFile)
 	{
 		if(m_pConsole)
@@ -407,6 +407,7 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 {
 	m_File = 0;
 	m_pKeyFrames = 0;
+	m_SeekSnapshotInterval = 0;
 	m_SpeedIndex = 4;
 
 	m_TickTime = 0;
@@ -482,6 +483,15 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+int CDemoPlayer::DecompressChunk(const void *pChunk, int ChunkSize, void *pData, int DataSize)
+{
+	char aDecompressed[CSnapshot::MAX_SIZE];
+	int Size = CNetBase::Decompress(pChunk, ChunkSize, aDecompressed, sizeof(aDecompressed));
+	if(Size < 0)
+		return Size;
+	return CVariableInt::Decompress(aDecompressed, Size, pData, DataSize);
+}
+
 void CDemoPlayer::ScanFile()
 {
 	long StartPos;
@@ -495,6 +505,20 @@ void CDemoPlayer::ScanFile()
 	StartPos = io_tell(m_File);
 	m_Info.m_SeekablePoints = 0;
 
+	// the snapshots are only decoded if they are kept for seeking
+	struct CScanBuffers
+	{
+		char m_aChunk[CSnapshot::MAX_SIZE];
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aSnapshot[CSnapshot::MAX_SIZE];
+		char m_aNewSnapshot[CSnapshot::MAX_SIZE];
+	};
+	CScanBuffers *pBuffers = m_SeekSnapshotInterval > 0 ? (CScanBuffers *)malloc(sizeof(CScanBuffers)) : 0;
+	int SnapshotSize = -1;
+	int LastSeekSnapshotTick = -1;
+	m_vSeekSnapshots.clear();
+	m_vSeekSnapshotData.clear();
+
 	while(1)
 	{
 		long CurrentPos = io_tell(m_File);
@@ -520,16 +544,53 @@ void CDemoPlayer::ScanFile()
 					pFirstKey = pKey;
 				pCurrentKey = pKey;
 				m_Info.m_SeekablePoints++;
+				LastSeekSnapshotTick = ChunkTick;
+			}
+			else if(pBuffers && SnapshotSize > 0 && ChunkTick - LastSeekSnapshotTick >= m_SeekSnapshotInterval)
+			{
+				// keep the snapshot the ticks after this marker are based on
+				CSeekSnapshot SeekSnapshot;
+				SeekSnapshot.m_Filepos = io_tell(m_File);
+				SeekSnapshot.m_Tick = ChunkTick;
+				SeekSnapshot.m_DataOffset = m_vSeekSnapshotData.size();
+				SeekSnapshot.m_DataSize = SnapshotSize;
+				m_vSeekSnapshots.push_back(SeekSnapshot);
+				m_vSeekSnapshotData.insert(m_vSeekSnapshotData.end(), pBuffers->m_aSnapshot, pBuffers->m_aSnapshot + SnapshotSize);
+				LastSeekSnapshotTick = ChunkTick;
 			}
 
 			if(m_Info.m_Info.m_FirstTick == -1)
 				m_Info.m_Info.m_FirstTick = ChunkTick;
 			m_Info.m_Info.m_LastTick = ChunkTick;
 		}
+		else if(pBuffers && ChunkSize && (ChunkType == CHUNKTYPE_SNAPSHOT || ChunkType == CHUNKTYPE_DELTA))
+		{
+			if(io_read(m_File, pBuffers->m_aChunk, ChunkSize) != (unsigned)ChunkSize)
+				break;
+			int DataSize = DecompressChunk(pBuffers->m_aChunk, ChunkSize, pBuffers->m_aData, sizeof(pBuffers->m_aData));
+			if(DataSize < 0)
+				continue;
+			if(ChunkType == CHUNKTYPE_SNAPSHOT)
+			{
+				SnapshotSize = DataSize;
+				mem_copy(pBuffers->m_aSnapshot, pBuffers->m_aData, DataSize);
+			}
+			else if(SnapshotSize >= 0)
+			{
+				DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot *)pBuffers->m_aSnapshot, (CSnapshot *)pBuffers->m_aNewSnapshot, pBuffers->m_aData, DataSize);
+				if(DataSize >= 0)
+				{
+					SnapshotSize = DataSize;
+					mem_copy(pBuffers->m_aSnapshot, pBuffers->m_aNewSnapshot, DataSize);
+				}
+			}
+		}
 		else if(ChunkSize)
 			io_skip(m_File, ChunkSize);
 	}
 
+	free(pBuffers);
+
 	// copy all the frames to an array instead for fast access
 	m_pKeyFrames = (CKeyFrame *)calloc(maximum(m_Info.m_SeekablePoints, 1), sizeof(CKeyFrame));
 	for(pCurrentKey = pFirstKey, i = 0; pCurrentKey; pCurrentKey = pCurrentKey->m_pNext, i++)
@@ -541,9 +602,6 @@ void CDemoPlayer::ScanFile()
 
 void CDemoPlayer::DoTick()
 {
-	static char s_aCompresseddata[CSnapshot::MAX_SIZE];
-	static char s_aDecompressed[CSnapshot::MAX_SIZE];
-	static char s_aData[CSnapshot::MAX_SIZE];
 	int ChunkType, ChunkTick, ChunkSize;
 	int DataSize = 0;
 	int GotSnapshot = 0;
@@ -578,7 +636,7 @@ void CDemoPlayer::DoTick()
 		// read the chunk
 		if(ChunkSize)
 		{
-			if(io_read(m_File, s_aCompresseddata, ChunkSize) != (unsigned)ChunkSize)
+			if(io_read(m_File, m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
 			{
 				// stop on error or eof
 				if(m_pConsole)
@@ -587,7 +645,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CNetBase::Decompress(s_aCompresseddata, ChunkSize, s_aDecompressed, sizeof(s_aDecompressed));
+			DataSize = CNetBase::Decompress(m_aCompressedData, ChunkSize, m_aDecompressedData, sizeof(m_aDecompressedData));
 			if(DataSize < 0)
 			{
 				// stop on error or eof
@@ -597,7 +655,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CVariableInt::Decompress(s_aDecompressed, DataSize, s_aData, sizeof(s_aData));
+			DataSize = CVariableInt::Decompress(m_aDecompressedData, DataSize, m_aChunkData, sizeof(m_aChunkData));
 
 			if(DataSize < 0)
 			{
@@ -611,19 +669,17 @@ void CDemoPlayer::DoTick()
 		if(ChunkType == CHUNKTYPE_DELTA)
 		{
 			// process delta snapshot
-			static char s_aNewsnap[CSnapshot::MAX_SIZE];
-
 			GotSnapshot = 1;
 
-			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)s_aNewsnap, s_aData, DataSize);
+			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)m_aNewSnapshotData, m_aChunkData, DataSize);
 
 			if(DataSize >= 0)
 			{
 				if(m_pListener)
-					m_pListener->OnDemoPlayerSnapshot(s_aNewsnap, DataSize);
+					m_pListener->OnDemoPlayerSnapshot(m_aNewSnapshotData, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, s_aNewsnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnapshotData, DataSize);
 			}
 			else
 			{
@@ -641,9 +697,9 @@ void CDemoPlayer::DoTick()
 			GotSnapshot = 1;
 
 			m_LastSnapshotDataSize = DataSize;
-			mem_copy(m_aLastSnapshotData, s_aData, DataSize);
+			mem_copy(m_aLastSnapshotData, m_aChunkData, DataSize);
 			if(m_pListener)
-				m_pListener->OnDemoPlayerSnapshot(s_aData, DataSize);
+				m_pListener->OnDemoPlayerSnapshot(m_aChunkData, DataSize);
 		}
 		else
 		{
@@ -663,7 +719,7 @@ void CDemoPlayer::DoTick()
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
 				if(m_pListener)
-					m_pListener->OnDemoPlayerMessage(s_aData, DataSize);
+					m_pListener->OnDemoPlayerMessage(m_aChunkData, DataSize);
 			}
 		}
 	}
@@ -812,26 +868,34 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 	// scan the file for interesting points
 	ScanFile();
 
-	// reset slice markers
-	g_Config.m_ClDemoSliceBegin = -1;
-	g_Config.m_ClDemoSliceEnd = -1;
-
 	// ready for playback
 	return 0;
 }
 
-bool CDemoPlayer::ExtractMap(class IStorage *pStorage)
+unsigned char *CDemoPlayer::GetMapData()
 {
 	if(!m_MapInfo.m_Size)
-		return false;
+		return 0;
 
 	long CurSeek = io_tell(m_File);
 
 	// get map data
 	io_seek(m_File, m_MapOffset, IOSEEK_START);
 	unsigned char *pMapData = (unsigned char *)malloc(m_MapInfo.m_Size);
-	io_read(m_File, pMapData, m_MapInfo.m_Size);
+	if(io_read(m_File, pMapData, m_MapInfo.m_Size) != (unsigned)m_MapInfo.m_Size)
+	{
+		free(pMapData);
+		pMapData = 0;
+	}
 	io_seek(m_File, CurSeek, IOSEEK_START);
+	return pMapData;
+}
+
+bool CDemoPlayer::ExtractMap(class IStorage *pStorage)
+{
+	unsigned char *pMapData = GetMapData();
+	if(!pMapData)
+		return false;
 
 	// handle sha256
 	SHA256_DIGEST Sha256 = SHA256_ZEROED;
@@ -851,7 +915,10 @@ bool CDemoPlayer::ExtractMap(class IStorage *pStorage)
 	// save map
 	IOHANDLE MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!MapFile)
+	{
+		free(pMapData);
 		return false;
+	}
 
 	io_write(MapFile, pMapData, m_MapInfo.m_Size);
 	io_close(MapFile);
@@ -922,34 +989,84 @@ int CDemoPlayer::SeekTime(float Seconds)
 	return SetPos(WantedTick);
 }
 
-int CDemoPlayer::SetPos(int WantedTick)
+int CDemoPlayer::SeekToTick(int WantedTick)
 {
-	if(!m_File)
+	if(m_Info.m_SeekablePoints == 0)
 		return -1;
 
-	// -5 because we have to have a current tick and previous tick when we do the playback
-	WantedTick = clamp(WantedTick, m_Info.m_Info.m_FirstTick, m_Info.m_Info.m_LastTick) - 5;
+	// start before the wanted tick so the previous tick gets set too
+	int StartTick = WantedTick - 1;
 
-	// get correct key frame
-	int KeyFrame = 0;
-	while(KeyFrame < m_Info.m_SeekablePoints - 1 && m_pKeyFrames[KeyFrame].m_Tick < WantedTick)
+	// get the last key frame before the tick, or the first one
+	int Low = 0, High = m_Info.m_SeekablePoints;
+	while(Low < High)
 	{
-		KeyFrame++;
+		int Middle = (Low + High) / 2;
+		if(m_pKeyFrames[Middle].m_Tick <= StartTick)
+			Low = Middle + 1;
+		else
+			High = Middle;
 	}
-	while(KeyFrame > 0 && m_pKeyFrames[KeyFrame].m_Tick > WantedTick)
+	const CKeyFrame *pKeyFrame = &m_pKeyFrames[maximum(Low - 1, 0)];
+
+	// a decoded snapshot might be closer
+	const CSeekSnapshot *pSeekSnapshot = 0;
+	Low = 0;
+	High = m_vSeekSnapshots.size();
+	while(Low < High)
 	{
-		KeyFrame--;
+		int Middle = (Low + High) / 2;
+		if(m_vSeekSnapshots[Middle].m_Tick <= StartTick)
+			Low = Middle + 1;
+		else
+			High = Middle;
 	}
-
-	// seek to the correct key frame
-	io_seek(m_File, m_pKeyFrames[KeyFrame].m_Filepos, IOSEEK_START);
+	if(Low > 0 && m_vSeekSnapshots[Low - 1].m_Tick > pKeyFrame->m_Tick)
+		pSeekSnapshot = &m_vSeekSnapshots[Low - 1];
 
 	m_Info.m_NextTick = -1;
 	m_Info.m_Info.m_CurrentTick = -1;
 	m_Info.m_PreviousTick = -1;
 
+	if(pSeekSnapshot)
+	{
+		// continue right after its tick marker
+		io_seek(m_File, pSeekSnapshot->m_Filepos, IOSEEK_START);
+		m_Info.m_NextTick = pSeekSnapshot->m_Tick;
+		mem_copy(m_aLastSnapshotData, &m_vSeekSnapshotData[pSeekSnapshot->m_DataOffset], pSeekSnapshot->m_DataSize);
+		m_LastSnapshotDataSize = pSeekSnapshot->m_DataSize;
+	}
+	else
+	{
+		// seek to the correct key frame
+		io_seek(m_File, pKeyFrame->m_Filepos, IOSEEK_START);
+	}
+
 	// playback everything until we hit our tick
-	while(m_Info.m_PreviousTick < WantedTick && IsPlaying())
+	while(m_Info.m_Info.m_CurrentTick < WantedTick && IsPlaying())
+	{
+		int CurrentTick = m_Info.m_Info.m_CurrentTick;
+		DoTick();
+		// the tick doesn't change anymore at the end of the demo
+		if(CurrentTick != -1 && m_Info.m_Info.m_CurrentTick == CurrentTick)
+			break;
+	}
+
+	return 0;
+}
+
+int CDemoPlayer::SetPos(int WantedTick)
+{
+	if(!m_File)
+		return -1;
+
+	// -5 because we have to have a current tick and previous tick when we do the playback
+	WantedTick = clamp(WantedTick, m_Info.m_Info.m_FirstTick, m_Info.m_Info.m_LastTick) - 5;
+
+	// the previous tick is the wanted one after the next tick
+	if(SeekToTick(WantedTick))
+		return -1;
+	if(IsPlaying())
 		DoTick();
 
 	Play();
@@ -957,6 +1074,37 @@ int CDemoPlayer::SetPos(int WantedTick)
 	return 0;
 }
 
+int CDemoPlayer::SeekTick(ETickOffset TickOffset)
+{
+	if(!m_File)
+		return -1;
+
+	int WantedTick;
+	switch(TickOffset)
+	{
+	case TICK_CURRENT:
+		WantedTick = m_Info.m_Info.m_CurrentTick;
+		break;
+	case TICK_PREVIOUS:
+		WantedTick = m_Info.m_PreviousTick;
+		break;
+	case TICK_NEXT:
+		WantedTick = m_Info.m_NextTick;
+		break;
+	default:
+		dbg_assert(false, "invalid TickOffset");
+		return -1;
+	}
+
+	// ticks can be missing, the wanted tick is the first one at or after it
+	if(SeekToTick(clamp(WantedTick, m_Info.m_Info.m_FirstTick, m_Info.m_Info.m_LastTick)))
+		return -1;
+
+	Play();
+
+	return 0;
+}
+
 void CDemoPlayer::SetSpeed(float Speed)
 {
 	m_Info.m_Info.m_Speed = clamp(Speed, 0.f, 256.f);
@@ -1042,6 +1190,8 @@ int CDemoPlayer::Stop()
 	m_File = 0;
 	free(m_pKeyFrames);
 	m_pKeyFrames = 0;
+	m_vSeekSnapshots.clear();
+	m_vSeekSnapshotData.clear();
 	str_copy(m_aFilename, "", sizeof(m_aFilename));
 	return 0;
 }
@@ -1141,25 +1291,35 @@ void CDemoEditor::Slice(const char *pDemo, const char *pDst, int StartTick, int
 	const CMapInfo *pMapInfo = m_pDemoPlayer->GetMapInfo();
 	const CDemoPlayer::CPlaybackInfo *pInfo = m_pDemoPlayer->Info();
 
+	// take the map from the demo, the recorder looks for it otherwise
+	unsigned char *pMapData = m_pDemoPlayer->GetMapData();
 	SHA256_DIGEST Sha256 = pMapInfo->m_Sha256;
-	if(pInfo->m_Header.m_Version < s_Sha256Version)
-	{
-		if(m_pDemoPlayer->ExtractMap(m_pStorage))
-			Sha256 = pMapInfo->m_Sha256;
-	}
+	if(pMapData && pInfo->m_Header.m_Version < s_Sha256Version)
+		Sha256 = sha256(pMapData, pMapInfo->m_Size);
 
-	if(m_pDemoRecorder->Start(m_pStorage, m_pConsole, pDst, m_pNetVersion, pMapInfo->m_aName, &Sha256, pMapInfo->m_Crc, "client", pMapInfo->m_Size, NULL, NULL, pfnFilter, pUser) == -1)
+	int Result = m_pDemoRecorder->Start(m_pStorage, m_pConsole, pDst, m_pNetVersion, pMapInfo->m_aName, &Sha256, pMapInfo->m_Crc, "client", pMapInfo->m_Size, pMapData, NULL, pfnFilter, pUser);
+	free(pMapData);
+	if(Result == -1)
 		return;
 
-	m_pDemoPlayer->Play();
-
-	while(m_pDemoPlayer->IsPlaying() && !m_Stop)
+	// start at the keyframe before the slice instead of decoding everything
+	// in front of it, ticks before the slice are skipped by the listener
+	if(StartTick != -1)
 	{
-		m_pDemoPlayer->Update(false);
-
-		if(pInfo->m_Info.m_Paused)
-			break;
+		if(m_pDemoPlayer->SetPos(StartTick) == -1)
+		{
+			m_pDemoPlayer->Stop();
+			m_pDemoRecorder->Stop();
+			return;
+		}
 	}
+	else
+		m_pDemoPlayer->Play();
+
+	// one tick at a time, so the cut ends at the end of the slice and not at
+	// the end of the demo
+	while(m_pDemoPlayer->IsPlaying() && !m_Stop && !pInfo->m_Info.m_Paused)
+		m_pDemoPlayer->NextFrame();
 
 	m_pDemoPlayer->Stop();
 	m_pDemoRecorder->Stop();
@@ -7,9 +7,12 @@
 
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
+#include <engine/storage.h>
 
 #include "snapshot.h"
 
+#include <vector>
+
 class CDemoRecorder : public IDemoRecorder
 {
 	class IConsole *m_pConsole;
@@ -35,7 +38,7 @@ public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false);
 	CDemoRecorder() {}
 
-	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, SHA256_DIGEST *pSha256, unsigned MapCrc, const char *pType, unsigned int MapSize, unsigned char *pMapData, IOHANDLE MapFile = 0, DEMOFUNC_FILTER pfnFilter = 0, void *pUser = 0);
+	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, SHA256_DIGEST *pSha256, unsigned MapCrc, const char *pType, unsigned int MapSize, unsigned char *pMapData, IOHANDLE MapFile = 0, DEMOFUNC_FILTER pfnFilter = 0, void *pUser = 0, int StorageType = IStorage::TYPE_SAVE);
 	int Stop();
 	void AddDemoMarker();
 
@@ -94,11 +97,24 @@ private:
 		CKeyFrameSearch *m_pNext;
 	};
 
+	// decoded snapshot before a tick marker, playback can start right
+	// after the marker like at a key frame
+	struct CSeekSnapshot
+	{
+		long m_Filepos;
+		int m_Tick;
+		int m_DataOffset;
+		int m_DataSize;
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	long m_MapOffset;
 	char m_aFilename[256];
 	CKeyFrame *m_pKeyFrames;
+	int m_SeekSnapshotInterval;
+	std::vector<CSeekSnapshot> m_vSeekSnapshots;
+	std::vector<char> m_vSeekSnapshotData;
 	CMapInfo m_MapInfo;
 	int m_SpeedIndex;
 
@@ -108,10 +124,17 @@ private:
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 
+	// for decoding chunks in DoTick, so players can run on several threads
+	char m_aCompressedData[CSnapshot::MAX_SIZE];
+	char m_aDecompressedData[CSnapshot::MAX_SIZE];
+	char m_aChunkData[CSnapshot::MAX_SIZE];
+	char m_aNewSnapshotData[CSnapshot::MAX_SIZE];
+
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
+	int DecompressChunk(const void *pChunk, int ChunkSize, void *pData, int DataSize);
 	void DoTick();
 	void ScanFile();
-	int NextFrame();
+	int SeekToTick(int WantedTick);
 
 	int64_t time();
 
@@ -122,9 +145,14 @@ public:
 	CDemoPlayer(class CSnapshotDelta *pSnapshotDelta);
 
 	void SetListener(IListener *pListener);
+	// keep a decoded snapshot every this many ticks when loading a demo,
+	// seeking then only has to play back from the closest one. 0 disables it
+	void SetSeekSnapshotInterval(int Ticks) { m_SeekSnapshotInterval = Ticks; }
 
 	int Load(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, int StorageType);
 	bool ExtractMap(class IStorage *pStorage);
+	// returns the map data stored in the demo, free it with free()
+	unsigned char *GetMapData();
 	int Play();
 	void Pause();
 	void Unpause();
@@ -134,6 +162,7 @@ public:
 	int SeekPercent(float Percent);
 	int SeekTime(float Seconds);
 	int SetPos(int WantedTick);
+	int SeekTick(ETickOffset TickOffset);
 	const CInfo *BaseInfo() const { return &m_Info.m_Info; }
 	void GetDemoName(char *pBuffer, int BufferSize) const;
 	bool GetDemoInfo(class IStorage *pStorage, const char *pFilename, int StorageType, CDemoHeader *pDemoHeader, CTimelineMarkers *pTimelineMarkers, CMapInfo *pMapInfo) const;
@@ -141,6 +170,8 @@ public:
 	int GetDemoType() const;
 
 	int Update(bool RealTime = true);
+	// plays back one tick, regardless of the time
+	int NextFrame();
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
 	virtual bool IsPlaying() const { return m_File != 0; }
@@ -0,0 +1,316 @@
+#include "demo_index.h"
+
+#include <engine/shared/jobs.h>
+#include <engine/storage.h>
+
+static const unsigned char s_aIndexMarker[8] = {'D', 'D', 'D', 'E', 'M', 'O', 'I', 'X'};
+static const int s_IndexVersion = 2;
+
+// the entries are stored as they are in memory, an index written by a
+// build with a different layout is thrown away
+struct CIndexFileHeader
+{
+	unsigned char m_aMarker[sizeof(s_aIndexMarker)];
+	int m_Version;
+	int m_EntrySize;
+	int m_NumEntries;
+};
+
+CDemoIndex::CData::CData()
+{
+	m_Lock = lock_create();
+	m_SaveLock = lock_create();
+	m_Dirty = false;
+	m_Generation = 0;
+	m_Shutdown = false;
+}
+
+CDemoIndex::CData::~CData()
+{
+	lock_destroy(m_Lock);
+	lock_destroy(m_SaveLock);
+}
+
+// reads the infos of the requested demos, opening thousands of demos takes
+// too long for a frame
+class CDemoIndexJob : public IJob
+{
+	std::shared_ptr<CDemoIndex::CData> m_pData;
+	IStorage *m_pStorage;
+	const IDemoPlayer *m_pDemoPlayer;
+	std::string m_Filename;
+	std::vector<CDemoIndex::CRequest> m_vRequests;
+
+	void Run() override
+	{
+		int NumIndexed = 0;
+		for(const auto &Request : m_vRequests)
+		{
+			if(m_pData->m_Shutdown)
+				return;
+
+			CDemoIndex::CEntry Entry;
+			mem_zero(&Entry, sizeof(Entry));
+			Entry.m_Date = Request.m_Date;
+			Entry.m_Size = Request.m_Size;
+			CDemoIndexInfo *pInfo = &Entry.m_Info;
+			pInfo->m_Valid = m_pDemoPlayer->GetDemoInfo(m_pStorage, Request.m_Path.c_str(), Request.m_StorageType, &pInfo->m_Info, &pInfo->m_TimelineMarkers, &pInfo->m_MapInfo);
+
+			lock_wait(m_pData->m_Lock);
+			m_pData->m_Entries[Request.m_Key] = Entry;
+			// bumped with the erase, so whoever sees the demo isn't
+			// pending anymore also sees the new generation. Don't make
+			// the browser look everything up after every demo
+			if(++NumIndexed % 256 == 0 || &Request == &m_vRequests.back())
+				m_pData->m_Generation++;
+			m_pData->m_Pending.erase(Request.m_Key);
+			m_pData->m_Dirty = true;
+			lock_unlock(m_pData->m_Lock);
+		}
+
+		CDemoIndex::Save(m_pStorage, m_Filename.c_str(), m_pData.get());
+	}
+
+public:
+	CDemoIndexJob(const std::shared_ptr<CDemoIndex::CData> &pData, IStorage *pStorage, const IDemoPlayer *pDemoPlayer, const char *pFilename, std::vector<CDemoIndex::CRequest> &&vRequests) :
+		m_pData(pData),
+		m_pStorage(pStorage),
+		m_pDemoPlayer(pDemoPlayer),
+		m_Filename(pFilename),
+		m_vRequests(std::move(vRequests))
+	{
+	}
+};
+
+CDemoIndex::CDemoIndex()
+{
+	m_pStorage = 0;
+	m_pDemoPlayer = 0;
+	m_pJobPool = 0;
+	m_aFilename[0] = 0;
+	m_pData = std::make_shared<CData>();
+}
+
+CDemoIndex::~CDemoIndex()
+{
+	// running jobs stop after their current demo
+	m_pData->m_Shutdown = true;
+}
+
+void CDemoIndex::Init(IStorage *pStorage, const IDemoPlayer *pDemoPlayer, CJobPool *pJobPool, const char *pFilename)
+{
+	m_pStorage = pStorage;
+	m_pDemoPlayer = pDemoPlayer;
+	m_pJobPool = pJobPool;
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+	Load();
+}
+
+void CDemoIndex::Key(const char *pPath, int StorageType, char *pBuffer, int BufferSize)
+{
+	// the same demo can be listed from different storage types
+	if(StorageType == IStorage::TYPE_ABSOLUTE)
+		str_copy(pBuffer, pPath, BufferSize);
+	else
+		m_pStorage->GetCompletePath(StorageType, pPath, pBuffer, BufferSize);
+}
+
+bool CDemoIndex::Find(const char *pPath, int StorageType, time_t Date, int64_t Size, CDemoIndexInfo *pInfo)
+{
+	char aKey[MAX_PATH_LENGTH];
+	Key(pPath, StorageType, aKey, sizeof(aKey));
+
+	bool Found = false;
+	lock_wait(m_pData->m_Lock);
+	auto Entry = m_pData->m_Entries.find(aKey);
+	if(Entry != m_pData->m_Entries.end() && Entry->second.m_Date == Date && Entry->second.m_Size == Size)
+	{
+		*pInfo = Entry->second.m_Info;
+		Found = true;
+	}
+	lock_unlock(m_pData->m_Lock);
+	return Found;
+}
+
+void CDemoIndex::Add(const char *pPath, int StorageType, time_t Date, int64_t Size, const CDemoIndexInfo *pInfo)
+{
+	char aKey[MAX_PATH_LENGTH];
+	Key(pPath, StorageType, aKey, sizeof(aKey));
+
+	CEntry Entry;
+	mem_zero(&Entry, sizeof(Entry));
+	Entry.m_Date = Date;
+	Entry.m_Size = Size;
+	Entry.m_Info = *pInfo;
+
+	lock_wait(m_pData->m_Lock);
+	m_pData->m_Entries[aKey] = Entry;
+	m_pData->m_Dirty = true;
+	lock_unlock(m_pData->m_Lock);
+}
+
+void CDemoIndex::Prune(const char *pFolder, int StorageType, const std::vector<std::string> &vFilenames)
+{
+	char aPrefix[MAX_PATH_LENGTH];
+	Key(pFolder, StorageType, aPrefix, sizeof(aPrefix));
+	str_append(aPrefix, "/", sizeof(aPrefix));
+	int PrefixLength = str_length(aPrefix);
+	std::set<std::string> Listed(vFilenames.begin(), vFilenames.end());
+
+	// the keys of the folder are next to each other, demos in subfolders
+	// are kept
+	lock_wait(m_pData->m_Lock);
+	auto Entry = m_pData->m_Entries.lower_bound(aPrefix);
+	while(Entry != m_pData->m_Entries.end() && str_startswith(Entry->first.c_str(), aPrefix))
+	{
+		const char *pName = Entry->first.c_str() + PrefixLength;
+		if(str_find(pName, "/") || Listed.count(pName))
+			++Entry;
+		else
+		{
+			Entry = m_pData->m_Entries.erase(Entry);
+			m_pData->m_Dirty = true;
+		}
+	}
+	lock_unlock(m_pData->m_Lock);
+}
+
+void CDemoIndex::Request(const char *pPath, int StorageType, time_t Date, int64_t Size)
+{
+	char aKey[MAX_PATH_LENGTH];
+	Key(pPath, StorageType, aKey, sizeof(aKey));
+
+	lock_wait(m_pData->m_Lock);
+	bool Pending = !m_pData->m_Pending.insert(aKey).second;
+	lock_unlock(m_pData->m_Lock);
+	if(Pending)
+		return;
+
+	CRequest Request;
+	Request.m_Key = aKey;
+	Request.m_Path = pPath;
+	Request.m_StorageType = StorageType;
+	Request.m_Date = Date;
+	Request.m_Size = Size;
+	m_vRequests.push_back(Request);
+}
+
+void CDemoIndex::StartJob()
+{
+	if(m_vRequests.empty())
+		return;
+
+	m_pJobPool->Add(std::make_shared<CDemoIndexJob>(m_pData, m_pStorage, m_pDemoPlayer, m_aFilename, std::move(m_vRequests)), CJobPool::PRIORITY_LOW);
+	m_vRequests.clear();
+}
+
+void CDemoIndex::Shutdown()
+{
+	m_pData->m_Shutdown = true;
+	Save();
+}
+
+int CDemoIndex::NumPending()
+{
+	lock_wait(m_pData->m_Lock);
+	int NumPending = m_pData->m_Pending.size();
+	lock_unlock(m_pData->m_Lock);
+	return NumPending;
+}
+
+bool CDemoIndex::Load()
+{
+	IOHANDLE File = m_pStorage->OpenFile(m_aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	CIndexFileHeader Header;
+	bool Success = io_read(File, &Header, sizeof(Header)) == sizeof(Header) &&
+		       mem_comp(Header.m_aMarker, s_aIndexMarker, sizeof(s_aIndexMarker)) == 0 &&
+		       Header.m_Version == s_IndexVersion &&
+		       Header.m_EntrySize == (int)sizeof(CEntry);
+
+	std::map<std::string, CEntry> Entries;
+	for(int i = 0; Success && i < Header.m_NumEntries; i++)
+	{
+		int KeyLength;
+		char aKey[MAX_PATH_LENGTH];
+		CEntry Entry;
+		Success = io_read(File, &KeyLength, sizeof(KeyLength)) == sizeof(KeyLength) &&
+			  KeyLength > 0 && KeyLength < (int)sizeof(aKey) &&
+			  io_read(File, aKey, KeyLength) == (unsigned)KeyLength &&
+			  io_read(File, &Entry, sizeof(Entry)) == sizeof(Entry);
+		if(Success)
+		{
+			// any other value than 0 or 1 isn't a bool
+			unsigned char Valid;
+			mem_copy(&Valid, &Entry.m_Info.m_Valid, sizeof(Valid));
+			Success = Valid <= 1;
+		}
+		if(Success)
+			Entries.emplace_hint(Entries.end(), std::string(aKey, KeyLength), Entry);
+	}
+	io_close(File);
+
+	if(!Success)
+	{
+		dbg_msg("demo_index", "failed to load '%s', starting a new index", m_aFilename);
+		return false;
+	}
+
+	lock_wait(m_pData->m_Lock);
+	m_pData->m_Entries.swap(Entries);
+	m_pData->m_Dirty = false;
+	lock_unlock(m_pData->m_Lock);
+	return true;
+}
+
+bool CDemoIndex::Save()
+{
+	return Save(m_pStorage, m_aFilename, m_pData.get());
+}
+
+bool CDemoIndex::Save(IStorage *pStorage, const char *pFilename, CData *pData)
+{
+	// write a copy, the entries stay usable while the file is written
+	lock_wait(pData->m_SaveLock);
+	lock_wait(pData->m_Lock);
+	if(!pData->m_Dirty)
+	{
+		lock_unlock(pData->m_Lock);
+		lock_unlock(pData->m_SaveLock);
+		return true;
+	}
+	std::vector<std::pair<std::string, CEntry>> vEntries(pData->m_Entries.begin(), pData->m_Entries.end());
+	pData->m_Dirty = false;
+	lock_unlock(pData->m_Lock);
+
+	char aTmpFilename[256];
+	str_format(aTmpFilename, sizeof(aTmpFilename), "%s.%d.tmp", pFilename, pid());
+	IOHANDLE File = pStorage->OpenFile(aTmpFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("demo_index", "failed to open '%s' for writing", aTmpFilename);
+		lock_unlock(pData->m_SaveLock);
+		return false;
+	}
+
+	CIndexFileHeader Header;
+	mem_copy(Header.m_aMarker, s_aIndexMarker, sizeof(Header.m_aMarker));
+	Header.m_Version = s_IndexVersion;
+	Header.m_EntrySize = sizeof(CEntry);
+	Header.m_NumEntries = vEntries.size();
+	io_write(File, &Header, sizeof(Header));
+	for(const auto &Entry : vEntries)
+	{
+		int KeyLength = Entry.first.size();
+		io_write(File, &KeyLength, sizeof(KeyLength));
+		io_write(File, Entry.first.c_str(), KeyLength);
+		io_write(File, &Entry.second, sizeof(Entry.second));
+	}
+	io_close(File);
+
+	bool Success = pStorage->RenameFile(aTmpFilename, pFilename, IStorage::TYPE_SAVE);
+	lock_unlock(pData->m_SaveLock);
+	return Success;
+}
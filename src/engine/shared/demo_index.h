@@ -0,0 +1,108 @@
+#ifndef ENGINE_SHARED_DEMO_INDEX_H
+#define ENGINE_SHARED_DEMO_INDEX_H
+
+#include <base/system.h>
+#include <engine/demo.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class CJobPool;
+class IStorage;
+
+// what the demo browser shows, sorts and filters by
+struct CDemoIndexInfo
+{
+	bool m_Valid;
+	CDemoHeader m_Info;
+	CTimelineMarkers m_TimelineMarkers;
+	CMapInfo m_MapInfo;
+};
+
+// Infos of demo files, kept on disk and keyed by the path, the size and
+// the modification date of the demos, so listing a folder doesn't have
+// to open every demo in it. Demos that aren't indexed yet are read by a
+// background job.
+class CDemoIndex
+{
+public:
+	class CEntry
+	{
+	public:
+		int64_t m_Date;
+		int64_t m_Size;
+		CDemoIndexInfo m_Info;
+	};
+
+	// a demo for the background job
+	class CRequest
+	{
+	public:
+		std::string m_Key;
+		std::string m_Path;
+		int m_StorageType;
+		int64_t m_Date;
+		int64_t m_Size;
+	};
+
+	// shared with the jobs, which may outlive the index
+	class CData
+	{
+	public:
+		LOCK m_Lock;
+		// only one save writes the file at a time
+		LOCK m_SaveLock;
+		std::map<std::string, CEntry> m_Entries GUARDED_BY(m_Lock);
+		std::set<std::string> m_Pending GUARDED_BY(m_Lock);
+		bool m_Dirty GUARDED_BY(m_Lock);
+		std::atomic<int> m_Generation;
+		std::atomic<bool> m_Shutdown;
+
+		CData();
+		~CData();
+	};
+
+private:
+	IStorage *m_pStorage;
+	const IDemoPlayer *m_pDemoPlayer;
+	CJobPool *m_pJobPool;
+	char m_aFilename[128];
+	std::shared_ptr<CData> m_pData;
+	std::vector<CRequest> m_vRequests;
+
+	void Key(const char *pPath, int StorageType, char *pBuffer, int BufferSize);
+
+public:
+	CDemoIndex();
+	~CDemoIndex();
+
+	// loads the index from pFilename in the save directory. GetDemoInfo of
+	// the demo player is called on the job threads
+	void Init(IStorage *pStorage, const IDemoPlayer *pDemoPlayer, CJobPool *pJobPool, const char *pFilename = "ddnet-demo-index.dat");
+
+	// false if the demo isn't indexed or changed since
+	bool Find(const char *pPath, int StorageType, time_t Date, int64_t Size, CDemoIndexInfo *pInfo);
+	void Add(const char *pPath, int StorageType, time_t Date, int64_t Size, const CDemoIndexInfo *pInfo);
+	// forgets the demos of a folder that weren't listed in it
+	void Prune(const char *pFolder, int StorageType, const std::vector<std::string> &vFilenames);
+
+	// queues a demo for the background job, StartJob reads the queued ones
+	void Request(const char *pPath, int StorageType, time_t Date, int64_t Size);
+	void StartJob();
+	int NumPending();
+	// changes whenever the job indexed demos
+	int Generation() const { return m_pData->m_Generation.load(); }
+
+	// stops the jobs after their current demo and saves the index
+	void Shutdown();
+
+	bool Load();
+	bool Save();
+	static bool Save(IStorage *pStorage, const char *pFilename, CData *pData);
+};
+
+#endif // ENGINE_SHARED_DEMO_INDEX_H
@@ -99,11 +99,11 @@ public:
 			dbg_logger_file(g_Config.m_Logfile);
 	}
 
-	void AddJob(std::shared_ptr<IJob> pJob)
+	void AddJob(std::shared_ptr<IJob> pJob, int Priority)
 	{
 		if(g_Config.m_Debug)
 			dbg_msg("engine", "job added");
-		m_JobPool.Add(std::move(pJob));
+		m_JobPool.Add(std::move(pJob), Priority);
 	}
 };
 
@@ -106,94 +106,82 @@ void CHuffman::Init(const unsigned *pFrequencies)
 	// build decode LUT
 	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
-		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		CDecodeEntry *pEntry = &m_aDecodeLut[i];
+		unsigned Used = 0;
+		while(pEntry->m_NumSymbols < HUFFMAN_LUTSYMBOLS)
 		{
-			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
-			Bits >>= 1;
-
-			if(!pNode)
-				break;
+			// walk the next code as far as the looked up bits go
+			CNode *pNode = m_pStartNode;
+			unsigned Depth = 0;
+			while(!pNode->m_NumBits && Used + Depth < HUFFMAN_LUTBITS)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[(i >> (Used + Depth)) & 1]];
+				Depth++;
+			}
 
-			if(pNode->m_NumBits)
+			if(!pNode->m_NumBits || pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			{
-				m_apDecodeLut[i] = pNode;
+				if(pEntry->m_NumSymbols == 0)
+				{
+					pEntry->m_Node = pNode - m_aNodes;
+					pEntry->m_NumBits = Depth;
+				}
 				break;
 			}
-		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+			pEntry->m_aSymbols[pEntry->m_NumSymbols++] = pNode->m_Symbol;
+			Used += Depth;
+			pEntry->m_NumBits = Used;
+		}
 	}
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-	Bitcount += m_aNodes[Sym].m_NumBits;
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	while(Bitcount >= 8) \
-	{ \
-		*pDst++ = (unsigned char)(Bits & 0xff); \
-		if(pDst == pDstEnd) \
-			return -1; \
-		Bits >>= 8; \
-		Bitcount -= 8; \
-	}
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// symbol variables, the bits are written out a word at a time
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	// load the symbols for the bytes and the EOF symbol after them
+	for(;; pSrc++)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		int Symbol = pSrc != pSrcEnd ? *pSrc : (int)HUFFMAN_EOF_SYMBOL;
+		unsigned NumBits = m_aNodes[Symbol].m_NumBits;
+		Bits |= (uint64_t)m_aNodes[Symbol].m_Bits << Bitcount;
+		Bitcount += NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 64)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			// the last byte is always written, make sure it fits behind the word
+			if(pDstEnd - pDst < 8 + 1)
+				return -1;
+			for(int i = 0; i < 8; i++)
+				pDst[i] = (unsigned char)(Bits >> (i * 8));
+			pDst += 8;
+			Bitcount -= 64;
+			Bits = (uint64_t)m_aNodes[Symbol].m_Bits >> (NumBits - Bitcount);
 		}
 
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-		HUFFMAN_MACRO_WRITE()
+		if(Symbol == HUFFMAN_EOF_SYMBOL)
+			break;
 	}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
-	HUFFMAN_MACRO_WRITE()
-
-	// write out the last bits
-	*pDst++ = Bits;
+	// write out the last bits, and a byte for them even if there are none
+	int Size = Bitcount / 8 + 1;
+	if(pDstEnd - pDst < Size)
+		return -1;
+	for(int i = 0; i < Size; i++)
+		*pDst++ = (unsigned char)(Bits >> (i * 8));
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -201,52 +189,84 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
 	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 	CNode *pNode = 0;
 
-	while(1)
+	// {A} while a word of input is left every code is loaded completely,
+	// decode several symbols per lookup
+	while(pSrcEnd - pSrc >= 8 && pDstEnd - pDst >= HUFFMAN_LUTSYMBOLS)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+		// fill up to 56 to 63 bits, the partially loaded byte gets loaded
+		// again by the next fill
+		uint64_t Word = 0;
+		for(int i = 0; i < 8; i++)
+			Word |= (uint64_t)pSrc[i] << (i * 8);
+		Bits |= Word << Bitcount;
+		pSrc += (63 - Bitcount) >> 3;
+		Bitcount |= 56;
+
+		const CDecodeEntry *pEntry = &m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+		if(pEntry->m_NumSymbols)
+		{
+			// copy all of them, only the decoded ones are kept
+			mem_copy(pDst, pEntry->m_aSymbols, HUFFMAN_LUTSYMBOLS);
+			pDst += pEntry->m_NumSymbols;
+			Bits >>= pEntry->m_NumBits;
+			Bitcount -= pEntry->m_NumBits;
+			continue;
+		}
 
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// eof or a longer code, walk the tree for it
+		pNode = &m_aNodes[pEntry->m_Node];
+		Bits >>= pEntry->m_NumBits;
+		Bitcount -= pEntry->m_NumBits;
+		while(!pNode->m_NumBits)
 		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+			Bitcount--;
+			Bits >>= 1;
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+		if(pNode == pEof)
+			return (int)(pDst - (const unsigned char *)pOutput);
+		*pDst++ = pNode->m_Symbol;
+	}
 
-		if(!pNode)
-			return -1;
+	// {B} decode the rest one symbol at a time, the same way the decoder
+	// always did, for the same results on truncated input
+	while(1)
+	{
+		// fill with new bits
+		while(Bitcount < 24 && pSrc != pSrcEnd)
+		{
+			Bits |= (uint64_t)(*pSrc++) << Bitcount;
+			Bitcount += 8;
+		}
 
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		const CDecodeEntry *pEntry = &m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+		if(pEntry->m_NumSymbols)
 		{
-			// remove the bits for that symbol
+			// remove the bits for the first symbol
+			pNode = &m_aNodes[pEntry->m_aSymbols[0]];
 			Bits >>= pNode->m_NumBits;
 			Bitcount -= pNode->m_NumBits;
 		}
 		else
 		{
 			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
+			pNode = &m_aNodes[pEntry->m_Node];
+			Bits >>= pEntry->m_NumBits;
+			Bitcount -= pEntry->m_NumBits;
 
 			// walk the tree bit by bit
-			while(1)
+			while(!pNode->m_NumBits)
 			{
 				// traverse tree
 				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
@@ -255,12 +275,8 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 				Bitcount--;
 				Bits >>= 1;
 
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
-
 				// no more bits, decoding error
-				if(Bitcount == 0)
+				if(!pNode->m_NumBits && Bitcount == 0)
 					return -1;
 			}
 		}
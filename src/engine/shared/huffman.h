@@ -14,7 +14,8 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+		HUFFMAN_LUTSYMBOLS = 4
 	};
 
 	struct CNode
@@ -30,8 +31,22 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	struct CDecodeEntry
+	{
+		// the symbols whose codes fit into the looked up bits, stops
+		// before eof and before codes that are longer
+		unsigned char m_aSymbols[HUFFMAN_LUTSYMBOLS];
+		unsigned char m_NumSymbols;
+
+		// bits of the symbols, without symbols the bits to m_Node
+		unsigned char m_NumBits;
+
+		// without symbols the eof node or the node to walk the tree from
+		unsigned short m_Node;
+	};
+
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
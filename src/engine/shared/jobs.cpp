@@ -3,17 +3,20 @@
 #include "jobs.h"
 
 IJob::IJob() :
+	m_pGroup(0),
 	m_Status(STATE_PENDING)
 {
 }
 
 IJob::IJob(const IJob &Other) :
+	m_pGroup(0),
 	m_Status(STATE_PENDING)
 {
 }
 
 IJob &IJob::operator=(const IJob &Other)
 {
+	m_pGroup = 0;
 	m_Status = STATE_PENDING;
 	return *this;
 }
@@ -27,15 +30,107 @@ int IJob::Status()
 	return m_Status.load();
 }
 
+CJobGroup::CJobGroup()
+{
+	m_Lock = lock_create();
+	sphore_init(&m_Done);
+	m_NumPending = 0;
+}
+
+CJobGroup::~CJobGroup()
+{
+	lock_destroy(m_Lock);
+	sphore_destroy(&m_Done);
+}
+
+int CJobGroup::NumPending()
+{
+	lock_wait(m_Lock);
+	int NumPending = m_NumPending;
+	lock_unlock(m_Lock);
+	return NumPending;
+}
+
+void CJobGroup::Finish()
+{
+	// signal while holding the lock, the group may be destroyed as soon
+	// as a waiter sees no pending jobs
+	lock_wait(m_Lock);
+	if(--m_NumPending == 0)
+		sphore_signal(&m_Done);
+	lock_unlock(m_Lock);
+}
+
+void CJobGroup::Wait()
+{
+	// the semaphore can hold signals from earlier rounds, recheck
+	while(NumPending() > 0)
+		sphore_wait(&m_Done);
+}
+
+CJobPool::CQueue::CQueue()
+{
+	for(unsigned i = 0; i < SIZE; i++)
+		m_aSlots[i].m_Sequence.store(i, std::memory_order_relaxed);
+	m_PushPos.store(0, std::memory_order_relaxed);
+	m_PopPos.store(0, std::memory_order_relaxed);
+}
+
+bool CJobPool::CQueue::TryPush(std::shared_ptr<IJob> &pJob)
+{
+	unsigned Pos = m_PushPos.load(std::memory_order_relaxed);
+	CSlot *pSlot;
+	while(true)
+	{
+		pSlot = &m_aSlots[Pos & MASK];
+		int Diff = (int)(pSlot->m_Sequence.load(std::memory_order_acquire) - Pos);
+		if(Diff == 0)
+		{
+			if(m_PushPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if(Diff < 0)
+			return false; // full
+		else
+			Pos = m_PushPos.load(std::memory_order_relaxed);
+	}
+	pSlot->m_pJob = std::move(pJob);
+	pSlot->m_Sequence.store(Pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool CJobPool::CQueue::TryPop(std::shared_ptr<IJob> &pJob)
+{
+	unsigned Pos = m_PopPos.load(std::memory_order_relaxed);
+	CSlot *pSlot;
+	while(true)
+	{
+		pSlot = &m_aSlots[Pos & MASK];
+		int Diff = (int)(pSlot->m_Sequence.load(std::memory_order_acquire) - (Pos + 1));
+		if(Diff == 0)
+		{
+			if(m_PopPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if(Diff < 0)
+			return false; // empty, or the next job isn't written yet
+		else
+			Pos = m_PopPos.load(std::memory_order_relaxed);
+	}
+	pJob = std::move(pSlot->m_pJob);
+	pSlot->m_Sequence.store(Pos + SIZE, std::memory_order_release);
+	return true;
+}
+
 CJobPool::CJobPool()
 {
 	// empty the pool
 	m_NumThreads = 0;
 	m_Shutdown = false;
-	m_Lock = lock_create();
+	m_OverflowLock = lock_create();
+	for(auto &NumOverflow : m_aNumOverflow)
+		NumOverflow = 0;
 	sphore_init(&m_Semaphore);
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
 }
 
 CJobPool::~CJobPool()
@@ -48,34 +143,51 @@ CJobPool::~CJobPool()
 		if(m_apThreads[i])
 			thread_wait(m_apThreads[i]);
 	}
-	lock_destroy(m_Lock);
+	lock_destroy(m_OverflowLock);
 	sphore_destroy(&m_Semaphore);
 }
 
+bool CJobPool::TryPop(std::shared_ptr<IJob> &pJob)
+{
+	for(int i = 0; i < NUM_PRIORITIES; i++)
+	{
+		// the overflow only holds jobs added after the ones in the queue
+		if(m_aQueues[i].TryPop(pJob))
+			return true;
+		if(m_aNumOverflow[i].load() == 0)
+			continue;
+
+		bool Found = false;
+		lock_wait(m_OverflowLock);
+		if(!m_aOverflow[i].empty())
+		{
+			pJob = std::move(m_aOverflow[i].front());
+			m_aOverflow[i].pop_front();
+			m_aNumOverflow[i]--;
+			Found = true;
+		}
+		lock_unlock(m_OverflowLock);
+		if(Found)
+			return true;
+	}
+	return false;
+}
+
 void CJobPool::WorkerThread(void *pUser)
 {
 	CJobPool *pPool = (CJobPool *)pUser;
 
 	while(!pPool->m_Shutdown)
 	{
-		std::shared_ptr<IJob> pJob = 0;
-
-		// fetch job from queue
 		sphore_wait(&pPool->m_Semaphore);
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
-		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(!pPool->m_pFirstJob)
-				pPool->m_pLastJob = 0;
-		}
-		lock_unlock(pPool->m_Lock);
 
-		// do the job if we have one
-		if(pJob)
+		// a wakeup can find the job already taken by another worker, or
+		// still being written, its producer signals again afterwards
+		std::shared_ptr<IJob> pJob;
+		while(!pPool->m_Shutdown && pPool->TryPop(pJob))
 		{
 			RunBlocking(pJob.get());
+			pJob = nullptr;
 		}
 	}
 }
@@ -84,28 +196,40 @@ void CJobPool::Init(int NumThreads)
 {
 	// start threads
 	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
-	for(int i = 0; i < NumThreads; i++)
+	for(int i = 0; i < m_NumThreads; i++)
 		m_apThreads[i] = thread_init(WorkerThread, this, "CJobPool worker");
 }
 
-void CJobPool::Add(std::shared_ptr<IJob> pJob)
+void CJobPool::Add(std::shared_ptr<IJob> pJob, int Priority, CJobGroup *pGroup)
 {
-	lock_wait(m_Lock);
-
-	// add job to queue
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = std::move(pJob);
-	if(!m_pFirstJob)
-		m_pFirstJob = m_pLastJob;
+	dbg_assert(Priority >= 0 && Priority < NUM_PRIORITIES, "invalid job priority");
+	if(pGroup)
+	{
+		lock_wait(pGroup->m_Lock);
+		pGroup->m_NumPending++;
+		lock_unlock(pGroup->m_Lock);
+		pJob->m_pGroup = pGroup;
+	}
 
-	lock_unlock(m_Lock);
+	if(m_aNumOverflow[Priority].load() > 0 || !m_aQueues[Priority].TryPush(pJob))
+	{
+		lock_wait(m_OverflowLock);
+		m_aOverflow[Priority].push_back(std::move(pJob));
+		m_aNumOverflow[Priority]++;
+		lock_unlock(m_OverflowLock);
+	}
 	sphore_signal(&m_Semaphore);
 }
 
 void CJobPool::RunBlocking(IJob *pJob)
 {
+	CJobGroup *pGroup = pJob->m_pGroup;
 	pJob->m_Status = IJob::STATE_RUNNING;
 	pJob->Run();
 	pJob->m_Status = IJob::STATE_DONE;
+	if(pGroup)
+	{
+		pJob->m_pGroup = 0;
+		pGroup->Finish();
+	}
 }
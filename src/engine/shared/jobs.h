@@ -6,9 +6,11 @@
 #include <base/system.h>
 
 #include <atomic>
+#include <deque>
 #include <memory>
 
 class IJob;
+class CJobGroup;
 class CJobPool;
 
 class IJob
@@ -16,7 +18,7 @@ class IJob
 	friend class CJobPool;
 
 private:
-	std::shared_ptr<IJob> m_pNext;
+	CJobGroup *m_pGroup;
 
 	std::atomic<int> m_Status;
 	virtual void Run() = 0;
@@ -36,21 +38,90 @@ public:
 	};
 };
 
+// Tracks the jobs added to a pool with it, must outlive them.
+class CJobGroup
+{
+	friend class CJobPool;
+
+	LOCK m_Lock;
+	SEMAPHORE m_Done;
+	int m_NumPending GUARDED_BY(m_Lock);
+
+	void Finish();
+
+public:
+	CJobGroup();
+	~CJobGroup();
+	int NumPending();
+	// blocks until all jobs of the group are done, don't call it from
+	// a job of the same pool
+	void Wait();
+};
+
 class CJobPool
 {
+public:
 	enum
 	{
 		MAX_THREADS = 32
 	};
+
+	enum
+	{
+		PRIORITY_HIGH = 0,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		NUM_PRIORITIES
+	};
+
+private:
+	// bounded lock-free multi-producer multi-consumer queue, each slot
+	// has a sequence number telling whether it can be written or read
+	class CQueue
+	{
+	public:
+		enum
+		{
+			SIZE = 1024,
+			MASK = SIZE - 1,
+		};
+
+		CQueue();
+		bool TryPush(std::shared_ptr<IJob> &pJob);
+		bool TryPop(std::shared_ptr<IJob> &pJob);
+
+	private:
+		struct CSlot
+		{
+			std::atomic<unsigned> m_Sequence;
+			std::shared_ptr<IJob> m_pJob;
+		};
+
+		CSlot m_aSlots[SIZE];
+		// padded to keep them on separate cache lines, alignas would need
+		// aligned new
+		char m_aPad0[64];
+		std::atomic<unsigned> m_PushPos;
+		char m_aPad1[64];
+		std::atomic<unsigned> m_PopPos;
+	};
+
 	int m_NumThreads;
 	void *m_apThreads[MAX_THREADS];
 	std::atomic<bool> m_Shutdown;
 
-	LOCK m_Lock;
+	CQueue m_aQueues[NUM_PRIORITIES];
+	// used when a queue is full, and for the jobs of that priority after
+	// it until the overflow is drained so they keep their order
+	LOCK m_OverflowLock;
+	std::deque<std::shared_ptr<IJob>> m_aOverflow[NUM_PRIORITIES] GUARDED_BY(m_OverflowLock);
+	std::atomic<int> m_aNumOverflow[NUM_PRIORITIES];
+
+	// woken once per added job, workers then run jobs until the queues
+	// are empty
 	SEMAPHORE m_Semaphore;
-	std::shared_ptr<IJob> m_pFirstJob GUARDED_BY(m_Lock);
-	std::shared_ptr<IJob> m_pLastJob GUARDED_BY(m_Lock);
 
+	bool TryPop(std::shared_ptr<IJob> &pJob);
 	static void WorkerThread(void *pUser);
 
 public:
@@ -58,7 +129,7 @@ public:
 	~CJobPool();
 
 	void Init(int NumThreads);
-	void Add(std::shared_ptr<IJob> pJob);
+	void Add(std::shared_ptr<IJob> pJob, int Priority = PRIORITY_NORMAL, CJobGroup *pGroup = 0);
 	static void RunBlocking(IJob *pJob);
 };
 #endif
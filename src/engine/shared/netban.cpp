@@ -194,6 +194,7 @@ void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanIn
 
 void CNetBan::UnbanAll()
 {
+	CScopeLock Lock(&m_PoolLock);
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
 }
@@ -250,6 +251,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
 	// check if it already exists
+	CScopeLock Lock(&m_PoolLock);
 	CNetHash NetHash(pData);
 	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
 	if(pBan)
@@ -279,6 +281,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
+	CScopeLock Lock(&m_PoolLock);
 	CNetHash NetHash(pData);
 	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
 	if(pBan)
@@ -318,6 +321,7 @@ void CNetBan::Update()
 	int Now = time_timestamp();
 
 	// remove expired bans
+	CScopeLock Lock(&m_PoolLock);
 	char aBuf[256], aNetStr[256];
 	while(m_BanAddrPool.First() && m_BanAddrPool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanAddrPool.First()->m_Info.m_Expires < Now)
 	{
@@ -363,6 +367,7 @@ int CNetBan::UnbanByRange(const CNetRange *pRange)
 
 int CNetBan::UnbanByIndex(int Index)
 {
+	CScopeLock Lock(&m_PoolLock);
 	int Result;
 	char aBuf[256];
 	CBanAddr *pBan = m_BanAddrPool.Get(Index);
@@ -406,6 +411,7 @@ bool CNetBan::IsBanned(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize
 	int Length = CNetHash::MakeHashArray(pAddr, aHash);
 
 	// check ban addresses
+	CScopeLock Lock(&m_PoolLock);
 	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
 	if(pBan)
 	{
@@ -4,6 +4,7 @@
 #include <engine/console.h>
 
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
 {
@@ -158,6 +159,9 @@ protected:
 	CBanAddrPool m_BanAddrPool;
 	CBanRangePool m_BanRangePool;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
+	// taken for changing the pools and by IsBanned, so the server's receive
+	// thread can check addresses
+	mutable CLock m_PoolLock;
 
 public:
 	enum
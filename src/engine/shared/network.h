@@ -123,6 +123,10 @@ struct CNetChunk
 	unsigned char m_aExtraData[4];
 };
 
+// returns true if it answered the packet, replies have to be sent with
+// Socket since it may be called on the receive thread
+typedef bool (*NETFUNC_CONNLESS)(NETSOCKET Socket, const CNetChunk *pChunk, SECURITY_TOKEN ResponseToken, void *pUser);
+
 class CNetChunkHeader
 {
 public:
@@ -309,6 +313,7 @@ class CNetServer
 	NETADDR m_Address;
 	NETSOCKET m_Socket;
 	MMSGS m_MMSGS;
+	SEND_MMSGS m_SendMMSGS;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients;
@@ -318,6 +323,7 @@ class CNetServer
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
 	NETFUNC_DELCLIENT m_pfnDelClient;
 	NETFUNC_CLIENTREJOIN m_pfnClientRejoin;
+	NETFUNC_CONNLESS m_pfnConnless;
 	void *m_pUser;
 
 	int m_NumConAttempts; // log flooding attacks
@@ -332,6 +338,10 @@ class CNetServer
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
+	// reads and unpacks the packets if started, Recv takes them from it
+	class CRecvThread;
+	CRecvThread *m_pRecvThread;
+
 	void OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketConstruct &Packet);
 	int OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg, const CNetPacketConstruct &Packet, SECURITY_TOKEN &ResponseToken, SECURITY_TOKEN Token);
 	void OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet);
@@ -348,6 +358,9 @@ class CNetServer
 public:
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_NOAUTH pfnNewClientNoAuth, NETFUNC_CLIENTREJOIN pfnClientRejoin, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
+	// gets the connless packets first, on the receive thread if it's
+	// started, packets it answered aren't returned by Recv
+	void SetConnlessCallback(NETFUNC_CONNLESS pfnConnless) { m_pfnConnless = pfnConnless; }
 
 	//
 	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags);
@@ -357,6 +370,17 @@ public:
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
 	int Update();
+	// sends the packets queued since the last call, before waiting for
+	// new ones
+	void SendQueued() { net_udp_flush(m_Socket); }
+	// returns true if packets arrived before the time ran out
+	bool WaitForPackets(int Microseconds);
+
+	// moves reading the socket, unpacking the packets, ban checks, token
+	// requests and the connless callback to a thread, everything else
+	// stays on the calling thread
+	void StartRecvThread();
+	void StopRecvThread();
 
 	//
 	int Drop(int ClientID, const char *pReason);
@@ -372,6 +396,11 @@ public:
 
 	void SendTokenSixup(NETADDR &Addr, SECURITY_TOKEN Token);
 	int SendConnlessSixup(CNetChunk *pChunk, SECURITY_TOKEN ResponseToken);
+	// sends connless packets that already carry their header, for 0.7
+	// the security tokens in it are filled in. Socket is Socket() or the
+	// one the connless callback got
+	void SendConnlessRaw(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize) { net_udp_send(Socket, pAddr, pData, DataSize); }
+	void SendConnlessSixupRaw(NETSOCKET Socket, const NETADDR *pAddr, unsigned char *pData, int DataSize, SECURITY_TOKEN ResponseToken);
 
 	//
 	void SetMaxClientsPerIP(int Max);
@@ -8,10 +8,16 @@
 #include "config.h"
 #include "netban.h"
 #include "network.h"
+#include "spsc_queue.h"
 #include <engine/message.h>
 #include <engine/shared/protocol.h>
 #include <game/generated/protocol.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 const int DummyMapCrc = 0x6c760ac4;
 unsigned char g_aDummyMapData[] = {
 	0x44, 0x41, 0x54, 0x41, 0x04, 0x00, 0x00, 0x00, 0x22, 0x01, 0x00, 0x00,
@@ -46,6 +52,193 @@ static SECURITY_TOKEN ToSecurityToken(const unsigned char *pData)
 	return (int)pData[0] | (pData[1] << 8) | (pData[2] << 16) | (pData[3] << 24);
 }
 
+static void SendTokenSixup(NETSOCKET Socket, NETADDR &Addr, SECURITY_TOKEN MyToken, SECURITY_TOKEN Token)
+{
+	unsigned char aBuf[512] = {};
+	mem_copy(aBuf, &MyToken, 4);
+	int Size = (Token == NET_SECURITY_TOKEN_UNKNOWN) ? 512 : 4;
+	CNetBase::SendControlMsg(Socket, &Addr, 0, 5, aBuf, Size, Token, true);
+}
+
+static void ConnlessChunk(CNetChunk *pChunk, const NETADDR &Addr, const CNetPacketConstruct &Packet)
+{
+	pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+	pChunk->m_ClientID = -1;
+	pChunk->m_Address = Addr;
+	pChunk->m_DataSize = Packet.m_DataSize;
+	pChunk->m_pData = Packet.m_aChunkData;
+	if(Packet.m_Flags & NET_PACKETFLAG_EXTENDED)
+	{
+		pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
+		mem_copy(pChunk->m_aExtraData, Packet.m_aExtraData, sizeof(pChunk->m_aExtraData));
+	}
+}
+
+class CNetServer::CRecvThread
+{
+public:
+	struct CPacket
+	{
+		NETADDR m_Addr;
+		int m_Bytes;
+		unsigned char m_aData[NET_MAX_PACKETSIZE];
+		bool m_Sixup;
+		SECURITY_TOKEN m_Token;
+		SECURITY_TOKEN m_ResponseToken;
+		CNetPacketConstruct m_Unpacked;
+	};
+
+	CRecvThread(CNetServer *pNetServer) :
+		m_pNetServer(pNetServer),
+		m_Socket(pNetServer->m_Socket),
+		m_Shutdown(false),
+		m_Waiting(false)
+	{
+		// replies are sent right away, the send queue belongs to the
+		// other thread
+		m_Socket.send_mmsgs = 0;
+		net_init_mmsgs(&m_MMSGS);
+		m_pThread = thread_init(Run, this, "network");
+	}
+
+	~CRecvThread()
+	{
+		m_Shutdown = true;
+		thread_wait(m_pThread);
+	}
+
+	// copies the oldest packet to the unpacker, returns false if there is none
+	bool Pop(CNetRecvUnpacker *pUnpacker, NETADDR *pAddr, int *pBytes, bool *pSixup, SECURITY_TOKEN *pToken, SECURITY_TOKEN *pResponseToken)
+	{
+		CPacket *pPacket = m_Queue.Front();
+		if(!pPacket)
+			return false;
+		*pAddr = pPacket->m_Addr;
+		*pBytes = pPacket->m_Bytes;
+		*pSixup = pPacket->m_Sixup;
+		*pToken = pPacket->m_Token;
+		*pResponseToken = pPacket->m_ResponseToken;
+		mem_copy(pUnpacker->m_aBuffer, pPacket->m_aData, pPacket->m_Bytes);
+		CNetPacketConstruct *pData = &pUnpacker->m_Data;
+		pData->m_Flags = pPacket->m_Unpacked.m_Flags;
+		pData->m_Ack = pPacket->m_Unpacked.m_Ack;
+		pData->m_NumChunks = pPacket->m_Unpacked.m_NumChunks;
+		pData->m_DataSize = pPacket->m_Unpacked.m_DataSize;
+		mem_copy(pData->m_aChunkData, pPacket->m_Unpacked.m_aChunkData, pData->m_DataSize);
+		mem_copy(pData->m_aExtraData, pPacket->m_Unpacked.m_aExtraData, sizeof(pData->m_aExtraData));
+		m_Queue.Pop();
+		return true;
+	}
+
+	bool Wait(int Microseconds)
+	{
+		std::unique_lock<std::mutex> Lock(m_WaitMutex);
+		m_Waiting = true;
+		bool Packets = m_WaitCond.wait_for(Lock, std::chrono::microseconds(Microseconds), [this]() { return !m_Queue.Empty(); });
+		m_Waiting = false;
+		return Packets;
+	}
+
+private:
+	CNetServer *m_pNetServer;
+	NETSOCKET m_Socket;
+	MMSGS m_MMSGS;
+	CSpscQueue<CPacket, 256> m_Queue;
+	std::atomic<bool> m_Shutdown;
+	void *m_pThread;
+
+	// wakes the thread in Wait after a push
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCond;
+	std::atomic<bool> m_Waiting;
+
+	// answers what doesn't need the connection state, returns true if the
+	// packet is done with
+	bool Process(CPacket *pPacket)
+	{
+		CNetServer *pNetServer = m_pNetServer;
+		const CNetPacketConstruct &Unpacked = pPacket->m_Unpacked;
+		if(Unpacked.m_Flags & NET_PACKETFLAG_CONNLESS)
+		{
+			if(pPacket->m_Sixup && pPacket->m_Token != pNetServer->GetToken(pPacket->m_Addr))
+				return true;
+			if(!pNetServer->m_pfnConnless)
+				return false;
+			CNetChunk Chunk;
+			ConnlessChunk(&Chunk, pPacket->m_Addr, Unpacked);
+			return pNetServer->m_pfnConnless(m_Socket, &Chunk, pPacket->m_ResponseToken, pNetServer->m_pUser);
+		}
+
+		// drop what Recv would drop too
+		if(Unpacked.m_Flags & NET_PACKETFLAG_CONTROL && Unpacked.m_DataSize == 0)
+			return true;
+
+		// 0.7 token request, the token only depends on the address. Clients
+		// that are connected already don't send them, so it's answered
+		// without looking for the slot
+		if(pPacket->m_Sixup && Unpacked.m_Flags & NET_PACKETFLAG_CONTROL && Unpacked.m_DataSize >= 512 && Unpacked.m_aChunkData[0] == 5)
+		{
+			SECURITY_TOKEN ResponseToken;
+			mem_copy(&ResponseToken, Unpacked.m_aChunkData + 1, 4);
+			::SendTokenSixup(m_Socket, pPacket->m_Addr, pNetServer->GetToken(pPacket->m_Addr), ResponseToken);
+			return true;
+		}
+		return false;
+	}
+
+	static void Run(void *pUser)
+	{
+		CRecvThread *pThis = (CRecvThread *)pUser;
+		CNetBan *pNetBan = pThis->m_pNetServer->NetBan();
+		unsigned char aBuffer[NET_MAX_PACKETSIZE];
+		while(!pThis->m_Shutdown)
+		{
+			CPacket *pPacket = pThis->m_Queue.Back();
+			if(!pPacket)
+			{
+				// the other thread is behind, leave the packets in the socket
+				thread_sleep(1000);
+				continue;
+			}
+
+			unsigned char *pData;
+			int Bytes = net_udp_recv(pThis->m_Socket, &pPacket->m_Addr, aBuffer, sizeof(aBuffer), &pThis->m_MMSGS, &pData);
+			if(Bytes <= 0)
+			{
+				// wake up now and then to check for the shutdown
+				net_socket_read_wait(pThis->m_Socket, 100000);
+				continue;
+			}
+
+			// banned addresses don't get their packets decompressed
+			char aBanMsg[128];
+			if(pNetBan && pNetBan->IsBanned(&pPacket->m_Addr, aBanMsg, sizeof(aBanMsg)))
+			{
+				CNetBase::SendControlMsg(pThis->m_Socket, &pPacket->m_Addr, 0, NET_CTRLMSG_CLOSE, aBanMsg, str_length(aBanMsg) + 1, NET_SECURITY_TOKEN_UNSUPPORTED);
+				continue;
+			}
+
+			pPacket->m_Sixup = false;
+			pPacket->m_ResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
+			if(CNetBase::UnpackPacket(pData, Bytes, &pPacket->m_Unpacked, pPacket->m_Sixup, &pPacket->m_Token, &pPacket->m_ResponseToken) != 0)
+				continue;
+			if(pThis->Process(pPacket))
+				continue;
+
+			// kept for unpacking it again if it turns out to be from a 0.7 connection
+			mem_copy(pPacket->m_aData, pData, Bytes);
+			pPacket->m_Bytes = Bytes;
+			pThis->m_Queue.Push();
+
+			if(pThis->m_Waiting)
+			{
+				std::lock_guard<std::mutex> Lock(pThis->m_WaitMutex);
+				pThis->m_WaitCond.notify_one();
+			}
+		}
+	}
+};
+
 bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags)
 {
 	// zero out the whole structure
@@ -56,6 +249,9 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	if(!m_Socket.type)
 		return false;
 
+	// packets of all connections are sent together once per server loop
+	net_udp_set_send_queue(&m_Socket, &m_SendMMSGS);
+
 	m_Address = BindAddr;
 	m_pNetBan = pNetBan;
 
@@ -102,6 +298,25 @@ int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_N
 	return 0;
 }
 
+void CNetServer::StartRecvThread()
+{
+	if(!m_pRecvThread)
+		m_pRecvThread = new CRecvThread(this);
+}
+
+void CNetServer::StopRecvThread()
+{
+	delete m_pRecvThread;
+	m_pRecvThread = 0;
+}
+
+bool CNetServer::WaitForPackets(int Microseconds)
+{
+	if(m_pRecvThread)
+		return m_pRecvThread->Wait(Microseconds);
+	return net_socket_read_wait(m_Socket, Microseconds);
+}
+
 int CNetServer::Close()
 {
 	// TODO: implement me
@@ -635,43 +850,49 @@ int CNetServer::Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
+		SECURITY_TOKEN Token;
+		bool Sixup = false;
+		*pResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
+
 		// TODO: empty the recvinfo
 		unsigned char *pData;
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
+		int Bytes;
+		if(m_pRecvThread)
+		{
+			// already unpacked
+			if(!m_pRecvThread->Pop(&m_RecvUnpacker, &Addr, &Bytes, &Sixup, &Token, pResponseToken))
+				break;
+			pData = m_RecvUnpacker.m_aBuffer;
+		}
+		else
+		{
+			Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
 
-		// no more packets for now
-		if(Bytes <= 0)
-			break;
+			// no more packets for now
+			if(Bytes <= 0)
+				break;
+		}
 
-		// check if we just should drop the packet
+		// check if we just should drop the packet, the receive thread did
+		// that already
 		char aBuf[128];
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+		if(!m_pRecvThread && NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
 		{
 			// banned, reply with a message
 			CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1, NET_SECURITY_TOKEN_UNSUPPORTED);
 			continue;
 		}
 
-		SECURITY_TOKEN Token;
-		bool Sixup = false;
-		*pResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
-		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token, pResponseToken) == 0)
+		if(m_pRecvThread || CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token, pResponseToken) == 0)
 		{
 			if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONNLESS)
 			{
 				if(Sixup && Token != GetToken(Addr))
 					continue;
 
-				pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-				pChunk->m_ClientID = -1;
-				pChunk->m_Address = Addr;
-				pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-				pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-				if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_EXTENDED)
-				{
-					pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
-					mem_copy(pChunk->m_aExtraData, m_RecvUnpacker.m_Data.m_aExtraData, sizeof(pChunk->m_aExtraData));
-				}
+				ConnlessChunk(pChunk, Addr, m_RecvUnpacker.m_Data);
+				if(!m_pRecvThread && m_pfnConnless && m_pfnConnless(m_Socket, pChunk, *pResponseToken, m_pUser))
+					continue;
 				return 1;
 			}
 			else
@@ -766,11 +987,7 @@ int CNetServer::Send(CNetChunk *pChunk)
 
 void CNetServer::SendTokenSixup(NETADDR &Addr, SECURITY_TOKEN Token)
 {
-	SECURITY_TOKEN MyToken = GetToken(Addr);
-	unsigned char aBuf[512] = {};
-	mem_copy(aBuf, &MyToken, 4);
-	int Size = (Token == NET_SECURITY_TOKEN_UNKNOWN) ? 512 : 4;
-	CNetBase::SendControlMsg(m_Socket, &Addr, 0, 5, aBuf, Size, Token, true);
+	::SendTokenSixup(m_Socket, Addr, GetToken(Addr), Token);
 }
 
 int CNetServer::SendConnlessSixup(CNetChunk *pChunk, SECURITY_TOKEN ResponseToken)
@@ -789,6 +1006,14 @@ int CNetServer::SendConnlessSixup(CNetChunk *pChunk, SECURITY_TOKEN ResponseToke
 	return 0;
 }
 
+void CNetServer::SendConnlessSixupRaw(NETSOCKET Socket, const NETADDR *pAddr, unsigned char *pData, int DataSize, SECURITY_TOKEN ResponseToken)
+{
+	SECURITY_TOKEN Token = GetToken(*pAddr);
+	mem_copy(pData + 1, &ResponseToken, 4);
+	mem_copy(pData + 5, &Token, 4);
+	net_udp_send(Socket, pAddr, pData, DataSize);
+}
+
 void CNetServer::SetMaxClientsPerIP(int Max)
 {
 	// clamp
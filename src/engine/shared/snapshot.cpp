@@ -4,9 +4,14 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <base/math.h>
 #include <game/generated/protocol.h>
 #include <game/generated/protocolglue.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // CSnapshot
 
 CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -89,59 +94,88 @@ void CSnapshot::DebugDump()
 
 // CSnapshotDelta
 
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
-
-enum
+CSnapshotDelta::CItemIndex::CItemIndex()
 {
-	HASHLIST_SIZE = 256,
-};
+	for(auto &Index : m_aIndices)
+		Index = -1;
+	m_NumUsedSlots = 0;
+}
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+bool CSnapshotDelta::CItemIndex::Build(const CSnapshot *pSnapshot)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	for(int i = 0; i < m_NumUsedSlots; i++)
+		m_aIndices[m_aUsedSlots[i]] = -1;
+	m_NumUsedSlots = 0;
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	// more can't be created by CSnapshotBuilder, only by broken demos
+	int NumItems = minimum(pSnapshot->NumItems(), (int)MAX_ITEMS);
+	bool Unique = true;
+	for(int i = 0; i < NumItems; i++)
 	{
 		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		unsigned Slot = CItemIndex::Slot(Key);
+		while(m_aIndices[Slot] != -1 && m_aKeys[Slot] != Key)
+			Slot = (Slot + 1) & MASK;
+		if(m_aIndices[Slot] != -1)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			// keep the first one
+			Unique = false;
+			continue;
 		}
+		m_aKeys[Slot] = Key;
+		m_aIndices[Slot] = i;
+		m_aUsedSlots[m_NumUsedSlots++] = Slot;
 	}
+	return Unique;
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotDelta::CItemIndex::Find(int Key) const
 {
-	int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
-	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	for(unsigned Slot = CItemIndex::Slot(Key);; Slot = (Slot + 1) & MASK)
 	{
-		if(pHashlist[HashID].m_aKeys[i] == Key)
-			return pHashlist[HashID].m_aIndex[i];
+		if(m_aIndices[Slot] == -1 || m_aKeys[Slot] == Key)
+			return m_aIndices[Slot];
 	}
-
-	return -1;
 }
 
 int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 {
+	// most items don't change, skip the equal start
+	int i = 0;
+#if defined(__SSE2__)
+	for(; i + 4 <= Size; i += 4)
+	{
+		__m128i Past = _mm_loadu_si128((const __m128i *)(pPast + i));
+		__m128i Current = _mm_loadu_si128((const __m128i *)(pCurrent + i));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(Past, Current)) != 0xffff)
+			break;
+	}
+#endif
+	while(i < Size && pPast[i] == pCurrent[i])
+		i++;
+	if(i == Size)
+		return 0;
+	mem_zero(pOut, i * sizeof(int));
+
 	int Needed = 0;
-	while(Size)
+#if defined(__SSE2__)
+	__m128i Needed4 = _mm_setzero_si128();
+	for(; i + 4 <= Size; i += 4)
 	{
-		*pOut = *pCurrent - *pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		__m128i Diff = _mm_sub_epi32(
+			_mm_loadu_si128((const __m128i *)(pCurrent + i)),
+			_mm_loadu_si128((const __m128i *)(pPast + i)));
+		_mm_storeu_si128((__m128i *)(pOut + i), Diff);
+		Needed4 = _mm_or_si128(Needed4, Diff);
+	}
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(1, 0, 3, 2)));
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(Needed4);
+#endif
+	for(; i < Size; i++)
+	{
+		pOut[i] = pCurrent[i] - pPast[i];
+		Needed |= pOut[i];
 	}
 
 	return Needed;
@@ -149,23 +183,42 @@ int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 
 void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
 {
-	while(Size)
+	int i = 0;
+#if defined(__SSE2__)
+	for(; i + 4 <= Size; i += 4)
 	{
-		*pOut = *pPast + *pDiff;
+		__m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff + i));
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast + i)), Diff));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(Diff, _mm_setzero_si128())) == 0xffff)
+		{
+			m_aSnapshotDataRate[m_SnapshotCurrent] += 4;
+			continue;
+		}
+		for(int j = i; j < i + 4; j++)
+		{
+			if(pDiff[j] == 0)
+				m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
+			else
+			{
+				unsigned char aBuf[16];
+				unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[j]);
+				m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char *)aBuf) * 8;
+			}
+		}
+	}
+#endif
+	for(; i < Size; i++)
+	{
+		pOut[i] = pPast[i] + pDiff[i];
 
-		if(*pDiff == 0)
+		if(pDiff[i] == 0)
 			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
 		else
 		{
 			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[i]);
 			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char *)aBuf) * 8;
 		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
 	}
 }
 
@@ -199,7 +252,6 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -214,32 +266,44 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	const int NumItems = pTo->NumItems();
+	int aPastIndices[1024];
 
-	// pack deleted stuff
-	for(i = 0; i < pFrom->NumItems(); i++)
+	// snapshots of following ticks mostly have the same items in the same order
+	bool SameOrder = pFrom->NumItems() == NumItems;
+	for(i = 0; SameOrder && i < NumItems; i++)
+		SameOrder = pFrom->GetItem(i)->Key() == pTo->GetItem(i)->Key();
+
+	bool Unique = m_ItemIndex.Build(pTo);
+	if(SameOrder)
 	{
-		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		// nothing deleted, repeated keys use the first past item like below
+		for(i = 0; i < NumItems; i++)
+			aPastIndices[i] = Unique ? i : m_ItemIndex.Find(pTo->GetItem(i)->Key());
+	}
+	else
+	{
+		// pack deleted stuff
+		for(i = 0; i < pFrom->NumItems(); i++)
 		{
-			// deleted
-			pDelta->m_NumDeletedItems++;
-			*pData = pFromItem->Key();
-			pData++;
+			pFromItem = pFrom->GetItem(i);
+			if(m_ItemIndex.Find(pFromItem->Key()) == -1)
+			{
+				// deleted
+				pDelta->m_NumDeletedItems++;
+				*pData = pFromItem->Key();
+				pData++;
+			}
 		}
-	}
 
-	GenerateHash(aHashlist, pFrom);
-	int aPastIndices[1024];
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
-	const int NumItems = pTo->NumItems();
-	for(i = 0; i < NumItems; i++)
-	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		// fetch previous indices
+		// we do this as a separate pass because it helps the cache
+		m_ItemIndex.Build(pFrom);
+		for(i = 0; i < NumItems; i++)
+		{
+			pCurItem = pTo->GetItem(i);
+			aPastIndices[i] = m_ItemIndex.Find(pCurItem->Key());
+		}
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -249,7 +313,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
 		PastIndex = aPastIndices[i];
 
-		bool IncludeSize = pCurItem->Type() >= MAX_NETOBJSIZES || !m_aItemSizes[pCurItem->Type()];
+		bool IncludeSize = pCurItem->Type() < 0 || pCurItem->Type() >= MAX_NETOBJSIZES || !m_aItemSizes[pCurItem->Type()];
 
 		if(PastIndex != -1)
 		{
@@ -331,6 +395,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 	int *pNewData;
 
 	Builder.Init();
+	m_ItemIndex.Build(pFrom);
 
 	// unpack deleted stuff
 	pDeleted = pData;
@@ -400,7 +465,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		if(!pNewData)
 			return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
+		FromIndex = m_ItemIndex.Find(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need pTo apply the diff
@@ -423,10 +488,117 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 // CSnapshotStorage
 
+CSnapshotStorage::CSnapshotStorage() :
+	m_pRing(0),
+	m_RingSize(0),
+	m_WantedRingSize(MIN_RING_SIZE),
+	m_NumAllocations(0)
+{
+	Init();
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	PurgeAll();
+	free(m_pRing);
+}
+
 void CSnapshotStorage::Init()
 {
 	m_pFirst = 0;
 	m_pLast = 0;
+	m_RingStart = 0;
+	m_RingEnd = 0;
+	m_NumRingHolders = 0;
+	m_UsedSize = 0;
+	mem_zero(m_apIndex, sizeof(m_apIndex));
+	m_NumUnindexed = 0;
+}
+
+CSnapshotStorage::CHolder *CSnapshotStorage::Alloc(int Size)
+{
+	// keep the following holders aligned
+	Size = (Size + alignof(CHolder) - 1) & ~(int)(alignof(CHolder) - 1);
+
+	if(m_NumRingHolders == 0)
+	{
+		if(m_WantedRingSize > m_RingSize)
+		{
+			// room for the snapshots kept while it ran empty
+			m_RingSize = maximum(m_WantedRingSize, (m_UsedSize + Size) * 2);
+			m_WantedRingSize = m_RingSize;
+			free(m_pRing);
+			m_pRing = (char *)malloc(m_RingSize);
+			m_NumAllocations++;
+		}
+		m_RingStart = 0;
+		m_RingEnd = 0;
+	}
+
+	int Offset = -1;
+	if(m_WantedRingSize > m_RingSize)
+	{
+		// let the ring run empty to grow it
+	}
+	else if(m_NumRingHolders == 0 || m_RingEnd > m_RingStart)
+	{
+		if(m_RingEnd + Size <= m_RingSize)
+			Offset = m_RingEnd;
+		else if(Size <= m_RingStart)
+			Offset = 0; // wrap around
+	}
+	else if(m_RingEnd + Size <= m_RingStart)
+	{
+		Offset = m_RingEnd;
+	}
+
+	CHolder *pHolder;
+	if(Offset >= 0)
+	{
+		pHolder = (CHolder *)(m_pRing + Offset);
+		pHolder->m_RingOffset = Offset;
+		m_RingEnd = Offset + Size;
+		m_NumRingHolders++;
+	}
+	else
+	{
+		// full, grow once the holders in it are gone
+		if(m_WantedRingSize <= m_RingSize)
+			m_WantedRingSize = maximum(m_RingSize * 2, (m_UsedSize + Size) * 2);
+		pHolder = (CHolder *)malloc(Size);
+		pHolder->m_RingOffset = -1;
+		m_NumAllocations++;
+	}
+	pHolder->m_AllocSize = Size;
+	m_UsedSize += Size;
+	return pHolder;
+}
+
+void CSnapshotStorage::Free(CHolder *pHolder)
+{
+	CHolder *&pIndexed = m_apIndex[pHolder->m_Tick & INDEX_MASK];
+	if(pIndexed == pHolder)
+		pIndexed = 0;
+	else
+		m_NumUnindexed--;
+	m_UsedSize -= pHolder->m_AllocSize;
+
+	if(pHolder->m_RingOffset < 0)
+	{
+		free(pHolder);
+		return;
+	}
+
+	// holders are freed oldest first, the ring starts at the next one
+	m_NumRingHolders--;
+	for(CHolder *pNext = pHolder->m_pNext; pNext; pNext = pNext->m_pNext)
+	{
+		if(pNext->m_RingOffset >= 0)
+		{
+			m_RingStart = pNext->m_RingOffset;
+			break;
+		}
+	}
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -437,7 +609,7 @@ void CSnapshotStorage::PurgeAll()
 	while(pHolder)
 	{
 		pNext = pHolder->m_pNext;
-		free(pHolder);
+		Free(pHolder);
 		pHolder = pNext;
 	}
 
@@ -456,7 +628,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		free(pHolder);
+		Free(pHolder);
 
 		// did we come to the end of the list?
 		if(!pNext)
@@ -481,7 +653,7 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	if(CreateAlt)
 		TotalSize += DataSize;
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+	CHolder *pHolder = Alloc(TotalSize);
 
 	// set data
 	pHolder->m_Tick = Tick;
@@ -506,29 +678,99 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	else
 		m_pFirst = pHolder;
 	m_pLast = pHolder;
+
+	CHolder *&pIndexed = m_apIndex[Tick & INDEX_MASK];
+	if(!pIndexed)
+		pIndexed = pHolder;
+	else
+		m_NumUnindexed++;
 }
 
 int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
+	CHolder *pHolder = m_apIndex[Tick & INDEX_MASK];
+	if(!pHolder || pHolder->m_Tick != Tick)
 	{
-		if(pHolder->m_Tick == Tick)
+		pHolder = 0;
+		if(m_NumUnindexed > 0)
 		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
+			for(CHolder *pCur = m_pFirst; pCur; pCur = pCur->m_pNext)
+			{
+				if(pCur->m_Tick == Tick)
+				{
+					pHolder = pCur;
+					break;
+				}
+			}
 		}
+	}
+	if(!pHolder)
+		return -1;
+
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
+}
+
+// CSnapshotDeltaCache
+
+CSnapshotDeltaCache::CSnapshotDeltaCache() :
+	m_NumEntries(0),
+	m_Hits(0),
+	m_Misses(0)
+{
+}
+
+void CSnapshotDeltaCache::Clear()
+{
+	m_NumEntries = 0;
+}
 
-		pHolder = pHolder->m_pNext;
+static bool SameSnapshot(CSnapshot *pA, CSnapshot *pB)
+{
+	return pA == pB || (pA->TotalSize() == pB->TotalSize() && mem_comp(pA, pB, pA->TotalSize()) == 0);
+}
+
+CSnapshotDeltaCache::CEntry *CSnapshotDeltaCache::Find(CSnapshot *pFrom, unsigned FromCrc, CSnapshot *pTo, unsigned ToCrc, bool Sixup)
+{
+	for(int i = 0; i < m_NumEntries; i++)
+	{
+		CEntry *pEntry = &m_vEntries[i];
+		// the crc is only a sum, compare the snapshots too
+		if(pEntry->m_ToCrc == ToCrc && pEntry->m_FromCrc == FromCrc && pEntry->m_Sixup == Sixup &&
+			SameSnapshot(pEntry->m_pTo, pTo) && SameSnapshot(pEntry->m_pFrom, pFrom))
+		{
+			m_Hits++;
+			return pEntry;
+		}
 	}
+	m_Misses++;
+	return nullptr;
+}
 
-	return -1;
+CSnapshotDeltaCache::CEntry *CSnapshotDeltaCache::Add(CSnapshot *pFrom, unsigned FromCrc, CSnapshot *pTo, unsigned ToCrc, bool Sixup, int Owner)
+{
+	if(m_NumEntries == (int)m_vEntries.size())
+		m_vEntries.emplace_back();
+	CEntry *pEntry = &m_vEntries[m_NumEntries++];
+	pEntry->m_pFrom = pFrom;
+	pEntry->m_pTo = pTo;
+	pEntry->m_FromCrc = FromCrc;
+	pEntry->m_ToCrc = ToCrc;
+	pEntry->m_Sixup = Sixup;
+	pEntry->m_Owner = Owner;
+	pEntry->m_CompSize = 0;
+	return pEntry;
+}
+
+void CSnapshotDeltaCache::SetCompData(CEntry *pEntry, const char *pCompData, int CompSize)
+{
+	pEntry->m_vCompData.assign(pCompData, pCompData + CompSize);
+	pEntry->m_CompSize = CompSize;
 }
 
 // CSnapshotBuilder
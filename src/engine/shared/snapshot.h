@@ -5,6 +5,8 @@
 
 #include <base/system.h>
 
+#include <vector>
+
 // CSnapshot
 
 class CSnapshotItem
@@ -47,6 +49,8 @@ public:
 	int GetItemIndex(int Key) const;
 	int GetItemType(int Index) const;
 
+	int TotalSize() const { return (int)sizeof(CSnapshot) + m_NumItems * (int)sizeof(int) + m_DataSize; }
+
 	unsigned Crc();
 	void DebugDump();
 	static void RemoveExtraInfo(unsigned char *pData);
@@ -71,15 +75,44 @@ private:
 	{
 		MAX_NETOBJSIZES = 64
 	};
+
+	// first index of each item key in a snapshot, open addressing
+	class CItemIndex
+	{
+		enum
+		{
+			MAX_ITEMS = 2048,
+			SIZE = MAX_ITEMS * 2,
+			MASK = SIZE - 1,
+		};
+
+		int m_aKeys[SIZE];
+		int m_aIndices[SIZE]; // -1 if empty
+		// for clearing only the used slots
+		int m_aUsedSlots[MAX_ITEMS];
+		int m_NumUsedSlots;
+
+		static unsigned Slot(int Key) { return ((unsigned)Key * 0x9e3779b1u) >> 20; }
+
+	public:
+		CItemIndex();
+		// returns false if a key appears more than once
+		bool Build(const CSnapshot *pSnapshot);
+		int Find(int Key) const;
+	};
+
 	short m_aItemSizes[MAX_NETOBJSIZES];
 	int m_aSnapshotDataRate[0xffff];
 	int m_aSnapshotDataUpdates[0xffff];
 	int m_SnapshotCurrent;
 	CData m_Empty;
+	// reused to not clear it for every delta
+	CItemIndex m_ItemIndex;
 
 	void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size);
 
 public:
+	// returns 0 and leaves pOut untouched if the items are equal
 	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
@@ -93,6 +126,8 @@ public:
 
 // CSnapshotStorage
 
+// snapshots in the order they were added, holders are taken from a ring
+// buffer because they are always freed oldest first
 class CSnapshotStorage
 {
 public:
@@ -108,18 +143,93 @@ public:
 		int m_SnapSize;
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// offset into the ring buffer, -1 if allocated separately
+		int m_RingOffset;
+		int m_AllocSize;
+	};
+
+	enum
+	{
+		INDEX_SIZE = 256,
+		INDEX_MASK = INDEX_SIZE - 1,
+		MIN_RING_SIZE = 64 * 1024,
 	};
 
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
-	CSnapshotStorage() { Init(); };
-	~CSnapshotStorage() { PurgeAll(); };
+	CSnapshotStorage();
+	~CSnapshotStorage();
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, int DataSize, void *pData, int CreateAlt);
 	int Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+
+	// number of mallocs so far, for the ring buffer or holders not fitting it
+	int NumAllocations() const { return m_NumAllocations; }
+
+private:
+	CHolder *Alloc(int Size);
+	void Free(CHolder *pHolder);
+
+	char *m_pRing;
+	int m_RingSize;
+	// grown to when no holder uses the ring anymore
+	int m_WantedRingSize;
+	int m_RingStart;
+	int m_RingEnd;
+	int m_NumRingHolders;
+	// bytes of all holders, in the ring or not
+	int m_UsedSize;
+	int m_NumAllocations;
+
+	// holders by tick, holders with a tick colliding with an older one
+	// are only found in the list
+	CHolder *m_apIndex[INDEX_SIZE];
+	int m_NumUnindexed;
+};
+
+// compressed deltas created during one tick, by the snapshots they were
+// created between. Clients that get the same snapshot and acked the same
+// one before can be sent the same delta
+class CSnapshotDeltaCache
+{
+public:
+	class CEntry
+	{
+	public:
+		CSnapshot *m_pFrom;
+		CSnapshot *m_pTo;
+		unsigned m_FromCrc;
+		unsigned m_ToCrc;
+		bool m_Sixup;
+
+		// who created the delta, e.g. a client id
+		int m_Owner;
+		int m_CompSize;
+		std::vector<char> m_vCompData;
+	};
+
+	CSnapshotDeltaCache();
+	void Clear();
+	// returns nullptr if no delta between these snapshots was added
+	CEntry *Find(CSnapshot *pFrom, unsigned FromCrc, CSnapshot *pTo, unsigned ToCrc, bool Sixup);
+	// the snapshots have to stay valid until the next Clear
+	CEntry *Add(CSnapshot *pFrom, unsigned FromCrc, CSnapshot *pTo, unsigned ToCrc, bool Sixup, int Owner);
+	void SetCompData(CEntry *pEntry, const char *pCompData, int CompSize);
+
+	int Num() const { return m_NumEntries; }
+	int64_t Hits() const { return m_Hits; }
+	int64_t Misses() const { return m_Misses; }
+
+private:
+	// entries are kept over Clear to reuse their buffers
+	std::vector<CEntry> m_vEntries;
+	int m_NumEntries;
+	int64_t m_Hits;
+	int64_t m_Misses;
 };
 
 class CSnapshotBuilder
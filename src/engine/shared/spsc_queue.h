@@ -0,0 +1,58 @@
+#ifndef ENGINE_SHARED_SPSC_QUEUE_H
+#define ENGINE_SHARED_SPSC_QUEUE_H
+
+#include <atomic>
+
+// lock-free queue for one producer and one consumer thread. Items are
+// written and read in place, so big ones don't have to be copied
+template<typename T, unsigned SIZE>
+class CSpscQueue
+{
+	static_assert(SIZE && (SIZE & (SIZE - 1)) == 0, "size must be a power of two");
+
+	T m_aItems[SIZE];
+	// padded to keep them on separate cache lines
+	char m_aPad0[64];
+	std::atomic<unsigned> m_Head;
+	char m_aPad1[64];
+	std::atomic<unsigned> m_Tail;
+	char m_aPad2[64];
+
+public:
+	CSpscQueue() :
+		m_Head(0), m_Tail(0)
+	{
+	}
+
+	// producer: returns the item to fill in, nullptr if the queue is full
+	T *Back()
+	{
+		unsigned Tail = m_Tail.load(std::memory_order_relaxed);
+		if(Tail - m_Head.load(std::memory_order_acquire) == SIZE)
+			return nullptr;
+		return &m_aItems[Tail & (SIZE - 1)];
+	}
+	// producer: makes the item returned by Back visible to the consumer
+	void Push()
+	{
+		m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1);
+	}
+
+	// consumer: returns the oldest item, nullptr if the queue is empty
+	T *Front()
+	{
+		unsigned Head = m_Head.load(std::memory_order_relaxed);
+		if(Head == m_Tail.load())
+			return nullptr;
+		return &m_aItems[Head & (SIZE - 1)];
+	}
+	// consumer: frees the item returned by Front
+	void Pop()
+	{
+		m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool Empty() const { return m_Head.load() == m_Tail.load(); }
+};
+
+#endif
@@ -0,0 +1,650 @@
+#include "teehistorian_reader.h"
+
+#include <engine/shared/block_writer.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/teehistorian_ex.h>
+#include <engine/storage.h>
+#include <game/generated/protocol7.h>
+
+#include <algorithm>
+
+#include <zlib.h>
+
+enum
+{
+	READ_SIZE = 64 * 1024,
+	// CVariableInt::Unpack may look past the end of the data
+	BUFFER_PADDING = 8,
+	MAX_HEADER_SIZE = 1024 * 1024,
+	MAX_FRAME_SIZE = 64 * 1024 * 1024,
+	// returned by ParseChunk if the chunk isn't in the buffer completely
+	CHUNK_INCOMPLETE = -2,
+};
+
+static unsigned ReadLittleEndian(const unsigned char *pData)
+{
+	return pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((unsigned)pData[3] << 24);
+}
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	m_File = 0;
+	m_Compressed = false;
+	m_Broken = false;
+	m_Finished = false;
+	m_BufferPos = 0;
+	m_BufferEnd = 0;
+	m_BufferOffset = 0;
+	m_FileOffset = 0;
+	mem_zero(&m_State, sizeof(m_State));
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	Close();
+}
+
+bool CTeeHistorianReader::Open(IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	Close();
+	m_File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(!m_File)
+	{
+		dbg_msg("teehistorian_reader", "could not open '%s'", pFilename);
+		return false;
+	}
+
+	unsigned char aMarker[sizeof(CBlockWriter::ms_aFrameMarker)];
+	m_Compressed = io_read(m_File, aMarker, sizeof(aMarker)) == sizeof(aMarker) &&
+		       mem_comp(aMarker, CBlockWriter::ms_aFrameMarker, sizeof(aMarker)) == 0;
+	io_seek(m_File, 0, IOSEEK_START);
+
+	m_Broken = false;
+	m_Finished = false;
+	m_BufferPos = 0;
+	m_BufferEnd = 0;
+	m_BufferOffset = 0;
+	m_FileOffset = 0;
+	m_vFrames.clear();
+	mem_zero(&m_State, sizeof(m_State));
+	m_State.m_LastPlayerID = MAX_CLIENTS;
+
+	if(!ReadHeader())
+	{
+		dbg_msg("teehistorian_reader", "'%s' is not a teehistorian file", pFilename);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CTeeHistorianReader::Close()
+{
+	if(m_File)
+		io_close(m_File);
+	m_File = 0;
+	m_Header.clear();
+}
+
+bool CTeeHistorianReader::Fill()
+{
+	// drop the consumed part, keeping the frame of the current position
+	if(m_BufferPos > 0)
+	{
+		mem_move(m_vBuffer.data(), m_vBuffer.data() + m_BufferPos, m_BufferEnd - m_BufferPos);
+		m_BufferOffset += m_BufferPos;
+		m_BufferEnd -= m_BufferPos;
+		m_BufferPos = 0;
+		int NumOld = 0;
+		while(NumOld + 1 < (int)m_vFrames.size() && m_vFrames[NumOld + 1].m_Offset <= m_BufferOffset)
+			NumOld++;
+		m_vFrames.erase(m_vFrames.begin(), m_vFrames.begin() + NumOld);
+	}
+
+	int Size;
+	if(!m_Compressed)
+	{
+		if((int)m_vBuffer.size() < m_BufferEnd + READ_SIZE + BUFFER_PADDING)
+			m_vBuffer.resize(m_BufferEnd + READ_SIZE + BUFFER_PADDING);
+		Size = io_read(m_File, m_vBuffer.data() + m_BufferEnd, READ_SIZE);
+		if(Size <= 0)
+			return false;
+	}
+	else
+	{
+		// a frame that is cut off is still being written
+		unsigned char aHeader[CBlockWriter::FRAME_HEADER_SIZE];
+		if(io_read(m_File, aHeader, sizeof(aHeader)) != sizeof(aHeader))
+			return false;
+		unsigned CompressedSize = ReadLittleEndian(aHeader + 4);
+		unsigned DataSize = ReadLittleEndian(aHeader + 8);
+		if(mem_comp(aHeader, CBlockWriter::ms_aFrameMarker, sizeof(CBlockWriter::ms_aFrameMarker)) != 0 ||
+			CompressedSize > MAX_FRAME_SIZE || DataSize > MAX_FRAME_SIZE)
+		{
+			dbg_msg("teehistorian_reader", "invalid frame at offset %lld", (long long)m_FileOffset);
+			m_Broken = true;
+			return false;
+		}
+		m_vCompressed.resize(CompressedSize);
+		if(io_read(m_File, m_vCompressed.data(), CompressedSize) != CompressedSize)
+			return false;
+
+		if(m_vBuffer.size() < m_BufferEnd + DataSize + BUFFER_PADDING)
+			m_vBuffer.resize(m_BufferEnd + DataSize + BUFFER_PADDING);
+		uLongf Uncompressed = DataSize;
+		int Result = uncompress(m_vBuffer.data() + m_BufferEnd, &Uncompressed, m_vCompressed.data(), CompressedSize);
+		if(Result != Z_OK || Uncompressed != DataSize)
+		{
+			dbg_msg("teehistorian_reader", "failed to decompress frame at offset %lld, err=%d", (long long)m_FileOffset, Result);
+			m_Broken = true;
+			return false;
+		}
+
+		CFrame Frame;
+		Frame.m_Offset = m_BufferOffset + m_BufferEnd;
+		Frame.m_FileOffset = m_FileOffset;
+		m_vFrames.push_back(Frame);
+		m_FileOffset += CBlockWriter::FRAME_HEADER_SIZE + CompressedSize;
+		Size = DataSize;
+	}
+	m_BufferEnd += Size;
+	mem_zero(m_vBuffer.data() + m_BufferEnd, BUFFER_PADDING);
+	return true;
+}
+
+bool CTeeHistorianReader::ReadHeader()
+{
+	static const CUuid s_Uuid = CalculateUuid(TEEHISTORIAN_NAME);
+
+	int End = sizeof(CUuid);
+	while(true)
+	{
+		for(; End < m_BufferEnd; End++)
+		{
+			if(m_vBuffer[End] == 0)
+				break;
+		}
+		if(End < m_BufferEnd)
+			break;
+		if(m_BufferEnd > MAX_HEADER_SIZE || !Fill())
+			return false;
+	}
+
+	if(mem_comp(m_vBuffer.data(), &s_Uuid, sizeof(s_Uuid)) != 0)
+		return false;
+	m_Header.assign((const char *)m_vBuffer.data() + sizeof(CUuid), End - sizeof(CUuid));
+	m_BufferPos = End + 1;
+	return true;
+}
+
+CTeeHistorianReader::CPosition CTeeHistorianReader::Position() const
+{
+	CPosition Position;
+	Position.m_Offset = m_BufferOffset + m_BufferPos;
+	Position.m_FrameOffset = Position.m_Offset;
+	Position.m_FrameFileOffset = Position.m_Offset;
+	if(m_Compressed)
+	{
+		// the next frame isn't read yet if the buffer is used up
+		Position.m_FrameOffset = m_BufferOffset + m_BufferEnd;
+		Position.m_FrameFileOffset = m_FileOffset;
+		for(int i = m_vFrames.size() - 1; i >= 0 && Position.m_Offset < m_BufferOffset + m_BufferEnd; i--)
+		{
+			if(m_vFrames[i].m_Offset <= Position.m_Offset)
+			{
+				Position.m_FrameOffset = m_vFrames[i].m_Offset;
+				Position.m_FrameFileOffset = m_vFrames[i].m_FileOffset;
+				break;
+			}
+		}
+	}
+	return Position;
+}
+
+bool CTeeHistorianReader::Seek(const CPosition &Position, const CState &State)
+{
+	if(io_seek(m_File, Position.m_FrameFileOffset, IOSEEK_START) != 0)
+		return false;
+	m_Broken = false;
+	m_Finished = false;
+	m_BufferPos = 0;
+	m_BufferEnd = 0;
+	m_BufferOffset = Position.m_FrameOffset;
+	m_FileOffset = Position.m_FrameFileOffset;
+	m_vFrames.clear();
+	m_State = State;
+
+	int Skip = Position.m_Offset - Position.m_FrameOffset;
+	while(m_BufferEnd < Skip)
+	{
+		if(!Fill())
+			return false;
+	}
+	m_BufferPos = Skip;
+	return true;
+}
+
+void CTeeHistorianReader::StartTick(int Tick, IListener *pListener)
+{
+	m_State.m_Tick = Tick;
+	pListener->OnTick(Tick);
+}
+
+static bool IsClientID(int ClientID)
+{
+	return ClientID >= 0 && ClientID < MAX_CLIENTS;
+}
+
+int CTeeHistorianReader::ParseChunk(IListener *pListener, int EndTick)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(m_vBuffer.data() + m_BufferPos, m_BufferEnd - m_BufferPos);
+
+	int Type = Unpacker.GetInt();
+	int ClientID = -1;
+	// position diffs start with the client id instead of a type
+	if(Type >= 0)
+	{
+		ClientID = Type;
+		Type = -TEEHISTORIAN_NONE;
+	}
+	Type = -Type;
+
+	// every field is read before anything is applied, a chunk can end
+	// after the buffer
+	int aValues[sizeof(CNetObj_PlayerInput) / sizeof(int)];
+	const char *pString = 0;
+	const unsigned char *pData = 0;
+	int DataSize = 0;
+	CUuid Uuid;
+	int FlagMask = 0;
+	m_vArgs.clear();
+	switch(Type)
+	{
+	case TEEHISTORIAN_NONE:
+		aValues[0] = Unpacker.GetInt();
+		aValues[1] = Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_FINISH:
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+		aValues[0] = Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_PLAYER_NEW:
+		ClientID = Unpacker.GetInt();
+		aValues[0] = Unpacker.GetInt();
+		aValues[1] = Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_PLAYER_OLD:
+	case TEEHISTORIAN_JOIN:
+		ClientID = Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+		ClientID = Unpacker.GetInt();
+		for(int &Value : aValues)
+			Value = Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_MESSAGE:
+		ClientID = Unpacker.GetInt();
+		DataSize = Unpacker.GetInt();
+		if(!Unpacker.Error() && DataSize < 0)
+			return CHUNK_ERROR;
+		pData = Unpacker.GetRaw(DataSize);
+		break;
+	case TEEHISTORIAN_DROP:
+		ClientID = Unpacker.GetInt();
+		pString = Unpacker.GetString(0);
+		break;
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+	{
+		ClientID = Unpacker.GetInt();
+		FlagMask = Unpacker.GetInt();
+		pString = Unpacker.GetString(0);
+		int NumArgs = Unpacker.GetInt();
+		if(!Unpacker.Error() && NumArgs < 0)
+			return CHUNK_ERROR;
+		for(int i = 0; i < NumArgs && !Unpacker.Error(); i++)
+			m_vArgs.push_back(Unpacker.GetString(0));
+		break;
+	}
+	case TEEHISTORIAN_EX:
+		pData = Unpacker.GetRaw(sizeof(Uuid));
+		if(pData)
+			mem_copy(&Uuid, pData, sizeof(Uuid));
+		DataSize = Unpacker.GetInt();
+		if(!Unpacker.Error() && DataSize < 0)
+			return CHUNK_ERROR;
+		pData = Unpacker.GetRaw(DataSize);
+		break;
+	default:
+		dbg_msg("teehistorian_reader", "unknown chunk type %d at offset %lld", -Type, (long long)(m_BufferOffset + m_BufferPos));
+		return CHUNK_ERROR;
+	}
+	if(Unpacker.Error())
+		return CHUNK_INCOMPLETE;
+
+	bool PlayerData = Type == TEEHISTORIAN_NONE || Type == TEEHISTORIAN_PLAYER_NEW || Type == TEEHISTORIAN_PLAYER_OLD;
+	bool HasClientID = Type != TEEHISTORIAN_FINISH && Type != TEEHISTORIAN_TICK_SKIP && Type != TEEHISTORIAN_EX;
+	// the server console records commands with -1
+	if(HasClientID && !IsClientID(ClientID) && !(Type == TEEHISTORIAN_CONSOLE_COMMAND && ClientID == -1))
+	{
+		dbg_msg("teehistorian_reader", "invalid client id %d at offset %lld", ClientID, (long long)(m_BufferOffset + m_BufferPos));
+		return CHUNK_ERROR;
+	}
+
+	int Tick = m_State.m_Tick;
+	if(Type == TEEHISTORIAN_TICK_SKIP)
+	{
+		if(aValues[0] < 0)
+			return CHUNK_ERROR;
+		Tick += aValues[0] + 1;
+	}
+	else if(PlayerData && ClientID <= m_State.m_LastPlayerID)
+		Tick++;
+	if(Tick != m_State.m_Tick && EndTick >= 0 && Tick > EndTick)
+		return CHUNK_END;
+
+	m_BufferPos += Unpacker.CompleteSize() - Unpacker.RemainingSize();
+	if(Tick != m_State.m_Tick)
+		StartTick(Tick, pListener);
+	if(Type == TEEHISTORIAN_TICK_SKIP)
+		m_State.m_LastPlayerID = -1;
+	else if(PlayerData)
+		m_State.m_LastPlayerID = ClientID;
+
+	CPlayerState *pPlayer = ClientID >= 0 ? &m_State.m_aPlayers[ClientID] : 0;
+	switch(Type)
+	{
+	case TEEHISTORIAN_NONE:
+		pPlayer->m_X += aValues[0];
+		pPlayer->m_Y += aValues[1];
+		pListener->OnPlayer(ClientID, pPlayer->m_X, pPlayer->m_Y);
+		break;
+	case TEEHISTORIAN_FINISH:
+		m_Finished = true;
+		return CHUNK_END;
+	case TEEHISTORIAN_PLAYER_NEW:
+		pPlayer->m_Alive = true;
+		pPlayer->m_X = aValues[0];
+		pPlayer->m_Y = aValues[1];
+		pListener->OnPlayer(ClientID, pPlayer->m_X, pPlayer->m_Y);
+		break;
+	case TEEHISTORIAN_PLAYER_OLD:
+		pPlayer->m_Alive = false;
+		pListener->OnPlayerOld(ClientID);
+		break;
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+	{
+		int *pInput = (int *)&pPlayer->m_Input;
+		for(unsigned i = 0; i < sizeof(aValues) / sizeof(int); i++)
+			pInput[i] = Type == TEEHISTORIAN_INPUT_DIFF ? pInput[i] + aValues[i] : aValues[i];
+		pPlayer->m_InputExists = true;
+		pListener->OnInput(ClientID, &pPlayer->m_Input);
+		break;
+	}
+	case TEEHISTORIAN_MESSAGE:
+		pListener->OnMessage(ClientID, pData, DataSize);
+		break;
+	case TEEHISTORIAN_JOIN:
+		pListener->OnJoin(ClientID);
+		break;
+	case TEEHISTORIAN_DROP:
+		pListener->OnDrop(ClientID, pString);
+		break;
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+		pListener->OnConsoleCommand(ClientID, FlagMask, pString, m_vArgs.size(), m_vArgs.data());
+		break;
+	case TEEHISTORIAN_EX:
+		pListener->OnEx(Uuid, pData, DataSize);
+		break;
+	}
+	return CHUNK_READ;
+}
+
+int CTeeHistorianReader::ReadChunk(IListener *pListener, int EndTick)
+{
+	if(!m_File || m_Broken)
+		return CHUNK_ERROR;
+	if(m_Finished)
+		return CHUNK_END;
+
+	while(true)
+	{
+		if(m_BufferPos < m_BufferEnd)
+		{
+			int Result = ParseChunk(pListener, EndTick);
+			if(Result != CHUNK_INCOMPLETE)
+			{
+				if(Result == CHUNK_ERROR)
+					m_Broken = true;
+				return Result;
+			}
+		}
+		// the rest of a running game's file isn't written yet
+		if(!Fill())
+			return m_Broken ? CHUNK_ERROR : CHUNK_END;
+	}
+}
+
+bool CTeeHistorianReader::Read(IListener *pListener, int EndTick)
+{
+	int Result;
+	do
+	{
+		Result = ReadChunk(pListener, EndTick);
+	} while(Result == CHUNK_READ);
+	return Result != CHUNK_ERROR;
+}
+
+static const unsigned char s_aIndexMarker[8] = {'T', 'H', 'I', 'N', 'D', 'E', 'X', 0};
+static const int s_IndexVersion = 1;
+static const CUuid UUID_TEEHISTORIAN_JOINVER7 = CalculateUuid("teehistorian-joinver7@ddnet.tw");
+
+struct CIndexFileHeader
+{
+	unsigned char m_aMarker[sizeof(s_aIndexMarker)];
+	int m_Version;
+	int m_LastTick;
+	int64_t m_FileSize;
+	int m_Finished;
+	int m_NumCheckpoints;
+	int m_NumPlayers;
+	int m_Padding;
+};
+
+// collects the join and drop ticks and the names of the players
+class CIndexBuilder : public CTeeHistorianReader::IListener
+{
+	CTeeHistorianIndex *m_pIndex;
+	const CTeeHistorianReader *m_pReader;
+	// index into m_vPlayers of the connected players, -1 if none
+	int m_aRange[MAX_CLIENTS];
+	bool m_aProtocol7[MAX_CLIENTS];
+
+public:
+	CIndexBuilder(CTeeHistorianIndex *pIndex, const CTeeHistorianReader *pReader) :
+		m_pIndex(pIndex), m_pReader(pReader)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aRange[i] = -1;
+			m_aProtocol7[i] = false;
+		}
+	}
+
+	void OnJoin(int ClientID) override
+	{
+		CTeeHistorianIndex::CPlayerRange Range;
+		Range.m_ClientID = ClientID;
+		Range.m_JoinTick = m_pReader->State()->m_Tick;
+		Range.m_DropTick = -1;
+		Range.m_aName[0] = 0;
+		m_aRange[ClientID] = m_pIndex->m_vPlayers.size();
+		m_pIndex->m_vPlayers.push_back(Range);
+	}
+
+	void OnDrop(int ClientID, const char *pReason) override
+	{
+		if(m_aRange[ClientID] >= 0)
+			m_pIndex->m_vPlayers[m_aRange[ClientID]].m_DropTick = m_pReader->State()->m_Tick;
+		m_aRange[ClientID] = -1;
+		m_aProtocol7[ClientID] = false;
+	}
+
+	void OnEx(CUuid Uuid, const void *pData, int DataSize) override
+	{
+		if(Uuid != UUID_TEEHISTORIAN_JOINVER7)
+			return;
+		CUnpacker Unpacker;
+		Unpacker.Reset(pData, DataSize);
+		int ClientID = Unpacker.GetInt();
+		if(!Unpacker.Error() && ClientID >= 0 && ClientID < MAX_CLIENTS)
+			m_aProtocol7[ClientID] = true;
+	}
+
+	void OnMessage(int ClientID, const void *pMsg, int MsgSize) override
+	{
+		int Range = m_aRange[ClientID];
+		if(Range < 0 || m_pIndex->m_vPlayers[Range].m_aName[0])
+			return;
+
+		// the sanitizing unpacker changes the data
+		unsigned char aMsg[1024];
+		if(MsgSize > (int)sizeof(aMsg))
+			return;
+		mem_copy(aMsg, pMsg, MsgSize);
+		CUnpacker Unpacker;
+		Unpacker.Reset(aMsg, MsgSize);
+		int MsgID = Unpacker.GetInt();
+		if(Unpacker.Error() || MsgID & 1)
+			return;
+		MsgID >>= 1;
+		bool Info = m_aProtocol7[ClientID] ? MsgID == protocol7::NETMSGTYPE_CL_STARTINFO : MsgID == NETMSGTYPE_CL_STARTINFO || MsgID == NETMSGTYPE_CL_CHANGEINFO;
+		if(!Info)
+			return;
+		const char *pName = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		if(!Unpacker.Error())
+			str_copy(m_pIndex->m_vPlayers[Range].m_aName, pName, sizeof(m_pIndex->m_vPlayers[Range].m_aName));
+	}
+};
+
+bool CTeeHistorianIndex::Build(CTeeHistorianReader *pReader, int64_t FileSize, int CheckpointInterval)
+{
+	m_FileSize = FileSize;
+	m_vCheckpoints.clear();
+	m_vPlayers.clear();
+
+	CIndexBuilder Builder(this, pReader);
+	int NextCheckpoint = CheckpointInterval;
+	int Result;
+	do
+	{
+		int Tick = pReader->State()->m_Tick;
+		if(Tick >= NextCheckpoint)
+		{
+			CCheckpoint Checkpoint;
+			Checkpoint.m_Position = pReader->Position();
+			Checkpoint.m_State = *pReader->State();
+			m_vCheckpoints.push_back(Checkpoint);
+			NextCheckpoint = Tick - Tick % CheckpointInterval + CheckpointInterval;
+		}
+		Result = pReader->ReadChunk(&Builder);
+	} while(Result == CTeeHistorianReader::CHUNK_READ);
+
+	m_LastTick = pReader->State()->m_Tick;
+	m_Finished = pReader->Finished();
+	return Result != CTeeHistorianReader::CHUNK_ERROR;
+}
+
+bool CTeeHistorianIndex::Load(IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(!File)
+		return false;
+
+	// io_length seeks back to the start
+	int64_t Length = io_length(File);
+	CIndexFileHeader Header;
+	bool Valid = io_read(File, &Header, sizeof(Header)) == sizeof(Header) &&
+		     mem_comp(Header.m_aMarker, s_aIndexMarker, sizeof(s_aIndexMarker)) == 0 &&
+		     Header.m_Version == s_IndexVersion &&
+		     Header.m_NumCheckpoints >= 0 && Header.m_NumPlayers >= 0 &&
+		     Length == (int64_t)(sizeof(Header) + Header.m_NumCheckpoints * sizeof(CCheckpoint) + Header.m_NumPlayers * sizeof(CPlayerRange));
+	if(Valid)
+	{
+		m_FileSize = Header.m_FileSize;
+		m_LastTick = Header.m_LastTick;
+		m_Finished = Header.m_Finished;
+		m_vCheckpoints.resize(Header.m_NumCheckpoints);
+		m_vPlayers.resize(Header.m_NumPlayers);
+		io_read(File, m_vCheckpoints.data(), m_vCheckpoints.size() * sizeof(CCheckpoint));
+		io_read(File, m_vPlayers.data(), m_vPlayers.size() * sizeof(CPlayerRange));
+		for(auto &Player : m_vPlayers)
+			Player.m_aName[sizeof(Player.m_aName) - 1] = 0;
+	}
+	io_close(File);
+	return Valid;
+}
+
+bool CTeeHistorianIndex::Save(IStorage *pStorage, const char *pFilename, int StorageType) const
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, StorageType);
+	if(!File)
+		return false;
+
+	CIndexFileHeader Header;
+	mem_zero(&Header, sizeof(Header));
+	mem_copy(Header.m_aMarker, s_aIndexMarker, sizeof(s_aIndexMarker));
+	Header.m_Version = s_IndexVersion;
+	Header.m_LastTick = m_LastTick;
+	Header.m_FileSize = m_FileSize;
+	Header.m_Finished = m_Finished;
+	Header.m_NumCheckpoints = m_vCheckpoints.size();
+	Header.m_NumPlayers = m_vPlayers.size();
+	io_write(File, &Header, sizeof(Header));
+	io_write(File, m_vCheckpoints.data(), m_vCheckpoints.size() * sizeof(CCheckpoint));
+	io_write(File, m_vPlayers.data(), m_vPlayers.size() * sizeof(CPlayerRange));
+	return io_close(File) == 0;
+}
+
+const CTeeHistorianIndex::CCheckpoint *CTeeHistorianIndex::Find(int Tick) const
+{
+	auto It = std::lower_bound(m_vCheckpoints.begin(), m_vCheckpoints.end(), Tick, [](const CCheckpoint &Checkpoint, int Tick) {
+		return Checkpoint.m_State.m_Tick < Tick;
+	});
+	if(It == m_vCheckpoints.begin())
+		return nullptr;
+	return &*(It - 1);
+}
+
+bool CTeeHistorianIndex::Seek(CTeeHistorianReader *pReader, int Tick) const
+{
+	const CCheckpoint *pCheckpoint = Find(Tick);
+	return !pCheckpoint || pReader->Seek(pCheckpoint->m_Position, pCheckpoint->m_State);
+}
+
+bool CTeeHistorianIndex::Open(IStorage *pStorage, const char *pFilename, int StorageType, CTeeHistorianIndex *pIndex, int CheckpointInterval)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(!File)
+		return false;
+	int64_t FileSize = io_length(File);
+	io_close(File);
+
+	char aIndexFilename[MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", pFilename);
+	if(pIndex->Load(pStorage, aIndexFilename, StorageType) && pIndex->m_FileSize == FileSize)
+		return true;
+
+	CTeeHistorianReader Reader;
+	if(!Reader.Open(pStorage, pFilename, StorageType) || !pIndex->Build(&Reader, FileSize, CheckpointInterval))
+		return false;
+	// the index is still usable if it can't be saved, e.g. next to a
+	// file in a read-only folder
+	int SaveType = StorageType == IStorage::TYPE_ALL ? IStorage::TYPE_SAVE : StorageType;
+	if(!pIndex->Save(pStorage, aIndexFilename, SaveType))
+		dbg_msg("teehistorian_reader", "failed to save index '%s'", aIndexFilename);
+	return true;
+}
@@ -0,0 +1,179 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_READER_H
+#define ENGINE_SHARED_TEEHISTORIAN_READER_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+#include <game/generated/protocol.h>
+
+#include <string>
+#include <vector>
+
+class IStorage;
+
+// Decodes teehistorian files chunk by chunk, plain ones and the zlib
+// frames written by CBlockWriter. Only a window of the file is kept in
+// memory, and reading can continue from any chunk whose position and
+// state were saved, see CTeeHistorianIndex.
+class CTeeHistorianReader
+{
+public:
+	class IListener
+	{
+	public:
+		virtual ~IListener() {}
+		// called before the first chunk of a tick
+		virtual void OnTick(int Tick) {}
+		// a new player or one that moved
+		virtual void OnPlayer(int ClientID, int X, int Y) {}
+		virtual void OnPlayerOld(int ClientID) {}
+		virtual void OnInput(int ClientID, const CNetObj_PlayerInput *pInput) {}
+		virtual void OnMessage(int ClientID, const void *pMsg, int MsgSize) {}
+		virtual void OnJoin(int ClientID) {}
+		virtual void OnDrop(int ClientID, const char *pReason) {}
+		virtual void OnConsoleCommand(int ClientID, int FlagMask, const char *pCmd, int NumArgs, const char **ppArgs) {}
+		virtual void OnEx(CUuid Uuid, const void *pData, int DataSize) {}
+	};
+
+	struct CPlayerState
+	{
+		int m_Alive;
+		int m_X;
+		int m_Y;
+		int m_InputExists;
+		CNetObj_PlayerInput m_Input;
+	};
+
+	// what the decoding depends on, positions and inputs are diffs
+	struct CState
+	{
+		int m_Tick;
+		// the last client id with player data in this tick, player data
+		// with a lower or equal one starts the next tick
+		int m_LastPlayerID;
+		CPlayerState m_aPlayers[MAX_CLIENTS];
+	};
+
+	// a chunk in the file, compressed files are read from the start of
+	// the frame that holds it
+	struct CPosition
+	{
+		int64_t m_Offset; // in the uncompressed stream
+		int64_t m_FrameOffset; // in the uncompressed stream
+		int64_t m_FrameFileOffset;
+	};
+
+	enum
+	{
+		CHUNK_ERROR = -1,
+		CHUNK_END = 0,
+		CHUNK_READ = 1,
+	};
+
+private:
+	struct CFrame
+	{
+		int64_t m_Offset;
+		int64_t m_FileOffset;
+	};
+
+	IOHANDLE m_File;
+	bool m_Compressed;
+	// a frame or chunk couldn't be decoded
+	bool m_Broken;
+	std::string m_Header;
+	CState m_State;
+	bool m_Finished;
+
+	// the buffered part of the stream, m_vBuffer[0] is at m_BufferOffset
+	std::vector<unsigned char> m_vBuffer;
+	int m_BufferPos;
+	int m_BufferEnd;
+	int64_t m_BufferOffset;
+	int64_t m_FileOffset;
+	// the frames of the buffer, oldest first
+	std::vector<CFrame> m_vFrames;
+	std::vector<unsigned char> m_vCompressed;
+	std::vector<const char *> m_vArgs;
+
+	bool Fill();
+	bool ReadHeader();
+	void StartTick(int Tick, IListener *pListener);
+	int ParseChunk(IListener *pListener, int EndTick);
+
+public:
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	bool Open(IStorage *pStorage, const char *pFilename, int StorageType);
+	void Close();
+
+	bool IsCompressed() const { return m_Compressed; }
+	// the json header
+	const char *Header() const { return m_Header.c_str(); }
+	const CState *State() const { return &m_State; }
+	CPosition Position() const;
+	// true after the finish chunk, files of running games don't have it
+	bool Finished() const { return m_Finished; }
+
+	// continues at a chunk with the state from before it
+	bool Seek(const CPosition &Position, const CState &State);
+	// CHUNK_END at the end of the file or before the first chunk after
+	// EndTick, the chunk is read by the next call then
+	int ReadChunk(IListener *pListener, int EndTick = -1);
+	// reads chunks until ReadChunk doesn't return CHUNK_READ, false on
+	// an error
+	bool Read(IListener *pListener, int EndTick = -1);
+};
+
+// Sidecar of a teehistorian file: the state of the reader every few
+// ticks, so reading a time window doesn't have to start at the
+// beginning, and the ticks in which players were connected.
+class CTeeHistorianIndex
+{
+public:
+	enum
+	{
+		DEFAULT_CHECKPOINT_INTERVAL = SERVER_TICK_SPEED * 60,
+	};
+
+	struct CCheckpoint
+	{
+		CTeeHistorianReader::CPosition m_Position;
+		CTeeHistorianReader::CState m_State;
+	};
+
+	struct CPlayerRange
+	{
+		int m_ClientID;
+		int m_JoinTick;
+		// -1 if the player didn't leave
+		int m_DropTick;
+		// the first name the player sent
+		char m_aName[MAX_NAME_LENGTH];
+	};
+
+	// size of the indexed file, the index is rebuilt if it changes
+	int64_t m_FileSize;
+	int m_LastTick;
+	bool m_Finished;
+	std::vector<CCheckpoint> m_vCheckpoints;
+	std::vector<CPlayerRange> m_vPlayers;
+
+	// reads the whole file from the start
+	bool Build(CTeeHistorianReader *pReader, int64_t FileSize, int CheckpointInterval = DEFAULT_CHECKPOINT_INTERVAL);
+	bool Load(IStorage *pStorage, const char *pFilename, int StorageType);
+	bool Save(IStorage *pStorage, const char *pFilename, int StorageType) const;
+
+	// the last checkpoint before Tick, nullptr to read from the start
+	const CCheckpoint *Find(int Tick) const;
+	// seeks to the last checkpoint before Tick, stays at the start if
+	// there is none
+	bool Seek(CTeeHistorianReader *pReader, int Tick) const;
+
+	// loads the index next to a teehistorian file, building and saving
+	// it if it's missing or outdated
+	static bool Open(IStorage *pStorage, const char *pFilename, int StorageType, CTeeHistorianIndex *pIndex, int CheckpointInterval = DEFAULT_CHECKPOINT_INTERVAL);
+};
+
+#endif
@@ -1193,6 +1193,9 @@ void CMenus::OnInit()
 	m_RefreshButton.Init(UI());
 	m_ConnectButton.Init(UI());
 
+	m_DemoIndex.Init(Storage(), DemoPlayer(), m_pClient->Engine()->JobPool());
+	m_DemoIndexGeneration = m_DemoIndex.Generation();
+
 	Console()->Chain("add_favorite", ConchainServerbrowserUpdate, this);
 	Console()->Chain("remove_favorite", ConchainServerbrowserUpdate, this);
 	Console()->Chain("add_friend", ConchainFriendlistUpdate, this);
@@ -1217,6 +1220,11 @@ void CMenus::OnInit()
 	Storage()->ListDirectory(IStorage::TYPE_ALL, "menuimages", MenuImageScan, this);
 }
 
+void CMenus::OnShutdown()
+{
+	m_DemoIndex.Shutdown();
+}
+
 void CMenus::PopupMessage(const char *pTopic, const char *pBody, const char *pButton)
 {
 	// reset active item
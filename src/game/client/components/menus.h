@@ -9,6 +9,7 @@
 #include <engine/demo.h>
 #include <engine/friends.h>
 #include <engine/shared/config.h>
+#include <engine/shared/demo_index.h>
 #include <engine/shared/linereader.h>
 #include <engine/textrender.h>
 #include <game/client/components/mapimages.h>
@@ -379,6 +380,7 @@ protected:
 		bool m_IsDir;
 		int m_StorageType;
 		time_t m_Date;
+		int64_t m_Size;
 
 		bool m_InfosLoaded;
 		bool m_Valid;
@@ -442,7 +444,10 @@ protected:
 
 	void DemolistOnUpdate(bool Reset);
 	//void DemolistPopulate();
-	static int DemolistFetchCallback(const char *pName, time_t Date, int IsDir, int StorageType, void *pUser);
+	static int DemolistFetchCallback(const char *pName, time_t Date, int64_t Size, int IsDir, int StorageType, void *pUser);
+
+	CDemoIndex m_DemoIndex;
+	int m_DemoIndexGeneration;
 
 	// friends
 	struct CFriendItem
@@ -482,6 +487,7 @@ protected:
 	// found in menus_demo.cpp
 	static bool DemoFilterChat(const void *pData, int Size, void *pUser);
 	bool FetchHeader(CDemoItem &Item);
+	bool FetchIndexedHeader(CDemoItem &Item);
 	void FetchAllHeaders();
 	void RenderDemoPlayer(CUIRect MainView);
 	void RenderDemoList(CUIRect MainView);
@@ -547,6 +553,7 @@ public:
 
 	bool IsActive() const { return m_MenuActive; }
 	void KillServer();
+	void OnShutdown();
 
 	virtual void OnInit();
 
@@ -214,6 +214,16 @@ void CMenus::RenderDemoPlayer(CUIRect MainView)
 			DemoPlayer()->SeekTime(5.0f);
 		}
 
+		// step one tick backward/forward while paused
+		if(pInfo->m_Paused && Input()->KeyPress(KEY_COMMA))
+		{
+			DemoPlayer()->SeekTick(IDemoPlayer::TICK_PREVIOUS);
+		}
+		else if(pInfo->m_Paused && Input()->KeyPress(KEY_PERIOD))
+		{
+			DemoPlayer()->SeekTick(IDemoPlayer::TICK_NEXT);
+		}
+
 		// seek to 0-90%
 		const int SeekPercentKeys[] = {KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9};
 		for(unsigned i = 0; i < sizeof(SeekPercentKeys) / sizeof(SeekPercentKeys[0]); i++)
@@ -740,7 +750,7 @@ int CMenus::UiLogicGetCurrentClickedItem()
 		return -1;
 }
 
-int CMenus::DemolistFetchCallback(const char *pName, time_t Date, int IsDir, int StorageType, void *pUser)
+int CMenus::DemolistFetchCallback(const char *pName, time_t Date, int64_t Size, int IsDir, int StorageType, void *pUser)
 {
 	CMenus *pSelf = (CMenus *)pUser;
 	if(str_comp(pName, ".") == 0 || (str_comp(pName, "..") == 0 && str_comp(pSelf->m_aCurrentDemoFolder, "demos") == 0) || (!IsDir && !str_endswith(pName, ".demo")))
@@ -756,12 +766,14 @@ int CMenus::DemolistFetchCallback(const char *pName, time_t Date, int IsDir, int
 		Item.m_InfosLoaded = false;
 		Item.m_Valid = false;
 		Item.m_Date = 0;
+		Item.m_Size = 0;
 	}
 	else
 	{
 		str_truncate(Item.m_aName, sizeof(Item.m_aName), pName, str_length(pName) - 5);
 		Item.m_InfosLoaded = false;
 		Item.m_Date = Date;
+		Item.m_Size = Size;
 	}
 	Item.m_IsDir = IsDir != 0;
 	Item.m_StorageType = StorageType;
@@ -777,6 +789,21 @@ void CMenus::DemolistPopulate()
 		m_DemolistStorageType = IStorage::TYPE_ALL;
 	Storage()->ListDirectoryInfo(m_DemolistStorageType, m_aCurrentDemoFolder, DemolistFetchCallback, this);
 
+	// take the infos the index has, forget the demos that are gone
+	std::map<int, std::vector<std::string>> Listed;
+	if(m_DemolistStorageType != IStorage::TYPE_ALL)
+		Listed[m_DemolistStorageType];
+	for(sorted_array<CDemoItem>::range r = m_lDemos.all(); !r.empty(); r.pop_front())
+	{
+		CDemoItem &Item = r.front();
+		if(Item.m_IsDir)
+			continue;
+		FetchIndexedHeader(Item);
+		Listed[Item.m_StorageType].push_back(Item.m_aFilename);
+	}
+	for(const auto &Folder : Listed)
+		m_DemoIndex.Prune(m_aCurrentDemoFolder, Folder.first, Folder.second);
+
 	if(g_Config.m_BrDemoFetchInfo)
 		FetchAllHeaders();
 
@@ -820,17 +847,50 @@ bool CMenus::FetchHeader(CDemoItem &Item)
 		str_format(aBuffer, sizeof(aBuffer), "%s/%s", m_aCurrentDemoFolder, Item.m_aFilename);
 		Item.m_Valid = DemoPlayer()->GetDemoInfo(Storage(), aBuffer, Item.m_StorageType, &Item.m_Info, &Item.m_TimelineMarkers, &Item.m_MapInfo);
 		Item.m_InfosLoaded = true;
+
+		if(!Item.m_IsDir)
+		{
+			CDemoIndexInfo Info;
+			Info.m_Valid = Item.m_Valid;
+			Info.m_Info = Item.m_Info;
+			Info.m_TimelineMarkers = Item.m_TimelineMarkers;
+			Info.m_MapInfo = Item.m_MapInfo;
+			m_DemoIndex.Add(aBuffer, Item.m_StorageType, Item.m_Date, Item.m_Size, &Info);
+		}
 	}
 	return Item.m_Valid;
 }
 
+bool CMenus::FetchIndexedHeader(CDemoItem &Item)
+{
+	char aBuffer[512];
+	str_format(aBuffer, sizeof(aBuffer), "%s/%s", m_aCurrentDemoFolder, Item.m_aFilename);
+	CDemoIndexInfo Info;
+	if(!m_DemoIndex.Find(aBuffer, Item.m_StorageType, Item.m_Date, Item.m_Size, &Info))
+		return false;
+
+	Item.m_Valid = Info.m_Valid;
+	Item.m_Info = Info.m_Info;
+	Item.m_TimelineMarkers = Info.m_TimelineMarkers;
+	Item.m_MapInfo = Info.m_MapInfo;
+	Item.m_InfosLoaded = true;
+	return true;
+}
+
 void CMenus::FetchAllHeaders()
 {
+	// the demos that aren't indexed yet are read in the background
 	for(sorted_array<CDemoItem>::range r = m_lDemos.all(); !r.empty(); r.pop_front())
 	{
-		FetchHeader(r.front());
+		CDemoItem &Item = r.front();
+		if(Item.m_IsDir || Item.m_InfosLoaded)
+			continue;
+
+		char aBuffer[512];
+		str_format(aBuffer, sizeof(aBuffer), "%s/%s", m_aCurrentDemoFolder, Item.m_aFilename);
+		m_DemoIndex.Request(aBuffer, Item.m_StorageType, Item.m_Date, Item.m_Size);
 	}
-	m_lDemos.sort_range();
+	m_DemoIndex.StartJob();
 }
 
 void CMenus::RenderDemoList(CUIRect MainView)
@@ -843,6 +903,24 @@ void CMenus::RenderDemoList(CUIRect MainView)
 		s_Inited = 1;
 	}
 
+	// pick up the demos the index job read since
+	if(m_DemoIndex.Generation() != m_DemoIndexGeneration)
+	{
+		m_DemoIndexGeneration = m_DemoIndex.Generation();
+		bool Changed = false;
+		for(sorted_array<CDemoItem>::range r = m_lDemos.all(); !r.empty(); r.pop_front())
+		{
+			CDemoItem &Item = r.front();
+			if(!Item.m_IsDir && !Item.m_InfosLoaded)
+				Changed |= FetchIndexedHeader(Item);
+		}
+		if(Changed)
+		{
+			m_lDemos.sort_range();
+			DemolistOnUpdate(false);
+		}
+	}
+
 	char aFooterLabel[128] = {0};
 	if(m_DemolistSelectedIndex >= 0)
 	{
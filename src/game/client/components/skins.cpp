@@ -421,7 +421,8 @@ int CSkins::FindImpl(const char *pName)
 	str_format(aUrl, sizeof(aUrl), "%s%s.png", g_Config.m_ClSkinDownloadUrl, pName);
 	str_format(Skin.m_aPath, sizeof(Skin.m_aPath), "downloadedskins/%s.%d.tmp", pName, pid());
 	Skin.m_pTask = std::make_shared<CGetPngFile>(this, Storage(), aUrl, Skin.m_aPath, IStorage::TYPE_SAVE, CTimeout{0, 0, 0}, HTTPLOG::NONE);
-	m_pClient->Engine()->AddJob(Skin.m_pTask);
+	// don't hold up the map download when joining a server with many new skins
+	m_pClient->Engine()->AddJob(Skin.m_pTask, CJobPool::PRIORITY_LOW);
 	m_aDownloadSkins.add(Skin);
 	return -1;
 }
@@ -915,6 +915,7 @@ void CGameClient::OnStateChange(int NewState, int OldState)
 void CGameClient::OnShutdown()
 {
 	m_pMenus->KillServer();
+	m_pMenus->OnShutdown();
 	m_pRaceDemo->OnReset();
 	m_pGhost->OnReset();
 }
@@ -893,11 +893,11 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::list<int> Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-		for(int Index : Indices)
-			HandleTiles(Index);
-	else
+	int NumIndices = Collision()->ForEachMapIndex(m_PrevPos, m_Pos, [this](int Index) {
+		HandleTiles(Index);
+		return true;
+	});
+	if(!NumIndices)
 	{
 		HandleTiles(CurrentIndex);
 	}
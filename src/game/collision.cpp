@@ -51,6 +51,9 @@ CCollision::CCollision()
 	m_pDoor = 0;
 	m_pSwitchers = 0;
 	m_pTune = 0;
+	for(auto &pTileBits : m_apTileBits)
+		pTileBits = 0;
+	m_TileBitsStride = 0;
 }
 
 CCollision::~CCollision()
@@ -110,6 +113,16 @@ void CCollision::Init(class CLayers *pLayers)
 			m_pFront = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->FrontLayer()->m_Front));
 	}
 
+	m_TileBitsStride = (m_Width + 63) / 64;
+	size_t TileBitsSize = (size_t)m_TileBitsStride * m_Height;
+	m_apTileBits[0] = new uint64_t[TileBitsSize * NUM_TILEBITS];
+	mem_zero(m_apTileBits[0], TileBitsSize * NUM_TILEBITS * sizeof(uint64_t));
+	for(int i = 1; i < NUM_TILEBITS; i++)
+		m_apTileBits[i] = m_apTileBits[0] + TileBitsSize * i;
+	for(int y = 0; y < m_Height; y++)
+		for(int x = 0; x < m_Width; x++)
+			UpdateTileBits(x, y);
+
 	for(int i = 0; i < m_Width * m_Height; i++)
 	{
 		int Index;
@@ -327,7 +340,7 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
 				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			return SolidTile(ix, iy);
 		}
 
 		Last = Pos;
@@ -372,7 +385,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		if(CheckPoint(ix, iy))
 		{
 			if(!IsThrough(ix, iy, dx, dy, Pos0, Pos1))
-				hit = GetCollisionAt(ix, iy);
+				hit = SolidTile(ix, iy);
 		}
 		else if(IsHookBlocker(ix, iy, Pos0, Pos1))
 		{
@@ -429,7 +442,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
 				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			return SolidTile(ix, iy);
 		}
 
 		Last = Pos;
@@ -480,18 +493,47 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 	}
 }
 
-bool CCollision::TestBox(vec2 Pos, vec2 Size) const
+void CCollision::UpdateTileBits(int Nx, int Ny)
+{
+	int Index = Ny * m_Width + Nx;
+	int Tile = m_pTiles[Index].m_Index;
+	int FTile = m_pFront ? m_pFront[Index].m_Index : 0;
+	bool aSet[NUM_TILEBITS];
+	aSet[TILEBITS_SOLID] = Tile == TILE_SOLID || Tile == TILE_NOHOOK;
+	aSet[TILEBITS_NOHOOK] = Tile == TILE_NOHOOK;
+	aSet[TILEBITS_DEATH] = Tile == TILE_DEATH || FTile == TILE_DEATH;
+	aSet[TILEBITS_THROUGH] = Tile == TILE_THROUGH || FTile == TILE_THROUGH;
+
+	uint64_t Bit = (uint64_t)1 << (Nx & 63);
+	for(int i = 0; i < NUM_TILEBITS; i++)
+	{
+		uint64_t &Word = m_apTileBits[i][Ny * m_TileBitsStride + (Nx >> 6)];
+		Word = aSet[i] ? Word | Bit : Word & ~Bit;
+	}
+}
+
+bool CCollision::TestBoxBits(int Bits, vec2 Pos, vec2 Size) const
 {
+	if(!m_apTileBits[Bits])
+		return false;
+
+	// same rounding as CheckPoint on the four corners
 	Size *= 0.5f;
-	if(CheckPoint(Pos.x - Size.x, Pos.y - Size.y))
-		return true;
-	if(CheckPoint(Pos.x + Size.x, Pos.y - Size.y))
-		return true;
-	if(CheckPoint(Pos.x - Size.x, Pos.y + Size.y))
-		return true;
-	if(CheckPoint(Pos.x + Size.x, Pos.y + Size.y))
-		return true;
-	return false;
+	int x0 = clamp(round_to_int(Pos.x - Size.x) / 32, 0, m_Width - 1);
+	int x1 = clamp(round_to_int(Pos.x + Size.x) / 32, 0, m_Width - 1);
+	int y0 = clamp(round_to_int(Pos.y - Size.y) / 32, 0, m_Height - 1);
+	int y1 = clamp(round_to_int(Pos.y + Size.y) / 32, 0, m_Height - 1);
+
+	const uint64_t *pRow0 = &m_apTileBits[Bits][y0 * m_TileBitsStride];
+	const uint64_t *pRow1 = &m_apTileBits[Bits][y1 * m_TileBitsStride];
+	if((x0 >> 6) == (x1 >> 6))
+	{
+		// usual case, all corners in one word per row
+		uint64_t Mask = ((uint64_t)1 << (x0 & 63)) | ((uint64_t)1 << (x1 & 63));
+		return ((pRow0[x0 >> 6] | pRow1[x0 >> 6]) & Mask) != 0;
+	}
+	return (((pRow0[x0 >> 6] | pRow1[x0 >> 6]) >> (x0 & 63)) & 1) ||
+	       (((pRow0[x1 >> 6] | pRow1[x1 >> 6]) >> (x1 & 63)) & 1);
 }
 
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
@@ -581,12 +623,27 @@ void CCollision::Dest()
 	m_pTune = 0;
 	m_pDoor = 0;
 	m_pSwitchers = 0;
+	delete[] m_apTileBits[0];
+	for(auto &pTileBits : m_apTileBits)
+		pTileBits = 0;
+	m_TileBitsStride = 0;
 }
 
 int CCollision::IsSolid(int x, int y) const
 {
-	int index = GetTile(x, y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	if(!m_apTileBits[TILEBITS_SOLID])
+		return 0;
+
+	int Nx = clamp(x / 32, 0, m_Width - 1);
+	int Ny = clamp(y / 32, 0, m_Height - 1);
+	return TileBit(TILEBITS_SOLID, Nx, Ny);
+}
+
+int CCollision::SolidTile(int x, int y) const
+{
+	int Nx = clamp(x / 32, 0, m_Width - 1);
+	int Ny = clamp(y / 32, 0, m_Height - 1);
+	return TileBit(TILEBITS_NOHOOK, Nx, Ny) ? TILE_NOHOOK : TILE_SOLID;
 }
 
 bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1) const
@@ -596,8 +653,9 @@ bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos
 		return true;
 	if(m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_DIR && ((m_pFront[pos].m_Flags == ROTATION_0 && pos0.y > pos1.y) || (m_pFront[pos].m_Flags == ROTATION_90 && pos0.x < pos1.x) || (m_pFront[pos].m_Flags == ROTATION_180 && pos0.y < pos1.y) || (m_pFront[pos].m_Flags == ROTATION_270 && pos0.x > pos1.x)))
 		return true;
-	int offpos = GetPureMapIndex(x + xoff, y + yoff);
-	if(m_pTiles[offpos].m_Index == TILE_THROUGH || (m_pFront && m_pFront[offpos].m_Index == TILE_THROUGH))
+	int OffX = clamp((x + xoff) / 32, 0, m_Width - 1);
+	int OffY = clamp((y + yoff) / 32, 0, m_Height - 1);
+	if(TileBit(TILEBITS_THROUGH, OffX, OffY))
 		return true;
 	return false;
 }
@@ -907,9 +965,7 @@ bool CCollision::TileExistsNext(int Index) const
 
 int CCollision::GetMapIndex(vec2 Pos) const
 {
-	int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-	int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-	int Index = Ny * m_Width + Nx;
+	int Index = GetClampedMapIndex(Pos);
 
 	if(TileExists(Index))
 		return Index;
@@ -917,52 +973,6 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
-{
-	std::list<int> Indices;
-	float d = distance(PrevPos, Pos);
-	int End(d + 1);
-	if(!d)
-	{
-		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-		int Index = Ny * m_Width + Nx;
-
-		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
-	}
-	else
-	{
-		float a = 0.0f;
-		vec2 Tmp = vec2(0, 0);
-		int Nx = 0;
-		int Ny = 0;
-		int Index, LastIndex = 0;
-		for(int i = 0; i < End; i++)
-		{
-			a = i / d;
-			Tmp = mix(PrevPos, Pos, a);
-			Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
-			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
-				LastIndex = Index;
-			}
-		}
-
-		return Indices;
-	}
-}
-
 vec2 CCollision::GetPos(int Index) const
 {
 	if(Index < 0)
@@ -1119,6 +1129,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateTileBits(Nx, Ny);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -6,8 +6,6 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
-
 enum
 {
 	CANTMOVE_LEFT = 1 << 0,
@@ -43,7 +41,8 @@ public:
 	int IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const;
 	void MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces) const;
 	void MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const;
-	bool TestBox(vec2 Pos, vec2 Size) const;
+	bool TestBox(vec2 Pos, vec2 Size) const { return TestBoxBits(TILEBITS_SOLID, Pos, Size); }
+	bool TestBoxDeath(vec2 Pos, vec2 Size) const { return TestBoxBits(TILEBITS_DEATH, Pos, Size); }
 
 	// DDRace
 
@@ -73,8 +72,45 @@ public:
 	int Entity(int x, int y, int Layer) const;
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+	// Calls Fn(Index) for every tile index with tiles on the way from
+	// PrevPos to Pos, in order, skipping immediate repeats. Fn returns
+	// false to stop the traversal. Returns the number of visited indices.
+	template<typename F>
+	int ForEachMapIndex(vec2 PrevPos, vec2 Pos, F &&Fn) const
+	{
+		float d = distance(PrevPos, Pos);
+		if(!d)
+		{
+			int Index = GetClampedMapIndex(Pos);
+			if(!TileExists(Index))
+				return 0;
+			Fn(Index);
+			return 1;
+		}
+
+		int End(d + 1);
+		int Num = 0;
+		int LastIndex = 0;
+		for(int i = 0; i < End; i++)
+		{
+			int Index = GetClampedMapIndex(mix(PrevPos, Pos, i / d));
+			if(LastIndex != Index && TileExists(Index))
+			{
+				Num++;
+				LastIndex = Index;
+				if(!Fn(Index))
+					break;
+			}
+		}
+		return Num;
+	}
 	int GetMapIndex(vec2 Pos) const;
+	int GetClampedMapIndex(vec2 Pos) const
+	{
+		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
+		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
+		return Ny * m_Width + Nx;
+	}
 	bool TileExists(int Index) const;
 	bool TileExistsNext(int Index) const;
 	vec2 GetPos(int Index) const;
@@ -117,6 +153,28 @@ public:
 	int m_NumSwitchers;
 
 private:
+	// one bit per tile, rows padded to whole words, kept in sync with
+	// the tiles so the physics doesn't have to touch the tile layers
+	enum
+	{
+		TILEBITS_SOLID = 0, // solid or nohook in the game layer
+		TILEBITS_NOHOOK,
+		TILEBITS_DEATH, // death in the game or front layer
+		TILEBITS_THROUGH, // through in the game or front layer
+		NUM_TILEBITS
+	};
+	uint64_t *m_apTileBits[NUM_TILEBITS];
+	int m_TileBitsStride;
+
+	void UpdateTileBits(int Nx, int Ny);
+	bool TileBit(int Bits, int Nx, int Ny) const
+	{
+		return (m_apTileBits[Bits][Ny * m_TileBitsStride + (Nx >> 6)] >> (Nx & 63)) & 1;
+	}
+	bool TestBoxBits(int Bits, vec2 Pos, vec2 Size) const;
+	// the tile at a solid point, solid or nohook
+	int SolidTile(int x, int y) const;
+
 	class CTeleTile *m_pTele;
 	class CSpeedupTile *m_pSpeedup;
 	class CTile *m_pFront;
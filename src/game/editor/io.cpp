@@ -6,6 +6,7 @@
 #include "editor.h"
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/serverbrowser.h>
 #include <engine/storage.h>
@@ -225,6 +226,7 @@ int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
 	str_format(aBuf, sizeof(aBuf), "saving to '%s'...", pFileName);
 	m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
 	CDataFileWriter df;
+	df.SetJobPool(m_pEditor->Kernel()->RequestInterface<IEngine>()->JobPool());
 	if(!df.Open(pStorage, pFileName))
 	{
 		str_format(aBuf, sizeof(aBuf), "failed to open file '%s'...", pFileName);
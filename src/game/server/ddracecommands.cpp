@@ -778,3 +778,25 @@ void CGameContext::ConDumpAntibot(IConsole::IResult *pResult, void *pUserData)
 	CGameContext *pSelf = (CGameContext *)pUserData;
 	pSelf->Antibot()->Dump();
 }
+
+void CGameContext::ConDumpTeeHistorian(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(!pSelf->m_TeeHistorianActive)
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", "not recording");
+		return;
+	}
+
+	CBlockWriter::CStats Stats;
+	pSelf->m_pTeeHistorianWriter->GetStats(&Stats);
+	double Seconds = maximum(Stats.m_Time / (double)time_freq(), 1.0);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "written %lld bytes (%lld in the file, %d frames), %.1f KiB/s, %.1f%% of the time writing",
+		(long long)Stats.m_BytesIn, (long long)Stats.m_BytesOut, Stats.m_NumFrames, Stats.m_BytesIn / Seconds / 1024,
+		Stats.m_WriteTime * 100.0 / maximum(Stats.m_Time, (int64_t)1));
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", aBuf);
+	str_format(aBuf, sizeof(aBuf), "backlog %lld bytes in %d blocks, at most %lld bytes, the tick waited %d times",
+		(long long)Stats.m_BacklogBytes, Stats.m_BacklogBlocks, (long long)Stats.m_MaxBacklogBytes, Stats.m_NumStalls);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", aBuf);
+}
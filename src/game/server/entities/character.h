@@ -39,6 +39,7 @@ public:
 	virtual void Tick();
 	virtual void TickDefered();
 	virtual void TickPaused();
+	virtual void PreSnap(CGameWorld::CSnapEntity *pSnap);
 	virtual void Snap(int SnappingClient);
 
 	bool IsGrounded();
@@ -60,6 +60,12 @@ void CDoor::Tick()
 {
 }
 
+void CDoor::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP | CGameWorld::SNAPENTITY_CLIP2;
+	pSnap->m_ClipPos2 = m_To;
+}
+
 void CDoor::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
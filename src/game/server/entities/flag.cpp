@@ -31,6 +31,16 @@ void CFlag::TickPaused()
 		++m_GrabTick;
 }
 
+void CFlag::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP;
+
+	CNetObj_Flag *pFlag = (CNetObj_Flag *)GameWorld()->SnapSharedItem(pSnap, NETOBJTYPE_FLAG, m_Team, sizeof(CNetObj_Flag));
+	pFlag->m_X = (int)m_Pos.x;
+	pFlag->m_Y = (int)m_Pos.y;
+	pFlag->m_Team = m_Team;
+}
+
 void CFlag::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -109,6 +109,11 @@ void CGun::Tick()
 		Fire();
 }
 
+void CGun::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP;
+}
+
 void CGun::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -24,6 +24,7 @@ public:
 
 	virtual void Reset();
 	virtual void Tick();
+	virtual void PreSnap(CGameWorld::CSnapEntity *pSnap);
 	virtual void Snap(int SnappingClient);
 };
 
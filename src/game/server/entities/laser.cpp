@@ -254,6 +254,29 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
+void CLaser::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+	if(!pOwnerChar)
+	{
+		pSnap->m_Flags |= CGameWorld::SNAPENTITY_SKIP;
+		return;
+	}
+
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP;
+	if(pOwnerChar->IsAlive())
+		pSnap->m_TeamMask = pOwnerChar->Teams()->TeamMask(pOwnerChar->Team(), -1, m_Owner);
+
+	CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(GameWorld()->SnapSharedItem(pSnap, NETOBJTYPE_LASER, GetID(), sizeof(CNetObj_Laser)));
+	pObj->m_X = (int)m_Pos.x;
+	pObj->m_Y = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_From.x;
+	pObj->m_FromY = (int)m_From.y;
+	pObj->m_StartTick = m_EvalTick;
+}
+
 void CLaser::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -13,6 +13,7 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void TickPaused();
+	virtual void PreSnap(CGameWorld::CSnapEntity *pSnap);
 	virtual void Snap(int SnappingClient);
 
 protected:
@@ -26,12 +26,13 @@ CLight::CLight(CGameWorld *pGameWorld, vec2 Pos, float Rotation, int Length,
 
 bool CLight::HitCharacter()
 {
-	std::list<CCharacter *> HitCharacters =
-		GameServer()->m_World.IntersectedCharacters(m_Pos, m_To, 0.0f, 0);
-	if(HitCharacters.empty())
+	CCharacter *apHitCharacters[MAX_CLIENTS];
+	int Num = GameServer()->m_World.IntersectedCharacters(m_Pos, m_To, 0.0f, apHitCharacters, MAX_CLIENTS, 0);
+	if(!Num)
 		return false;
-	for(auto *Char : HitCharacters)
+	for(int i = 0; i < Num; i++)
 	{
+		CCharacter *Char = apHitCharacters[i];
 		if(m_Layer == LAYER_SWITCH && m_Number > 0 && !GameServer()->Collision()->m_pSwitchers[m_Number].m_Status[Char->Team()])
 			continue;
 		Char->Freeze();
@@ -99,6 +100,12 @@ void CLight::Tick()
 	return;
 }
 
+void CLight::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP | CGameWorld::SNAPENTITY_CLIP2;
+	pSnap->m_ClipPos2 = m_To;
+}
+
 void CLight::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
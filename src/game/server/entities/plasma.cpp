@@ -83,6 +83,11 @@ void CPlasma::Tick()
 	}
 }
 
+void CPlasma::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP;
+}
+
 void CPlasma::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -296,6 +296,19 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+void CProjectile::PreSnap(CGameWorld::CSnapEntity *pSnap)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	pSnap->m_Flags |= CGameWorld::SNAPENTITY_CLIP;
+	pSnap->m_ClipPos = GetPos(Ct);
+
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+	if(pOwnerChar && pOwnerChar->IsAlive())
+		pSnap->m_TeamMask = pOwnerChar->Teams()->TeamMask(pOwnerChar->Team(), -1, m_Owner);
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
@@ -21,6 +21,10 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+
+	m_GridNode.m_pUser = this;
+	m_WorldSeq = 0;
+	m_SnapIndex = -1;
 }
 
 CEntity::~CEntity()
@@ -8,6 +8,7 @@
 #include "alloc.h"
 #include "gamecontext.h"
 #include "gameworld.h"
+#include "spatialgrid.h"
 
 /*
 	Class: Entity
@@ -22,6 +23,11 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	// spatial index and ordering within the type list
+	CSpatialGrid::CNode m_GridNode;
+	int m_WorldSeq;
+	int m_SnapIndex;
+
 	/* Identity */
 	class CGameWorld *m_pGameWorld;
 
@@ -114,6 +120,20 @@ public:
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: PreSnap
+			Called once per snapshot tick before the Snap() calls.
+			Fills in the parts of the snapshot that don't depend on
+			the snapping client, so CGameWorld::Snap can skip clients
+			that can't see the entity or copy a shared item instead
+			of calling Snap().
+
+		Arguments:
+			pSnap - Shared snapshot data of the entity. By default
+				Snap() is called for every client.
+	*/
+	virtual void PreSnap(CGameWorld::CSnapEntity *pSnap) {}
+
 	/*
 		Function: NetworkClipped
 			Performs a series of test to see if a client can see the
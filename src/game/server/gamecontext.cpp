@@ -109,7 +109,7 @@ void CGameContext::Clear()
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
-	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+	pSelf->m_pTeeHistorianWriter->Write(pData, DataSize);
 }
 
 void CGameContext::CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
@@ -762,7 +762,7 @@ void CGameContext::OnTick()
 
 	if(m_TeeHistorianActive)
 	{
-		int Error = aio_error(m_pTeeHistorianFile);
+		int Error = m_pTeeHistorianWriter->Error();
 		if(Error)
 		{
 			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
@@ -774,6 +774,8 @@ void CGameContext::OnTick()
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
 		}
+		// hand over the last tick at once, with a sync point every few seconds
+		m_pTeeHistorianWriter->Flush(Server()->Tick() % (SERVER_TICK_SPEED * 5) == 0);
 		m_TeeHistorian.BeginTick(Server()->Tick());
 		m_TeeHistorian.BeginPlayers();
 	}
@@ -3052,6 +3054,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("add_map_votes", "", CFGFLAG_SERVER, ConAddMapVotes, this, "Automatically adds voting options for all maps");
 	Console()->Register("vote", "r['yes'|'no']", CFGFLAG_SERVER, ConVote, this, "Force a vote to yes/no");
 	Console()->Register("dump_antibot", "", CFGFLAG_SERVER, ConDumpAntibot, this, "Dumps the antibot status");
+	Console()->Register("dump_teehistorian", "", CFGFLAG_SERVER, ConDumpTeeHistorian, this, "Dumps the tee historian write rate and backlog");
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
 
@@ -3198,8 +3201,9 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		char aGameUuid[UUID_MAXSTRSIZE];
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
-		char aFilename[64];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		int Compression = g_Config.m_SvTeeHistorianCompression ? CBlockWriter::COMPRESSION_ZLIB : CBlockWriter::COMPRESSION_NONE;
+		char aFilename[128];
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, Compression == CBlockWriter::COMPRESSION_ZLIB ? ".z" : "");
 
 		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!File)
@@ -3212,7 +3216,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(File);
+		m_pTeeHistorianWriter = new CBlockWriter(File, Compression);
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -3427,6 +3431,9 @@ void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
 
 	CDataFileWriter Writer;
 	Writer.Init();
+	// the map is only written to be sent to clients, keep it quick
+	Writer.SetJobPool(Engine()->JobPool());
+	Writer.SetCompressionLevel(Z_BEST_SPEED);
 
 	int SettingsIndex = Reader.NumData();
 	bool FoundInfo = false;
@@ -3517,15 +3524,13 @@ void CGameContext::OnShutdown()
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
-		aio_close(m_pTeeHistorianFile);
-		aio_wait(m_pTeeHistorianFile);
-		int Error = aio_error(m_pTeeHistorianFile);
+		int Error = m_pTeeHistorianWriter->Close();
 		if(Error)
 		{
 			dbg_msg("teehistorian", "error closing file, err=%d", Error);
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
-		aio_free(m_pTeeHistorianFile);
+		delete m_pTeeHistorianWriter;
 	}
 
 	DeleteTempfile();
@@ -3598,9 +3603,13 @@ void CGameContext::OnSnap(int ClientID)
 	if(ClientID > -1)
 		m_apPlayers[ClientID]->FakeSnap();
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_World.PreSnap();
+}
 void CGameContext::OnPostSnap()
 {
+	m_World.PostSnap();
 	m_Events.Clear();
 }
 
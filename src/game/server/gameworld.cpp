@@ -21,8 +21,14 @@ CGameWorld::CGameWorld()
 
 	m_Paused = false;
 	m_ResetRequested = false;
+	m_SnapEntitiesValid = false;
+	m_pNextTraverseEntity = 0;
+	m_pCurTraverseEntity = 0;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = 0;
+	for(auto &MaxProximityRadius : m_aMaxProximityRadius)
+		MaxProximityRadius = 0.0f;
+	m_NextEntitySeq = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -47,25 +53,60 @@ CEntity *CGameWorld::FindFirst(int Type)
 
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
-	if(Type < 0 || Type >= NUM_ENTTYPES)
+	if(Type < 0 || Type >= NUM_ENTTYPES || Max <= 0)
 		return 0;
 
+	// keep the result in type list order (newest first) like a linear
+	// scan would, so the same entities are found when it's truncated
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
-		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
+	float Range = Radius + m_aMaxProximityRadius[Type];
+	m_aGrids[Type].QueryBox(Pos - vec2(Range, Range), Pos + vec2(Range, Range), [&](CSpatialGrid::CNode *pNode) {
+		CEntity *pEnt = (CEntity *)pNode->m_pUser;
+		if(distance(pEnt->m_Pos, Pos) >= Radius + pEnt->m_ProximityRadius)
+			return;
+
+		if(!ppEnts)
 		{
-			if(ppEnts)
-				ppEnts[Num] = pEnt;
-			Num++;
-			if(Num == Max)
-				break;
+			Num = minimum(Num + 1, Max);
+			return;
 		}
-	}
+
+		if(Num == Max)
+		{
+			if(ppEnts[Num - 1]->m_WorldSeq > pEnt->m_WorldSeq)
+				return;
+			Num--;
+		}
+		int i = Num;
+		for(; i > 0 && ppEnts[i - 1]->m_WorldSeq < pEnt->m_WorldSeq; i--)
+			ppEnts[i] = ppEnts[i - 1];
+		ppEnts[i] = pEnt;
+		Num++;
+	});
 
 	return Num;
 }
 
+void CGameWorld::UpdateEntityGrid(CEntity *pEnt)
+{
+	m_aGrids[pEnt->m_ObjType].Move(&pEnt->m_GridNode, pEnt->m_Pos);
+}
+
+void CGameWorld::UpdateGrid()
+{
+	for(auto *pEnt : m_apFirstEntityTypes)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			UpdateEntityGrid(pEnt);
+}
+
+void CGameWorld::UpdateTraversedEntity()
+{
+	// unset by RemoveEntity if the entity got removed or destroyed
+	if(m_pCurTraverseEntity)
+		UpdateEntityGrid(m_pCurTraverseEntity);
+	m_pCurTraverseEntity = 0;
+}
+
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
 #ifdef CONF_DEBUG
@@ -79,14 +120,27 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	pEnt->m_WorldSeq = m_NextEntitySeq++;
+	m_aGrids[pEnt->m_ObjType].Insert(&pEnt->m_GridNode, pEnt->m_Pos);
+	m_aMaxProximityRadius[pEnt->m_ObjType] = maximum(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+
+	// the shared snapshot data doesn't know about this entity
+	m_SnapEntitiesValid = false;
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	if(m_pCurTraverseEntity == pEnt)
+		m_pCurTraverseEntity = 0;
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
 
+	// the shared snapshot data might still point to this entity
+	m_SnapEntitiesValid = false;
+
 	// remove
 	if(pEnt->m_pPrevTypeEntity)
 		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
@@ -101,20 +155,159 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_aGrids[pEnt->m_ObjType].Remove(&pEnt->m_GridNode);
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(SnappingClient == -1 || !m_SnapEntitiesValid)
+	{
+		for(auto *pEnt : m_apFirstEntityTypes)
+			for(; pEnt;)
+			{
+				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				pEnt->Snap(SnappingClient);
+				pEnt = m_pNextTraverseEntity;
+			}
+		return;
+	}
+
+	// only filter the shared data, entities that need the snapping
+	// client for more than that still get their own Snap() call
+	CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	if(pPlayer->m_ShowAll)
+	{
+		m_vSnapIndices.resize(m_vSnapEntities.size());
+		for(unsigned i = 0; i < m_vSnapIndices.size(); i++)
+			m_vSnapIndices[i] = i;
+		SnapCached(SnappingClient);
+		return;
+	}
+
+	// look up the entities around the view in the spatial index, the
+	// others can't be culled by it
+	m_vSnapIndices = m_vSnapUngridded;
+	vec2 ViewMin = pPlayer->m_ViewPos - pPlayer->m_ShowDistance;
+	vec2 ViewMax = pPlayer->m_ViewPos + pPlayer->m_ShowDistance;
+	for(auto &Grid : m_aGrids)
+		Grid.QueryBox(ViewMin, ViewMax, [&](CSpatialGrid::CNode *pNode) {
+			CEntity *pEnt = (CEntity *)pNode->m_pUser;
+			if(m_vSnapEntities[pEnt->m_SnapIndex].m_Flags & SNAPENTITY_GRID)
+				m_vSnapIndices.push_back(pEnt->m_SnapIndex);
+		});
+	std::sort(m_vSnapIndices.begin(), m_vSnapIndices.end());
+	SnapCached(SnappingClient);
+}
+
+void CGameWorld::SnapCached(int SnappingClient)
+{
+	m_vSnappedSeqs.clear();
+	for(int Index : m_vSnapIndices)
+	{
+		// a Snap() call added or removed entities, the rest of the
+		// snapshot comes from the entity lists
+		if(!m_SnapEntitiesValid)
+		{
+			SnapRemaining(SnappingClient);
+			return;
+		}
+		const CSnapEntity &SnapEnt = m_vSnapEntities[Index];
+		m_vSnappedSeqs.push_back(SnapEnt.m_pEntity->m_WorldSeq);
+		SnapEntity(SnapEnt, SnappingClient);
+	}
+}
+
+void CGameWorld::SnapRemaining(int SnappingClient)
+{
+	// entities that weren't looked up in the spatial index clip themselves
+	// in Snap()
+	std::sort(m_vSnappedSeqs.begin(), m_vSnappedSeqs.end());
 	for(auto *pEnt : m_apFirstEntityTypes)
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
+			if(!std::binary_search(m_vSnappedSeqs.begin(), m_vSnappedSeqs.end(), pEnt->m_WorldSeq))
+				pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
 }
 
+void CGameWorld::SnapEntity(const CSnapEntity &SnapEnt, int SnappingClient)
+{
+	if(SnapEnt.m_Flags & SNAPENTITY_SKIP)
+		return;
+	if(!CmaskIsSet(SnapEnt.m_TeamMask, SnappingClient))
+		return;
+	if(SnapEnt.m_Flags & SNAPENTITY_CLIP && NetworkClipped(GameServer(), SnappingClient, SnapEnt.m_ClipPos))
+	{
+		if(!(SnapEnt.m_Flags & SNAPENTITY_CLIP2) || NetworkClipped(GameServer(), SnappingClient, SnapEnt.m_ClipPos2))
+			return;
+	}
+
+	if(SnapEnt.m_Flags & SNAPENTITY_ITEM)
+	{
+		void *pItem = Server()->SnapNewItem(SnapEnt.m_ItemType, SnapEnt.m_ItemID, SnapEnt.m_ItemSize);
+		if(pItem)
+			mem_copy(pItem, &m_vSnapData[SnapEnt.m_ItemOffset], SnapEnt.m_ItemSize);
+	}
+	else
+		SnapEnt.m_pEntity->Snap(SnappingClient);
+}
+
+void CGameWorld::PreSnap()
+{
+	m_vSnapEntities.clear();
+	m_vSnapData.clear();
+	m_vSnapUngridded.clear();
+
+	for(auto *pEnt : m_apFirstEntityTypes)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			UpdateEntityGrid(pEnt);
+			CSnapEntity SnapEnt;
+			SnapEnt.m_pEntity = pEnt;
+			SnapEnt.m_Flags = 0;
+			SnapEnt.m_ClipPos = pEnt->m_Pos;
+			SnapEnt.m_ClipPos2 = pEnt->m_Pos;
+			SnapEnt.m_TeamMask = -1LL;
+			SnapEnt.m_ItemType = 0;
+			SnapEnt.m_ItemID = 0;
+			SnapEnt.m_ItemSize = 0;
+			SnapEnt.m_ItemOffset = 0;
+			pEnt->PreSnap(&SnapEnt);
+
+			// the spatial index knows where entities are that are only
+			// clipped by their own position
+			if((SnapEnt.m_Flags & (SNAPENTITY_SKIP | SNAPENTITY_CLIP | SNAPENTITY_CLIP2)) == SNAPENTITY_CLIP && SnapEnt.m_ClipPos == pEnt->m_Pos)
+				SnapEnt.m_Flags |= SNAPENTITY_GRID;
+			else if(!(SnapEnt.m_Flags & SNAPENTITY_SKIP))
+				m_vSnapUngridded.push_back(m_vSnapEntities.size());
+
+			pEnt->m_SnapIndex = m_vSnapEntities.size();
+			m_vSnapEntities.push_back(SnapEnt);
+		}
+
+	m_SnapEntitiesValid = true;
+}
+
+void CGameWorld::PostSnap()
+{
+	m_SnapEntitiesValid = false;
+}
+
+void *CGameWorld::SnapSharedItem(CSnapEntity *pSnap, int Type, int ID, int Size)
+{
+	pSnap->m_Flags |= SNAPENTITY_ITEM;
+	pSnap->m_ItemType = Type;
+	pSnap->m_ItemID = ID;
+	pSnap->m_ItemSize = Size;
+	pSnap->m_ItemOffset = m_vSnapData.size();
+	m_vSnapData.resize(m_vSnapData.size() + (Size + sizeof(int) - 1) / sizeof(int));
+	return &m_vSnapData[pSnap->m_ItemOffset];
+}
+
 void CGameWorld::Reset()
 {
 	// reset all entities
@@ -248,6 +441,9 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	// entities might have been moved from outside the world since the last tick
+	UpdateGrid();
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
@@ -257,7 +453,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurTraverseEntity = pEnt;
 				pEnt->Tick();
+				UpdateTraversedEntity();
 				pEnt = m_pNextTraverseEntity;
 			}
 
@@ -265,7 +463,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurTraverseEntity = pEnt;
 				pEnt->TickDefered();
+				UpdateTraversedEntity();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -276,7 +476,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pCurTraverseEntity = pEnt;
 				pEnt->TickPaused();
+				UpdateTraversedEntity();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -302,17 +504,19 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	float Range = Radius + m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	vec2 BoxMin = vec2(minimum(Pos0.x, Pos1.x) - Range, minimum(Pos0.y, Pos1.y) - Range);
+	vec2 BoxMax = vec2(maximum(Pos0.x, Pos1.x) + Range, maximum(Pos0.y, Pos1.y) + Range);
+	m_aGrids[ENTTYPE_CHARACTER].QueryBox(BoxMin, BoxMax, [&](CSpatialGrid::CNode *pNode) {
+		CCharacter *p = (CCharacter *)pNode->m_pUser;
 		if(p == pNotThis)
-			continue;
+			return;
 
 		if(pThisOnly && p != pThisOnly)
-			continue;
+			return;
 
 		if(CollideWith != -1 && !p->CanCollide(CollideWith))
-			continue;
+			return;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, p->m_Pos, IntersectPos))
@@ -320,8 +524,9 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 			float Len = distance(p->m_Pos, IntersectPos);
 			if(Len < p->m_ProximityRadius + Radius)
 			{
+				// on a tie, the character first in the type list wins
 				Len = distance(Pos0, IntersectPos);
-				if(Len < ClosestLen)
+				if(Len < ClosestLen || (Len == ClosestLen && pClosest && p->m_WorldSeq > pClosest->m_WorldSeq))
 				{
 					NewPos = IntersectPos;
 					ClosestLen = Len;
@@ -329,7 +534,7 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 				}
 			}
 		}
-	}
+	});
 
 	return pClosest;
 }
@@ -340,35 +545,38 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	float Range = Radius + m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	m_aGrids[ENTTYPE_CHARACTER].QueryBox(Pos - vec2(Range, Range), Pos + vec2(Range, Range), [&](CSpatialGrid::CNode *pNode) {
+		CCharacter *p = (CCharacter *)pNode->m_pUser;
 		if(p == pNotThis)
-			continue;
+			return;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
 		{
-			if(Len < ClosestRange)
+			// on a tie, the character first in the type list wins
+			if(Len < ClosestRange || (Len == ClosestRange && pClosest && p->m_WorldSeq > pClosest->m_WorldSeq))
 			{
 				ClosestRange = Len;
 				pClosest = p;
 			}
 		}
-	}
+	});
 
 	return pClosest;
 }
 
-std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
+int CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, CCharacter **ppChars, int Max, class CEntity *pNotThis)
 {
-	std::list<CCharacter *> listOfChars;
+	m_vpQueryEntities.clear();
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	float Range = Radius + m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	vec2 BoxMin = vec2(minimum(Pos0.x, Pos1.x) - Range, minimum(Pos0.y, Pos1.y) - Range);
+	vec2 BoxMax = vec2(maximum(Pos0.x, Pos1.x) + Range, maximum(Pos0.y, Pos1.y) + Range);
+	m_aGrids[ENTTYPE_CHARACTER].QueryBox(BoxMin, BoxMax, [&](CSpatialGrid::CNode *pNode) {
+		CCharacter *pChr = (CCharacter *)pNode->m_pUser;
 		if(pChr == pNotThis)
-			continue;
+			return;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -377,11 +585,20 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 			if(Len < pChr->m_ProximityRadius + Radius)
 			{
 				pChr->m_Intersection = IntersectPos;
-				listOfChars.push_back(pChr);
+				m_vpQueryEntities.push_back(pChr);
 			}
 		}
-	}
-	return listOfChars;
+	});
+
+	// return them in type list order
+	std::sort(m_vpQueryEntities.begin(), m_vpQueryEntities.end(), [](const CEntity *pA, const CEntity *pB) {
+		return pA->m_WorldSeq > pB->m_WorldSeq;
+	});
+
+	int Num = minimum((int)m_vpQueryEntities.size(), Max);
+	for(int i = 0; i < Num; i++)
+		ppChars[i] = (CCharacter *)m_vpQueryEntities[i];
+	return Num;
 }
 
 void CGameWorld::ReleaseHooked(int ClientID)
@@ -5,7 +5,9 @@
 
 #include <game/gamecore.h>
 
-#include <list>
+#include "spatialgrid.h"
+
+#include <vector>
 
 class CEntity;
 class CCharacter;
@@ -28,13 +30,63 @@ public:
 		NUM_ENTTYPES
 	};
 
+	enum
+	{
+		SNAPENTITY_SKIP = 1 << 0,
+		SNAPENTITY_CLIP = 1 << 1,
+		SNAPENTITY_CLIP2 = 1 << 2,
+		SNAPENTITY_ITEM = 1 << 3,
+		SNAPENTITY_GRID = 1 << 4,
+	};
+
+	/*
+		Class: Snap Entity
+			Per-tick snapshot data of an entity that is the same for
+			every snapping client, filled by CEntity::PreSnap.
+	*/
+	class CSnapEntity
+	{
+	public:
+		CEntity *m_pEntity;
+		int m_Flags;
+		vec2 m_ClipPos;
+		vec2 m_ClipPos2;
+		int64_t m_TeamMask;
+		int m_ItemType;
+		int m_ItemID;
+		int m_ItemSize;
+		int m_ItemOffset;
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
 
 	CEntity *m_pNextTraverseEntity;
+	CEntity *m_pCurTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	CSpatialGrid m_aGrids[NUM_ENTTYPES];
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+	int m_NextEntitySeq;
+	std::vector<int> m_vSnapIndices;
+	std::vector<CEntity *> m_vpQueryEntities;
+
+	void UpdateTraversedEntity();
+
+	std::vector<CSnapEntity> m_vSnapEntities;
+	std::vector<int> m_vSnapData;
+	std::vector<int> m_vSnapUngridded;
+	bool m_SnapEntitiesValid;
+
+	// world seqs of the entities the current snapshot went through
+	std::vector<int> m_vSnappedSeqs;
+
+	void SnapEntity(const CSnapEntity &SnapEnt, int SnappingClient);
+	// snaps m_vSnapIndices from the shared data
+	void SnapCached(int SnappingClient);
+	void SnapRemaining(int SnappingClient);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -74,6 +126,25 @@ public:
 	*/
 	int FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type);
 
+	/*
+		Function: UpdateEntityGrid
+			Moves an entity to its current cell of the spatial index.
+			Entities are updated automatically after their own tick
+			functions, call this after moving an entity from anywhere
+			else.
+
+		Arguments:
+			pEntity - Entity that has been moved.
+	*/
+	void UpdateEntityGrid(CEntity *pEntity);
+
+	/*
+		Function: UpdateGrid
+			Moves all entities to their current cells of the spatial
+			index.
+	*/
+	void UpdateGrid();
+
 	/*
 		Function: InterserctCharacters
 			Finds the CCharacters that intersects the line. // made for types lasers=1 and doors=0
@@ -133,6 +204,36 @@ public:
 	*/
 	void Snap(int SnappingClient);
 
+	/*
+		Function: PreSnap
+			Collects the snapshot data of all entities that doesn't
+			depend on the snapping client, once per snapshot tick.
+			Snap() then only filters and copies it for each client.
+	*/
+	void PreSnap();
+
+	/*
+		Function: PostSnap
+			Drops the data collected by PreSnap().
+	*/
+	void PostSnap();
+
+	/*
+		Function: SnapSharedItem
+			Adds a snapshot item that is sent unchanged to every
+			client that can see the entity.
+
+		Arguments:
+			pSnap - Shared snapshot data of the entity.
+			Type - Item type.
+			ID - Item ID.
+			Size - Item size in bytes.
+
+		Returns:
+			Pointer to the item data, valid until the next call.
+	*/
+	void *SnapSharedItem(CSnapEntity *pSnap, int Type, int ID, int Size);
+
 	/*
 		Function: tick
 			Calls tick on all the entities in the world to progress
@@ -155,10 +256,13 @@ public:
 			new_pos - Intersection position
 			notthis - Entity to ignore intersecting with
 
+			ppChars - Array that gets filled with the characters.
+			Max - Number of characters that fit into the array.
+
 		Returns:
-			Returns list with all Characters on line.
+			Number of characters on the line.
 	*/
-	std::list<class CCharacter *> IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis = 0);
+	int IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CCharacter **ppChars, int Max, class CEntity *pNotThis = 0);
 };
 
 #endif
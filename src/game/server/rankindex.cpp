@@ -0,0 +1,84 @@
+#include "rankindex.h"
+
+#include <base/system.h>
+
+#include <algorithm>
+
+static bool EntryLess(const CRankIndex::CEntry &a, const CRankIndex::CEntry &b)
+{
+	if(a.m_Time != b.m_Time)
+		return a.m_Time < b.m_Time;
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+void CRankIndex::Load(std::vector<CEntry> vEntries)
+{
+	Clear();
+	for(auto &Entry : vEntries)
+	{
+		auto Result = m_BestTimes.emplace(Entry.m_aName, Entry.m_Time);
+		if(!Result.second && Entry.m_Time < Result.first->second)
+			Result.first->second = Entry.m_Time;
+	}
+	m_vEntries.reserve(m_BestTimes.size());
+	for(auto &BestTime : m_BestTimes)
+	{
+		CEntry Entry;
+		Entry.m_Time = BestTime.second;
+		str_copy(Entry.m_aName, BestTime.first.c_str(), sizeof(Entry.m_aName));
+		m_vEntries.push_back(Entry);
+	}
+	std::sort(m_vEntries.begin(), m_vEntries.end(), EntryLess);
+}
+
+void CRankIndex::Add(const char *pName, float Time)
+{
+	CEntry Entry;
+	Entry.m_Time = Time;
+	str_copy(Entry.m_aName, pName, sizeof(Entry.m_aName));
+
+	auto Result = m_BestTimes.emplace(Entry.m_aName, Time);
+	if(!Result.second)
+	{
+		if(Result.first->second <= Time)
+			return;
+		CEntry Old = Entry;
+		Old.m_Time = Result.first->second;
+		m_vEntries.erase(m_vEntries.begin() + Position(Old));
+		Result.first->second = Time;
+	}
+	m_vEntries.insert(m_vEntries.begin() + Position(Entry), Entry);
+}
+
+void CRankIndex::Clear()
+{
+	m_vEntries.clear();
+	m_BestTimes.clear();
+}
+
+int CRankIndex::Position(const CEntry &Entry) const
+{
+	return std::lower_bound(m_vEntries.begin(), m_vEntries.end(), Entry, EntryLess) - m_vEntries.begin();
+}
+
+int CRankIndex::RankAt(int Pos) const
+{
+	float Time = m_vEntries[Pos].m_Time;
+	auto First = std::lower_bound(m_vEntries.begin(), m_vEntries.begin() + Pos, Time, [](const CEntry &Entry, float Time) { return Entry.m_Time < Time; });
+	return First - m_vEntries.begin() + 1;
+}
+
+bool CRankIndex::Find(const char *pName, int *pRank, float *pTime, float *pPercentRank) const
+{
+	auto BestTime = m_BestTimes.find(pName);
+	if(BestTime == m_BestTimes.end())
+		return false;
+
+	CEntry Entry;
+	Entry.m_Time = BestTime->second;
+	str_copy(Entry.m_aName, pName, sizeof(Entry.m_aName));
+	*pRank = RankAt(Position(Entry));
+	*pTime = Entry.m_Time;
+	*pPercentRank = Num() > 1 ? (*pRank - 1) / (float)(Num() - 1) : 0.0f;
+	return true;
+}
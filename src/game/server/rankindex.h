@@ -0,0 +1,45 @@
+#ifndef GAME_SERVER_RANKINDEX_H
+#define GAME_SERVER_RANKINDEX_H
+
+#include <engine/shared/protocol.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Class: Rank Index
+		Best time of every player on a map, ordered by time. Ranks
+		follow SQL's RANK() and PERCENT_RANK() over the best times, so
+		players with equal times share a rank.
+*/
+class CRankIndex
+{
+public:
+	struct CEntry
+	{
+		float m_Time;
+		char m_aName[MAX_NAME_LENGTH];
+	};
+
+	// replaces the index, names may appear multiple times
+	void Load(std::vector<CEntry> vEntries);
+	// keeps the better of the old and new time of the player
+	void Add(const char *pName, float Time);
+	void Clear();
+
+	int Num() const { return m_vEntries.size(); }
+	// entries in time order, ties ordered by name
+	const CEntry &Get(int Pos) const { return m_vEntries[Pos]; }
+	int RankAt(int Pos) const;
+	// returns false if the player has no time
+	bool Find(const char *pName, int *pRank, float *pTime, float *pPercentRank) const;
+
+private:
+	int Position(const CEntry &Entry) const;
+
+	std::vector<CEntry> m_vEntries;
+	std::unordered_map<std::string, float> m_BestTimes;
+};
+
+#endif
@@ -149,6 +149,7 @@ void CSaveTee::Load(CCharacter *pChr, int Team)
 
 	pChr->m_Pos = m_Pos;
 	pChr->m_PrevPos = m_PrevPos;
+	pChr->GameWorld()->UpdateEntityGrid(pChr);
 	pChr->m_TeleCheckpoint = m_TeleCheckpoint;
 	pChr->m_LastPenalty = m_LastPenalty;
 
@@ -3,6 +3,7 @@
 #include "gamemodes/DDRace.h"
 #include "player.h"
 #include "save.h"
+#include "scoreworker.h"
 
 #include <base/system.h>
 #include <engine/server/databases/connection.h>
@@ -25,85 +26,6 @@ static const CUuid UUID_NO_SAVE_ID =
 	{{0x6b, 0x40, 0x7e, 0x81, 0x8b, 0x77, 0x3e, 0x04,
 		0xa2, 0x07, 0x8d, 0xa1, 0x7f, 0x37, 0xd0, 0x00}};
 
-CScorePlayerResult::CScorePlayerResult()
-{
-	SetVariant(Variant::DIRECT);
-}
-
-void CScorePlayerResult::SetVariant(Variant v)
-{
-	m_MessageKind = v;
-	switch(v)
-	{
-	case DIRECT:
-	case ALL:
-		for(auto &aMessage : m_Data.m_aaMessages)
-			aMessage[0] = 0;
-		break;
-	case BROADCAST:
-		m_Data.m_Broadcast[0] = 0;
-		break;
-	case MAP_VOTE:
-		m_Data.m_MapVote.m_Map[0] = '\0';
-		m_Data.m_MapVote.m_Reason[0] = '\0';
-		m_Data.m_MapVote.m_Server[0] = '\0';
-		break;
-	case PLAYER_INFO:
-		m_Data.m_Info.m_Score = -9999;
-		m_Data.m_Info.m_Birthday = 0;
-		m_Data.m_Info.m_HasFinishScore = false;
-		m_Data.m_Info.m_Time = 0;
-		for(float &CpTime : m_Data.m_Info.m_CpTime)
-			CpTime = 0;
-	}
-}
-
-CTeamrank::CTeamrank() :
-	m_NumNames(0)
-{
-	for(auto &aName : m_aaNames)
-		aName[0] = '\0';
-	mem_zero(&m_TeamID.m_aData, sizeof(m_TeamID));
-}
-
-bool CTeamrank::NextSqlResult(IDbConnection *pSqlServer, bool *pEnd, char *pError, int ErrorSize)
-{
-	pSqlServer->GetBlob(1, m_TeamID.m_aData, sizeof(m_TeamID.m_aData));
-	pSqlServer->GetString(2, m_aaNames[0], sizeof(m_aaNames[0]));
-	m_NumNames = 1;
-	bool End = false;
-	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
-	{
-		CUuid TeamID;
-		pSqlServer->GetBlob(1, TeamID.m_aData, sizeof(TeamID.m_aData));
-		if(m_TeamID != TeamID)
-		{
-			*pEnd = false;
-			return false;
-		}
-		pSqlServer->GetString(2, m_aaNames[m_NumNames], sizeof(m_aaNames[m_NumNames]));
-		m_NumNames++;
-	}
-	if(!End)
-	{
-		return true;
-	}
-	*pEnd = true;
-	return false;
-}
-
-bool CTeamrank::SamePlayers(const std::vector<std::string> *aSortedNames)
-{
-	if(aSortedNames->size() != m_NumNames)
-		return false;
-	for(unsigned int i = 0; i < m_NumNames; i++)
-	{
-		if(str_comp(aSortedNames->at(i).c_str(), m_aaNames[i]) != 0)
-			return false;
-	}
-	return true;
-}
-
 std::shared_ptr<CScorePlayerResult> CScore::NewSqlPlayerResult(int ClientID)
 {
 	CPlayer *pCurPlayer = GameServer()->m_apPlayers[ClientID];
@@ -124,15 +46,20 @@ void CScore::ExecPlayerThread(
 	if(pResult == nullptr)
 		return;
 	auto Tmp = std::unique_ptr<CSqlPlayerRequest>(new CSqlPlayerRequest(pResult));
-	str_copy(Tmp->m_Name, pName, sizeof(Tmp->m_Name));
-	str_copy(Tmp->m_Map, g_Config.m_SvMap, sizeof(Tmp->m_Map));
-	str_copy(Tmp->m_Server, g_Config.m_SvSqlServerName, sizeof(Tmp->m_Server));
-	str_copy(Tmp->m_RequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_RequestingPlayer));
-	Tmp->m_Offset = Offset;
+	FillPlayerRequest(Tmp.get(), ClientID, pName, Offset);
 
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
 
+void CScore::FillPlayerRequest(CSqlPlayerRequest *pRequest, int ClientID, const char *pName, int Offset)
+{
+	str_copy(pRequest->m_Name, pName, sizeof(pRequest->m_Name));
+	str_copy(pRequest->m_Map, g_Config.m_SvMap, sizeof(pRequest->m_Map));
+	str_copy(pRequest->m_Server, g_Config.m_SvSqlServerName, sizeof(pRequest->m_Server));
+	str_copy(pRequest->m_RequestingPlayer, Server()->ClientName(ClientID), sizeof(pRequest->m_RequestingPlayer));
+	pRequest->m_Offset = Offset;
+}
+
 bool CScore::RateLimitPlayer(int ClientID)
 {
 	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientID];
@@ -158,6 +85,8 @@ void CScore::GeneratePassphrase(char *pBuf, int BufSize)
 
 CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pPool(pPool),
+	m_RanksLoaded(false),
+	m_RanksLoadTime(0),
 	m_pGameServer(pGameServer),
 	m_pServer(pGameServer->Server())
 {
@@ -197,326 +126,96 @@ CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 		return;
 	}
 
-	m_pPool->Execute(Init, std::move(Tmp), "load best time");
+	m_pPool->Execute(CScoreWorker::Init, std::move(Tmp), "load best time");
+	UpdateRanks();
 }
 
-bool CScore::Init(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::LoadRanks()
 {
-	const CSqlInitData *pData = dynamic_cast<const CSqlInitData *>(pGameData);
-	CScoreInitResult *pResult = dynamic_cast<CScoreInitResult *>(pGameData->m_pResult.get());
-
-	char aBuf[512];
-	// get the best time
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Time FROM %s_race WHERE Map=? ORDER BY `Time` ASC LIMIT 1;",
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		pResult->m_CurrentRecord = pSqlServer->GetFloat(1);
-	}
-
-	return false;
-}
+	m_pRanksResult = std::make_shared<CScoreRanksResult>();
+	auto Tmp = std::unique_ptr<CSqlRanksRequest>(new CSqlRanksRequest(m_pRanksResult));
+	str_copy(Tmp->m_Map, g_Config.m_SvMap, sizeof(Tmp->m_Map));
+	str_copy(Tmp->m_Server, g_Config.m_SvSqlServerName, sizeof(Tmp->m_Server));
+	m_RanksLoadTime = time_get();
 
-void CScore::LoadPlayerData(int ClientID)
-{
-	ExecPlayerThread(LoadPlayerDataThread, "load player data", ClientID, "", 0);
+	m_pPool->Execute(CScoreWorker::LoadRanksThread, std::move(Tmp), "load ranks");
 }
 
-// update stuff
-bool CScore::LoadPlayerDataThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::UpdateRanks()
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	pResult->SetVariant(CScorePlayerResult::PLAYER_INFO);
-
-	char aBuf[512];
-	// get best race time
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Time, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, "
-		"  cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, "
-		"  cp21, cp22, cp23, cp24, cp25 "
-		"FROM %s_race "
-		"WHERE Map = ? AND Name = ? "
-		"ORDER BY Time ASC "
-		"LIMIT 1;",
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_RequestingPlayer);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
+	if(m_pRanksResult != nullptr && m_pRanksResult->m_Completed)
 	{
-		// get the best time
-		float Time = pSqlServer->GetFloat(1);
-		pResult->m_Data.m_Info.m_Time = Time;
-		pResult->m_Data.m_Info.m_Score = -Time;
-		pResult->m_Data.m_Info.m_HasFinishScore = true;
-
-		if(g_Config.m_SvCheckpointSave)
+		if(m_pRanksResult->m_Success)
 		{
-			for(int i = 0; i < NUM_CHECKPOINTS; i++)
+			std::swap(m_GlobalRanks, m_pRanksResult->m_GlobalRanks);
+			std::swap(m_LocalRanks, m_pRanksResult->m_LocalRanks);
+			for(auto &Finish : m_vRanksPendingFinishes)
 			{
-				pResult->m_Data.m_Info.m_CpTime[i] = pSqlServer->GetFloat(i + 2);
+				m_GlobalRanks.Add(Finish.m_aName, Finish.m_Time);
+				m_LocalRanks.Add(Finish.m_aName, Finish.m_Time);
 			}
+			m_RanksLoaded = true;
 		}
+		m_vRanksPendingFinishes.clear();
+		m_pRanksResult = nullptr;
 	}
 
-	// birthday check
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT CURRENT_TIMESTAMP AS Current, MIN(Timestamp) AS Stamp "
-		"FROM %s_race "
-		"WHERE Name = ?",
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	if(g_Config.m_SvRankCacheRefresh == 0)
 	{
-		return true;
+		m_RanksLoaded = false;
+		m_GlobalRanks.Clear();
+		m_LocalRanks.Clear();
+		return;
 	}
-	pSqlServer->BindString(1, pData->m_RequestingPlayer);
 
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End && !pSqlServer->IsNull(2))
-	{
-		char aCurrent[TIMESTAMP_STR_LENGTH];
-		pSqlServer->GetString(1, aCurrent, sizeof(aCurrent));
-		char aStamp[TIMESTAMP_STR_LENGTH];
-		pSqlServer->GetString(2, aStamp, sizeof(aStamp));
-		int CurrentYear, CurrentMonth, CurrentDay;
-		int StampYear, StampMonth, StampDay;
-		if(sscanf(aCurrent, "%d-%d-%d", &CurrentYear, &CurrentMonth, &CurrentDay) == 3 && sscanf(aStamp, "%d-%d-%d", &StampYear, &StampMonth, &StampDay) == 3 && CurrentMonth == StampMonth && CurrentDay == StampDay)
-			pResult->m_Data.m_Info.m_Birthday = CurrentYear - StampYear;
-	}
-	return false;
+	// keeps answering from the old ranks while reloading, other servers
+	// might have added times to the map in the meantime
+	if(m_pRanksResult == nullptr && (m_RanksLoadTime == 0 || time_get() > m_RanksLoadTime + (int64_t)g_Config.m_SvRankCacheRefresh * 60 * time_freq()))
+		LoadRanks();
 }
 
-void CScore::MapVote(int ClientID, const char *MapName)
+void CScore::LoadPlayerData(int ClientID)
 {
-	if(RateLimitPlayer(ClientID))
-		return;
-	ExecPlayerThread(MapVoteThread, "map vote", ClientID, MapName, 0);
+	ExecPlayerThread(CScoreWorker::LoadPlayerDataThread, "load player data", ClientID, "", 0);
 }
 
-bool CScore::MapVoteThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::MapVote(int ClientID, const char *MapName)
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	char aFuzzyMap[128];
-	str_copy(aFuzzyMap, pData->m_Name, sizeof(aFuzzyMap));
-	sqlstr::FuzzyString(aFuzzyMap, sizeof(aFuzzyMap));
-
-	char aMapPrefix[128];
-	str_copy(aMapPrefix, pData->m_Name, sizeof(aMapPrefix));
-	str_append(aMapPrefix, "%", sizeof(aMapPrefix));
-
-	char aBuf[768];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Map, Server "
-		"FROM %s_maps "
-		"WHERE Map LIKE %s "
-		"ORDER BY "
-		"  CASE WHEN Map = ? THEN 0 ELSE 1 END, "
-		"  CASE WHEN Map LIKE ? THEN 0 ELSE 1 END, "
-		"  LENGTH(Map), Map "
-		"LIMIT 1;",
-		pSqlServer->GetPrefix(), pSqlServer->CollateNocase());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, aFuzzyMap);
-	pSqlServer->BindString(2, pData->m_Name);
-	pSqlServer->BindString(3, aMapPrefix);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		pResult->SetVariant(CScorePlayerResult::MAP_VOTE);
-		auto *MapVote = &pResult->m_Data.m_MapVote;
-		pSqlServer->GetString(1, MapVote->m_Map, sizeof(MapVote->m_Map));
-		pSqlServer->GetString(2, MapVote->m_Server, sizeof(MapVote->m_Server));
-		str_copy(MapVote->m_Reason, "/map", sizeof(MapVote->m_Reason));
-
-		for(char *p = MapVote->m_Server; *p; p++) // lower case server
-			*p = tolower(*p);
-	}
-	else
-	{
-		pResult->SetVariant(CScorePlayerResult::DIRECT);
-		str_format(paMessages[0], sizeof(paMessages[0]),
-			"No map like \"%s\" found. "
-			"Try adding a '%%' at the start if you don't know the first character. "
-			"Example: /map %%castle for \"Out of Castle\"",
-			pData->m_Name);
-	}
-	return false;
+	if(RateLimitPlayer(ClientID))
+		return;
+	ExecPlayerThread(CScoreWorker::MapVoteThread, "map vote", ClientID, MapName, 0);
 }
 
 void CScore::MapInfo(int ClientID, const char *MapName)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(MapInfoThread, "map info", ClientID, MapName, 0);
+	ExecPlayerThread(CScoreWorker::MapInfoThread, "map info", ClientID, MapName, 0);
 }
 
-bool CScore::MapInfoThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::SaveScore(int ClientID, float Time, const char *pTimestamp, float CpTime[NUM_CHECKPOINTS], bool NotEligible)
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-
-	char aFuzzyMap[128];
-	str_copy(aFuzzyMap, pData->m_Name, sizeof(aFuzzyMap));
-	sqlstr::FuzzyString(aFuzzyMap, sizeof(aFuzzyMap));
-
-	char aMapPrefix[128];
-	str_copy(aMapPrefix, pData->m_Name, sizeof(aMapPrefix));
-	str_append(aMapPrefix, "%", sizeof(aMapPrefix));
-
-	char aCurrentTimestamp[512];
-	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
-	char aTimestamp[512];
-	pSqlServer->ToUnixTimestamp("l.Timestamp", aTimestamp, sizeof(aTimestamp));
-
-	char aMedianMapTime[2048];
-	char aBuf[4096];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT l.Map, l.Server, Mapper, Points, Stars, "
-		"  (SELECT COUNT(Name) FROM %s_race WHERE Map = l.Map) AS Finishes, "
-		"  (SELECT COUNT(DISTINCT Name) FROM %s_race WHERE Map = l.Map) AS Finishers, "
-		"  (%s) AS Median, "
-		"  %s AS Stamp, "
-		"  %s-%s AS Ago, "
-		"  (SELECT MIN(Time) FROM %s_race WHERE Map = l.Map AND Name = ?) AS OwnTime "
-		"FROM ("
-		"  SELECT * FROM %s_maps "
-		"  WHERE Map LIKE %s "
-		"  ORDER BY "
-		"    CASE WHEN Map = ? THEN 0 ELSE 1 END, "
-		"    CASE WHEN Map LIKE ? THEN 0 ELSE 1 END, "
-		"    LENGTH(Map), "
-		"    Map "
-		"  LIMIT 1"
-		") as l;",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(),
-		pSqlServer->MedianMapTime(aMedianMapTime, sizeof(aMedianMapTime)),
-		aTimestamp, aCurrentTimestamp, aTimestamp,
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(),
-		pSqlServer->CollateNocase());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_RequestingPlayer);
-	pSqlServer->BindString(2, aFuzzyMap);
-	pSqlServer->BindString(3, pData->m_Name);
-	pSqlServer->BindString(4, aMapPrefix);
+	CConsole *pCon = (CConsole *)GameServer()->Console();
+	if(pCon->m_Cheated || NotEligible)
+		return;
 
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
+	UpdateRanks();
+	if(m_RanksLoaded || m_pRanksResult != nullptr)
 	{
-		char aMap[MAX_MAP_LENGTH];
-		pSqlServer->GetString(1, aMap, sizeof(aMap));
-		char aServer[32];
-		pSqlServer->GetString(2, aServer, sizeof(aServer));
-		char aMapper[128];
-		pSqlServer->GetString(3, aMapper, sizeof(aMapper));
-		int Points = pSqlServer->GetInt(4);
-		int Stars = pSqlServer->GetInt(5);
-		int Finishes = pSqlServer->GetInt(6);
-		int Finishers = pSqlServer->GetInt(7);
-		float Median = !pSqlServer->IsNull(8) ? pSqlServer->GetInt(8) : -1.0f;
-		int Stamp = pSqlServer->GetInt(9);
-		int Ago = pSqlServer->GetInt(10);
-		float OwnTime = !pSqlServer->IsNull(11) ? pSqlServer->GetFloat(11) : -1.0f;
-
-		char aAgoString[40] = "\0";
-		char aReleasedString[60] = "\0";
-		if(Stamp != 0)
-		{
-			sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
-			str_format(aReleasedString, sizeof(aReleasedString), ", released %s ago", aAgoString);
-		}
-
-		char aMedianString[60] = "\0";
-		if(Median > 0)
+		// the time as it ends up in the database
+		char aTime[32];
+		str_format(aTime, sizeof(aTime), "%.2f", Time);
+		CRankIndex::CEntry Finish;
+		Finish.m_Time = str_tofloat(aTime);
+		str_copy(Finish.m_aName, Server()->ClientName(ClientID), sizeof(Finish.m_aName));
+		if(m_RanksLoaded)
 		{
-			str_time((int64_t)Median * 100, TIME_HOURS, aBuf, sizeof(aBuf));
-			str_format(aMedianString, sizeof(aMedianString), " in %s median", aBuf);
+			m_GlobalRanks.Add(Finish.m_aName, Finish.m_Time);
+			m_LocalRanks.Add(Finish.m_aName, Finish.m_Time);
 		}
-
-		char aStars[20];
-		switch(Stars)
-		{
-		case 0: str_copy(aStars, "✰✰✰✰✰", sizeof(aStars)); break;
-		case 1: str_copy(aStars, "★✰✰✰✰", sizeof(aStars)); break;
-		case 2: str_copy(aStars, "★★✰✰✰", sizeof(aStars)); break;
-		case 3: str_copy(aStars, "★★★✰✰", sizeof(aStars)); break;
-		case 4: str_copy(aStars, "★★★★✰", sizeof(aStars)); break;
-		case 5: str_copy(aStars, "★★★★★", sizeof(aStars)); break;
-		default: aStars[0] = '\0';
-		}
-
-		char aOwnFinishesString[40] = "\0";
-		if(OwnTime > 0)
-		{
-			str_time_float(OwnTime, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-			str_format(aOwnFinishesString, sizeof(aOwnFinishesString),
-				", your time: %s", aBuf);
-		}
-
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"\"%s\" by %s on %s, %s, %d %s%s, %d %s by %d %s%s%s",
-			aMap, aMapper, aServer, aStars,
-			Points, Points == 1 ? "point" : "points",
-			aReleasedString,
-			Finishes, Finishes == 1 ? "finish" : "finishes",
-			Finishers, Finishers == 1 ? "tee" : "tees",
-			aMedianString, aOwnFinishesString);
+		if(m_pRanksResult != nullptr)
+			m_vRanksPendingFinishes.push_back(Finish);
 	}
-	else
-	{
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"No map like \"%s\" found.", pData->m_Name);
-	}
-	return false;
-}
-
-void CScore::SaveScore(int ClientID, float Time, const char *pTimestamp, float CpTime[NUM_CHECKPOINTS], bool NotEligible)
-{
-	CConsole *pCon = (CConsole *)GameServer()->Console();
-	if(pCon->m_Cheated || NotEligible)
-		return;
 
 	CPlayer *pCurPlayer = GameServer()->m_apPlayers[ClientID];
 	if(pCurPlayer->m_ScoreFinishResult != nullptr)
@@ -532,99 +231,7 @@ void CScore::SaveScore(int ClientID, float Time, const char *pTimestamp, float C
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCpCurrent[i] = CpTime[i];
 
-	m_pPool->ExecuteWrite(SaveScoreThread, std::move(Tmp), "save score");
-}
-
-bool CScore::SaveScoreThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize)
-{
-	const CSqlScoreData *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	char aBuf[1024];
-
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT COUNT(*) AS NumFinished FROM %s_race WHERE Map=? AND Name=? ORDER BY time ASC LIMIT 1;",
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_Name);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	int NumFinished = pSqlServer->GetInt(1);
-	if(NumFinished == 0)
-	{
-		str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map=?", pSqlServer->GetPrefix());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_Map);
-
-		bool End;
-		if(pSqlServer->Step(&End, pError, ErrorSize))
-		{
-			return true;
-		}
-		if(!End)
-		{
-			int Points = pSqlServer->GetInt(1);
-			if(pSqlServer->AddPoints(pData->m_Name, Points, pError, ErrorSize))
-			{
-				return true;
-			}
-			str_format(paMessages[0], sizeof(paMessages[0]),
-				"You earned %d point%s for finishing this map!",
-				Points, Points == 1 ? "" : "s");
-		}
-	}
-
-	// save score. Can't fail, because no UNIQUE/PRIMARY KEY constrain is defined.
-	str_format(aBuf, sizeof(aBuf),
-		"%s INTO %s_race("
-		"	Map, Name, Timestamp, Time, Server, "
-		"	cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, "
-		"	cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, "
-		"	GameID, DDNet7) "
-		"VALUES (?, ?, %s, %.2f, ?, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	?, false);",
-		pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
-		pSqlServer->InsertTimestampAsUtc(), pData->m_Time,
-		pData->m_aCpCurrent[0], pData->m_aCpCurrent[1], pData->m_aCpCurrent[2],
-		pData->m_aCpCurrent[3], pData->m_aCpCurrent[4], pData->m_aCpCurrent[5],
-		pData->m_aCpCurrent[6], pData->m_aCpCurrent[7], pData->m_aCpCurrent[8],
-		pData->m_aCpCurrent[9], pData->m_aCpCurrent[10], pData->m_aCpCurrent[11],
-		pData->m_aCpCurrent[12], pData->m_aCpCurrent[13], pData->m_aCpCurrent[14],
-		pData->m_aCpCurrent[15], pData->m_aCpCurrent[16], pData->m_aCpCurrent[17],
-		pData->m_aCpCurrent[18], pData->m_aCpCurrent[19], pData->m_aCpCurrent[20],
-		pData->m_aCpCurrent[21], pData->m_aCpCurrent[22], pData->m_aCpCurrent[23],
-		pData->m_aCpCurrent[24]);
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_Name);
-	pSqlServer->BindString(3, pData->m_aTimestamp);
-	pSqlServer->BindString(4, g_Config.m_SvSqlServerName);
-	pSqlServer->BindString(5, pData->m_GameUuid);
-	pSqlServer->Print();
-	int NumInserted;
-	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
-	{
-		return true;
-	}
-	return false;
+	m_pPool->ExecuteWriteBatch(CScoreWorker::SaveScoreThread, std::move(Tmp), "save score");
 }
 
 void CScore::SaveTeamScore(int *aClientIDs, unsigned int Size, float Time, const char *pTimestamp)
@@ -646,858 +253,155 @@ void CScore::SaveTeamScore(int *aClientIDs, unsigned int Size, float Time, const
 	FormatUuid(GameServer()->GameUuid(), Tmp->m_GameUuid, sizeof(Tmp->m_GameUuid));
 	str_copy(Tmp->m_Map, g_Config.m_SvMap, sizeof(Tmp->m_Map));
 
-	m_pPool->ExecuteWrite(SaveTeamScoreThread, std::move(Tmp), "save team score");
-}
-
-bool CScore::SaveTeamScoreThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize)
-{
-	const CSqlTeamScoreData *pData = dynamic_cast<const CSqlTeamScoreData *>(pGameData);
-
-	char aBuf[512];
-
-	// get the names sorted in a tab separated string
-	std::vector<std::string> aNames;
-	for(unsigned int i = 0; i < pData->m_Size; i++)
-		aNames.push_back(pData->m_aNames[i]);
-
-	std::sort(aNames.begin(), aNames.end());
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT l.ID, Name, Time "
-		"FROM (" // preselect teams with first name in team
-		"  SELECT ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? AND Name = ? AND DDNet7 = false"
-		") as l INNER JOIN %s_teamrace AS r ON l.ID = r.ID "
-		"ORDER BY l.ID, Name COLLATE %s;",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->BinaryCollate());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_aNames[0]);
-
-	bool FoundTeam = false;
-	float Time;
-	CTeamrank Teamrank;
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		bool SearchTeamEnd = false;
-		while(!SearchTeamEnd)
-		{
-			Time = pSqlServer->GetFloat(3);
-			if(Teamrank.NextSqlResult(pSqlServer, &SearchTeamEnd, pError, ErrorSize))
-			{
-				return true;
-			}
-			if(Teamrank.SamePlayers(&aNames))
-			{
-				FoundTeam = true;
-				break;
-			}
-		}
-	}
-	if(FoundTeam)
-	{
-		dbg_msg("sql", "found team rank from same team (old time: %f, new time: %f)", Time, pData->m_Time);
-		if(pData->m_Time < Time)
-		{
-			str_format(aBuf, sizeof(aBuf),
-				"UPDATE %s_teamrace SET Time=%.2f, Timestamp=?, DDNet7=false, GameID=? WHERE ID = ?;",
-				pSqlServer->GetPrefix(), pData->m_Time);
-			if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-			{
-				return true;
-			}
-			pSqlServer->BindString(1, pData->m_aTimestamp);
-			pSqlServer->BindString(2, pData->m_GameUuid);
-			pSqlServer->BindBlob(3, Teamrank.m_TeamID.m_aData, sizeof(Teamrank.m_TeamID.m_aData));
-			pSqlServer->Print();
-			int NumUpdated;
-			if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
-			{
-				return true;
-			}
-		}
-	}
-	else
-	{
-		CUuid GameID = RandomUuid();
-		for(unsigned int i = 0; i < pData->m_Size; i++)
-		{
-			// if no entry found... create a new one
-			str_format(aBuf, sizeof(aBuf),
-				"%s INTO %s_teamrace(Map, Name, Timestamp, Time, ID, GameID, DDNet7) "
-				"VALUES (?, ?, %s, %.2f, ?, ?, false);",
-				pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
-				pSqlServer->InsertTimestampAsUtc(), pData->m_Time);
-			if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-			{
-				return true;
-			}
-			pSqlServer->BindString(1, pData->m_Map);
-			pSqlServer->BindString(2, pData->m_aNames[i]);
-			pSqlServer->BindString(3, pData->m_aTimestamp);
-			pSqlServer->BindBlob(4, GameID.m_aData, sizeof(GameID.m_aData));
-			pSqlServer->BindString(5, pData->m_GameUuid);
-			pSqlServer->Print();
-			int NumInserted;
-			if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
-			{
-				return true;
-			}
-		}
-	}
-	return false;
+	m_pPool->ExecuteWriteBatch(CScoreWorker::SaveTeamScoreThread, std::move(Tmp), "save team score");
 }
 
 void CScore::ShowRank(int ClientID, const char *pName)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowRankThread, "show rank", ClientID, pName, 0);
-}
-
-bool CScore::ShowRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-
-	char aServerLike[16];
-	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_Server);
-
-	// check sort method
-	char aBuf[600];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Rank, Time, PercentRank "
-		"FROM ("
-		"  SELECT RANK() OVER w AS Rank, PERCENT_RANK() OVER w as PercentRank, Name, MIN(Time) AS Time "
-		"  FROM %s_race "
-		"  WHERE Map = ? "
-		"  AND Server LIKE ?"
-		"  GROUP BY Name "
-		"  WINDOW w AS (ORDER BY Time)"
-		") as a "
-		"WHERE Name = ?;",
-		pSqlServer->GetPrefix());
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, aServerLike);
-	pSqlServer->BindString(3, pData->m_Name);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-
-	char aRegionalRank[16];
-	if(End)
-	{
-		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
-	}
-	else
-	{
-		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
-	}
-
-	const char *pAny = "%";
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pAny);
-	pSqlServer->BindString(3, pData->m_Name);
-
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-
-	if(!End)
-	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0 - 100.0 * pSqlServer->GetFloat(3));
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		if(g_Config.m_SvHideScore)
-		{
-			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
-		}
-		else
-		{
-			pResult->m_MessageKind = CScorePlayerResult::ALL;
-
-			if(str_comp_nocase(pData->m_RequestingPlayer, pData->m_Name) == 0)
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%%",
-					pData->m_Name, aBuf, BetterThanPercent);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%% - requested by %s",
-					pData->m_Name, aBuf, BetterThanPercent, pData->m_RequestingPlayer);
-			}
-
-			str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-				"Global rank %d - %s %s",
-				Rank, pData->m_Server, aRegionalRank);
-		}
-	}
-	else
+	UpdateRanks();
+	if(!m_RanksLoaded)
 	{
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"%s is not ranked", pData->m_Name);
-	}
-	return false;
-}
-
-void CScore::ShowTeamRank(int ClientID, const char *pName)
-{
-	if(RateLimitPlayer(ClientID))
+		ExecPlayerThread(CScoreWorker::ShowRankThread, "show rank", ClientID, pName, 0);
 		return;
-	ExecPlayerThread(ShowTeamRankThread, "show team rank", ClientID, pName, 0);
-}
-
-bool CScore::ShowTeamRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-
-	// check sort method
-	char aBuf[2400];
-
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT l.ID, Name, Time, Rank, PercentRank "
-		"FROM (" // teamrank score board
-		"  SELECT RANK() OVER w AS Rank, PERCENT_RANK() OVER w AS PercentRank, ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? "
-		"  GROUP BY ID "
-		"  WINDOW w AS (ORDER BY Time)"
-		") AS TeamRank INNER JOIN (" // select rank with Name in team
-		"  SELECT ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? AND Name = ? "
-		"  ORDER BY Time "
-		"  LIMIT 1"
-		") AS l ON TeamRank.ID = l.ID "
-		"INNER JOIN %s_teamrace AS r ON l.ID = r.ID ",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
 	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_Map);
-	pSqlServer->BindString(3, pData->m_Name);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		float Time = pSqlServer->GetFloat(3);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		int Rank = pSqlServer->GetInt(4);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0 - 100.0 * pSqlServer->GetFloat(5));
-		CTeamrank Teamrank;
-		if(Teamrank.NextSqlResult(pSqlServer, &End, pError, ErrorSize))
-		{
-			return true;
-		}
-
-		char aFormattedNames[512] = "";
-		for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
-		{
-			str_append(aFormattedNames, Teamrank.m_aaNames[Name], sizeof(aFormattedNames));
 
-			if(Name < Teamrank.m_NumNames - 2)
-				str_append(aFormattedNames, ", ", sizeof(aFormattedNames));
-			else if(Name < Teamrank.m_NumNames - 1)
-				str_append(aFormattedNames, " & ", sizeof(aFormattedNames));
-		}
-
-		if(g_Config.m_SvHideScore)
-		{
-			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"Your team time: %s, better than %d%%", aBuf, BetterThanPercent);
-		}
-		else
-		{
-			pResult->m_MessageKind = CScorePlayerResult::ALL;
-			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"%d. %s Team time: %s, better than %d%%, requested by %s",
-				Rank, aFormattedNames, aBuf, BetterThanPercent, pData->m_RequestingPlayer);
-		}
-	}
-	else
-	{
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"%s has no team ranks", pData->m_Name);
-	}
-	return false;
-}
-
-void CScore::ShowTop(int ClientID, int Offset)
-{
-	if(RateLimitPlayer(ClientID))
-		return;
-	ExecPlayerThread(ShowTopThread, "show top5", ClientID, "", Offset);
-}
-
-bool CScore::ShowTopThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-
-	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
-	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
-	const char *pAny = "%";
-
-	// check sort method
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Name, Time, Rank, Server "
-		"FROM ("
-		"  SELECT RANK() OVER w AS Rank, Name, MIN(Time) AS Time, Server "
-		"  FROM %s_race "
-		"  WHERE Map = ? "
-		"  AND Server LIKE ? "
-		"  GROUP BY Name "
-		"  WINDOW w AS (ORDER BY Time)"
-		") as a "
-		"ORDER BY Rank %s "
-		"LIMIT %d, ?;",
-		pSqlServer->GetPrefix(),
-		pOrder,
-		LimitStart);
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pAny);
-	pSqlServer->BindInt(3, 5);
-
-	// show top
-	int Line = 0;
-	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
-	Line++;
-
-	char aTime[32];
-	bool End = false;
-	bool HasLocal = false;
-
-	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
-	{
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(1, aName, sizeof(aName));
-		float Time = pSqlServer->GetFloat(2);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-		int Rank = pSqlServer->GetInt(3);
-		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"%d. %s Time: %s", Rank, aName, aTime);
-
-		char aRecordServer[6];
-		pSqlServer->GetString(4, aRecordServer, sizeof(aRecordServer));
-
-		HasLocal = HasLocal || str_comp(aRecordServer, pData->m_Server) == 0;
-
-		Line++;
-	}
-
-	if(!HasLocal)
-	{
-		char aServerLike[16];
-		str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_Server);
-
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_Map);
-		pSqlServer->BindString(2, aServerLike);
-		pSqlServer->BindInt(3, 3);
-
-		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"------------ %s Top ------------", pData->m_Server);
-		Line++;
-
-		// show top
-		while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
-		{
-			char aName[MAX_NAME_LENGTH];
-			pSqlServer->GetString(1, aName, sizeof(aName));
-			float Time = pSqlServer->GetFloat(2);
-			str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-			int Rank = pSqlServer->GetInt(3);
-			str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-				"%d. %s Time: %s", Rank, aName, aTime);
-			Line++;
-		}
-	}
-	else
-	{
-		str_copy(pResult->m_Data.m_aaMessages[Line], "---------------------------------------",
-			sizeof(pResult->m_Data.m_aaMessages[Line]));
-	}
-
-	if(!End)
-	{
-		return true;
-	}
-
-	return false;
-}
-
-void CScore::ShowTeamTop5(int ClientID, int Offset)
-{
-	if(RateLimitPlayer(ClientID))
-		return;
-	ExecPlayerThread(ShowTeamTop5Thread, "show team top5", ClientID, "", Offset);
-}
-
-bool CScore::ShowTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
-	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
-
-	// check sort method
-	char aBuf[512];
-
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Name, Time, Rank, TeamSize "
-		"FROM (" // limit to 5
-		"  SELECT TeamSize, Rank, ID "
-		"  FROM (" // teamrank score board
-		"    SELECT RANK() OVER w AS Rank, ID, COUNT(*) AS Teamsize "
-		"    FROM %s_teamrace "
-		"    WHERE Map = ? "
-		"    GROUP BY Id "
-		"    WINDOW w AS (ORDER BY Time)"
-		"  ) as l1 "
-		"  ORDER BY Rank %s "
-		"  LIMIT %d, 5"
-		") as l2 "
-		"INNER JOIN %s_teamrace as r ON l2.ID = r.ID "
-		"ORDER BY Rank %s, r.ID, Name ASC;",
-		pSqlServer->GetPrefix(), pOrder, LimitStart, pSqlServer->GetPrefix(), pOrder);
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-
-	// show teamtop5
-	int Line = 0;
-	str_copy(paMessages[Line++], "------- Team Top 5 -------", sizeof(paMessages[Line]));
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		for(Line = 1; Line < 6; Line++) // print
-		{
-			bool Last = false;
-			float Time = pSqlServer->GetFloat(2);
-			str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-			int Rank = pSqlServer->GetInt(3);
-			int TeamSize = pSqlServer->GetInt(4);
-
-			char aNames[2300] = {0};
-			for(int i = 0; i < TeamSize; i++)
-			{
-				char aName[MAX_NAME_LENGTH];
-				pSqlServer->GetString(1, aName, sizeof(aName));
-				str_append(aNames, aName, sizeof(aNames));
-				if(i < TeamSize - 2)
-					str_append(aNames, ", ", sizeof(aNames));
-				else if(i == TeamSize - 2)
-					str_append(aNames, " & ", sizeof(aNames));
-				if(pSqlServer->Step(&Last, pError, ErrorSize))
-				{
-					return true;
-				}
-				if(Last)
-				{
-					break;
-				}
-			}
-			str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
-				Rank, aNames, aBuf);
-			if(Last)
-			{
-				Line++;
-				break;
-			}
-		}
-	}
+	auto pResult = NewSqlPlayerResult(ClientID);
+	if(pResult == nullptr)
+		return;
+	CSqlPlayerRequest Request(pResult);
+	FillPlayerRequest(&Request, ClientID, pName, 0);
 
-	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
-	return false;
+	int Rank;
+	float Time;
+	float PercentRank;
+	char aRegionalRank[16];
+	if(m_LocalRanks.Find(pName, &Rank, &Time, &PercentRank))
+		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", Rank);
+	else
+		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+
+	if(m_GlobalRanks.Find(pName, &Rank, &Time, &PercentRank))
+		CScoreWorker::FormatRank(pResult.get(), &Request, Rank, Time, PercentRank, aRegionalRank);
+	else
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pName);
+	pResult->m_Success = true;
+	pResult->m_Completed = true;
 }
 
-void CScore::ShowTeamTop5(int ClientID, const char *pName, int Offset)
+void CScore::ShowTeamRank(int ClientID, const char *pName)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowPlayerTeamTop5Thread, "show team top5 player", ClientID, pName, Offset);
+	ExecPlayerThread(CScoreWorker::ShowTeamRankThread, "show team rank", ClientID, pName, 0);
 }
 
-bool CScore::ShowPlayerTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::ShowTop(int ClientID, int Offset)
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
+	if(RateLimitPlayer(ClientID))
+		return;
+	UpdateRanks();
+	if(!m_RanksLoaded)
+	{
+		ExecPlayerThread(CScoreWorker::ShowTopThread, "show top5", ClientID, "", Offset);
+		return;
+	}
 
-	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
-	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
+	auto pResult = NewSqlPlayerResult(ClientID);
+	if(pResult == nullptr)
+		return;
+	auto *paMessages = pResult->m_Data.m_aaMessages;
 
-	// check sort method
-	char aBuf[2400];
+	int LimitStart = maximum(abs(Offset) - 1, 0);
+	char aTime[32];
+	int Line = 0;
+	str_copy(paMessages[Line], "------------ Global Top ------------", sizeof(paMessages[Line]));
+	Line++;
 
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT l.ID, Name, Time, Rank "
-		"FROM (" // teamrank score board
-		"  SELECT RANK() OVER w AS Rank, ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? "
-		"  GROUP BY ID "
-		"  WINDOW w AS (ORDER BY Time)"
-		") AS TeamRank INNER JOIN (" // select rank with Name in team
-		"  SELECT ID "
-		"  FROM %s_teamrace "
-		"  WHERE Map = ? AND Name = ? "
-		"  ORDER BY Time %s "
-		"  LIMIT %d, 5 "
-		") AS l ON TeamRank.ID = l.ID "
-		"INNER JOIN %s_teamrace AS r ON l.ID = r.ID "
-		"ORDER BY Time %s, l.ID ",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pOrder, LimitStart, pSqlServer->GetPrefix(), pOrder);
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	bool HasLocal = false;
+	for(int i = 0; i < 5 && LimitStart + i < m_GlobalRanks.Num(); i++)
 	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, pData->m_Map);
-	pSqlServer->BindString(3, pData->m_Name);
+		int Pos = Offset >= 0 ? LimitStart + i : m_GlobalRanks.Num() - 1 - LimitStart - i;
+		const CRankIndex::CEntry &Entry = m_GlobalRanks.Get(Pos);
+		str_time_float(Entry.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Time: %s", m_GlobalRanks.RankAt(Pos), Entry.m_aName, aTime);
 
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
+		// the record was set on this server if the local time is as good
+		int LocalRank;
+		float LocalTime;
+		float LocalPercentRank;
+		HasLocal = HasLocal || (m_LocalRanks.Find(Entry.m_aName, &LocalRank, &LocalTime, &LocalPercentRank) && LocalTime == Entry.m_Time);
+
+		Line++;
 	}
-	if(!End)
+
+	if(!HasLocal)
 	{
-		// show teamtop5
-		int Line = 0;
-		str_copy(paMessages[Line++], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"------------ %s Top ------------", g_Config.m_SvSqlServerName);
+		Line++;
 
-		for(Line = 1; Line < 6; Line++) // print
+		for(int i = 0; i < 3 && LimitStart + i < m_LocalRanks.Num(); i++)
 		{
-			float Time = pSqlServer->GetFloat(3);
-			str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-			int Rank = pSqlServer->GetInt(4);
-			CTeamrank Teamrank;
-			bool Last;
-			if(Teamrank.NextSqlResult(pSqlServer, &Last, pError, ErrorSize))
-			{
-				return true;
-			}
-
-			char aFormattedNames[512] = "";
-			for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
-			{
-				str_append(aFormattedNames, Teamrank.m_aaNames[Name], sizeof(aFormattedNames));
-
-				if(Name < Teamrank.m_NumNames - 2)
-					str_append(aFormattedNames, ", ", sizeof(aFormattedNames));
-				else if(Name < Teamrank.m_NumNames - 1)
-					str_append(aFormattedNames, " & ", sizeof(aFormattedNames));
-			}
-
-			str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
-				Rank, aFormattedNames, aBuf);
-			if(Last)
-			{
-				Line++;
-				break;
-			}
+			int Pos = Offset >= 0 ? LimitStart + i : m_LocalRanks.Num() - 1 - LimitStart - i;
+			const CRankIndex::CEntry &Entry = m_LocalRanks.Get(Pos);
+			str_time_float(Entry.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+			str_format(paMessages[Line], sizeof(paMessages[Line]),
+				"%d. %s Time: %s", m_LocalRanks.RankAt(Pos), Entry.m_aName, aTime);
+			Line++;
 		}
-		str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
 	}
 	else
 	{
-		if(pData->m_Offset == 0)
-			str_format(paMessages[0], sizeof(paMessages[0]), "%s has no team ranks", pData->m_Name);
-		else
-			str_format(paMessages[0], sizeof(paMessages[0]), "%s has no team ranks in the specified range", pData->m_Name);
+		str_copy(paMessages[Line], "---------------------------------------", sizeof(paMessages[Line]));
 	}
-	return false;
+	pResult->m_Success = true;
+	pResult->m_Completed = true;
 }
 
-void CScore::ShowTimes(int ClientID, int Offset)
+void CScore::ShowTeamTop5(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowTimesThread, "show times", ClientID, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTeamTop5Thread, "show team top5", ClientID, "", Offset);
 }
 
-void CScore::ShowTimes(int ClientID, const char *pName, int Offset)
+void CScore::ShowTeamTop5(int ClientID, const char *pName, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowTimesThread, "show times", ClientID, pName, Offset);
+	ExecPlayerThread(CScoreWorker::ShowPlayerTeamTop5Thread, "show team top5 player", ClientID, pName, Offset);
 }
 
-bool CScore::ShowTimesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::ShowTimes(int ClientID, int Offset)
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
-	const char *pOrder = pData->m_Offset >= 0 ? "DESC" : "ASC";
-
-	char aCurrentTimestamp[512];
-	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
-	char aTimestamp[512];
-	pSqlServer->ToUnixTimestamp("Timestamp", aTimestamp, sizeof(aTimestamp));
-	char aBuf[512];
-	if(pData->m_Name[0] != '\0') // last 5 times of a player
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Time, (%s-%s) as Ago, %s as Stamp, Server "
-			"FROM %s_race "
-			"WHERE Map = ? AND Name = ? "
-			"ORDER BY Timestamp %s "
-			"LIMIT ?, 5;",
-			aCurrentTimestamp, aTimestamp, aTimestamp,
-			pSqlServer->GetPrefix(), pOrder);
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_Map);
-		pSqlServer->BindString(2, pData->m_Name);
-		pSqlServer->BindInt(3, LimitStart);
-	}
-	else // last 5 times of server
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Time, (%s-%s) as Ago, %s as Stamp, Server, Name "
-			"FROM %s_race "
-			"WHERE Map = ? "
-			"ORDER BY Timestamp %s "
-			"LIMIT ?, 5;",
-			aCurrentTimestamp, aTimestamp, aTimestamp,
-			pSqlServer->GetPrefix(), pOrder);
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_Map);
-		pSqlServer->BindInt(2, LimitStart);
-	}
-
-	// show top5
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(End)
-	{
-		str_copy(paMessages[0], "There are no times in the specified range", sizeof(paMessages[0]));
-		return false;
-	}
-
-	str_copy(paMessages[0], "------------- Last Times -------------", sizeof(paMessages[0]));
-	int Line = 1;
-
-	do
-	{
-		float Time = pSqlServer->GetFloat(1);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		int Ago = pSqlServer->GetInt(2);
-		int Stamp = pSqlServer->GetInt(3);
-		char aServer[5];
-		pSqlServer->GetString(4, aServer, sizeof(aServer));
-		char aServerFormatted[8] = "\0";
-		if(str_comp(aServer, "UNK") != 0)
-			str_format(aServerFormatted, sizeof(aServerFormatted), "[%s] ", aServer);
-
-		char aAgoString[40] = "\0";
-		sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
-
-		if(pData->m_Name[0] != '\0') // last 5 times of a player
-		{
-			if(Stamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
-				str_format(paMessages[Line], sizeof(paMessages[Line]),
-					"%s%s, don't know how long ago", aServerFormatted, aBuf);
-			else
-				str_format(paMessages[Line], sizeof(paMessages[Line]),
-					"%s%s ago, %s", aServerFormatted, aAgoString, aBuf);
-		}
-		else // last 5 times of the server
-		{
-			char aName[MAX_NAME_LENGTH];
-			pSqlServer->GetString(5, aName, sizeof(aName));
-			if(Stamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
-			{
-				str_format(paMessages[Line], sizeof(paMessages[Line]),
-					"%s%s, %s, don't know when", aServerFormatted, aName, aBuf);
-			}
-			else
-			{
-				str_format(paMessages[Line], sizeof(paMessages[Line]),
-					"%s%s, %s ago, %s", aServerFormatted, aName, aAgoString, aBuf);
-			}
-		}
-		Line++;
-	} while(!pSqlServer->Step(&End, pError, ErrorSize) && !End);
-	if(!End)
-	{
-		return true;
-	}
-	str_copy(paMessages[Line], "----------------------------------------------------", sizeof(paMessages[Line]));
-
-	return false;
+	if(RateLimitPlayer(ClientID))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowTimesThread, "show times", ClientID, "", Offset);
 }
 
-void CScore::ShowPoints(int ClientID, const char *pName)
+void CScore::ShowTimes(int ClientID, const char *pName, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowPointsThread, "show points", ClientID, pName, 0);
+	ExecPlayerThread(CScoreWorker::ShowTimesThread, "show times", ClientID, pName, Offset);
 }
 
-bool CScore::ShowPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+void CScore::ShowPoints(int ClientID, const char *pName)
 {
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT ("
-		"  SELECT COUNT(Name) + 1 FROM %s_points WHERE Points > ("
-		"    SELECT points FROM %s_points WHERE Name = ?"
-		")) as Rank, Points, Name "
-		"FROM %s_points WHERE Name = ?;",
-		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Name);
-	pSqlServer->BindString(2, pData->m_Name);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		int Rank = pSqlServer->GetInt(1);
-		int Count = pSqlServer->GetInt(2);
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(3, aName, sizeof(aName));
-		pResult->m_MessageKind = CScorePlayerResult::ALL;
-		str_format(paMessages[0], sizeof(paMessages[0]),
-			"%d. %s Points: %d, requested by %s",
-			Rank, aName, Count, pData->m_RequestingPlayer);
-	}
-	else
-	{
-		str_format(paMessages[0], sizeof(paMessages[0]),
-			"%s has not collected any points so far", pData->m_Name);
-	}
-	return false;
+	if(RateLimitPlayer(ClientID))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowPointsThread, "show points", ClientID, pName, 0);
 }
 
 void CScore::ShowTopPoints(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(ShowTopPointsThread, "show top points", ClientID, "", Offset);
-}
-
-bool CScore::ShowTopPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	int LimitStart = maximum(pData->m_Offset - 1, 0);
-
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT RANK() OVER (ORDER BY a.Points DESC) as Rank, Points, Name "
-		"FROM ("
-		"  SELECT Points, Name "
-		"  FROM %s_points "
-		"  ORDER BY Points DESC LIMIT ?"
-		") as a "
-		"LIMIT ?, 5;",
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindInt(1, LimitStart + 5);
-	pSqlServer->BindInt(2, LimitStart);
-
-	// show top points
-	str_copy(paMessages[0], "-------- Top Points --------", sizeof(paMessages[0]));
-
-	bool End = false;
-	int Line = 1;
-	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
-	{
-		int Rank = pSqlServer->GetInt(1);
-		int Points = pSqlServer->GetInt(2);
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(3, aName, sizeof(aName));
-		str_format(paMessages[Line], sizeof(paMessages[Line]),
-			"%d. %s Points: %d", Rank, aName, Points);
-		Line++;
-	}
-	if(!End)
-	{
-		return true;
-	}
-	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
-
-	return false;
+	ExecPlayerThread(CScoreWorker::ShowTopPointsThread, "show top points", ClientID, "", Offset);
 }
 
 void CScore::RandomMap(int ClientID, int Stars)
@@ -1511,57 +415,7 @@ void CScore::RandomMap(int ClientID, int Stars)
 	str_copy(Tmp->m_ServerType, g_Config.m_SvServerType, sizeof(Tmp->m_ServerType));
 	str_copy(Tmp->m_RequestingPlayer, GameServer()->Server()->ClientName(ClientID), sizeof(Tmp->m_RequestingPlayer));
 
-	m_pPool->Execute(RandomMapThread, std::move(Tmp), "random map");
-}
-
-bool CScore::RandomMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlRandomMapRequest *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
-	CScoreRandomMapResult *pResult = dynamic_cast<CScoreRandomMapResult *>(pGameData->m_pResult.get());
-
-	char aBuf[512];
-	if(0 <= pData->m_Stars && pData->m_Stars <= 5)
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Map FROM %s_maps "
-			"WHERE Server = ? AND Map != ? AND Stars = ? "
-			"ORDER BY %s LIMIT 1;",
-			pSqlServer->GetPrefix(), pSqlServer->Random());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindInt(3, pData->m_Stars);
-	}
-	else
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Map FROM %s_maps "
-			"WHERE Server = ? AND Map != ? "
-			"ORDER BY %s LIMIT 1;",
-			pSqlServer->GetPrefix(), pSqlServer->Random());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-	}
-	pSqlServer->BindString(1, pData->m_ServerType);
-	pSqlServer->BindString(2, pData->m_CurrentMap);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		pSqlServer->GetString(1, pResult->m_Map, sizeof(pResult->m_Map));
-	}
-	else
-	{
-		str_copy(pResult->m_aMessage, "No maps found on this server!", sizeof(pResult->m_aMessage));
-	}
-	return false;
+	m_pPool->Execute(CScoreWorker::RandomMapThread, std::move(Tmp), "random map");
 }
 
 void CScore::RandomUnfinishedMap(int ClientID, int Stars)
@@ -1575,71 +429,7 @@ void CScore::RandomUnfinishedMap(int ClientID, int Stars)
 	str_copy(Tmp->m_ServerType, g_Config.m_SvServerType, sizeof(Tmp->m_ServerType));
 	str_copy(Tmp->m_RequestingPlayer, GameServer()->Server()->ClientName(ClientID), sizeof(Tmp->m_RequestingPlayer));
 
-	m_pPool->Execute(RandomUnfinishedMapThread, std::move(Tmp), "random unfinished map");
-}
-
-bool CScore::RandomUnfinishedMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlRandomMapRequest *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
-	CScoreRandomMapResult *pResult = dynamic_cast<CScoreRandomMapResult *>(pGameData->m_pResult.get());
-
-	char aBuf[512];
-	if(pData->m_Stars >= 0)
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Map "
-			"FROM %s_maps "
-			"WHERE Server = ? AND Map != ? AND Stars = ? AND Map NOT IN ("
-			"  SELECT Map "
-			"  FROM %s_race "
-			"  WHERE Name = ?"
-			") ORDER BY %s "
-			"LIMIT 1;",
-			pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->Random());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_ServerType);
-		pSqlServer->BindString(2, pData->m_CurrentMap);
-		pSqlServer->BindInt(3, pData->m_Stars);
-		pSqlServer->BindString(4, pData->m_RequestingPlayer);
-	}
-	else
-	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT Map "
-			"FROM %s_maps AS maps "
-			"WHERE Server = ? AND Map != ? AND Map NOT IN ("
-			"  SELECT Map "
-			"  FROM %s_race as race "
-			"  WHERE Name = ?"
-			") ORDER BY %s "
-			"LIMIT 1;",
-			pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->Random());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_ServerType);
-		pSqlServer->BindString(2, pData->m_CurrentMap);
-		pSqlServer->BindString(3, pData->m_RequestingPlayer);
-	}
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		pSqlServer->GetString(1, pResult->m_Map, sizeof(pResult->m_Map));
-	}
-	else
-	{
-		str_copy(pResult->m_aMessage, "You have no more unfinished maps on this server!", sizeof(pResult->m_aMessage));
-	}
-	return false;
+	m_pPool->Execute(CScoreWorker::RandomUnfinishedMapThread, std::move(Tmp), "random unfinished map");
 }
 
 void CScore::SaveTeam(int ClientID, const char *Code, const char *Server)
@@ -1936,63 +726,5 @@ void CScore::GetSaves(int ClientID)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(GetSavesThread, "get saves", ClientID, "", 0);
-}
-
-bool CScore::GetSavesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
-{
-	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
-	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
-
-	char aSaveLike[128] = "";
-	str_append(aSaveLike, "%\n", sizeof(aSaveLike));
-	sqlstr::EscapeLike(aSaveLike + str_length(aSaveLike),
-		pData->m_RequestingPlayer,
-		sizeof(aSaveLike) - str_length(aSaveLike));
-	str_append(aSaveLike, "\t%", sizeof(aSaveLike));
-
-	char aCurrentTimestamp[512];
-	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
-	char aMaxTimestamp[512];
-	pSqlServer->ToUnixTimestamp("MAX(Timestamp)", aMaxTimestamp, sizeof(aMaxTimestamp));
-
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT COUNT(*) AS NumSaves, %s-%s AS Ago "
-		"FROM %s_saves "
-		"WHERE Map = ? AND Savegame LIKE ?;",
-		aCurrentTimestamp, aMaxTimestamp,
-		pSqlServer->GetPrefix());
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_Map);
-	pSqlServer->BindString(2, aSaveLike);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-	if(!End)
-	{
-		int NumSaves = pSqlServer->GetInt(1);
-		int Ago = pSqlServer->GetInt(2);
-		char aAgoString[40] = "\0";
-		char aLastSavedString[60] = "\0";
-		if(Ago)
-		{
-			sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
-			str_format(aLastSavedString, sizeof(aLastSavedString), ", last saved %s ago", aAgoString);
-		}
-
-		str_format(paMessages[0], sizeof(paMessages[0]),
-			"%s has %d save%s on %s%s",
-			pData->m_RequestingPlayer,
-			NumSaves, NumSaves == 1 ? "" : "s",
-			pData->m_Map, aLastSavedString);
-	}
-	return false;
+	ExecPlayerThread(CScoreWorker::GetSavesThread, "get saves", ClientID, "", 0);
 }
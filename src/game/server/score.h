@@ -12,6 +12,7 @@
 #include <game/prng.h>
 #include <game/voting.h>
 
+#include "rankindex.h"
 #include "save.h"
 
 struct ISqlData;
@@ -112,6 +113,13 @@ struct CScoreInitResult : ISqlResult
 	float m_CurrentRecord;
 };
 
+struct CScoreRanksResult : ISqlResult
+{
+	// best times on the map, of all servers and of this server
+	CRankIndex m_GlobalRanks;
+	CRankIndex m_LocalRanks;
+};
+
 class CPlayerData
 {
 public:
@@ -153,6 +161,17 @@ struct CSqlInitData : ISqlData
 	char m_Map[MAX_MAP_LENGTH];
 };
 
+struct CSqlRanksRequest : ISqlData
+{
+	CSqlRanksRequest(std::shared_ptr<CScoreRanksResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	char m_Map[MAX_MAP_LENGTH];
+	char m_Server[5];
+};
+
 struct CSqlPlayerRequest : ISqlData
 {
 	CSqlPlayerRequest(std::shared_ptr<CScorePlayerResult> pResult) :
@@ -282,30 +301,24 @@ class CScore
 	CPlayerData m_aPlayerData[MAX_CLIENTS];
 	CDbConnectionPool *m_pPool;
 
-	static bool Init(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-
-	static bool RandomMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool RandomUnfinishedMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool MapVoteThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-
-	static bool LoadPlayerDataThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool MapInfoThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowTeamRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowTopThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowPlayerTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowTimesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool ShowTopPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-	static bool GetSavesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
-
+	// in-memory ranks answering /rank and /top5, reloaded from the
+	// database every sv_rank_cache_refresh minutes
+	CRankIndex m_GlobalRanks;
+	CRankIndex m_LocalRanks;
+	bool m_RanksLoaded;
+	int64_t m_RanksLoadTime;
+	std::shared_ptr<CScoreRanksResult> m_pRanksResult;
+	// finishes while loading, might be missing in the loaded ranks
+	std::vector<CRankIndex::CEntry> m_vRanksPendingFinishes;
+
+	void LoadRanks();
+	void UpdateRanks();
+
+	// the database requests are run by CScoreWorker, except the team
+	// saves which need the game state
 	static bool SaveTeamThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize);
 	static bool LoadTeamThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize);
 
-	static bool SaveScoreThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize);
-	static bool SaveTeamScoreThread(IDbConnection *pSqlServer, const ISqlData *pGameData, bool Failure, char *pError, int ErrorSize);
-
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const { return m_pServer; }
 	CGameContext *m_pGameServer;
@@ -325,6 +338,8 @@ class CScore
 		const char *pName,
 		int Offset);
 
+	void FillPlayerRequest(CSqlPlayerRequest *pRequest, int ClientID, const char *pName, int Offset);
+
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientID);
 
@@ -0,0 +1,1561 @@
+#include "scoreworker.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/sql_string_helpers.h>
+#include <engine/shared/config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+CScorePlayerResult::CScorePlayerResult()
+{
+	SetVariant(Variant::DIRECT);
+}
+
+void CScorePlayerResult::SetVariant(Variant v)
+{
+	m_MessageKind = v;
+	switch(v)
+	{
+	case DIRECT:
+	case ALL:
+		for(auto &aMessage : m_Data.m_aaMessages)
+			aMessage[0] = 0;
+		break;
+	case BROADCAST:
+		m_Data.m_Broadcast[0] = 0;
+		break;
+	case MAP_VOTE:
+		m_Data.m_MapVote.m_Map[0] = '\0';
+		m_Data.m_MapVote.m_Reason[0] = '\0';
+		m_Data.m_MapVote.m_Server[0] = '\0';
+		break;
+	case PLAYER_INFO:
+		m_Data.m_Info.m_Score = -9999;
+		m_Data.m_Info.m_Birthday = 0;
+		m_Data.m_Info.m_HasFinishScore = false;
+		m_Data.m_Info.m_Time = 0;
+		for(float &CpTime : m_Data.m_Info.m_CpTime)
+			CpTime = 0;
+	}
+}
+
+CTeamrank::CTeamrank() :
+	m_NumNames(0)
+{
+	for(auto &aName : m_aaNames)
+		aName[0] = '\0';
+	mem_zero(&m_TeamID.m_aData, sizeof(m_TeamID));
+}
+
+bool CTeamrank::NextSqlResult(IDbConnection *pSqlServer, bool *pEnd, char *pError, int ErrorSize)
+{
+	pSqlServer->GetBlob(1, m_TeamID.m_aData, sizeof(m_TeamID.m_aData));
+	pSqlServer->GetString(2, m_aaNames[0], sizeof(m_aaNames[0]));
+	m_NumNames = 1;
+	bool End = false;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CUuid TeamID;
+		pSqlServer->GetBlob(1, TeamID.m_aData, sizeof(TeamID.m_aData));
+		if(m_TeamID != TeamID)
+		{
+			*pEnd = false;
+			return false;
+		}
+		pSqlServer->GetString(2, m_aaNames[m_NumNames], sizeof(m_aaNames[m_NumNames]));
+		m_NumNames++;
+	}
+	if(!End)
+	{
+		return true;
+	}
+	*pEnd = true;
+	return false;
+}
+
+bool CTeamrank::SamePlayers(const std::vector<std::string> *aSortedNames)
+{
+	if(aSortedNames->size() != m_NumNames)
+		return false;
+	for(unsigned int i = 0; i < m_NumNames; i++)
+	{
+		if(str_comp(aSortedNames->at(i).c_str(), m_aaNames[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+bool CScoreWorker::Init(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlInitData *pData = dynamic_cast<const CSqlInitData *>(pGameData);
+	CScoreInitResult *pResult = dynamic_cast<CScoreInitResult *>(pGameData->m_pResult.get());
+
+	char aBuf[512];
+	// get the best time
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Time FROM %s_race WHERE Map=? ORDER BY `Time` ASC LIMIT 1;",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		pResult->m_CurrentRecord = pSqlServer->GetFloat(1);
+	}
+
+	return false;
+}
+
+bool CScoreWorker::LoadRanksThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlRanksRequest *pData = dynamic_cast<const CSqlRanksRequest *>(pGameData);
+	CScoreRanksResult *pResult = dynamic_cast<CScoreRanksResult *>(pGameData->m_pResult.get());
+
+	char aServerLike[16];
+	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_Server);
+	const char *pAny = "%";
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, MIN(Time) AS Time "
+		"FROM %s_race "
+		"WHERE Map = ? "
+		"AND Server LIKE ? "
+		"GROUP BY Name;",
+		pSqlServer->GetPrefix());
+
+	for(int Local = 0; Local < 2; Local++)
+	{
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_Map);
+		pSqlServer->BindString(2, Local ? aServerLike : pAny);
+
+		std::vector<CRankIndex::CEntry> vEntries;
+		bool End = false;
+		while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+		{
+			CRankIndex::CEntry Entry;
+			pSqlServer->GetString(1, Entry.m_aName, sizeof(Entry.m_aName));
+			Entry.m_Time = pSqlServer->GetFloat(2);
+			vEntries.push_back(Entry);
+		}
+		if(!End)
+		{
+			return true;
+		}
+		(Local ? pResult->m_LocalRanks : pResult->m_GlobalRanks).Load(std::move(vEntries));
+	}
+	return false;
+}
+
+// update stuff
+bool CScoreWorker::LoadPlayerDataThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	pResult->SetVariant(CScorePlayerResult::PLAYER_INFO);
+
+	char aBuf[512];
+	// get best race time
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Time, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, "
+		"  cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, "
+		"  cp21, cp22, cp23, cp24, cp25 "
+		"FROM %s_race "
+		"WHERE Map = ? AND Name = ? "
+		"ORDER BY Time ASC "
+		"LIMIT 1;",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pData->m_RequestingPlayer);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		// get the best time
+		float Time = pSqlServer->GetFloat(1);
+		pResult->m_Data.m_Info.m_Time = Time;
+		pResult->m_Data.m_Info.m_Score = -Time;
+		pResult->m_Data.m_Info.m_HasFinishScore = true;
+
+		if(g_Config.m_SvCheckpointSave)
+		{
+			for(int i = 0; i < NUM_CHECKPOINTS; i++)
+			{
+				pResult->m_Data.m_Info.m_CpTime[i] = pSqlServer->GetFloat(i + 2);
+			}
+		}
+	}
+
+	// birthday check
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT CURRENT_TIMESTAMP AS Current, MIN(Timestamp) AS Stamp "
+		"FROM %s_race "
+		"WHERE Name = ?",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_RequestingPlayer);
+
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End && !pSqlServer->IsNull(2))
+	{
+		char aCurrent[TIMESTAMP_STR_LENGTH];
+		pSqlServer->GetString(1, aCurrent, sizeof(aCurrent));
+		char aStamp[TIMESTAMP_STR_LENGTH];
+		pSqlServer->GetString(2, aStamp, sizeof(aStamp));
+		int CurrentYear, CurrentMonth, CurrentDay;
+		int StampYear, StampMonth, StampDay;
+		if(sscanf(aCurrent, "%d-%d-%d", &CurrentYear, &CurrentMonth, &CurrentDay) == 3 && sscanf(aStamp, "%d-%d-%d", &StampYear, &StampMonth, &StampDay) == 3 && CurrentMonth == StampMonth && CurrentDay == StampDay)
+			pResult->m_Data.m_Info.m_Birthday = CurrentYear - StampYear;
+	}
+	return false;
+}
+
+bool CScoreWorker::MapVoteThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	char aFuzzyMap[128];
+	str_copy(aFuzzyMap, pData->m_Name, sizeof(aFuzzyMap));
+	sqlstr::FuzzyString(aFuzzyMap, sizeof(aFuzzyMap));
+
+	char aMapPrefix[128];
+	str_copy(aMapPrefix, pData->m_Name, sizeof(aMapPrefix));
+	str_append(aMapPrefix, "%", sizeof(aMapPrefix));
+
+	char aBuf[768];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Map, Server "
+		"FROM %s_maps "
+		"WHERE Map LIKE %s "
+		"ORDER BY "
+		"  CASE WHEN Map = ? THEN 0 ELSE 1 END, "
+		"  CASE WHEN Map LIKE ? THEN 0 ELSE 1 END, "
+		"  LENGTH(Map), Map "
+		"LIMIT 1;",
+		pSqlServer->GetPrefix(), pSqlServer->CollateNocase());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, aFuzzyMap);
+	pSqlServer->BindString(2, pData->m_Name);
+	pSqlServer->BindString(3, aMapPrefix);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		pResult->SetVariant(CScorePlayerResult::MAP_VOTE);
+		auto *MapVote = &pResult->m_Data.m_MapVote;
+		pSqlServer->GetString(1, MapVote->m_Map, sizeof(MapVote->m_Map));
+		pSqlServer->GetString(2, MapVote->m_Server, sizeof(MapVote->m_Server));
+		str_copy(MapVote->m_Reason, "/map", sizeof(MapVote->m_Reason));
+
+		for(char *p = MapVote->m_Server; *p; p++) // lower case server
+			*p = tolower(*p);
+	}
+	else
+	{
+		pResult->SetVariant(CScorePlayerResult::DIRECT);
+		str_format(paMessages[0], sizeof(paMessages[0]),
+			"No map like \"%s\" found. "
+			"Try adding a '%%' at the start if you don't know the first character. "
+			"Example: /map %%castle for \"Out of Castle\"",
+			pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::MapInfoThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+
+	char aFuzzyMap[128];
+	str_copy(aFuzzyMap, pData->m_Name, sizeof(aFuzzyMap));
+	sqlstr::FuzzyString(aFuzzyMap, sizeof(aFuzzyMap));
+
+	char aMapPrefix[128];
+	str_copy(aMapPrefix, pData->m_Name, sizeof(aMapPrefix));
+	str_append(aMapPrefix, "%", sizeof(aMapPrefix));
+
+	char aCurrentTimestamp[512];
+	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
+	char aTimestamp[512];
+	pSqlServer->ToUnixTimestamp("l.Timestamp", aTimestamp, sizeof(aTimestamp));
+
+	char aMedianMapTime[2048];
+	char aBuf[4096];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT l.Map, l.Server, Mapper, Points, Stars, "
+		"  (SELECT COUNT(Name) FROM %s_race WHERE Map = l.Map) AS Finishes, "
+		"  (SELECT COUNT(DISTINCT Name) FROM %s_race WHERE Map = l.Map) AS Finishers, "
+		"  (%s) AS Median, "
+		"  %s AS Stamp, "
+		"  %s-%s AS Ago, "
+		"  (SELECT MIN(Time) FROM %s_race WHERE Map = l.Map AND Name = ?) AS OwnTime "
+		"FROM ("
+		"  SELECT * FROM %s_maps "
+		"  WHERE Map LIKE %s "
+		"  ORDER BY "
+		"    CASE WHEN Map = ? THEN 0 ELSE 1 END, "
+		"    CASE WHEN Map LIKE ? THEN 0 ELSE 1 END, "
+		"    LENGTH(Map), "
+		"    Map "
+		"  LIMIT 1"
+		") as l;",
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(),
+		pSqlServer->MedianMapTime(aMedianMapTime, sizeof(aMedianMapTime)),
+		aTimestamp, aCurrentTimestamp, aTimestamp,
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(),
+		pSqlServer->CollateNocase());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_RequestingPlayer);
+	pSqlServer->BindString(2, aFuzzyMap);
+	pSqlServer->BindString(3, pData->m_Name);
+	pSqlServer->BindString(4, aMapPrefix);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		char aMap[MAX_MAP_LENGTH];
+		pSqlServer->GetString(1, aMap, sizeof(aMap));
+		char aServer[32];
+		pSqlServer->GetString(2, aServer, sizeof(aServer));
+		char aMapper[128];
+		pSqlServer->GetString(3, aMapper, sizeof(aMapper));
+		int Points = pSqlServer->GetInt(4);
+		int Stars = pSqlServer->GetInt(5);
+		int Finishes = pSqlServer->GetInt(6);
+		int Finishers = pSqlServer->GetInt(7);
+		float Median = !pSqlServer->IsNull(8) ? pSqlServer->GetInt(8) : -1.0f;
+		int Stamp = pSqlServer->GetInt(9);
+		int Ago = pSqlServer->GetInt(10);
+		float OwnTime = !pSqlServer->IsNull(11) ? pSqlServer->GetFloat(11) : -1.0f;
+
+		char aAgoString[40] = "\0";
+		char aReleasedString[60] = "\0";
+		if(Stamp != 0)
+		{
+			sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
+			str_format(aReleasedString, sizeof(aReleasedString), ", released %s ago", aAgoString);
+		}
+
+		char aMedianString[60] = "\0";
+		if(Median > 0)
+		{
+			str_time((int64_t)Median * 100, TIME_HOURS, aBuf, sizeof(aBuf));
+			str_format(aMedianString, sizeof(aMedianString), " in %s median", aBuf);
+		}
+
+		char aStars[20];
+		switch(Stars)
+		{
+		case 0: str_copy(aStars, "✰✰✰✰✰", sizeof(aStars)); break;
+		case 1: str_copy(aStars, "★✰✰✰✰", sizeof(aStars)); break;
+		case 2: str_copy(aStars, "★★✰✰✰", sizeof(aStars)); break;
+		case 3: str_copy(aStars, "★★★✰✰", sizeof(aStars)); break;
+		case 4: str_copy(aStars, "★★★★✰", sizeof(aStars)); break;
+		case 5: str_copy(aStars, "★★★★★", sizeof(aStars)); break;
+		default: aStars[0] = '\0';
+		}
+
+		char aOwnFinishesString[40] = "\0";
+		if(OwnTime > 0)
+		{
+			str_time_float(OwnTime, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+			str_format(aOwnFinishesString, sizeof(aOwnFinishesString),
+				", your time: %s", aBuf);
+		}
+
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"\"%s\" by %s on %s, %s, %d %s%s, %d %s by %d %s%s%s",
+			aMap, aMapper, aServer, aStars,
+			Points, Points == 1 ? "point" : "points",
+			aReleasedString,
+			Finishes, Finishes == 1 ? "finish" : "finishes",
+			Finishers, Finishers == 1 ? "tee" : "tees",
+			aMedianString, aOwnFinishesString);
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"No map like \"%s\" found.", pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::SaveScoreThread(IDbConnection *pSqlServer, const ISqlData *const *ppGameData, int NumData, bool Failure, char *pError, int ErrorSize)
+{
+	// the finishes of a batch are usually on the same map
+	std::vector<bool> vSaved(NumData, false);
+	for(int First = 0; First < NumData; First++)
+	{
+		if(vSaved[First])
+			continue;
+		const char *pMap = dynamic_cast<const CSqlScoreData *>(ppGameData[First])->m_Map;
+		std::vector<const CSqlScoreData *> vpData;
+		for(int i = First; i < NumData; i++)
+		{
+			const CSqlScoreData *pData = dynamic_cast<const CSqlScoreData *>(ppGameData[i]);
+			if(!vSaved[i] && str_comp(pData->m_Map, pMap) == 0)
+			{
+				vpData.push_back(pData);
+				vSaved[i] = true;
+			}
+		}
+		if(SaveMapScores(pSqlServer, vpData, pError, ErrorSize))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CScoreWorker::SaveMapScores(IDbConnection *pSqlServer, const std::vector<const CSqlScoreData *> &vpData, char *pError, int ErrorSize)
+{
+	char aBuf[1024];
+	const char *pMap = vpData[0]->m_Map;
+	bool PointsLoaded = false;
+	int Points = 0;
+	bool MapHasPoints = false;
+	for(unsigned i = 0; i < vpData.size(); i++)
+	{
+		const CSqlScoreData *pData = vpData[i];
+		// the finishes of this batch aren't inserted yet
+		bool FinishedBefore = false;
+		for(unsigned j = 0; j < i && !FinishedBefore; j++)
+			FinishedBefore = str_comp(vpData[j]->m_Name, pData->m_Name) == 0;
+		if(FinishedBefore)
+			continue;
+
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT COUNT(*) AS NumFinished FROM %s_race WHERE Map=? AND Name=? ORDER BY time ASC LIMIT 1;",
+			pSqlServer->GetPrefix());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pMap);
+		pSqlServer->BindString(2, pData->m_Name);
+
+		bool End;
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+		if(pSqlServer->GetInt(1) != 0)
+			continue;
+
+		if(!PointsLoaded)
+		{
+			str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map=?", pSqlServer->GetPrefix());
+			if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+			{
+				return true;
+			}
+			pSqlServer->BindString(1, pMap);
+			if(pSqlServer->Step(&End, pError, ErrorSize))
+			{
+				return true;
+			}
+			MapHasPoints = !End;
+			if(MapHasPoints)
+				Points = pSqlServer->GetInt(1);
+			PointsLoaded = true;
+		}
+		if(MapHasPoints)
+		{
+			if(pSqlServer->AddPoints(pData->m_Name, Points, pError, ErrorSize))
+			{
+				return true;
+			}
+			CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pData->m_pResult.get());
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"You earned %d point%s for finishing this map!",
+				Points, Points == 1 ? "" : "s");
+		}
+	}
+
+	// save scores. Can't fail, because no UNIQUE/PRIMARY KEY constrain is defined.
+	std::string Insert;
+	str_format(aBuf, sizeof(aBuf),
+		"%s INTO %s_race("
+		"	Map, Name, Timestamp, Time, Server, "
+		"	cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, "
+		"	cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, "
+		"	GameID, DDNet7) "
+		"VALUES ",
+		pSqlServer->InsertIgnore(), pSqlServer->GetPrefix());
+	Insert += aBuf;
+	for(unsigned i = 0; i < vpData.size(); i++)
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"%s(?, ?, %s, ?, ?, "
+			"	?, ?, ?, ?, ?, ?, ?, ?, ?, "
+			"	?, ?, ?, ?, ?, ?, ?, ?, ?, "
+			"	?, ?, ?, ?, ?, ?, ?, "
+			"	?, false)",
+			i == 0 ? "" : ", ",
+			pSqlServer->InsertTimestampAsUtc());
+		Insert += aBuf;
+	}
+	Insert += ";";
+	// the times are bound instead of formatted into the query so the
+	// statement can be reused from the connection's statement cache
+	if(pSqlServer->PrepareStatement(Insert.c_str(), pError, ErrorSize))
+	{
+		return true;
+	}
+	const int NumRowParams = 6 + NUM_CHECKPOINTS;
+	for(unsigned i = 0; i < vpData.size(); i++)
+	{
+		int Idx = i * NumRowParams;
+		pSqlServer->BindString(++Idx, pMap);
+		pSqlServer->BindString(++Idx, vpData[i]->m_Name);
+		pSqlServer->BindString(++Idx, vpData[i]->m_aTimestamp);
+		pSqlServer->BindFloat(++Idx, vpData[i]->m_Time);
+		pSqlServer->BindString(++Idx, g_Config.m_SvSqlServerName);
+		for(int Cp = 0; Cp < NUM_CHECKPOINTS; Cp++)
+			pSqlServer->BindFloat(++Idx, vpData[i]->m_aCpCurrent[Cp]);
+		pSqlServer->BindString(++Idx, vpData[i]->m_GameUuid);
+	}
+	pSqlServer->Print();
+	int NumInserted;
+	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+	{
+		return true;
+	}
+	return false;
+}
+
+bool CScoreWorker::SaveTeamScoreThread(IDbConnection *pSqlServer, const ISqlData *const *ppGameData, int NumData, bool Failure, char *pError, int ErrorSize)
+{
+	// in order, a team finishing twice in a batch finds its first time
+	for(int i = 0; i < NumData; i++)
+	{
+		if(SaveMapTeamScore(pSqlServer, dynamic_cast<const CSqlTeamScoreData *>(ppGameData[i]), pError, ErrorSize))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CScoreWorker::SaveMapTeamScore(IDbConnection *pSqlServer, const CSqlTeamScoreData *pData, char *pError, int ErrorSize)
+{
+
+	char aBuf[512];
+
+	// get the names sorted in a tab separated string
+	std::vector<std::string> aNames;
+	for(unsigned int i = 0; i < pData->m_Size; i++)
+		aNames.push_back(pData->m_aNames[i]);
+
+	std::sort(aNames.begin(), aNames.end());
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT l.ID, Name, Time "
+		"FROM (" // preselect teams with first name in team
+		"  SELECT ID "
+		"  FROM %s_teamrace "
+		"  WHERE Map = ? AND Name = ? AND DDNet7 = false"
+		") as l INNER JOIN %s_teamrace AS r ON l.ID = r.ID "
+		"ORDER BY l.ID, Name COLLATE %s;",
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->BinaryCollate());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pData->m_aNames[0]);
+
+	bool FoundTeam = false;
+	float Time;
+	CTeamrank Teamrank;
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		bool SearchTeamEnd = false;
+		while(!SearchTeamEnd)
+		{
+			Time = pSqlServer->GetFloat(3);
+			if(Teamrank.NextSqlResult(pSqlServer, &SearchTeamEnd, pError, ErrorSize))
+			{
+				return true;
+			}
+			if(Teamrank.SamePlayers(&aNames))
+			{
+				FoundTeam = true;
+				break;
+			}
+		}
+	}
+	if(FoundTeam)
+	{
+		dbg_msg("sql", "found team rank from same team (old time: %f, new time: %f)", Time, pData->m_Time);
+		if(pData->m_Time < Time)
+		{
+			str_format(aBuf, sizeof(aBuf),
+				"UPDATE %s_teamrace SET Time=?, Timestamp=?, DDNet7=false, GameID=? WHERE ID = ?;",
+				pSqlServer->GetPrefix());
+			if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+			{
+				return true;
+			}
+			pSqlServer->BindFloat(1, pData->m_Time);
+			pSqlServer->BindString(2, pData->m_aTimestamp);
+			pSqlServer->BindString(3, pData->m_GameUuid);
+			pSqlServer->BindBlob(4, Teamrank.m_TeamID.m_aData, sizeof(Teamrank.m_TeamID.m_aData));
+			pSqlServer->Print();
+			int NumUpdated;
+			if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
+			{
+				return true;
+			}
+		}
+	}
+	else
+	{
+		// if no entry found... create a new one
+		CUuid GameID = RandomUuid();
+		std::string Insert;
+		str_format(aBuf, sizeof(aBuf),
+			"%s INTO %s_teamrace(Map, Name, Timestamp, Time, ID, GameID, DDNet7) VALUES ",
+			pSqlServer->InsertIgnore(), pSqlServer->GetPrefix());
+		Insert += aBuf;
+		for(unsigned int i = 0; i < pData->m_Size; i++)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s(?, ?, %s, ?, ?, ?, false)",
+				i == 0 ? "" : ", ", pSqlServer->InsertTimestampAsUtc());
+			Insert += aBuf;
+		}
+		Insert += ";";
+		if(pSqlServer->PrepareStatement(Insert.c_str(), pError, ErrorSize))
+		{
+			return true;
+		}
+		for(unsigned int i = 0; i < pData->m_Size; i++)
+		{
+			pSqlServer->BindString(i * 6 + 1, pData->m_Map);
+			pSqlServer->BindString(i * 6 + 2, pData->m_aNames[i]);
+			pSqlServer->BindString(i * 6 + 3, pData->m_aTimestamp);
+			pSqlServer->BindFloat(i * 6 + 4, pData->m_Time);
+			pSqlServer->BindBlob(i * 6 + 5, GameID.m_aData, sizeof(GameID.m_aData));
+			pSqlServer->BindString(i * 6 + 6, pData->m_GameUuid);
+		}
+		pSqlServer->Print();
+		int NumInserted;
+		if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void CScoreWorker::FormatRank(CScorePlayerResult *pResult, const CSqlPlayerRequest *pData, int Rank, float Time, float PercentRank, const char *pRegionalRank)
+{
+	char aBuf[64];
+	// CEIL and FLOOR are not supported in SQLite
+	int BetterThanPercent = std::floor(100.0 - 100.0 * PercentRank);
+	str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+	if(g_Config.m_SvHideScore)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
+	}
+	else
+	{
+		pResult->m_MessageKind = CScorePlayerResult::ALL;
+
+		if(str_comp_nocase(pData->m_RequestingPlayer, pData->m_Name) == 0)
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%%",
+				pData->m_Name, aBuf, BetterThanPercent);
+		}
+		else
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%% - requested by %s",
+				pData->m_Name, aBuf, BetterThanPercent, pData->m_RequestingPlayer);
+		}
+
+		str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+			"Global rank %d - %s %s",
+			Rank, pData->m_Server, pRegionalRank);
+	}
+}
+
+bool CScoreWorker::ShowRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+
+	char aServerLike[16];
+	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_Server);
+
+	// check sort method
+	char aBuf[600];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Rank, Time, PercentRank "
+		"FROM ("
+		"  SELECT RANK() OVER w AS Rank, PERCENT_RANK() OVER w as PercentRank, Name, MIN(Time) AS Time "
+		"  FROM %s_race "
+		"  WHERE Map = ? "
+		"  AND Server LIKE ?"
+		"  GROUP BY Name "
+		"  WINDOW w AS (ORDER BY Time)"
+		") as a "
+		"WHERE Name = ?;",
+		pSqlServer->GetPrefix());
+
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, aServerLike);
+	pSqlServer->BindString(3, pData->m_Name);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+
+	char aRegionalRank[16];
+	if(End)
+	{
+		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	}
+	else
+	{
+		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
+	}
+
+	const char *pAny = "%";
+
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pAny);
+	pSqlServer->BindString(3, pData->m_Name);
+
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+
+	if(!End)
+	{
+		FormatRank(pResult, pData, pSqlServer->GetInt(1), pSqlServer->GetFloat(2), pSqlServer->GetFloat(3), aRegionalRank);
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::ShowTeamRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+
+	// check sort method
+	char aBuf[2400];
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT l.ID, Name, Time, Rank, PercentRank "
+		"FROM (" // teamrank score board
+		"  SELECT RANK() OVER w AS Rank, PERCENT_RANK() OVER w AS PercentRank, ID "
+		"  FROM %s_teamrace "
+		"  WHERE Map = ? "
+		"  GROUP BY ID "
+		"  WINDOW w AS (ORDER BY Time)"
+		") AS TeamRank INNER JOIN (" // select rank with Name in team
+		"  SELECT ID "
+		"  FROM %s_teamrace "
+		"  WHERE Map = ? AND Name = ? "
+		"  ORDER BY Time "
+		"  LIMIT 1"
+		") AS l ON TeamRank.ID = l.ID "
+		"INNER JOIN %s_teamrace AS r ON l.ID = r.ID ",
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pData->m_Map);
+	pSqlServer->BindString(3, pData->m_Name);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		float Time = pSqlServer->GetFloat(3);
+		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+		int Rank = pSqlServer->GetInt(4);
+		// CEIL and FLOOR are not supported in SQLite
+		int BetterThanPercent = std::floor(100.0 - 100.0 * pSqlServer->GetFloat(5));
+		CTeamrank Teamrank;
+		if(Teamrank.NextSqlResult(pSqlServer, &End, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		char aFormattedNames[512] = "";
+		for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
+		{
+			str_append(aFormattedNames, Teamrank.m_aaNames[Name], sizeof(aFormattedNames));
+
+			if(Name < Teamrank.m_NumNames - 2)
+				str_append(aFormattedNames, ", ", sizeof(aFormattedNames));
+			else if(Name < Teamrank.m_NumNames - 1)
+				str_append(aFormattedNames, " & ", sizeof(aFormattedNames));
+		}
+
+		if(g_Config.m_SvHideScore)
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"Your team time: %s, better than %d%%", aBuf, BetterThanPercent);
+		}
+		else
+		{
+			pResult->m_MessageKind = CScorePlayerResult::ALL;
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%d. %s Team time: %s, better than %d%%, requested by %s",
+				Rank, aFormattedNames, aBuf, BetterThanPercent, pData->m_RequestingPlayer);
+		}
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s has no team ranks", pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::ShowTopThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+
+	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
+	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
+	const char *pAny = "%";
+
+	// check sort method
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Time, Rank, Server "
+		"FROM ("
+		"  SELECT RANK() OVER w AS Rank, Name, MIN(Time) AS Time, Server "
+		"  FROM %s_race "
+		"  WHERE Map = ? "
+		"  AND Server LIKE ? "
+		"  GROUP BY Name "
+		"  WINDOW w AS (ORDER BY Time)"
+		") as a "
+		"ORDER BY Rank %s "
+		"LIMIT ?, ?;",
+		pSqlServer->GetPrefix(),
+		pOrder);
+
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pAny);
+	pSqlServer->BindInt(3, LimitStart);
+	pSqlServer->BindInt(4, 5);
+
+	// show top
+	int Line = 0;
+	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+	Line++;
+
+	char aTime[32];
+	bool End = false;
+	bool HasLocal = false;
+
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		float Time = pSqlServer->GetFloat(2);
+		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		int Rank = pSqlServer->GetInt(3);
+		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			"%d. %s Time: %s", Rank, aName, aTime);
+
+		char aRecordServer[6];
+		pSqlServer->GetString(4, aRecordServer, sizeof(aRecordServer));
+
+		HasLocal = HasLocal || str_comp(aRecordServer, pData->m_Server) == 0;
+
+		Line++;
+	}
+
+	if(!HasLocal)
+	{
+		char aServerLike[16];
+		str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_Server);
+
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_Map);
+		pSqlServer->BindString(2, aServerLike);
+		pSqlServer->BindInt(3, LimitStart);
+		pSqlServer->BindInt(4, 3);
+
+		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			"------------ %s Top ------------", pData->m_Server);
+		Line++;
+
+		// show top
+		while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+		{
+			char aName[MAX_NAME_LENGTH];
+			pSqlServer->GetString(1, aName, sizeof(aName));
+			float Time = pSqlServer->GetFloat(2);
+			str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+			int Rank = pSqlServer->GetInt(3);
+			str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+				"%d. %s Time: %s", Rank, aName, aTime);
+			Line++;
+		}
+	}
+	else
+	{
+		str_copy(pResult->m_Data.m_aaMessages[Line], "---------------------------------------",
+			sizeof(pResult->m_Data.m_aaMessages[Line]));
+	}
+
+	if(!End)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+bool CScoreWorker::ShowTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
+	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
+
+	// check sort method
+	char aBuf[512];
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Time, Rank, TeamSize "
+		"FROM (" // limit to 5
+		"  SELECT TeamSize, Rank, ID "
+		"  FROM (" // teamrank score board
+		"    SELECT RANK() OVER w AS Rank, ID, COUNT(*) AS Teamsize "
+		"    FROM %s_teamrace "
+		"    WHERE Map = ? "
+		"    GROUP BY Id "
+		"    WINDOW w AS (ORDER BY Time)"
+		"  ) as l1 "
+		"  ORDER BY Rank %s "
+		"  LIMIT ?, 5"
+		") as l2 "
+		"INNER JOIN %s_teamrace as r ON l2.ID = r.ID "
+		"ORDER BY Rank %s, r.ID, Name ASC;",
+		pSqlServer->GetPrefix(), pOrder, pSqlServer->GetPrefix(), pOrder);
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindInt(2, LimitStart);
+
+	// show teamtop5
+	int Line = 0;
+	str_copy(paMessages[Line++], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		for(Line = 1; Line < 6; Line++) // print
+		{
+			bool Last = false;
+			float Time = pSqlServer->GetFloat(2);
+			str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+			int Rank = pSqlServer->GetInt(3);
+			int TeamSize = pSqlServer->GetInt(4);
+
+			char aNames[2300] = {0};
+			for(int i = 0; i < TeamSize; i++)
+			{
+				char aName[MAX_NAME_LENGTH];
+				pSqlServer->GetString(1, aName, sizeof(aName));
+				str_append(aNames, aName, sizeof(aNames));
+				if(i < TeamSize - 2)
+					str_append(aNames, ", ", sizeof(aNames));
+				else if(i == TeamSize - 2)
+					str_append(aNames, " & ", sizeof(aNames));
+				if(pSqlServer->Step(&Last, pError, ErrorSize))
+				{
+					return true;
+				}
+				if(Last)
+				{
+					break;
+				}
+			}
+			str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
+				Rank, aNames, aBuf);
+			if(Last)
+			{
+				Line++;
+				break;
+			}
+		}
+	}
+
+	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+	return false;
+}
+
+bool CScoreWorker::ShowPlayerTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
+	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
+
+	// check sort method
+	char aBuf[2400];
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT l.ID, Name, Time, Rank "
+		"FROM (" // teamrank score board
+		"  SELECT RANK() OVER w AS Rank, ID "
+		"  FROM %s_teamrace "
+		"  WHERE Map = ? "
+		"  GROUP BY ID "
+		"  WINDOW w AS (ORDER BY Time)"
+		") AS TeamRank INNER JOIN (" // select rank with Name in team
+		"  SELECT ID "
+		"  FROM %s_teamrace "
+		"  WHERE Map = ? AND Name = ? "
+		"  ORDER BY Time %s "
+		"  LIMIT ?, 5 "
+		") AS l ON TeamRank.ID = l.ID "
+		"INNER JOIN %s_teamrace AS r ON l.ID = r.ID "
+		"ORDER BY Time %s, l.ID ",
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pOrder, pSqlServer->GetPrefix(), pOrder);
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, pData->m_Map);
+	pSqlServer->BindString(3, pData->m_Name);
+	pSqlServer->BindInt(4, LimitStart);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		// show teamtop5
+		int Line = 0;
+		str_copy(paMessages[Line++], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+
+		for(Line = 1; Line < 6; Line++) // print
+		{
+			float Time = pSqlServer->GetFloat(3);
+			str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+			int Rank = pSqlServer->GetInt(4);
+			CTeamrank Teamrank;
+			bool Last;
+			if(Teamrank.NextSqlResult(pSqlServer, &Last, pError, ErrorSize))
+			{
+				return true;
+			}
+
+			char aFormattedNames[512] = "";
+			for(unsigned int Name = 0; Name < Teamrank.m_NumNames; Name++)
+			{
+				str_append(aFormattedNames, Teamrank.m_aaNames[Name], sizeof(aFormattedNames));
+
+				if(Name < Teamrank.m_NumNames - 2)
+					str_append(aFormattedNames, ", ", sizeof(aFormattedNames));
+				else if(Name < Teamrank.m_NumNames - 1)
+					str_append(aFormattedNames, " & ", sizeof(aFormattedNames));
+			}
+
+			str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
+				Rank, aFormattedNames, aBuf);
+			if(Last)
+			{
+				Line++;
+				break;
+			}
+		}
+		str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+	}
+	else
+	{
+		if(pData->m_Offset == 0)
+			str_format(paMessages[0], sizeof(paMessages[0]), "%s has no team ranks", pData->m_Name);
+		else
+			str_format(paMessages[0], sizeof(paMessages[0]), "%s has no team ranks in the specified range", pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::ShowTimesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	int LimitStart = maximum(abs(pData->m_Offset) - 1, 0);
+	const char *pOrder = pData->m_Offset >= 0 ? "DESC" : "ASC";
+
+	char aCurrentTimestamp[512];
+	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
+	char aTimestamp[512];
+	pSqlServer->ToUnixTimestamp("Timestamp", aTimestamp, sizeof(aTimestamp));
+	char aBuf[512];
+	if(pData->m_Name[0] != '\0') // last 5 times of a player
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Time, (%s-%s) as Ago, %s as Stamp, Server "
+			"FROM %s_race "
+			"WHERE Map = ? AND Name = ? "
+			"ORDER BY Timestamp %s "
+			"LIMIT ?, 5;",
+			aCurrentTimestamp, aTimestamp, aTimestamp,
+			pSqlServer->GetPrefix(), pOrder);
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_Map);
+		pSqlServer->BindString(2, pData->m_Name);
+		pSqlServer->BindInt(3, LimitStart);
+	}
+	else // last 5 times of server
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Time, (%s-%s) as Ago, %s as Stamp, Server, Name "
+			"FROM %s_race "
+			"WHERE Map = ? "
+			"ORDER BY Timestamp %s "
+			"LIMIT ?, 5;",
+			aCurrentTimestamp, aTimestamp, aTimestamp,
+			pSqlServer->GetPrefix(), pOrder);
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_Map);
+		pSqlServer->BindInt(2, LimitStart);
+	}
+
+	// show top5
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(End)
+	{
+		str_copy(paMessages[0], "There are no times in the specified range", sizeof(paMessages[0]));
+		return false;
+	}
+
+	str_copy(paMessages[0], "------------- Last Times -------------", sizeof(paMessages[0]));
+	int Line = 1;
+
+	do
+	{
+		float Time = pSqlServer->GetFloat(1);
+		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+		int Ago = pSqlServer->GetInt(2);
+		int Stamp = pSqlServer->GetInt(3);
+		char aServer[5];
+		pSqlServer->GetString(4, aServer, sizeof(aServer));
+		char aServerFormatted[8] = "\0";
+		if(str_comp(aServer, "UNK") != 0)
+			str_format(aServerFormatted, sizeof(aServerFormatted), "[%s] ", aServer);
+
+		char aAgoString[40] = "\0";
+		sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
+
+		if(pData->m_Name[0] != '\0') // last 5 times of a player
+		{
+			if(Stamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
+				str_format(paMessages[Line], sizeof(paMessages[Line]),
+					"%s%s, don't know how long ago", aServerFormatted, aBuf);
+			else
+				str_format(paMessages[Line], sizeof(paMessages[Line]),
+					"%s%s ago, %s", aServerFormatted, aAgoString, aBuf);
+		}
+		else // last 5 times of the server
+		{
+			char aName[MAX_NAME_LENGTH];
+			pSqlServer->GetString(5, aName, sizeof(aName));
+			if(Stamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
+			{
+				str_format(paMessages[Line], sizeof(paMessages[Line]),
+					"%s%s, %s, don't know when", aServerFormatted, aName, aBuf);
+			}
+			else
+			{
+				str_format(paMessages[Line], sizeof(paMessages[Line]),
+					"%s%s, %s ago, %s", aServerFormatted, aName, aAgoString, aBuf);
+			}
+		}
+		Line++;
+	} while(!pSqlServer->Step(&End, pError, ErrorSize) && !End);
+	if(!End)
+	{
+		return true;
+	}
+	str_copy(paMessages[Line], "----------------------------------------------------", sizeof(paMessages[Line]));
+
+	return false;
+}
+
+bool CScoreWorker::ShowPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT ("
+		"  SELECT COUNT(Name) + 1 FROM %s_points WHERE Points > ("
+		"    SELECT points FROM %s_points WHERE Name = ?"
+		")) as Rank, Points, Name "
+		"FROM %s_points WHERE Name = ?;",
+		pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Name);
+	pSqlServer->BindString(2, pData->m_Name);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		int Rank = pSqlServer->GetInt(1);
+		int Count = pSqlServer->GetInt(2);
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(3, aName, sizeof(aName));
+		pResult->m_MessageKind = CScorePlayerResult::ALL;
+		str_format(paMessages[0], sizeof(paMessages[0]),
+			"%d. %s Points: %d, requested by %s",
+			Rank, aName, Count, pData->m_RequestingPlayer);
+	}
+	else
+	{
+		str_format(paMessages[0], sizeof(paMessages[0]),
+			"%s has not collected any points so far", pData->m_Name);
+	}
+	return false;
+}
+
+bool CScoreWorker::ShowTopPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	int LimitStart = maximum(pData->m_Offset - 1, 0);
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT RANK() OVER (ORDER BY a.Points DESC) as Rank, Points, Name "
+		"FROM ("
+		"  SELECT Points, Name "
+		"  FROM %s_points "
+		"  ORDER BY Points DESC LIMIT ?"
+		") as a "
+		"LIMIT ?, 5;",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindInt(1, LimitStart + 5);
+	pSqlServer->BindInt(2, LimitStart);
+
+	// show top points
+	str_copy(paMessages[0], "-------- Top Points --------", sizeof(paMessages[0]));
+
+	bool End = false;
+	int Line = 1;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		int Rank = pSqlServer->GetInt(1);
+		int Points = pSqlServer->GetInt(2);
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(3, aName, sizeof(aName));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Points: %d", Rank, aName, Points);
+		Line++;
+	}
+	if(!End)
+	{
+		return true;
+	}
+	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+
+	return false;
+}
+
+bool CScoreWorker::RandomMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlRandomMapRequest *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
+	CScoreRandomMapResult *pResult = dynamic_cast<CScoreRandomMapResult *>(pGameData->m_pResult.get());
+
+	char aBuf[512];
+	if(0 <= pData->m_Stars && pData->m_Stars <= 5)
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Map FROM %s_maps "
+			"WHERE Server = ? AND Map != ? AND Stars = ? "
+			"ORDER BY %s LIMIT 1;",
+			pSqlServer->GetPrefix(), pSqlServer->Random());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindInt(3, pData->m_Stars);
+	}
+	else
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Map FROM %s_maps "
+			"WHERE Server = ? AND Map != ? "
+			"ORDER BY %s LIMIT 1;",
+			pSqlServer->GetPrefix(), pSqlServer->Random());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+	}
+	pSqlServer->BindString(1, pData->m_ServerType);
+	pSqlServer->BindString(2, pData->m_CurrentMap);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		pSqlServer->GetString(1, pResult->m_Map, sizeof(pResult->m_Map));
+	}
+	else
+	{
+		str_copy(pResult->m_aMessage, "No maps found on this server!", sizeof(pResult->m_aMessage));
+	}
+	return false;
+}
+
+bool CScoreWorker::RandomUnfinishedMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlRandomMapRequest *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
+	CScoreRandomMapResult *pResult = dynamic_cast<CScoreRandomMapResult *>(pGameData->m_pResult.get());
+
+	char aBuf[512];
+	if(pData->m_Stars >= 0)
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Map "
+			"FROM %s_maps "
+			"WHERE Server = ? AND Map != ? AND Stars = ? AND Map NOT IN ("
+			"  SELECT Map "
+			"  FROM %s_race "
+			"  WHERE Name = ?"
+			") ORDER BY %s "
+			"LIMIT 1;",
+			pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->Random());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_ServerType);
+		pSqlServer->BindString(2, pData->m_CurrentMap);
+		pSqlServer->BindInt(3, pData->m_Stars);
+		pSqlServer->BindString(4, pData->m_RequestingPlayer);
+	}
+	else
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Map "
+			"FROM %s_maps AS maps "
+			"WHERE Server = ? AND Map != ? AND Map NOT IN ("
+			"  SELECT Map "
+			"  FROM %s_race as race "
+			"  WHERE Name = ?"
+			") ORDER BY %s "
+			"LIMIT 1;",
+			pSqlServer->GetPrefix(), pSqlServer->GetPrefix(), pSqlServer->Random());
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_ServerType);
+		pSqlServer->BindString(2, pData->m_CurrentMap);
+		pSqlServer->BindString(3, pData->m_RequestingPlayer);
+	}
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		pSqlServer->GetString(1, pResult->m_Map, sizeof(pResult->m_Map));
+	}
+	else
+	{
+		str_copy(pResult->m_aMessage, "You have no more unfinished maps on this server!", sizeof(pResult->m_aMessage));
+	}
+	return false;
+}
+
+bool CScoreWorker::GetSavesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlPlayerRequest *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	CScorePlayerResult *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	char aSaveLike[128] = "";
+	str_append(aSaveLike, "%\n", sizeof(aSaveLike));
+	sqlstr::EscapeLike(aSaveLike + str_length(aSaveLike),
+		pData->m_RequestingPlayer,
+		sizeof(aSaveLike) - str_length(aSaveLike));
+	str_append(aSaveLike, "\t%", sizeof(aSaveLike));
+
+	char aCurrentTimestamp[512];
+	pSqlServer->ToUnixTimestamp("CURRENT_TIMESTAMP", aCurrentTimestamp, sizeof(aCurrentTimestamp));
+	char aMaxTimestamp[512];
+	pSqlServer->ToUnixTimestamp("MAX(Timestamp)", aMaxTimestamp, sizeof(aMaxTimestamp));
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT COUNT(*) AS NumSaves, %s-%s AS Ago "
+		"FROM %s_saves "
+		"WHERE Map = ? AND Savegame LIKE ?;",
+		aCurrentTimestamp, aMaxTimestamp,
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_Map);
+	pSqlServer->BindString(2, aSaveLike);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(!End)
+	{
+		int NumSaves = pSqlServer->GetInt(1);
+		int Ago = pSqlServer->GetInt(2);
+		char aAgoString[40] = "\0";
+		char aLastSavedString[60] = "\0";
+		if(Ago)
+		{
+			sqlstr::AgoTimeToString(Ago, aAgoString, sizeof(aAgoString));
+			str_format(aLastSavedString, sizeof(aLastSavedString), ", last saved %s ago", aAgoString);
+		}
+
+		str_format(paMessages[0], sizeof(paMessages[0]),
+			"%s has %d save%s on %s%s",
+			pData->m_RequestingPlayer,
+			NumSaves, NumSaves == 1 ? "" : "s",
+			pData->m_Map, aLastSavedString);
+	}
+	return false;
+}
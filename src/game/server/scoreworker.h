@@ -0,0 +1,44 @@
+#ifndef GAME_SERVER_SCOREWORKER_H
+#define GAME_SERVER_SCOREWORKER_H
+
+#include "score.h"
+
+#include <vector>
+
+class IDbConnection;
+struct ISqlData;
+
+// the database side of CScore, run on the workers of CDbConnectionPool.
+// returns true on failure like the pool expects
+struct CScoreWorker
+{
+	static bool Init(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool LoadRanksThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+
+	static bool RandomMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool RandomUnfinishedMapThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool MapVoteThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+
+	static bool LoadPlayerDataThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool MapInfoThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowTeamRankThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowTopThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowPlayerTeamTop5Thread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowTimesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool ShowTopPointsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool GetSavesThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+
+	// batched, see CDbConnectionPool::ExecuteWriteBatch
+	static bool SaveScoreThread(IDbConnection *pSqlServer, const ISqlData *const *ppGameData, int NumData, bool Failure, char *pError, int ErrorSize);
+	static bool SaveTeamScoreThread(IDbConnection *pSqlServer, const ISqlData *const *ppGameData, int NumData, bool Failure, char *pError, int ErrorSize);
+	static bool SaveMapScores(IDbConnection *pSqlServer, const std::vector<const CSqlScoreData *> &vpData, char *pError, int ErrorSize);
+	static bool SaveMapTeamScore(IDbConnection *pSqlServer, const CSqlTeamScoreData *pData, char *pError, int ErrorSize);
+
+	// also used for the ranks answered from memory
+	static void FormatRank(CScorePlayerResult *pResult, const CSqlPlayerRequest *pData, int Rank, float Time, float PercentRank, const char *pRegionalRank);
+};
+
+#endif // GAME_SERVER_SCOREWORKER_H
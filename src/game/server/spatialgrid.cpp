@@ -0,0 +1,60 @@
+#include "spatialgrid.h"
+
+#include <base/math.h>
+
+CSpatialGrid::CSpatialGrid()
+{
+	Clear();
+}
+
+void CSpatialGrid::Clear()
+{
+	for(auto &pCell : m_apCells)
+		pCell = 0;
+}
+
+int CSpatialGrid::CellCoord(float Value)
+{
+	// keep far away and invalid positions in range, the grid wraps anyway
+	if(!(Value > -1e9f))
+		Value = -1e9f;
+	else if(Value > 1e9f)
+		Value = 1e9f;
+	return round_truncate(Value) >> CELL_SHIFT;
+}
+
+void CSpatialGrid::Insert(CNode *pNode, vec2 Pos)
+{
+	int Cell = CellIndex(CellCoord(Pos.x), CellCoord(Pos.y));
+	pNode->m_Cell = Cell;
+	pNode->m_pPrev = 0;
+	pNode->m_pNext = m_apCells[Cell];
+	if(m_apCells[Cell])
+		m_apCells[Cell]->m_pPrev = pNode;
+	m_apCells[Cell] = pNode;
+}
+
+void CSpatialGrid::Remove(CNode *pNode)
+{
+	if(pNode->m_Cell < 0)
+		return;
+
+	if(pNode->m_pPrev)
+		pNode->m_pPrev->m_pNext = pNode->m_pNext;
+	else
+		m_apCells[pNode->m_Cell] = pNode->m_pNext;
+	if(pNode->m_pNext)
+		pNode->m_pNext->m_pPrev = pNode->m_pPrev;
+
+	pNode->m_pPrev = 0;
+	pNode->m_pNext = 0;
+	pNode->m_Cell = -1;
+}
+
+void CSpatialGrid::Move(CNode *pNode, vec2 Pos)
+{
+	if(pNode->m_Cell < 0 || pNode->m_Cell == CellIndex(CellCoord(Pos.x), CellCoord(Pos.y)))
+		return;
+	Remove(pNode);
+	Insert(pNode, Pos);
+}
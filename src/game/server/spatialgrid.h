@@ -0,0 +1,81 @@
+#ifndef GAME_SERVER_SPATIALGRID_H
+#define GAME_SERVER_SPATIALGRID_H
+
+#include <base/vmath.h>
+
+/*
+	Class: Spatial Grid
+		Uniform grid that buckets nodes by position. The grid wraps
+		around, so a cell can contain nodes from far away positions;
+		queries return candidates that still need an exact check.
+*/
+class CSpatialGrid
+{
+public:
+	enum
+	{
+		CELL_SHIFT = 8, // 256 units, 8 tiles
+		CELL_SIZE = 1 << CELL_SHIFT,
+		GRID_BITS = 6,
+		GRID_SIZE = 1 << GRID_BITS,
+		GRID_MASK = GRID_SIZE - 1,
+		NUM_CELLS = GRID_SIZE * GRID_SIZE,
+	};
+
+	class CNode
+	{
+	public:
+		CNode() :
+			m_pPrev(0), m_pNext(0), m_Cell(-1), m_pUser(0) {}
+
+		CNode *m_pPrev;
+		CNode *m_pNext;
+		int m_Cell;
+		void *m_pUser;
+	};
+
+	CSpatialGrid();
+
+	void Insert(CNode *pNode, vec2 Pos);
+	void Remove(CNode *pNode);
+	// only relinks the node if it changed its cell
+	void Move(CNode *pNode, vec2 Pos);
+	void Clear();
+
+	static int CellCoord(float Value);
+	static int CellIndex(int x, int y) { return (x & GRID_MASK) + (y & GRID_MASK) * GRID_SIZE; }
+
+	/*
+		Function: QueryBox
+			Calls Fn for every node in the cells overlapping the box.
+			Every node is visited at most once.
+	*/
+	template<typename F>
+	void QueryBox(vec2 Min, vec2 Max, F Fn) const
+	{
+		int x0 = CellCoord(Min.x);
+		int y0 = CellCoord(Min.y);
+		int x1 = CellCoord(Max.x);
+		int y1 = CellCoord(Max.y);
+		if(x1 - x0 >= GRID_SIZE)
+		{
+			x0 = 0;
+			x1 = GRID_SIZE - 1;
+		}
+		if(y1 - y0 >= GRID_SIZE)
+		{
+			y0 = 0;
+			y1 = GRID_SIZE - 1;
+		}
+
+		for(int y = y0; y <= y1; y++)
+			for(int x = x0; x <= x1; x++)
+				for(CNode *pNode = m_apCells[CellIndex(x, y)]; pNode; pNode = pNode->m_pNext)
+					Fn(pNode);
+	}
+
+private:
+	CNode *m_apCells[NUM_CELLS];
+};
+
+#endif
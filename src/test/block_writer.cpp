@@ -0,0 +1,130 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/block_writer.h>
+
+#include <vector>
+
+#include <zlib.h>
+
+class BlockWriter : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	std::vector<unsigned char> m_vExpected;
+
+	CBlockWriter *Open(int Compression)
+	{
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_WRITE);
+		EXPECT_TRUE(File);
+		return new CBlockWriter(File, Compression);
+	}
+
+	// ticks of different sizes, made of small writes like the teehistorian.
+	// Paced waits for each tick to be written, so blocks aren't merged
+	void WriteTicks(CBlockWriter *pWriter, int NumTicks, bool Paced = false)
+	{
+		for(int Tick = 0; Tick < NumTicks; Tick++)
+		{
+			for(int i = 0; i < Tick % 100; i++)
+			{
+				unsigned char aData[7];
+				for(unsigned j = 0; j < sizeof(aData); j++)
+					aData[j] = (Tick * 31 + i * 7 + j) % 251;
+				pWriter->Write(aData, sizeof(aData));
+				m_vExpected.insert(m_vExpected.end(), aData, aData + sizeof(aData));
+			}
+			pWriter->Flush(Tick % 250 == 0);
+
+			CBlockWriter::CStats Stats;
+			pWriter->GetStats(&Stats);
+			while(Paced && Stats.m_BacklogBlocks)
+			{
+				thread_yield();
+				pWriter->GetStats(&Stats);
+			}
+		}
+	}
+
+	std::vector<unsigned char> ReadFile()
+	{
+		std::vector<unsigned char> vData;
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_READ);
+		EXPECT_TRUE(File);
+		if(File)
+		{
+			vData.resize(io_length(File));
+			EXPECT_EQ(io_read(File, vData.data(), vData.size()), vData.size());
+			io_close(File);
+		}
+		return vData;
+	}
+
+	~BlockWriter()
+	{
+		if(!HasFailure())
+			fs_remove(m_Info.m_aFilename);
+	}
+};
+
+static unsigned ReadLittleEndian(const unsigned char *pData)
+{
+	return pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((unsigned)pData[3] << 24);
+}
+
+TEST_F(BlockWriter, Uncompressed)
+{
+	CBlockWriter *pWriter = Open(CBlockWriter::COMPRESSION_NONE);
+	WriteTicks(pWriter, 1000);
+	EXPECT_EQ(pWriter->Close(), 0);
+
+	CBlockWriter::CStats Stats;
+	pWriter->GetStats(&Stats);
+	EXPECT_EQ(Stats.m_BytesIn, (int64_t)m_vExpected.size());
+	EXPECT_EQ(Stats.m_BytesOut, (int64_t)m_vExpected.size());
+	EXPECT_EQ(Stats.m_BacklogBytes, 0);
+	EXPECT_EQ(Stats.m_BacklogBlocks, 0);
+	delete pWriter;
+
+	EXPECT_EQ(ReadFile(), m_vExpected);
+}
+
+TEST_F(BlockWriter, Frames)
+{
+	CBlockWriter *pWriter = Open(CBlockWriter::COMPRESSION_ZLIB);
+	WriteTicks(pWriter, 3000, true);
+	EXPECT_EQ(pWriter->Close(), 0);
+	CBlockWriter::CStats Stats;
+	pWriter->GetStats(&Stats);
+	delete pWriter;
+
+	// every frame decompresses on its own
+	std::vector<unsigned char> vFile = ReadFile();
+	std::vector<unsigned char> vData;
+	int NumFrames = 0;
+	unsigned Pos = 0;
+	while(Pos < vFile.size())
+	{
+		ASSERT_LE(Pos + CBlockWriter::FRAME_HEADER_SIZE, vFile.size());
+		ASSERT_EQ(mem_comp(&vFile[Pos], CBlockWriter::ms_aFrameMarker, sizeof(CBlockWriter::ms_aFrameMarker)), 0);
+		unsigned CompressedSize = ReadLittleEndian(&vFile[Pos + 4]);
+		unsigned long Size = ReadLittleEndian(&vFile[Pos + 8]);
+		Pos += CBlockWriter::FRAME_HEADER_SIZE;
+		ASSERT_LE(Pos + CompressedSize, vFile.size());
+		EXPECT_LE(Size, (unsigned long)CBlockWriter::FRAME_SIZE + 100 * 7);
+
+		std::vector<unsigned char> vFrame(Size);
+		ASSERT_EQ(uncompress(vFrame.data(), &Size, &vFile[Pos], CompressedSize), Z_OK);
+		ASSERT_EQ(Size, vFrame.size());
+		vData.insert(vData.end(), vFrame.begin(), vFrame.end());
+		Pos += CompressedSize;
+		NumFrames++;
+	}
+	EXPECT_EQ(vData, m_vExpected);
+	// at least one frame per sync point
+	EXPECT_GE(NumFrames, 3000 / 250);
+	EXPECT_EQ(NumFrames, Stats.m_NumFrames);
+	EXPECT_EQ(Stats.m_BytesOut, (int64_t)vFile.size());
+	EXPECT_LT(vFile.size(), m_vExpected.size());
+}
@@ -0,0 +1,288 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <vector>
+
+class CTestMap : public IMap
+{
+public:
+	enum
+	{
+		WIDTH = 100,
+		HEIGHT = 48,
+	};
+
+	CMapItemGroup m_Group;
+	CMapItemLayerTilemap m_aLayers[2];
+	CTile m_aGameTiles[WIDTH * HEIGHT];
+	CTile m_aFrontTiles[WIDTH * HEIGHT];
+
+	CTestMap(unsigned Seed)
+	{
+		mem_zero(&m_Group, sizeof(m_Group));
+		m_Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		m_Group.m_StartLayer = 0;
+		m_Group.m_NumLayers = 2;
+
+		mem_zero(m_aLayers, sizeof(m_aLayers));
+		for(int i = 0; i < 2; i++)
+		{
+			m_aLayers[i].m_Layer.m_Type = LAYERTYPE_TILES;
+			m_aLayers[i].m_Version = 3;
+			m_aLayers[i].m_Width = WIDTH;
+			m_aLayers[i].m_Height = HEIGHT;
+		}
+		m_aLayers[0].m_Flags = TILESLAYERFLAG_GAME;
+		m_aLayers[0].m_Data = 0;
+		m_aLayers[1].m_Flags = TILESLAYERFLAG_FRONT;
+		m_aLayers[1].m_Front = 1;
+
+		// sparse solid, death and through tiles, stoppers and tiles that make
+		// TileExists true
+		static const int s_aTiles[] = {TILE_SOLID, TILE_NOHOOK, TILE_DEATH, TILE_THROUGH, TILE_FREEZE, TILE_UNFREEZE, TILE_START, TILE_FINISH, TILE_STOP, TILE_STOPS, TILE_STOPA};
+		mem_zero(m_aGameTiles, sizeof(m_aGameTiles));
+		mem_zero(m_aFrontTiles, sizeof(m_aFrontTiles));
+		for(int i = 0; i < WIDTH * HEIGHT; i++)
+		{
+			Seed = Seed * 1103515245 + 12345;
+			if((Seed >> 16) % 4 == 0)
+			{
+				CTile *pTile = (Seed >> 8) % 3 == 0 ? &m_aFrontTiles[i] : &m_aGameTiles[i];
+				pTile->m_Index = s_aTiles[(Seed >> 20) % (sizeof(s_aTiles) / sizeof(s_aTiles[0]))];
+				pTile->m_Flags = (Seed >> 24) % 4 == 0 ? ROTATION_90 : ROTATION_0;
+			}
+		}
+	}
+
+	void *GetData(int Index) override { return Index == 0 ? (void *)m_aGameTiles : (void *)m_aFrontTiles; }
+	int GetDataSize(int Index) override { return sizeof(m_aGameTiles); }
+	void *GetDataSwapped(int Index) override { return GetData(Index); }
+	void UnloadData(int Index) override {}
+	void *GetItem(int Index, int *pType, int *pID) override
+	{
+		if(Index == 0)
+			return &m_Group;
+		return &m_aLayers[Index - 1];
+	}
+	int GetItemSize(int Index) override { return Index == 0 ? sizeof(m_Group) : sizeof(m_aLayers[0]); }
+	void GetType(int Type, int *pStart, int *pNum) override
+	{
+		*pStart = Type == MAPITEMTYPE_GROUP ? 0 : 1;
+		*pNum = Type == MAPITEMTYPE_GROUP ? 1 : Type == MAPITEMTYPE_LAYER ? 2 : 0;
+	}
+	void *FindItem(int Type, int ID) override { return 0; }
+	int NumItems() override { return 3; }
+};
+
+// the list based implementation the traversal replaced
+static std::vector<int> ReferenceMapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> vIndices;
+	int Width = Collision.GetWidth();
+	int Height = Collision.GetHeight();
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+	{
+		int Nx = clamp((int)Pos.x / 32, 0, Width - 1);
+		int Ny = clamp((int)Pos.y / 32, 0, Height - 1);
+		int Index = Ny * Width + Nx;
+		if(Collision.TileExists(Index))
+			vIndices.push_back(Index);
+		return vIndices;
+	}
+
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		float a = i / d;
+		vec2 Tmp = mix(PrevPos, Pos, a);
+		int Nx = clamp((int)Tmp.x / 32, 0, Width - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Height - 1);
+		int Index = Ny * Width + Nx;
+		if(Collision.TileExists(Index) && LastIndex != Index)
+		{
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+static std::vector<int> MapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> vIndices;
+	int Num = Collision.ForEachMapIndex(PrevPos, Pos, [&](int Index) {
+		vIndices.push_back(Index);
+		return true;
+	});
+	EXPECT_EQ(Num, (int)vIndices.size());
+	return vIndices;
+}
+
+class Collision : public ::testing::Test
+{
+protected:
+	CTestMap m_Map;
+	IKernel *m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	Collision() :
+		m_Map(1)
+	{
+		m_pKernel = IKernel::Create();
+		m_pKernel->RegisterInterface(static_cast<IMap *>(&m_Map), false);
+		m_Layers.Init(m_pKernel);
+		m_Collision.Init(&m_Layers);
+	}
+
+	~Collision()
+	{
+		delete m_pKernel;
+	}
+};
+
+TEST_F(Collision, MapIndicesStationary)
+{
+	for(int y = 0; y < CTestMap::HEIGHT; y++)
+		for(int x = 0; x < CTestMap::WIDTH; x++)
+		{
+			vec2 Pos(x * 32 + 16, y * 32 + 16);
+			EXPECT_EQ(MapIndices(m_Collision, Pos, Pos), ReferenceMapIndices(m_Collision, Pos, Pos));
+		}
+}
+
+TEST_F(Collision, MapIndicesMovement)
+{
+	// replay tees flying around the map, bouncing off the borders and
+	// occasionally teleporting across it or leaving the map area
+	unsigned Seed = 7;
+	const vec2 MapSize(CTestMap::WIDTH * 32, CTestMap::HEIGHT * 32);
+	for(int Tee = 0; Tee < 16; Tee++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		vec2 Pos((Seed >> 8) % (int)MapSize.x, (Seed >> 16) % (int)MapSize.y);
+		vec2 Vel(0, 0);
+		for(int Tick = 0; Tick < 2000; Tick++)
+		{
+			vec2 PrevPos = Pos;
+			Seed = Seed * 1103515245 + 12345;
+			int Action = (Seed >> 16) % 64;
+			if(Action == 0)
+				Pos = vec2((Seed >> 4) % (int)MapSize.x, (Seed >> 8) % (int)MapSize.y);
+			else if(Action == 1)
+				Vel = vec2(-Vel.x * 3, -Vel.y * 3);
+			else
+			{
+				if(Action < 8)
+					Vel += vec2(((int)(Seed >> 8) % 31) - 15, -((int)(Seed >> 4) % 20));
+				Vel.y += 0.5f;
+				Vel = vec2(clamp(Vel.x, -60.0f, 60.0f), clamp(Vel.y, -60.0f, 60.0f));
+				Pos += Vel;
+				if(Pos.x < -64 || Pos.x > MapSize.x + 64)
+					Vel.x = -Vel.x;
+				if(Pos.y < -64 || Pos.y > MapSize.y + 64)
+					Vel.y = -Vel.y;
+			}
+			EXPECT_EQ(MapIndices(m_Collision, PrevPos, Pos), ReferenceMapIndices(m_Collision, PrevPos, Pos));
+		}
+	}
+}
+
+TEST_F(Collision, MapIndicesStop)
+{
+	vec2 PrevPos(16, 16);
+	vec2 Pos(CTestMap::WIDTH * 32 - 16, CTestMap::HEIGHT * 32 - 16);
+	std::vector<int> vAll = ReferenceMapIndices(m_Collision, PrevPos, Pos);
+	ASSERT_GT(vAll.size(), 3u);
+
+	std::vector<int> vIndices;
+	int Num = m_Collision.ForEachMapIndex(PrevPos, Pos, [&](int Index) {
+		vIndices.push_back(Index);
+		return vIndices.size() < 3;
+	});
+	EXPECT_EQ(Num, 3);
+	EXPECT_EQ(vIndices, std::vector<int>(vAll.begin(), vAll.begin() + 3));
+}
+
+static bool ReferenceTestBox(const CCollision &Collision, vec2 Pos, vec2 Size, bool Death)
+{
+	Size *= 0.5f;
+	for(int i = 0; i < 4; i++)
+	{
+		vec2 Corner(Pos.x + (i & 1 ? Size.x : -Size.x), Pos.y + (i & 2 ? Size.y : -Size.y));
+		int Tile = Collision.GetCollisionAt(Corner.x, Corner.y);
+		if(Death && (Tile == TILE_DEATH || Collision.GetFCollisionAt(Corner.x, Corner.y) == TILE_DEATH))
+			return true;
+		if(!Death && (Tile == TILE_SOLID || Tile == TILE_NOHOOK))
+			return true;
+	}
+	return false;
+}
+
+TEST_F(Collision, TestBox)
+{
+	unsigned Seed = 3;
+	const vec2 MapSize(CTestMap::WIDTH * 32, CTestMap::HEIGHT * 32);
+	for(int i = 0; i < 100000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		vec2 Pos((int)((Seed >> 4) % (int)(MapSize.x + 256)) - 128, (int)((Seed >> 12) % (int)(MapSize.y + 256)) - 128);
+		Pos += vec2(((Seed >> 20) % 100) / 100.0f, ((Seed >> 24) % 100) / 100.0f);
+		vec2 Size(28.0f, 28.0f);
+		if(i % 4 == 0)
+			Size = vec2((Seed >> 8) % 200, (Seed >> 16) % 200);
+		ASSERT_EQ(m_Collision.TestBox(Pos, Size), ReferenceTestBox(m_Collision, Pos, Size, false));
+		ASSERT_EQ(m_Collision.TestBoxDeath(Pos, Size), ReferenceTestBox(m_Collision, Pos, Size, true));
+		ASSERT_EQ(m_Collision.CheckPoint(Pos), ReferenceTestBox(m_Collision, Pos, vec2(0, 0), false));
+	}
+}
+
+TEST_F(Collision, SetCollisionAt)
+{
+	for(int x = 0; x < CTestMap::WIDTH; x++)
+	{
+		vec2 Pos(x * 32 + 16, 5 * 32 + 16);
+		m_Collision.SetCollisionAt(Pos.x, Pos.y, x % 2 ? TILE_SOLID : TILE_AIR);
+		EXPECT_EQ(m_Collision.CheckPoint(Pos), x % 2 == 1);
+		EXPECT_EQ(m_Collision.TestBox(Pos, vec2(28.0f, 28.0f)), x % 2 == 1);
+	}
+}
+
+TEST_F(Collision, IntersectLineHitTile)
+{
+	// the hit tile comes from the tile bits, it has to be the tile there
+	unsigned Seed = 5;
+	const vec2 MapSize(CTestMap::WIDTH * 32, CTestMap::HEIGHT * 32);
+	int NumNoHook = 0;
+	for(int i = 0; i < 10000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		vec2 Pos0((Seed >> 4) % (int)MapSize.x, (Seed >> 12) % (int)MapSize.y);
+		Seed = Seed * 1103515245 + 12345;
+		vec2 Pos1 = Pos0 + vec2((int)((Seed >> 4) % 800) - 400, (int)((Seed >> 12) % 800) - 400);
+		vec2 Collision;
+		int Hit = m_Collision.IntersectLine(Pos0, Pos1, &Collision, 0);
+		if(Hit)
+		{
+			ASSERT_EQ(Hit, m_Collision.GetCollisionAt(Collision.x, Collision.y));
+			NumNoHook += Hit == TILE_NOHOOK;
+		}
+	}
+	EXPECT_GT(NumNoHook, 0);
+
+	vec2 Pos(10 * 32 + 16, 5 * 32 + 16);
+	m_Collision.SetCollisionAt(Pos.x - 64, Pos.y, TILE_AIR);
+	m_Collision.SetCollisionAt(Pos.x - 32, Pos.y, TILE_AIR);
+	m_Collision.SetCollisionAt(Pos.x, Pos.y, TILE_NOHOOK);
+	EXPECT_EQ(m_Collision.IntersectLine(Pos - vec2(64, 0), Pos, 0, 0), TILE_NOHOOK);
+	m_Collision.SetCollisionAt(Pos.x, Pos.y, TILE_SOLID);
+	EXPECT_EQ(m_Collision.IntersectLine(Pos - vec2(64, 0), Pos, 0, 0), TILE_SOLID);
+}
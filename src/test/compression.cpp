@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+
+#include <climits>
+#include <vector>
+
+// CVariableInt::Compress and Decompress before the fast paths, the results
+// have to stay the same for every input
+static long ReferenceDecompress(const void *pSrc_, int Size, void *pDst_, int DstSize)
+{
+	const unsigned char *pSrc = (unsigned char *)pSrc_;
+	const unsigned char *pEnd = pSrc + Size;
+	int *pDst = (int *)pDst_;
+	int *pDstEnd = pDst + DstSize / 4;
+	while(pSrc < pEnd)
+	{
+		if(pDst >= pDstEnd)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, pDst);
+		pDst++;
+	}
+	return (unsigned char *)pDst - (unsigned char *)pDst_;
+}
+
+static long ReferenceCompress(const void *pSrc_, int Size, void *pDst_, int DstSize)
+{
+	int *pSrc = (int *)pSrc_;
+	unsigned char *pDst = (unsigned char *)pDst_;
+	unsigned char *pDstEnd = pDst + DstSize;
+	Size /= 4;
+	while(Size)
+	{
+		if(pDstEnd - pDst < 6)
+			return -1;
+		pDst = CVariableInt::Pack(pDst, *pSrc);
+		Size--;
+		pSrc++;
+	}
+	return pDst - (unsigned char *)pDst_;
+}
+
+class CRandom
+{
+	unsigned m_Seed;
+
+public:
+	CRandom(unsigned Seed) :
+		m_Seed(Seed) {}
+	int operator()(int Max)
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return (m_Seed >> 8) % Max;
+	}
+};
+
+// mostly zeros and small values with a few big ones, like snapshot deltas
+static int RandomInt(CRandom &Random)
+{
+	static const int s_aEdges[] = {63, 64, -64, -65, 8191, 8192, -8192, -8193, INT_MAX, INT_MIN, INT_MAX - 63, INT_MIN + 64};
+	switch(Random(8))
+	{
+	case 0: return Random(128) - 64;
+	case 1: return Random(1 << 20) - (1 << 19);
+	case 2: return Random(1 << 24) * (Random(2) ? 256 : -256);
+	case 3: return s_aEdges[Random(sizeof(s_aEdges) / sizeof(s_aEdges[0]))];
+	default: return Random(4) ? 0 : Random(8) - 4;
+	}
+}
+
+TEST(VariableInt, SameAsReferenceCompress)
+{
+	CRandom Random(1);
+	for(int i = 0; i < 20000; i++)
+	{
+		std::vector<int> vData(Random(4) ? Random(64) : Random(1024));
+		for(auto &Value : vData)
+			Value = RandomInt(Random);
+
+		int DstSize = Random(2) ? vData.size() * 6 + 6 : Random(vData.size() * 3 + 8);
+		std::vector<unsigned char> vOut(DstSize + 16);
+		std::vector<unsigned char> vReferenceOut(DstSize + 16);
+		long Size = CVariableInt::Compress(vData.data(), vData.size() * sizeof(int), vOut.data(), DstSize);
+		long ReferenceSize = ReferenceCompress(vData.data(), vData.size() * sizeof(int), vReferenceOut.data(), DstSize);
+		ASSERT_EQ(Size, ReferenceSize);
+		if(Size > 0)
+		{
+			ASSERT_EQ(mem_comp(vOut.data(), vReferenceOut.data(), Size), 0);
+		}
+	}
+}
+
+TEST(VariableInt, SameAsReferenceDecompress)
+{
+	CRandom Random(2);
+	for(int i = 0; i < 20000; i++)
+	{
+		std::vector<unsigned char> vData;
+		if(Random(2))
+		{
+			// valid data
+			std::vector<int> vInts(Random(4) ? Random(64) : Random(1024));
+			for(auto &Value : vInts)
+				Value = RandomInt(Random);
+			vData.resize(vInts.size() * 6 + 6);
+			vData.resize(ReferenceCompress(vInts.data(), vInts.size() * sizeof(int), vData.data(), vData.size()));
+			if(Random(4) == 0 && !vData.empty())
+				vData.resize(Random(vData.size()));
+		}
+		else
+		{
+			// garbage, with few or many extended bytes
+			vData.resize(Random(1024));
+			int Extended = Random(4) ? 16 : 256;
+			for(auto &Byte : vData)
+				Byte = Random(Extended) == 0 ? 0x80 | Random(128) : Random(128);
+		}
+		// the decompression reads up to 4 bytes past the end of broken data
+		int Size = vData.size();
+		for(int j = 0; j < 4; j++)
+			vData.push_back(Random(256));
+
+		int DstSize = Random(2) ? Size * 4 + 4 : Random(Size * 4 + 8);
+		std::vector<int> vOut(DstSize / 4 + 1);
+		std::vector<int> vReferenceOut(DstSize / 4 + 1);
+		long OutSize = CVariableInt::Decompress(vData.data(), Size, vOut.data(), DstSize);
+		long ReferenceOutSize = ReferenceDecompress(vData.data(), Size, vReferenceOut.data(), DstSize);
+		ASSERT_EQ(OutSize, ReferenceOutSize);
+		if(OutSize > 0)
+		{
+			ASSERT_EQ(mem_comp(vOut.data(), vReferenceOut.data(), OutSize), 0);
+		}
+	}
+}
@@ -5,6 +5,8 @@
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
 
+#include <vector>
+
 TEST(Datafile, ExtendedType)
 {
 	IStorage *pStorage = CreateLocalStorage();
@@ -59,3 +61,187 @@ TEST(Datafile, ExtendedType)
 
 	delete pStorage;
 }
+
+TEST(Datafile, DataCache)
+{
+	IStorage *pStorage = CreateLocalStorage();
+	CTestInfo Info;
+
+	const int NumData = 4;
+	const int DataSize = 64 * 1024;
+	static int s_aaData[NumData][DataSize / sizeof(int)];
+	for(int i = 0; i < NumData; i++)
+		for(int j = 0; j < (int)(DataSize / sizeof(int)); j++)
+			s_aaData[i][j] = i * 1000 + j % 100;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage, Info.m_aFilename);
+		for(auto &aData : s_aaData)
+			Writer.AddData(DataSize, aData);
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage, Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_EQ(Reader.NumData(), NumData);
+
+		// callers share the same inflated data
+		Reader.SetDataCacheSize(NumData * DataSize);
+		void *pData = Reader.GetData(0);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(Reader.GetData(0), pData);
+		EXPECT_EQ(Reader.GetDataSize(0), DataSize);
+		EXPECT_EQ(mem_comp(pData, s_aaData[0], DataSize), 0);
+		Reader.UnloadData(0);
+		Reader.UnloadData(0);
+
+		// unloaded data stays cached
+		EXPECT_EQ(Reader.GetData(0), pData);
+		Reader.UnloadData(0);
+
+		// only two blocks fit, the least recently used one is evicted
+		Reader.SetDataCacheSize(2 * DataSize);
+		for(int i = 0; i < NumData; i++)
+		{
+			void *pOther = Reader.GetData(i);
+			ASSERT_TRUE(pOther);
+			EXPECT_EQ(mem_comp(pOther, s_aaData[i], DataSize), 0);
+			Reader.UnloadData(i);
+		}
+
+		// data in use is never evicted
+		Reader.SetDataCacheSize(0);
+		pData = Reader.GetData(1);
+		for(int i = 0; i < NumData; i++)
+		{
+			EXPECT_EQ(mem_comp(Reader.GetData(i), s_aaData[i], DataSize), 0);
+			Reader.UnloadData(i);
+		}
+		EXPECT_EQ(mem_comp(pData, s_aaData[1], DataSize), 0);
+		Reader.UnloadData(1);
+
+		EXPECT_FALSE(Reader.GetData(NumData));
+		Reader.UnloadData(NumData);
+	}
+
+	{
+		// the same data read from a mapping
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage, Info.m_aFilename, IStorage::TYPE_ALL, true));
+		for(int i = 0; i < NumData; i++)
+		{
+			EXPECT_EQ(mem_comp(Reader.GetData(i), s_aaData[i], DataSize), 0);
+			Reader.UnloadData(i);
+		}
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+
+	delete pStorage;
+}
+
+class CBlockingJob : public IJob
+{
+	CSemaphore *m_pRelease;
+
+	void Run() override { m_pRelease->Wait(); }
+
+public:
+	CBlockingJob(CSemaphore *pRelease) :
+		m_pRelease(pRelease) {}
+};
+
+static void WriteDatafile(IStorage *pStorage, const char *pFilename, CJobPool *pJobPool, int CompressionLevel, const std::vector<std::vector<int>> &vvData)
+{
+	CDataFileWriter Writer;
+	Writer.SetJobPool(pJobPool);
+	Writer.SetCompressionLevel(CompressionLevel);
+	ASSERT_TRUE(Writer.Open(pStorage, pFilename));
+	for(const auto &vData : vvData)
+		Writer.AddData(vData.size() * sizeof(int), (void *)vData.data());
+	Writer.Finish();
+}
+
+TEST(Datafile, ParallelCompression)
+{
+	IStorage *pStorage = CreateLocalStorage();
+	CTestInfo Info;
+	char aParallelFilename[64];
+	str_format(aParallelFilename, sizeof(aParallelFilename), "%s.parallel", Info.m_aFilename);
+
+	// tile layers of different sizes, some too small for a job
+	std::vector<std::vector<int>> vvData;
+	unsigned Seed = 1;
+	for(int i = 0; i < 48; i++)
+	{
+		vvData.emplace_back((i % 3 == 0 ? 64 : 64 * 1024) + i);
+		for(auto &Value : vvData.back())
+		{
+			Seed = Seed * 1103515245 + 12345;
+			Value = (Seed >> 28) < 3 ? (Seed >> 16) & 0xff : 0;
+		}
+	}
+
+	CJobPool JobPool;
+	JobPool.Init(4);
+
+	WriteDatafile(pStorage, Info.m_aFilename, 0, Z_DEFAULT_COMPRESSION, vvData);
+	WriteDatafile(pStorage, aParallelFilename, &JobPool, Z_DEFAULT_COMPRESSION, vvData);
+
+	// the same file, no matter where the data was compressed
+	{
+		CDataFileReader Reader;
+		CDataFileReader ParallelReader;
+		ASSERT_TRUE(Reader.Open(pStorage, Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_TRUE(ParallelReader.Open(pStorage, aParallelFilename, IStorage::TYPE_ALL));
+		EXPECT_EQ(Reader.Sha256(), ParallelReader.Sha256());
+		ASSERT_EQ(ParallelReader.NumData(), (int)vvData.size());
+		for(int i = 0; i < ParallelReader.NumData(); i++)
+		{
+			ASSERT_EQ(ParallelReader.GetDataSize(i), (int)(vvData[i].size() * sizeof(int)));
+			EXPECT_EQ(mem_comp(ParallelReader.GetData(i), vvData[i].data(), vvData[i].size() * sizeof(int)), 0);
+			ParallelReader.UnloadData(i);
+		}
+	}
+
+	// a busy pool doesn't hold up Finish, the queued data is compressed
+	// right there
+	{
+		CJobPool BusyPool;
+		BusyPool.Init(1);
+		CSemaphore Release;
+		BusyPool.Add(std::make_shared<CBlockingJob>(&Release));
+		WriteDatafile(pStorage, aParallelFilename, &BusyPool, Z_DEFAULT_COMPRESSION, vvData);
+		Release.Signal();
+
+		CDataFileReader Reader;
+		CDataFileReader ParallelReader;
+		ASSERT_TRUE(Reader.Open(pStorage, Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_TRUE(ParallelReader.Open(pStorage, aParallelFilename, IStorage::TYPE_ALL));
+		EXPECT_EQ(Reader.Sha256(), ParallelReader.Sha256());
+	}
+
+	WriteDatafile(pStorage, aParallelFilename, &JobPool, Z_BEST_SPEED, vvData);
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage, aParallelFilename, IStorage::TYPE_ALL));
+		for(int i = 0; i < Reader.NumData(); i++)
+		{
+			EXPECT_EQ(mem_comp(Reader.GetData(i), vvData[i].data(), vvData[i].size() * sizeof(int)), 0);
+			Reader.UnloadData(i);
+		}
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aParallelFilename, IStorage::TYPE_SAVE);
+	}
+
+	delete pStorage;
+}
@@ -0,0 +1,194 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+#include <game/generated/protocol.h>
+
+#include <memory>
+#include <vector>
+
+enum
+{
+	FIRST_TICK = 1000,
+	NUM_CHARACTERS = 32,
+};
+
+// every snapshot tells its tick, messages count the chunks
+class CTestListener : public CDemoPlayer::IListener
+{
+public:
+	int m_SnapshotTick = -1;
+	int m_NumMessages = 0;
+	std::vector<unsigned char> m_vSnapshot;
+
+	void OnDemoPlayerSnapshot(void *pData, int Size) override
+	{
+		const CSnapshot *pSnap = (const CSnapshot *)pData;
+		m_SnapshotTick = pSnap->NumItems() ? ((const CNetObj_Character *)pSnap->GetItem(0)->Data())->m_Tick : -1;
+		m_vSnapshot.assign((unsigned char *)pData, (unsigned char *)pData + Size);
+	}
+	void OnDemoPlayerMessage(void *pData, int Size) override
+	{
+		m_NumMessages++;
+	}
+};
+
+static void RecordDemo(IStorage *pStorage, const char *pFilename, CSnapshotDelta *pDelta, int NumTicks)
+{
+	// the chunks are huffman compressed
+	CNetBase::Init();
+
+	CDemoRecorder Recorder(pDelta);
+	unsigned char aMapData[16] = {0};
+	SHA256_DIGEST Sha256 = SHA256_ZEROED;
+	ASSERT_EQ(Recorder.Start(pStorage, 0, pFilename, "0.6 626fce9a778df4d4", "testmap", &Sha256, 0, "client", sizeof(aMapData), aMapData), 0);
+
+	for(int Tick = FIRST_TICK; Tick < FIRST_TICK + NumTicks; Tick++)
+	{
+		// ticks can be missing
+		if(Tick % 97 == 0)
+			continue;
+
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			CNetObj_Character *pChar = (CNetObj_Character *)Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+			mem_zero(pChar, sizeof(*pChar));
+			pChar->m_Tick = Tick;
+			pChar->m_X = (Tick * (i + 1)) % 10000;
+			pChar->m_Y = (Tick * 7 + i * 100) % 5000;
+			pChar->m_VelX = i - Tick % 32;
+			pChar->m_Direction = (Tick / 50 + i) % 3 - 1;
+		}
+		unsigned char aData[CSnapshot::MAX_SIZE];
+		int Size = Builder.Finish(aData);
+		Recorder.RecordSnapshot(Tick, aData, Size);
+
+		if(Tick % 10 == 0)
+		{
+			int aMessage[2] = {Tick, 0};
+			Recorder.RecordMessage(aMessage, sizeof(aMessage));
+		}
+	}
+	Recorder.Stop();
+}
+
+TEST(Demo, Seek)
+{
+	IStorage *pStorage = CreateLocalStorage();
+	CTestInfo Info;
+	std::unique_ptr<CSnapshotDelta> pDelta(new CSnapshotDelta());
+	RecordDemo(pStorage, Info.m_aFilename, pDelta.get(), 3000);
+
+	CTestListener KeyFrameListener;
+	CDemoPlayer KeyFramePlayer(pDelta.get());
+	KeyFramePlayer.SetListener(&KeyFrameListener);
+	ASSERT_EQ(KeyFramePlayer.Load(pStorage, 0, Info.m_aFilename, IStorage::TYPE_ALL), 0);
+
+	CTestListener SnapshotListener;
+	CDemoPlayer SnapshotPlayer(pDelta.get());
+	SnapshotPlayer.SetListener(&SnapshotListener);
+	SnapshotPlayer.SetSeekSnapshotInterval(SERVER_TICK_SPEED);
+	ASSERT_EQ(SnapshotPlayer.Load(pStorage, 0, Info.m_aFilename, IStorage::TYPE_ALL), 0);
+
+	EXPECT_EQ(KeyFramePlayer.BaseInfo()->m_FirstTick, FIRST_TICK);
+	EXPECT_EQ(SnapshotPlayer.BaseInfo()->m_LastTick, FIRST_TICK + 2999);
+
+	// both land on the same ticks with the same snapshots
+	unsigned Seed = 1;
+	for(int i = 0; i < 200; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		int Tick = FIRST_TICK - 10 + (Seed >> 8) % 3020;
+		ASSERT_EQ(KeyFramePlayer.SetPos(Tick), 0);
+		ASSERT_EQ(SnapshotPlayer.SetPos(Tick), 0);
+		const CDemoPlayer::CPlaybackInfo *pKeyFrameInfo = KeyFramePlayer.Info();
+		const CDemoPlayer::CPlaybackInfo *pSnapshotInfo = SnapshotPlayer.Info();
+		ASSERT_EQ(pKeyFrameInfo->m_PreviousTick, pSnapshotInfo->m_PreviousTick) << "tick=" << Tick;
+		ASSERT_EQ(pKeyFrameInfo->m_Info.m_CurrentTick, pSnapshotInfo->m_Info.m_CurrentTick);
+		ASSERT_EQ(pKeyFrameInfo->m_NextTick, pSnapshotInfo->m_NextTick);
+		EXPECT_GE(pSnapshotInfo->m_PreviousTick, clamp(Tick, (int)FIRST_TICK, FIRST_TICK + 2999) - 5);
+		EXPECT_EQ(SnapshotListener.m_SnapshotTick, pSnapshotInfo->m_Info.m_CurrentTick);
+		EXPECT_EQ(KeyFrameListener.m_vSnapshot, SnapshotListener.m_vSnapshot);
+	}
+
+	// step backward and forward one tick at a time
+	ASSERT_EQ(SnapshotPlayer.SetPos(FIRST_TICK + 200), 0);
+	for(int i = 0; i < 150; i++)
+	{
+		int PreviousTick = SnapshotPlayer.Info()->m_PreviousTick;
+		ASSERT_EQ(SnapshotPlayer.SeekTick(IDemoPlayer::TICK_PREVIOUS), 0);
+		EXPECT_EQ(SnapshotPlayer.Info()->m_Info.m_CurrentTick, PreviousTick);
+		EXPECT_LT(SnapshotPlayer.Info()->m_PreviousTick, PreviousTick);
+		EXPECT_EQ(SnapshotListener.m_SnapshotTick, PreviousTick);
+	}
+	for(int i = 0; i < 150; i++)
+	{
+		int NextTick = SnapshotPlayer.Info()->m_NextTick;
+		ASSERT_EQ(SnapshotPlayer.SeekTick(IDemoPlayer::TICK_NEXT), 0);
+		EXPECT_EQ(SnapshotPlayer.Info()->m_Info.m_CurrentTick, NextTick);
+		EXPECT_EQ(SnapshotListener.m_SnapshotTick, NextTick);
+	}
+	int CurrentTick = SnapshotPlayer.Info()->m_Info.m_CurrentTick;
+	ASSERT_EQ(SnapshotPlayer.SeekTick(IDemoPlayer::TICK_CURRENT), 0);
+	EXPECT_EQ(SnapshotPlayer.Info()->m_Info.m_CurrentTick, CurrentTick);
+
+	KeyFramePlayer.Stop();
+	SnapshotPlayer.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+
+	delete pStorage;
+}
+
+TEST(Demo, Slice)
+{
+	IStorage *pStorage = CreateLocalStorage();
+	CTestInfo Info;
+	std::unique_ptr<CSnapshotDelta> pDelta(new CSnapshotDelta());
+	RecordDemo(pStorage, Info.m_aFilename, pDelta.get(), 3000);
+
+	char aSliced[128];
+	str_format(aSliced, sizeof(aSliced), "%s-sliced", Info.m_aFilename);
+	CDemoEditor Editor;
+	Editor.Init("0.6 626fce9a778df4d4", pDelta.get(), 0, pStorage);
+	Editor.Slice(Info.m_aFilename, aSliced, FIRST_TICK + 1000, FIRST_TICK + 1500, 0, 0);
+
+	CTestListener Listener;
+	CDemoPlayer Player(pDelta.get());
+	Player.SetListener(&Listener);
+	ASSERT_EQ(Player.Load(pStorage, 0, aSliced, IStorage::TYPE_ALL), 0);
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, FIRST_TICK + 1000);
+	EXPECT_EQ(Player.BaseInfo()->m_LastTick, FIRST_TICK + 1500);
+	EXPECT_EQ(Player.GetMapInfo()->m_Size, 16);
+
+	// every snapshot is the one of its tick, the messages of the ticks
+	// in the slice are all there
+	ASSERT_EQ(Player.Play(), 0);
+	while(Player.IsPlaying() && !Player.Info()->m_Info.m_Paused)
+	{
+		Player.NextFrame();
+		if(Listener.m_SnapshotTick != -1)
+		{
+			EXPECT_EQ(Listener.m_SnapshotTick, Player.Info()->m_Info.m_CurrentTick);
+		}
+	}
+	EXPECT_EQ(Listener.m_NumMessages, 51);
+	Player.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aSliced, IStorage::TYPE_SAVE);
+	}
+
+	delete pStorage;
+}
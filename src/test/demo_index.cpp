@@ -0,0 +1,178 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/demo_index.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CListedDemo
+{
+	time_t m_Date;
+	int64_t m_Size;
+};
+
+static int ListCallback(const char *pName, time_t Date, int64_t Size, int IsDir, int StorageType, void *pUser)
+{
+	if(!IsDir)
+		(*(std::map<std::string, CListedDemo> *)pUser)[pName] = {Date, Size};
+	return 0;
+}
+
+static void RecordDemo(IStorage *pStorage, const char *pFilename, CSnapshotDelta *pDelta, int NumTicks)
+{
+	CNetBase::Init();
+
+	CDemoRecorder Recorder(pDelta);
+	unsigned char aMapData[16] = {0};
+	SHA256_DIGEST Sha256 = SHA256_ZEROED;
+	ASSERT_EQ(Recorder.Start(pStorage, 0, pFilename, "0.6 626fce9a778df4d4", "testmap", &Sha256, 0, "client", sizeof(aMapData), aMapData), 0);
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		int *pData = (int *)Builder.NewItem(1, 0, sizeof(int));
+		*pData = Tick;
+		unsigned char aData[CSnapshot::MAX_SIZE];
+		Recorder.RecordSnapshot(Tick, aData, Builder.Finish(aData));
+	}
+	Recorder.Stop();
+}
+
+static bool WaitForIndex(CDemoIndex *pIndex)
+{
+	for(int i = 0; i < 5000 && pIndex->NumPending(); i++)
+		thread_sleep(1000);
+	return pIndex->NumPending() == 0;
+}
+
+static std::vector<unsigned char> ReadIndexFile(IStorage *pStorage, const char *pFilename)
+{
+	std::vector<unsigned char> vData;
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return vData;
+	vData.resize(io_length(File));
+	if(io_read(File, vData.data(), vData.size()) != vData.size())
+		vData.clear();
+	io_close(File);
+	return vData;
+}
+
+static void WriteIndexFile(IStorage *pStorage, const char *pFilename, const std::vector<unsigned char> &vData)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, vData.data(), vData.size());
+	io_close(File);
+}
+
+TEST(DemoIndex, Index)
+{
+	CTestInfo Info;
+	IStorage *pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	ASSERT_TRUE(pStorage->CreateFolder("demos", IStorage::TYPE_SAVE));
+
+	std::unique_ptr<CSnapshotDelta> pDelta(new CSnapshotDelta());
+	RecordDemo(pStorage, "demos/a.demo", pDelta.get(), 100);
+	RecordDemo(pStorage, "demos/b.demo", pDelta.get(), 250);
+	IOHANDLE File = pStorage->OpenFile("demos/invalid.demo", IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, "not a demo", 10);
+	io_close(File);
+
+	std::map<std::string, CListedDemo> Listed;
+	pStorage->ListDirectoryInfo(IStorage::TYPE_SAVE, "demos", ListCallback, &Listed);
+	ASSERT_EQ(Listed.size(), 3u);
+	EXPECT_EQ(Listed["invalid.demo"].m_Size, 10);
+
+	CJobPool Pool;
+	Pool.Init(2);
+	CDemoPlayer Player(pDelta.get());
+	CDemoIndexInfo IndexInfo;
+	{
+		CDemoIndex Index;
+		Index.Init(pStorage, &Player, &Pool, "demo-index.dat");
+		for(const auto &Demo : Listed)
+		{
+			std::string Path = "demos/" + Demo.first;
+			EXPECT_FALSE(Index.Find(Path.c_str(), IStorage::TYPE_SAVE, Demo.second.m_Date, Demo.second.m_Size, &IndexInfo));
+			Index.Request(Path.c_str(), IStorage::TYPE_SAVE, Demo.second.m_Date, Demo.second.m_Size);
+			// requesting twice reads the demo once
+			Index.Request(Path.c_str(), IStorage::TYPE_SAVE, Demo.second.m_Date, Demo.second.m_Size);
+		}
+		EXPECT_EQ(Index.NumPending(), 3);
+		int Generation = Index.Generation();
+		Index.StartJob();
+		ASSERT_TRUE(WaitForIndex(&Index));
+		EXPECT_NE(Index.Generation(), Generation);
+		EXPECT_TRUE(Index.Save());
+	}
+
+	// the infos survive the restart, a changed demo isn't found
+	CDemoIndex Index;
+	Index.Init(pStorage, &Player, &Pool, "demo-index.dat");
+	ASSERT_TRUE(Index.Find("demos/b.demo", IStorage::TYPE_SAVE, Listed["b.demo"].m_Date, Listed["b.demo"].m_Size, &IndexInfo));
+	EXPECT_TRUE(IndexInfo.m_Valid);
+	EXPECT_STREQ(IndexInfo.m_Info.m_aMapName, "testmap");
+	EXPECT_EQ(IndexInfo.m_MapInfo.m_Size, 16);
+	CDemoIndexInfo DemoInfo;
+	mem_zero(&DemoInfo, sizeof(DemoInfo));
+	ASSERT_TRUE(Player.GetDemoInfo(pStorage, "demos/b.demo", IStorage::TYPE_SAVE, &DemoInfo.m_Info, &DemoInfo.m_TimelineMarkers, &DemoInfo.m_MapInfo));
+	EXPECT_EQ(mem_comp(&IndexInfo.m_Info, &DemoInfo.m_Info, sizeof(DemoInfo.m_Info)), 0);
+	EXPECT_EQ(mem_comp(&IndexInfo.m_TimelineMarkers, &DemoInfo.m_TimelineMarkers, sizeof(DemoInfo.m_TimelineMarkers)), 0);
+	ASSERT_TRUE(Index.Find("demos/invalid.demo", IStorage::TYPE_SAVE, Listed["invalid.demo"].m_Date, 10, &IndexInfo));
+	EXPECT_FALSE(IndexInfo.m_Valid);
+	EXPECT_FALSE(Index.Find("demos/a.demo", IStorage::TYPE_SAVE, Listed["a.demo"].m_Date, Listed["a.demo"].m_Size + 1, &IndexInfo));
+
+	// demos that aren't in the folder anymore are forgotten
+	Index.Prune("demos", IStorage::TYPE_SAVE, {"a.demo"});
+	EXPECT_TRUE(Index.Find("demos/a.demo", IStorage::TYPE_SAVE, Listed["a.demo"].m_Date, Listed["a.demo"].m_Size, &IndexInfo));
+	EXPECT_FALSE(Index.Find("demos/b.demo", IStorage::TYPE_SAVE, Listed["b.demo"].m_Date, Listed["b.demo"].m_Size, &IndexInfo));
+
+	Index.Shutdown();
+
+	// broken index files are thrown away instead of trusted
+	std::vector<unsigned char> vIndexFile = ReadIndexFile(pStorage, "demo-index.dat");
+	ASSERT_GT(vIndexFile.size(), 24u);
+	EXPECT_TRUE(Index.Load());
+	{
+		// an index written with a different entry layout
+		std::vector<unsigned char> vBroken = vIndexFile;
+		vBroken[12]++;
+		WriteIndexFile(pStorage, "demo-index.dat", vBroken);
+		EXPECT_FALSE(Index.Load());
+	}
+	{
+		// no valid bool in the first entry, right after the header and its key
+		std::vector<unsigned char> vBroken = vIndexFile;
+		int KeyLength;
+		mem_copy(&KeyLength, &vBroken[20], sizeof(KeyLength));
+		vBroken[24 + KeyLength + offsetof(CDemoIndex::CEntry, m_Info) + offsetof(CDemoIndexInfo, m_Valid)] = 2;
+		WriteIndexFile(pStorage, "demo-index.dat", vBroken);
+		EXPECT_FALSE(Index.Load());
+	}
+	WriteIndexFile(pStorage, "demo-index.dat", vIndexFile);
+	EXPECT_TRUE(Index.Load());
+
+	if(!HasFailure())
+	{
+		// the test storage only cleans up flat folders
+		for(const auto &Demo : Listed)
+			pStorage->RemoveFile(("demos/" + Demo.first).c_str(), IStorage::TYPE_SAVE);
+		char aPath[MAX_PATH_LENGTH];
+		pStorage->GetCompletePath(IStorage::TYPE_SAVE, "demos", aPath, sizeof(aPath));
+		fs_removedir(aPath);
+	}
+	Info.DeleteTestStorageFilesOnSuccess();
+	delete pStorage;
+}
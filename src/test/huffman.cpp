@@ -0,0 +1,386 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/huffman.h>
+
+#include <vector>
+
+// the frequencies the network code uses
+static const unsigned s_aFreqTable[256 + 1] = {
+	1 << 30, 4545, 2657, 431, 1950, 919, 444, 482, 2244, 617, 838, 542, 715, 1814, 304, 240, 754, 212, 647, 186,
+	283, 131, 146, 166, 543, 164, 167, 136, 179, 859, 363, 113, 157, 154, 204, 108, 137, 180, 202, 176,
+	872, 404, 168, 134, 151, 111, 113, 109, 120, 126, 129, 100, 41, 20, 16, 22, 18, 18, 17, 19,
+	16, 37, 13, 21, 362, 166, 99, 78, 95, 88, 81, 70, 83, 284, 91, 187, 77, 68, 52, 68,
+	59, 66, 61, 638, 71, 157, 50, 46, 69, 43, 11, 24, 13, 19, 10, 12, 12, 20, 14, 9,
+	20, 20, 10, 10, 15, 15, 12, 12, 7, 19, 15, 14, 13, 18, 35, 19, 17, 14, 8, 5,
+	15, 17, 9, 15, 14, 18, 8, 10, 2173, 134, 157, 68, 188, 60, 170, 60, 194, 62, 175, 71,
+	148, 67, 167, 78, 211, 67, 156, 69, 1674, 90, 174, 53, 147, 89, 181, 51, 174, 63, 163, 80,
+	167, 94, 128, 122, 223, 153, 218, 77, 200, 110, 190, 73, 174, 69, 145, 66, 277, 143, 141, 60,
+	136, 53, 180, 57, 142, 57, 158, 61, 166, 112, 152, 92, 26, 22, 21, 28, 20, 26, 30, 21,
+	32, 27, 20, 17, 23, 21, 30, 22, 22, 21, 27, 25, 17, 27, 23, 18, 39, 26, 15, 21,
+	12, 18, 18, 27, 20, 18, 15, 19, 11, 17, 33, 12, 18, 15, 19, 18, 16, 26, 17, 18,
+	9, 10, 25, 22, 22, 17, 20, 16, 6, 16, 15, 20, 14, 18, 24, 335, 1517};
+
+// the implementation before the multi-symbol decoder, to compare against
+namespace ReferenceHuffman {
+
+enum
+{
+	HUFFMAN_EOF_SYMBOL = 256,
+
+	HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
+	HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
+
+	HUFFMAN_LUTBITS = 10,
+	HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
+	HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+};
+
+struct CNode
+{
+	unsigned m_Bits;
+	unsigned m_NumBits;
+	unsigned short m_aLeafs[2];
+	unsigned char m_Symbol;
+};
+
+struct CConstructNode
+{
+	unsigned short m_NodeId;
+	int m_Frequency;
+};
+
+class CHuffman
+{
+public:
+	CNode m_aNodes[HUFFMAN_MAX_NODES];
+	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CNode *m_pStartNode;
+	int m_NumNodes;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+	{
+		if(pNode->m_aLeafs[1] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits | (1 << Depth), Depth + 1);
+		if(pNode->m_aLeafs[0] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth + 1);
+
+		if(pNode->m_NumBits)
+		{
+			pNode->m_Bits = Bits;
+			pNode->m_NumBits = Depth;
+		}
+	}
+
+	static void BubbleSort(CConstructNode **ppList, int Size)
+	{
+		int Changed = 1;
+		while(Changed)
+		{
+			Changed = 0;
+			for(int i = 0; i < Size - 1; i++)
+			{
+				if(ppList[i]->m_Frequency < ppList[i + 1]->m_Frequency)
+				{
+					CConstructNode *pTemp = ppList[i];
+					ppList[i] = ppList[i + 1];
+					ppList[i + 1] = pTemp;
+					Changed = 1;
+				}
+			}
+			Size--;
+		}
+	}
+
+	void Init(const unsigned *pFrequencies)
+	{
+		mem_zero(this, sizeof(*this));
+
+		CConstructNode aNodesLeftStorage[HUFFMAN_MAX_SYMBOLS];
+		CConstructNode *apNodesLeft[HUFFMAN_MAX_SYMBOLS];
+		int NumNodesLeft = HUFFMAN_MAX_SYMBOLS;
+		for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		{
+			m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+			m_aNodes[i].m_Symbol = i;
+			m_aNodes[i].m_aLeafs[0] = 0xffff;
+			m_aNodes[i].m_aLeafs[1] = 0xffff;
+			aNodesLeftStorage[i].m_Frequency = i == HUFFMAN_EOF_SYMBOL ? 1 : pFrequencies[i];
+			aNodesLeftStorage[i].m_NodeId = i;
+			apNodesLeft[i] = &aNodesLeftStorage[i];
+		}
+		m_NumNodes = HUFFMAN_MAX_SYMBOLS;
+		while(NumNodesLeft > 1)
+		{
+			BubbleSort(apNodesLeft, NumNodesLeft);
+			m_aNodes[m_NumNodes].m_NumBits = 0;
+			m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft - 1]->m_NodeId;
+			m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft - 2]->m_NodeId;
+			apNodesLeft[NumNodesLeft - 2]->m_NodeId = m_NumNodes;
+			apNodesLeft[NumNodesLeft - 2]->m_Frequency = apNodesLeft[NumNodesLeft - 1]->m_Frequency + apNodesLeft[NumNodesLeft - 2]->m_Frequency;
+			m_NumNodes++;
+			NumNodesLeft--;
+		}
+		m_pStartNode = &m_aNodes[m_NumNodes - 1];
+		Setbits_r(m_pStartNode, 0, 0);
+
+		for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
+		{
+			unsigned Bits = i;
+			int k;
+			CNode *pNode = m_pStartNode;
+			for(k = 0; k < HUFFMAN_LUTBITS; k++)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+				Bits >>= 1;
+				if(pNode->m_NumBits)
+				{
+					m_apDecodeLut[i] = pNode;
+					break;
+				}
+			}
+			if(k == HUFFMAN_LUTBITS)
+				m_apDecodeLut[i] = pNode;
+		}
+	}
+
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+	{
+#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
+	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
+	Bitcount += m_aNodes[Sym].m_NumBits;
+
+#define HUFFMAN_MACRO_WRITE() \
+	while(Bitcount >= 8) \
+	{ \
+		*pDst++ = (unsigned char)(Bits & 0xff); \
+		if(pDst == pDstEnd) \
+			return -1; \
+		Bits >>= 8; \
+		Bitcount -= 8; \
+	}
+
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned char *pDst = (unsigned char *)pOutput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		if(InputSize)
+		{
+			int Symbol = *pSrc++;
+			while(pSrc != pSrcEnd)
+			{
+				HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+				Symbol = *pSrc++;
+				HUFFMAN_MACRO_WRITE()
+			}
+			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+			HUFFMAN_MACRO_WRITE()
+		}
+		HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
+		HUFFMAN_MACRO_WRITE()
+		*pDst++ = Bits;
+		return (int)(pDst - (const unsigned char *)pOutput);
+#undef HUFFMAN_MACRO_LOADSYMBOL
+#undef HUFFMAN_MACRO_WRITE
+	}
+
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+	{
+		unsigned char *pDst = (unsigned char *)pOutput;
+		unsigned char *pSrc = (unsigned char *)pInput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+		CNode *pNode = 0;
+		while(1)
+		{
+			pNode = 0;
+			if(Bitcount >= HUFFMAN_LUTBITS)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+			while(Bitcount < 24 && pSrc != pSrcEnd)
+			{
+				Bits |= (*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+			if(!pNode)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+			if(!pNode)
+				return -1;
+			if(pNode->m_NumBits)
+			{
+				Bits >>= pNode->m_NumBits;
+				Bitcount -= pNode->m_NumBits;
+			}
+			else
+			{
+				Bits >>= HUFFMAN_LUTBITS;
+				Bitcount -= HUFFMAN_LUTBITS;
+				while(1)
+				{
+					pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+					Bitcount--;
+					Bits >>= 1;
+					if(pNode->m_NumBits)
+						break;
+					if(Bitcount == 0)
+						return -1;
+				}
+			}
+			if(pNode == pEof)
+				break;
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+};
+
+} // namespace ReferenceHuffman
+
+class CRandom
+{
+	unsigned m_Seed;
+
+public:
+	CRandom(unsigned Seed) :
+		m_Seed(Seed) {}
+	int operator()(int Max)
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return (m_Seed >> 8) % Max;
+	}
+};
+
+// bytes distributed like the ones the frequency table was made for
+static std::vector<unsigned char> GamePacket(CRandom &Random, int Size)
+{
+	static unsigned s_aCumulative[256];
+	if(!s_aCumulative[255])
+	{
+		// leave out the zero bytes, they are added below
+		unsigned Sum = 0;
+		for(int i = 0; i < 256; i++)
+			s_aCumulative[i] = Sum += i ? s_aFreqTable[i] : 0;
+	}
+	std::vector<unsigned char> vData(Size);
+	for(auto &Byte : vData)
+	{
+		if(Random(2) == 0)
+		{
+			Byte = 0;
+			continue;
+		}
+		unsigned Value = Random(s_aCumulative[255]);
+		int i = 0;
+		while(s_aCumulative[i] <= Value)
+			i++;
+		Byte = i;
+	}
+	return vData;
+}
+
+class Huffman : public ::testing::Test
+{
+protected:
+	CHuffman m_Huffman;
+	ReferenceHuffman::CHuffman *m_pReference;
+
+	Huffman()
+	{
+		m_Huffman.Init(s_aFreqTable);
+		m_pReference = new ReferenceHuffman::CHuffman;
+		m_pReference->Init(s_aFreqTable);
+	}
+	~Huffman()
+	{
+		delete m_pReference;
+	}
+
+	void ExpectSameCompress(const std::vector<unsigned char> &vData, int OutputSize)
+	{
+		std::vector<unsigned char> vOut(OutputSize + 16);
+		std::vector<unsigned char> vReferenceOut(OutputSize + 16);
+		int Size = m_Huffman.Compress(vData.data(), vData.size(), vOut.data(), OutputSize);
+		int ReferenceSize = m_pReference->Compress(vData.data(), vData.size(), vReferenceOut.data(), OutputSize);
+		ASSERT_EQ(Size, ReferenceSize) << "input size " << vData.size() << ", output size " << OutputSize;
+		if(Size > 0)
+		{
+			ASSERT_EQ(mem_comp(vOut.data(), vReferenceOut.data(), Size), 0);
+		}
+	}
+
+	void ExpectSameDecompress(const std::vector<unsigned char> &vData, int OutputSize)
+	{
+		std::vector<unsigned char> vOut(OutputSize);
+		std::vector<unsigned char> vReferenceOut(OutputSize);
+		int Size = m_Huffman.Decompress(vData.data(), vData.size(), vOut.data(), OutputSize);
+		int ReferenceSize = m_pReference->Decompress(vData.data(), vData.size(), vReferenceOut.data(), OutputSize);
+		ASSERT_EQ(Size, ReferenceSize) << "input size " << vData.size() << ", output size " << OutputSize;
+		if(Size > 0)
+		{
+			ASSERT_EQ(mem_comp(vOut.data(), vReferenceOut.data(), Size), 0);
+		}
+	}
+};
+
+TEST_F(Huffman, CodeLengths)
+{
+	// the old decoder could only walk codes that fit into the bits it
+	// loaded, the new one has to give the same results on them
+	unsigned MaxBits = 0;
+	for(int i = 0; i <= 256; i++)
+		MaxBits = maximum(MaxBits, m_pReference->m_aNodes[i].m_NumBits);
+	EXPECT_LE(MaxBits, 24u);
+}
+
+TEST_F(Huffman, RoundTrip)
+{
+	CRandom Random(1);
+	for(int i = 0; i < 2000; i++)
+	{
+		std::vector<unsigned char> vData = GamePacket(Random, Random(1400));
+		unsigned char aCompressed[2048];
+		unsigned char aDecompressed[2048];
+		int Size = m_Huffman.Compress(vData.data(), vData.size(), aCompressed, sizeof(aCompressed));
+		ASSERT_GT(Size, 0);
+		ASSERT_EQ(m_Huffman.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)vData.size());
+		ASSERT_EQ(mem_comp(aDecompressed, vData.data(), vData.size()), 0);
+	}
+}
+
+TEST_F(Huffman, SameAsReference)
+{
+	CRandom Random(2);
+	for(int i = 0; i < 5000; i++)
+	{
+		int Size = Random(4) == 0 ? Random(16) : Random(1400);
+		std::vector<unsigned char> vData = Random(3) == 0 ? GamePacket(Random, Size) : std::vector<unsigned char>(Size);
+		if(Random(3) == 1)
+			for(auto &Byte : vData)
+				Byte = Random(256);
+
+		ExpectSameCompress(vData, 2048);
+		ExpectSameCompress(vData, 1 + Random(Size + 8));
+
+		unsigned char aCompressed[2048];
+		int CompressedSize = m_pReference->Compress(vData.data(), vData.size(), aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		std::vector<unsigned char> vCompressed(aCompressed, aCompressed + CompressedSize);
+		ExpectSameDecompress(vCompressed, 2048);
+		ExpectSameDecompress(vCompressed, Random(Size + 8));
+		// cut off
+		vCompressed.resize(Random(CompressedSize + 1));
+		ExpectSameDecompress(vCompressed, 2048);
+		// garbage
+		for(auto &Byte : vCompressed)
+			Byte = Random(256);
+		ExpectSameDecompress(vCompressed, 2048);
+		ExpectSameDecompress(vCompressed, Random(2048));
+	}
+}
@@ -6,6 +6,7 @@
 #include <engine/shared/jobs.h>
 
 #include <functional>
+#include <vector>
 
 static const int TEST_NUM_THREADS = 4;
 
@@ -19,9 +20,9 @@ protected:
 		m_Pool.Init(TEST_NUM_THREADS);
 	}
 
-	void Add(std::shared_ptr<IJob> pJob)
+	void Add(std::shared_ptr<IJob> pJob, int Priority = CJobPool::PRIORITY_NORMAL, CJobGroup *pGroup = 0)
 	{
-		m_Pool.Add(std::move(pJob));
+		m_Pool.Add(std::move(pJob), Priority, pGroup);
 	}
 	void RunBlocking(IJob *pJob)
 	{
@@ -119,3 +120,106 @@ TEST_F(Jobs, Many)
 	}
 	new(&m_Pool) CJobPool();
 }
+
+TEST_F(Jobs, Priority)
+{
+	// block all workers, then queue jobs of every priority
+	SEMAPHORE Blocked, Release;
+	sphore_init(&Blocked);
+	sphore_init(&Release);
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		Add(std::make_shared<CJob>([&] {
+			sphore_signal(&Blocked);
+			sphore_wait(&Release);
+		}));
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		sphore_wait(&Blocked);
+
+	// more jobs per priority than fit into a queue, the overflowed ones
+	// keep their priority and order
+	static const int NUM_JOBS = 1500;
+	LOCK Lock = lock_create();
+	std::vector<std::pair<int, int>> vOrder;
+	CJobGroup Group;
+	for(int Priority = CJobPool::NUM_PRIORITIES - 1; Priority >= 0; Priority--)
+		for(int i = 0; i < NUM_JOBS; i++)
+			Add(std::make_shared<CJob>([&, Priority, i] {
+				lock_wait(Lock);
+				vOrder.emplace_back(Priority, i);
+				lock_unlock(Lock);
+			}),
+				Priority, &Group);
+	EXPECT_EQ(Group.NumPending(), NUM_JOBS * CJobPool::NUM_PRIORITIES);
+
+	// a single worker picks the queued jobs up by priority
+	sphore_signal(&Release);
+	Group.Wait();
+	EXPECT_EQ(Group.NumPending(), 0);
+	ASSERT_EQ(vOrder.size(), (size_t)NUM_JOBS * CJobPool::NUM_PRIORITIES);
+	for(unsigned i = 0; i < vOrder.size(); i++)
+	{
+		EXPECT_EQ(vOrder[i].first, (int)i / NUM_JOBS);
+		EXPECT_EQ(vOrder[i].second, (int)i % NUM_JOBS);
+	}
+
+	for(int i = 1; i < TEST_NUM_THREADS; i++)
+		sphore_signal(&Release);
+	lock_destroy(Lock);
+	sphore_destroy(&Blocked);
+	sphore_destroy(&Release);
+}
+
+TEST_F(Jobs, Group)
+{
+	std::atomic<int> Done(0);
+	CJobGroup Group;
+	std::vector<std::shared_ptr<IJob>> vpJobs;
+	for(int Round = 0; Round < 10; Round++)
+	{
+		// more jobs than fit into a queue
+		for(int i = 0; i < 3000; i++)
+		{
+			vpJobs.push_back(std::make_shared<CJob>([&] { Done++; }));
+			Add(vpJobs.back(), CJobPool::PRIORITY_NORMAL, &Group);
+		}
+		Group.Wait();
+		EXPECT_EQ(Done.load(), (Round + 1) * 3000);
+		for(auto &pJob : vpJobs)
+			EXPECT_EQ(pJob->Status(), IJob::STATE_DONE);
+		vpJobs.clear();
+	}
+}
+
+TEST_F(Jobs, ManyProducers)
+{
+	// producers add jobs concurrently while the workers run them
+	static const int NUM_PRODUCERS = 4;
+	static const int NUM_JOBS = 100000;
+
+	struct CProducer
+	{
+		CJobPool *m_pPool;
+		CJobGroup *m_pGroup;
+		std::atomic<int> *m_pDone;
+	};
+	CJobGroup Group;
+	std::atomic<int> Done(0);
+	CProducer Producer = {&m_Pool, &Group, &Done};
+
+	void *apThreads[NUM_PRODUCERS];
+	for(auto &pThread : apThreads)
+		pThread = thread_init(
+			[](void *pUser) {
+				CProducer *pProducer = (CProducer *)pUser;
+				std::atomic<int> *pDone = pProducer->m_pDone;
+				for(int i = 0; i < NUM_JOBS / NUM_PRODUCERS; i++)
+					pProducer->m_pPool->Add(std::make_shared<CJob>([pDone] { (*pDone)++; }), CJobPool::PRIORITY_NORMAL, pProducer->m_pGroup);
+			},
+			&Producer, "jobs producer");
+	for(auto &pThread : apThreads)
+		thread_wait(pThread);
+	Group.Wait();
+
+	EXPECT_EQ(Group.NumPending(), 0);
+	EXPECT_EQ(Done.load(), NUM_JOBS);
+}
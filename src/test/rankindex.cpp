@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/server/rankindex.h>
+
+#include <map>
+#include <string>
+
+// RANK() and PERCENT_RANK() over the best times, like the SQL queries
+static bool ReferenceRank(const std::map<std::string, float> &BestTimes, const char *pName, int *pRank, float *pPercentRank)
+{
+	auto It = BestTimes.find(pName);
+	if(It == BestTimes.end())
+		return false;
+	*pRank = 1;
+	for(auto &BestTime : BestTimes)
+		if(BestTime.second < It->second)
+			(*pRank)++;
+	*pPercentRank = BestTimes.size() > 1 ? (*pRank - 1) / (float)(BestTimes.size() - 1) : 0.0f;
+	return true;
+}
+
+TEST(RankIndex, Empty)
+{
+	CRankIndex Index;
+	int Rank;
+	float Time, PercentRank;
+	EXPECT_EQ(Index.Num(), 0);
+	EXPECT_FALSE(Index.Find("nameless tee", &Rank, &Time, &PercentRank));
+}
+
+TEST(RankIndex, Ties)
+{
+	CRankIndex Index;
+	Index.Add("c", 20.0f);
+	Index.Add("b", 10.0f);
+	Index.Add("a", 10.0f);
+	Index.Add("d", 30.0f);
+
+	ASSERT_EQ(Index.Num(), 4);
+	EXPECT_STREQ(Index.Get(0).m_aName, "a");
+	EXPECT_STREQ(Index.Get(1).m_aName, "b");
+	EXPECT_EQ(Index.RankAt(0), 1);
+	EXPECT_EQ(Index.RankAt(1), 1);
+	EXPECT_EQ(Index.RankAt(2), 3);
+	EXPECT_EQ(Index.RankAt(3), 4);
+
+	int Rank;
+	float Time, PercentRank;
+	ASSERT_TRUE(Index.Find("d", &Rank, &Time, &PercentRank));
+	EXPECT_EQ(Rank, 4);
+	EXPECT_EQ(Time, 30.0f);
+	EXPECT_EQ(PercentRank, 1.0f);
+}
+
+TEST(RankIndex, KeepsBestTime)
+{
+	CRankIndex Index;
+	Index.Add("a", 10.0f);
+	Index.Add("a", 12.0f);
+	Index.Add("b", 11.0f);
+	int Rank;
+	float Time, PercentRank;
+	ASSERT_TRUE(Index.Find("a", &Rank, &Time, &PercentRank));
+	EXPECT_EQ(Time, 10.0f);
+	EXPECT_EQ(Rank, 1);
+
+	Index.Add("b", 9.0f);
+	EXPECT_EQ(Index.Num(), 2);
+	ASSERT_TRUE(Index.Find("a", &Rank, &Time, &PercentRank));
+	EXPECT_EQ(Rank, 2);
+	EXPECT_STREQ(Index.Get(0).m_aName, "b");
+}
+
+TEST(RankIndex, MatchesReference)
+{
+	// load finishes like the database returns them, then keep adding
+	unsigned Seed = 1;
+	std::map<std::string, float> BestTimes;
+	std::vector<CRankIndex::CEntry> vLoad;
+	CRankIndex Index;
+	for(int i = 0; i < 3000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		CRankIndex::CEntry Entry;
+		str_format(Entry.m_aName, sizeof(Entry.m_aName), "tee%d", (Seed >> 8) % 500);
+		Seed = Seed * 1103515245 + 12345;
+		// few distinct times to get ties
+		Entry.m_Time = 60.0f + ((Seed >> 8) % 400) / 4.0f;
+
+		auto It = BestTimes.emplace(Entry.m_aName, Entry.m_Time).first;
+		It->second = minimum(It->second, Entry.m_Time);
+		if(i < 1000)
+			vLoad.push_back(Entry);
+		else
+			Index.Add(Entry.m_aName, Entry.m_Time);
+		if(i == 999)
+			Index.Load(vLoad);
+	}
+
+	ASSERT_EQ(Index.Num(), (int)BestTimes.size());
+	for(int Pos = 1; Pos < Index.Num(); Pos++)
+		ASSERT_LE(Index.Get(Pos - 1).m_Time, Index.Get(Pos).m_Time);
+	for(auto &BestTime : BestTimes)
+	{
+		int Rank, ExpectedRank;
+		float Time, PercentRank, ExpectedPercentRank;
+		ASSERT_TRUE(Index.Find(BestTime.first.c_str(), &Rank, &Time, &PercentRank));
+		ASSERT_TRUE(ReferenceRank(BestTimes, BestTime.first.c_str(), &ExpectedRank, &ExpectedPercentRank));
+		EXPECT_EQ(Time, BestTime.second);
+		EXPECT_EQ(Rank, ExpectedRank);
+		EXPECT_FLOAT_EQ(PercentRank, ExpectedPercentRank);
+	}
+}
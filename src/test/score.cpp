@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <game/server/scoreworker.h>
+
+#include <memory>
+
+class Score : public ::testing::Test
+{
+protected:
+	std::unique_ptr<IDbConnection> m_pConn;
+	char m_aError[256] = {0};
+
+	Score()
+	{
+		m_pConn = std::unique_ptr<IDbConnection>(CreateSqliteConnection(":memory:", true));
+		EXPECT_FALSE(m_pConn->Connect(m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	~Score()
+	{
+		m_pConn->Disconnect();
+	}
+
+	void InsertRank(const char *pName, float Time, const char *pServer)
+	{
+		ASSERT_FALSE(m_pConn->PrepareStatement(
+			"INSERT INTO record_race (Map, Name, Time, Server) VALUES ('Kobra 3', ?, ?, ?);",
+			m_aError, sizeof(m_aError)))
+			<< m_aError;
+		m_pConn->BindString(1, pName);
+		m_pConn->BindFloat(2, Time);
+		m_pConn->BindString(3, pServer);
+		int NumUpdated;
+		ASSERT_FALSE(m_pConn->ExecuteUpdate(&NumUpdated, m_aError, sizeof(m_aError))) << m_aError;
+		EXPECT_EQ(NumUpdated, 1);
+	}
+
+	void ShowTop(int Offset, const char *pServer, const char *const *ppExpected, int NumExpected)
+	{
+		auto pResult = std::make_shared<CScorePlayerResult>();
+		CSqlPlayerRequest Request(pResult);
+		str_copy(Request.m_Name, "", sizeof(Request.m_Name));
+		str_copy(Request.m_Map, "Kobra 3", sizeof(Request.m_Map));
+		str_copy(Request.m_RequestingPlayer, "nameless tee", sizeof(Request.m_RequestingPlayer));
+		Request.m_Offset = Offset;
+		str_copy(Request.m_Server, pServer, sizeof(Request.m_Server));
+
+		ASSERT_FALSE(CScoreWorker::ShowTopThread(m_pConn.get(), &Request, m_aError, sizeof(m_aError))) << m_aError;
+		EXPECT_EQ(pResult->m_MessageKind, CScorePlayerResult::DIRECT);
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(pResult->m_Data.m_aaMessages[i], i < NumExpected ? ppExpected[i] : "");
+	}
+};
+
+TEST_F(Score, TopWithLocal)
+{
+	InsertRank("nameless tee", 100.0f, "GER");
+	InsertRank("brainless tee", 110.0f, "USA");
+
+	const char *apExpected[] = {
+		"------------ Global Top ------------",
+		"1. nameless tee Time: 01:40.00",
+		"2. brainless tee Time: 01:50.00",
+		"---------------------------------------",
+	};
+	ShowTop(1, "USA", apExpected, 4);
+}
+
+TEST_F(Score, TopWithoutLocal)
+{
+	// the times of this server are below the global top five
+	const char *apServers[] = {"GER", "USA", "CHN"};
+	char aName[16];
+	for(int i = 0; i < 15; i++)
+	{
+		str_format(aName, sizeof(aName), "tee%d", i + 1);
+		InsertRank(aName, 100.0f + i, apServers[i / 5]);
+	}
+
+	const char *apExpected[] = {
+		"------------ Global Top ------------",
+		"1. tee1 Time: 01:40.00",
+		"2. tee2 Time: 01:41.00",
+		"3. tee3 Time: 01:42.00",
+		"4. tee4 Time: 01:43.00",
+		"5. tee5 Time: 01:44.00",
+		"------------ USA Top ------------",
+		"1. tee6 Time: 01:45.00",
+		"2. tee7 Time: 01:46.00",
+		"3. tee8 Time: 01:47.00",
+	};
+	ShowTop(1, "USA", apExpected, 10);
+
+	// the local top starts at the same offset
+	const char *apOffset[] = {
+		"------------ Global Top ------------",
+		"3. tee3 Time: 01:42.00",
+		"4. tee4 Time: 01:43.00",
+		"5. tee5 Time: 01:44.00",
+		"6. tee6 Time: 01:45.00",
+		"7. tee7 Time: 01:46.00",
+		"------------ CHN Top ------------",
+		"3. tee13 Time: 01:52.00",
+		"4. tee14 Time: 01:53.00",
+		"5. tee15 Time: 01:54.00",
+	};
+	ShowTop(3, "CHN", apOffset, 10);
+
+	// a time of this server is in the global top
+	const char *apWithLocal[] = {
+		"------------ Global Top ------------",
+		"2. tee2 Time: 01:41.00",
+		"3. tee3 Time: 01:42.00",
+		"4. tee4 Time: 01:43.00",
+		"5. tee5 Time: 01:44.00",
+		"6. tee6 Time: 01:45.00",
+		"---------------------------------------",
+	};
+	ShowTop(2, "USA", apWithLocal, 7);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/server_info_cache.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <mastersrv/mastersrv.h>
+
+#include <vector>
+
+static std::vector<unsigned char> Expected(const void *pPrefix, int PrefixSize, const char *pToken, const void *pData, int DataSize)
+{
+	std::vector<unsigned char> vPacket((const unsigned char *)pPrefix, (const unsigned char *)pPrefix + PrefixSize);
+	vPacket.insert(vPacket.end(), pToken, pToken + str_length(pToken) + 1);
+	vPacket.insert(vPacket.end(), (const unsigned char *)pData, (const unsigned char *)pData + DataSize);
+	return vPacket;
+}
+
+TEST(ServerInfoCache, Packet)
+{
+	CServerInfoCache Cache;
+	Cache.AddChunk("first", 5);
+	Cache.AddChunk("second", 6);
+	Cache.SetPrefix("AB", 2, "CDE", 3);
+	ASSERT_EQ(Cache.m_Cache.size(), 2u);
+
+	// tokens of different lengths are written over each other
+	const char *apTokens[] = {"1", "16777215", "-1", "255"};
+	for(const char *pToken : apTokens)
+	{
+		int Size;
+		unsigned char *pPacket = Cache.m_Cache.front().Packet(pToken, str_length(pToken) + 1, &Size);
+		EXPECT_EQ(std::vector<unsigned char>(pPacket, pPacket + Size), Expected("AB", 2, pToken, "first", 5));
+		pPacket = Cache.m_Cache.back().Packet(pToken, str_length(pToken) + 1, &Size);
+		EXPECT_EQ(std::vector<unsigned char>(pPacket, pPacket + Size), Expected("CDE", 3, pToken, "second", 6));
+	}
+	EXPECT_EQ(mem_comp(Cache.m_Cache.back().Data(), "second", 6), 0);
+}
+
+TEST(ServerInfoCache, SameAsPacker)
+{
+	// three 64 player legacy packets of 24 players each
+	CServerInfoCache Cache;
+	std::vector<std::vector<unsigned char>> vvChunks;
+	for(int c = 0; c < 3; c++)
+	{
+		CPacker Packer;
+		Packer.Reset();
+		Packer.AddString("0.6.4, 16.0", 32);
+		Packer.AddString("DDNet GER10 - Novice", 256);
+		Packer.AddString("Multeasymap", 32);
+		Packer.AddString("DDraceNetwork", 16);
+		for(int i = 0; i < 24; i++)
+		{
+			Packer.AddString("nameless tee", 16);
+			Packer.AddString("clan", 12);
+			Packer.AddInt(-1);
+			Packer.AddInt(-9999);
+			Packer.AddInt(1);
+		}
+		Cache.AddChunk(Packer.Data(), Packer.Size());
+		vvChunks.emplace_back(Packer.Data(), Packer.Data() + Packer.Size());
+	}
+	unsigned char aPrefix[6 + sizeof(SERVERBROWSE_INFO_64_LEGACY)];
+	for(int i = 0; i < 6; i++)
+		aPrefix[i] = 0xff;
+	mem_copy(aPrefix + 6, SERVERBROWSE_INFO_64_LEGACY, sizeof(SERVERBROWSE_INFO_64_LEGACY));
+	Cache.SetPrefix(aPrefix, sizeof(aPrefix), aPrefix, sizeof(aPrefix));
+
+	// the packets have to be what every request packed before: the type,
+	// token and chunk behind the connless header
+	for(int r = 0; r < 256; r++)
+	{
+		char aToken[16];
+		str_format(aToken, sizeof(aToken), "%d", r);
+		auto It = Cache.m_Cache.begin();
+		for(int c = 0; c < (int)vvChunks.size(); c++, ++It)
+		{
+			CPacker p;
+			p.Reset();
+			p.AddRaw(SERVERBROWSE_INFO_64_LEGACY, sizeof(SERVERBROWSE_INFO_64_LEGACY));
+			p.AddString(aToken, 0);
+			p.AddRaw(vvChunks[c].data(), vvChunks[c].size());
+			std::vector<unsigned char> vExpected(6, 0xff);
+			vExpected.insert(vExpected.end(), p.Data(), p.Data() + p.Size());
+
+			int Size;
+			unsigned char *pPacket = It->Packet(aToken, str_length(aToken) + 1, &Size);
+			EXPECT_EQ(std::vector<unsigned char>(pPacket, pPacket + Size), vExpected);
+		}
+	}
+}
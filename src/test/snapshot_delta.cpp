@@ -0,0 +1,403 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+#include <game/generated/protocol.h>
+
+#include <vector>
+
+// CSnapshotDelta::CreateDelta before the item index, the output has to
+// stay the same byte for byte
+namespace ReferenceDelta {
+
+struct CItemList
+{
+	int m_Num;
+	int m_aKeys[64];
+	int m_aIndex[64];
+};
+
+enum
+{
+	HASHLIST_SIZE = 256,
+};
+
+static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+{
+	for(int i = 0; i < HASHLIST_SIZE; i++)
+		pHashlist[i].m_Num = 0;
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		int Key = pSnapshot->GetItem(i)->Key();
+		int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
+		if(pHashlist[HashID].m_Num != 64)
+		{
+			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
+			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
+			pHashlist[HashID].m_Num++;
+		}
+	}
+}
+
+static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+{
+	int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
+	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	{
+		if(pHashlist[HashID].m_aKeys[i] == Key)
+			return pHashlist[HashID].m_aIndex[i];
+	}
+	return -1;
+}
+
+static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	while(Size)
+	{
+		*pOut = *pCurrent - *pPast;
+		Needed |= *pOut;
+		pOut++;
+		pPast++;
+		pCurrent++;
+		Size--;
+	}
+	return Needed;
+}
+
+static int CreateDelta(const CNetObjHandler &NetObjHandler, CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+{
+	CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+	int *pData = (int *)pDelta->m_aData;
+
+	pDelta->m_NumDeletedItems = 0;
+	pDelta->m_NumUpdateItems = 0;
+	pDelta->m_NumTempItems = 0;
+
+	static CItemList s_aHashlist[HASHLIST_SIZE];
+	GenerateHash(s_aHashlist, pTo);
+	for(int i = 0; i < pFrom->NumItems(); i++)
+	{
+		CSnapshotItem *pFromItem = pFrom->GetItem(i);
+		if(GetItemIndexHashed(pFromItem->Key(), s_aHashlist) == -1)
+		{
+			pDelta->m_NumDeletedItems++;
+			*pData++ = pFromItem->Key();
+		}
+	}
+
+	GenerateHash(s_aHashlist, pFrom);
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		int ItemSize = pTo->GetItemSize(i);
+		CSnapshotItem *pCurItem = pTo->GetItem(i);
+		int PastIndex = GetItemIndexHashed(pCurItem->Key(), s_aHashlist);
+		bool IncludeSize = pCurItem->Type() >= 64 || !NetObjHandler.GetObjSize(pCurItem->Type());
+
+		if(PastIndex != -1)
+		{
+			int *pItemDataDst = pData + (IncludeSize ? 3 : 2);
+			if(DiffItem(pFrom->GetItem(PastIndex)->Data(), pCurItem->Data(), pItemDataDst, ItemSize / 4))
+			{
+				*pData++ = pCurItem->Type();
+				*pData++ = pCurItem->ID();
+				if(IncludeSize)
+					*pData++ = ItemSize / 4;
+				pData += ItemSize / 4;
+				pDelta->m_NumUpdateItems++;
+			}
+		}
+		else
+		{
+			*pData++ = pCurItem->Type();
+			*pData++ = pCurItem->ID();
+			if(IncludeSize)
+				*pData++ = ItemSize / 4;
+			mem_copy(pData, pCurItem->Data(), ItemSize);
+			pData += ItemSize / 4;
+			pDelta->m_NumUpdateItems++;
+		}
+	}
+
+	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems && !pDelta->m_NumTempItems)
+		return 0;
+	return (int)((char *)pData - (char *)pDstData);
+}
+
+} // namespace ReferenceDelta
+
+typedef std::vector<char> CSnapData;
+
+// a game of 64 tees running around and shooting, snapshots like the
+// server sends them to one client
+class CSimulatedGame
+{
+	unsigned m_Seed = 1;
+	int m_Tick = 0;
+	int m_NextProjectileID = 0;
+	struct CProjectile
+	{
+		int m_ID;
+		int m_StartTick;
+		int m_Owner;
+	};
+	std::vector<CProjectile> m_vProjectiles;
+
+	int Random(int Max)
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return (m_Seed >> 8) % Max;
+	}
+
+public:
+	CSnapData Tick()
+	{
+		m_Tick++;
+		for(unsigned i = 0; i < m_vProjectiles.size();)
+		{
+			if(m_Tick - m_vProjectiles[i].m_StartTick > 40 || Random(60) == 0)
+				m_vProjectiles.erase(m_vProjectiles.begin() + i);
+			else
+				i++;
+		}
+		for(int i = 0; i < 3; i++)
+		{
+			if(Random(4) == 0)
+				m_vProjectiles.push_back({m_NextProjectileID++ % 0x4000, m_Tick, Random(64)});
+		}
+
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		CNetObj_GameInfo *pGameInfo = (CNetObj_GameInfo *)Builder.NewItem(NETOBJTYPE_GAMEINFO, 0, sizeof(CNetObj_GameInfo));
+		pGameInfo->m_RoundStartTick = 1;
+		pGameInfo->m_WarmupTimer = 0;
+		for(int i = 0; i < 64; i++)
+		{
+			CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+			pInfo->m_ClientID = i;
+			pInfo->m_Local = i == 0;
+			pInfo->m_Team = 0;
+			pInfo->m_Score = i * 100 + m_Tick / 500;
+			pInfo->m_Latency = 20 + (i + m_Tick / 50) % 30;
+
+			// tees far away are not in the snapshot
+			if((i + m_Tick / 100) % 4 == 0)
+				continue;
+			CNetObj_Character *pChar = (CNetObj_Character *)Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+			pChar->m_Tick = m_Tick - m_Tick % (i % 3 + 1);
+			pChar->m_X = 1000 + i * 50 + (i % 2 ? m_Tick % 200 : 0);
+			pChar->m_Y = 2000 + (i % 5 == 0 ? 0 : (m_Tick * (i % 7)) % 300);
+			pChar->m_VelX = i % 2 ? 256 : 0;
+			pChar->m_VelY = i % 5 == 0 ? 0 : 128 * (i % 7);
+			pChar->m_Angle = (i * 37 + m_Tick / 3) % 628;
+			pChar->m_Direction = i % 3 - 1;
+			pChar->m_Weapon = i % 5;
+			pChar->m_Health = 10;
+			pChar->m_Armor = 0;
+			pChar->m_AmmoCount = 10;
+			pChar->m_Emote = 0;
+
+			CNetObj_DDNetCharacter *pDDNetChar = (CNetObj_DDNetCharacter *)Builder.NewItem(NETOBJTYPE_DDNETCHARACTER, i, sizeof(CNetObj_DDNetCharacter));
+			pDDNetChar->m_Flags = i % 4;
+			pDDNetChar->m_FreezeEnd = 0;
+			pDDNetChar->m_Jumps = 2;
+			pDDNetChar->m_TeleCheckpoint = 0;
+			pDDNetChar->m_StrongWeakID = i;
+		}
+		for(auto &Projectile : m_vProjectiles)
+		{
+			CNetObj_Projectile *pProj = (CNetObj_Projectile *)Builder.NewItem(NETOBJTYPE_PROJECTILE, Projectile.m_ID, sizeof(CNetObj_Projectile));
+			pProj->m_X = 1000 + Projectile.m_Owner * 50;
+			pProj->m_Y = 2000;
+			pProj->m_VelX = 1000;
+			pProj->m_VelY = -500;
+			pProj->m_Type = WEAPON_GRENADE;
+			pProj->m_StartTick = Projectile.m_StartTick;
+		}
+		for(int i = 0; i < 30; i++)
+		{
+			CNetObj_Pickup *pPickup = (CNetObj_Pickup *)Builder.NewItem(NETOBJTYPE_PICKUP, i, sizeof(CNetObj_Pickup));
+			pPickup->m_X = i * 320;
+			pPickup->m_Y = 640;
+			pPickup->m_Type = i % 2;
+			pPickup->m_Subtype = 0;
+		}
+
+		CSnapData Data(CSnapshot::MAX_SIZE);
+		Data.resize(Builder.Finish(Data.data()));
+		return Data;
+	}
+};
+
+static void InitDelta(CSnapshotDelta *pDelta, const CNetObjHandler &NetObjHandler)
+{
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		pDelta->SetStaticsize(i, NetObjHandler.GetObjSize(i));
+}
+
+static void ExpectSameDelta(CSnapshotDelta *pDelta, const CNetObjHandler &NetObjHandler, CSnapshot *pFrom, CSnapshot *pTo, bool Unpack = true)
+{
+	static char s_aDelta[CSnapshot::MAX_SIZE * 2];
+	static char s_aReference[CSnapshot::MAX_SIZE * 2];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	int Size = pDelta->CreateDelta(pFrom, pTo, s_aDelta);
+	int ReferenceSize = ReferenceDelta::CreateDelta(NetObjHandler, pFrom, pTo, s_aReference);
+	ASSERT_EQ(Size, ReferenceSize);
+	ASSERT_EQ(mem_comp(s_aDelta, s_aReference, Size), 0);
+	if(!Unpack)
+		return;
+
+	// an empty delta means the snapshot didn't change
+	int UnpackedSize = pDelta->UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, Size ? s_aDelta : (char *)pDelta->EmptyDelta(), Size ? Size : sizeof(CSnapshotDelta::CData));
+	ASSERT_GT(UnpackedSize, 0);
+	EXPECT_EQ(((CSnapshot *)s_aUnpacked)->Crc(), pTo->Crc());
+	EXPECT_EQ(((CSnapshot *)s_aUnpacked)->NumItems(), pTo->NumItems());
+}
+
+TEST(SnapshotDelta, DiffItem)
+{
+	for(int Size = 0; Size < 20; Size++)
+	{
+		for(int Changed = -1; Changed < Size; Changed++)
+		{
+			std::vector<int> vPast(Size), vCurrent(Size), vOut(Size, 12345);
+			for(int i = 0; i < Size; i++)
+				vPast[i] = vCurrent[i] = i * 1000 - 5000;
+			if(Changed >= 0)
+				vCurrent[Changed] += Changed * 7 + 1;
+
+			int Needed = CSnapshotDelta::DiffItem(vPast.data(), vCurrent.data(), vOut.data(), Size);
+			if(Changed < 0)
+			{
+				EXPECT_EQ(Needed, 0);
+				continue;
+			}
+			EXPECT_NE(Needed, 0);
+			for(int i = 0; i < Size; i++)
+				EXPECT_EQ(vOut[i], vCurrent[i] - vPast[i]);
+		}
+	}
+}
+
+TEST(SnapshotDelta, DuplicateKeys)
+{
+	CNetObjHandler NetObjHandler;
+	CSnapshotDelta Delta;
+	InitDelta(&Delta, NetObjHandler);
+
+	char aaSnaps[3][1024];
+	for(int s = 0; s < 3; s++)
+	{
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		// the same key twice, the second one only found in the first snapshot
+		for(int i = 0; i < (s == 1 ? 2 : 3); i++)
+		{
+			CNetObj_Pickup *pPickup = (CNetObj_Pickup *)Builder.NewItem(NETOBJTYPE_PICKUP, i == 2 ? 0 : i, sizeof(CNetObj_Pickup));
+			pPickup->m_X = i * 10 + s;
+		}
+		Builder.Finish(aaSnaps[s]);
+	}
+	CSnapshot *pFirst = (CSnapshot *)aaSnaps[0];
+	CSnapshot *pSecond = (CSnapshot *)aaSnaps[1];
+	CSnapshot *pThird = (CSnapshot *)aaSnaps[2];
+	// the delta can't describe duplicate keys, only compare it
+	ExpectSameDelta(&Delta, NetObjHandler, pFirst, pThird, false);
+	ExpectSameDelta(&Delta, NetObjHandler, pFirst, pSecond, false);
+	ExpectSameDelta(&Delta, NetObjHandler, pSecond, pThird, false);
+}
+
+TEST(SnapshotDelta, MatchesReference)
+{
+	CNetObjHandler NetObjHandler;
+	CSnapshotDelta Delta;
+	InitDelta(&Delta, NetObjHandler);
+	CSimulatedGame Game;
+	std::vector<CSnapData> vSnaps;
+	for(int i = 0; i < 1000; i++)
+		vSnaps.push_back(Game.Tick());
+
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	char aEmpty[sizeof(CSnapshot)];
+	Builder.Finish(aEmpty);
+
+	for(int i = 0; i < (int)vSnaps.size(); i++)
+	{
+		// the client acks a few ticks late, sometimes nothing
+		for(int Lag = 0; Lag <= 5 && Lag <= i; Lag++)
+			ExpectSameDelta(&Delta, NetObjHandler, (CSnapshot *)vSnaps[i - Lag].data(), (CSnapshot *)vSnaps[i].data());
+		if(i % 100 == 0)
+			ExpectSameDelta(&Delta, NetObjHandler, (CSnapshot *)aEmpty, (CSnapshot *)vSnaps[i].data());
+	}
+}
+
+TEST(SnapshotDelta, VariableIntRoundTrip)
+{
+	CNetObjHandler NetObjHandler;
+	CSnapshotDelta Delta;
+	InitDelta(&Delta, NetObjHandler);
+	CSimulatedGame Game;
+	std::vector<CSnapData> vSnaps;
+	for(int i = 0; i < 1000; i++)
+		vSnaps.push_back(Game.Tick());
+
+	// the deltas as the server compresses them before sending
+	const int Lag = 3;
+	static char s_aDelta[CSnapshot::MAX_SIZE * 2];
+	static char s_aDecompressed[CSnapshot::MAX_SIZE * 2];
+	static unsigned char s_aCompressed[CSnapshot::MAX_SIZE * 2];
+	for(int i = Lag; i < (int)vSnaps.size(); i++)
+	{
+		int Size = Delta.CreateDelta((CSnapshot *)vSnaps[i - Lag].data(), (CSnapshot *)vSnaps[i].data(), s_aDelta);
+		int CompressedSize = CVariableInt::Compress(s_aDelta, Size, s_aCompressed, sizeof(s_aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		ASSERT_EQ(CVariableInt::Decompress(s_aCompressed, CompressedSize, s_aDecompressed, sizeof(s_aDecompressed)), Size);
+		EXPECT_EQ(mem_comp(s_aDecompressed, s_aDelta, Size), 0);
+	}
+}
+
+TEST(SnapshotDeltaCache, Find)
+{
+	char aaSnaps[4][256];
+	for(int s = 0; s < 4; s++)
+	{
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		CNetObj_Pickup *pPickup = (CNetObj_Pickup *)Builder.NewItem(NETOBJTYPE_PICKUP, 0, sizeof(CNetObj_Pickup));
+		pPickup->m_X = s < 2 ? 10 : s == 2 ? 11 : 12;
+		// the last one only has the same crc
+		pPickup->m_Y = s < 3 ? 20 : 19;
+		pPickup->m_Type = 0;
+		pPickup->m_Subtype = 0;
+		Builder.Finish(aaSnaps[s]);
+	}
+	CSnapshot *pFrom = (CSnapshot *)aaSnaps[0];
+	CSnapshot *pFromCopy = (CSnapshot *)aaSnaps[1];
+	CSnapshot *pTo = (CSnapshot *)aaSnaps[2];
+	CSnapshot *pSameCrc = (CSnapshot *)aaSnaps[3];
+	ASSERT_EQ(pTo->Crc(), pSameCrc->Crc());
+
+	CSnapshotDeltaCache Cache;
+	EXPECT_EQ(Cache.Find(pFrom, pFrom->Crc(), pTo, pTo->Crc(), false), nullptr);
+	CSnapshotDeltaCache::CEntry *pEntry = Cache.Add(pFrom, pFrom->Crc(), pTo, pTo->Crc(), false, 3);
+	Cache.SetCompData(pEntry, "delta", 5);
+
+	pEntry = Cache.Find(pFromCopy, pFromCopy->Crc(), pTo, pTo->Crc(), false);
+	ASSERT_NE(pEntry, nullptr);
+	EXPECT_EQ(pEntry->m_Owner, 3);
+	EXPECT_EQ(pEntry->m_CompSize, 5);
+	EXPECT_EQ(mem_comp(pEntry->m_vCompData.data(), "delta", 5), 0);
+
+	EXPECT_EQ(Cache.Find(pFrom, pFrom->Crc(), pTo, pTo->Crc(), true), nullptr);
+	EXPECT_EQ(Cache.Find(pFrom, pFrom->Crc(), pSameCrc, pSameCrc->Crc(), false), nullptr);
+	EXPECT_EQ(Cache.Find(pTo, pTo->Crc(), pFrom, pFrom->Crc(), false), nullptr);
+	EXPECT_EQ(Cache.Hits(), 1);
+	EXPECT_EQ(Cache.Misses(), 4);
+
+	Cache.Clear();
+	EXPECT_EQ(Cache.Num(), 0);
+	EXPECT_EQ(Cache.Find(pFrom, pFrom->Crc(), pTo, pTo->Crc(), false), nullptr);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+
+#include <deque>
+#include <vector>
+
+struct CStoredSnap
+{
+	int m_Tick;
+	std::vector<char> m_vData;
+};
+
+static std::vector<char> RandomData(unsigned &Seed, int MaxSize)
+{
+	Seed = Seed * 1103515245 + 12345;
+	std::vector<char> vData(sizeof(CSnapshot) + (Seed >> 8) % MaxSize);
+	for(auto &Byte : vData)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		Byte = Seed >> 16;
+	}
+	return vData;
+}
+
+static void ExpectSame(CSnapshotStorage &Storage, const std::deque<CStoredSnap> &Reference)
+{
+	// list order is kept for the client walking it
+	auto It = Reference.begin();
+	CSnapshotStorage::CHolder *pLast = 0;
+	for(CSnapshotStorage::CHolder *pHolder = Storage.m_pFirst; pHolder; pHolder = pHolder->m_pNext, ++It)
+	{
+		ASSERT_NE(It, Reference.end());
+		EXPECT_EQ(pHolder->m_Tick, It->m_Tick);
+		EXPECT_EQ(pHolder->m_pPrev, pLast);
+		pLast = pHolder;
+	}
+	EXPECT_EQ(It, Reference.end());
+	EXPECT_EQ(Storage.m_pLast, pLast);
+
+	for(auto &Snap : Reference)
+	{
+		CSnapshot *pData;
+		CSnapshot *pAltData;
+		int64_t Tagtime;
+		ASSERT_EQ(Storage.Get(Snap.m_Tick, &Tagtime, &pData, &pAltData), (int)Snap.m_vData.size());
+		EXPECT_EQ(Tagtime, Snap.m_Tick * 10);
+		EXPECT_EQ(mem_comp(pData, Snap.m_vData.data(), Snap.m_vData.size()), 0);
+		EXPECT_EQ(mem_comp(pAltData, Snap.m_vData.data(), Snap.m_vData.size()), 0);
+	}
+}
+
+TEST(SnapshotStorage, Empty)
+{
+	CSnapshotStorage Storage;
+	EXPECT_EQ(Storage.Get(0, 0, 0, 0), -1);
+	EXPECT_EQ(Storage.m_pFirst, nullptr);
+	Storage.PurgeUntil(100);
+	Storage.PurgeAll();
+}
+
+TEST(SnapshotStorage, MatchesReference)
+{
+	unsigned Seed = 1;
+	CSnapshotStorage Storage;
+	std::deque<CStoredSnap> Reference;
+	int Tick = 0;
+	for(int Round = 0; Round < 3000; Round++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		// mostly consecutive ticks, sometimes ones colliding in the index
+		Tick += (Seed >> 8) % 50 == 0 ? (int)CSnapshotStorage::INDEX_SIZE : 1 + (Seed >> 8) % 3;
+		CStoredSnap Snap;
+		Snap.m_Tick = Tick;
+		// occasionally big snapshots, not fitting the ring
+		Snap.m_vData = RandomData(Seed, Round % 97 == 0 ? 60000 : 3000);
+		Storage.Add(Tick, Tick * 10, Snap.m_vData.size(), Snap.m_vData.data(), 1);
+		Reference.push_back(Snap);
+
+		Seed = Seed * 1103515245 + 12345;
+		if((Seed >> 8) % 500 == 0)
+		{
+			Storage.PurgeAll();
+			Reference.clear();
+		}
+		else
+		{
+			int PurgeTick = Tick - (Seed >> 8) % 300;
+			Storage.PurgeUntil(PurgeTick);
+			while(!Reference.empty() && Reference.front().m_Tick < PurgeTick)
+				Reference.pop_front();
+		}
+		EXPECT_EQ(Storage.Get(Tick + 1, 0, 0, 0), -1);
+		if(Round % 10 == 0)
+			ExpectSame(Storage, Reference);
+	}
+	ExpectSame(Storage, Reference);
+}
+
+TEST(SnapshotStorage, DuplicateTicks)
+{
+	CSnapshotStorage Storage;
+	char aFirst[sizeof(CSnapshot)] = {1};
+	char aSecond[sizeof(CSnapshot) + 4] = {2};
+	Storage.Add(5, 0, sizeof(aFirst), aFirst, 0);
+	Storage.Add(5, 0, sizeof(aSecond), aSecond, 0);
+	// the first one is found, like when walking the list
+	EXPECT_EQ(Storage.Get(5, 0, 0, 0), (int)sizeof(aFirst));
+	Storage.PurgeUntil(6);
+	EXPECT_EQ(Storage.Get(5, 0, 0, 0), -1);
+}
+
+TEST(SnapshotStorage, SteadyState)
+{
+	// like the server, keeping three seconds of snapshots for a client
+	// acking a few ticks late, the ring stops allocating once it grew
+	// large enough
+	const int NumTicks = 20000;
+	const int KeepTicks = 150;
+	unsigned Seed = 3;
+	std::vector<char> vData = RandomData(Seed, 1);
+	vData.resize(4000);
+
+	CSnapshotStorage Storage;
+	int WarmAllocations = 0;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		if(Tick == 1000)
+			WarmAllocations = Storage.NumAllocations();
+
+		Seed = Seed * 1103515245 + 12345;
+		int Size = 1000 + (Seed >> 8) % 3000;
+		Seed = Seed * 1103515245 + 12345;
+		int Lag = 1 + (Seed >> 8) % 20;
+
+		Storage.PurgeUntil(Tick - KeepTicks);
+		Storage.Add(Tick, 0, Size, vData.data(), 0);
+		if(Tick >= Lag)
+		{
+			EXPECT_GE(Storage.Get(Tick - Lag, 0, 0, 0), 0);
+		}
+	}
+	EXPECT_EQ(Storage.NumAllocations(), WarmAllocations);
+}
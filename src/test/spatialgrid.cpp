@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/spatialgrid.h>
+
+#include <algorithm>
+#include <vector>
+
+class CGridEntity
+{
+public:
+	vec2 m_Pos;
+	CSpatialGrid::CNode m_Node;
+};
+
+static vec2 RandomPos(unsigned &Seed, float Size)
+{
+	Seed = Seed * 1103515245 + 12345;
+	float x = (Seed >> 8) % (int)Size;
+	Seed = Seed * 1103515245 + 12345;
+	float y = (Seed >> 8) % (int)Size;
+	return vec2(x, y);
+}
+
+static std::vector<CGridEntity *> LinearQuery(const std::vector<CGridEntity> &vEntities, vec2 Pos, float Radius)
+{
+	std::vector<CGridEntity *> vResult;
+	for(auto &Entity : vEntities)
+		if(distance(Entity.m_Pos, Pos) < Radius)
+			vResult.push_back((CGridEntity *)&Entity);
+	return vResult;
+}
+
+static std::vector<CGridEntity *> GridQuery(const CSpatialGrid &Grid, vec2 Pos, float Radius)
+{
+	std::vector<CGridEntity *> vResult;
+	Grid.QueryBox(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CSpatialGrid::CNode *pNode) {
+		CGridEntity *pEntity = (CGridEntity *)pNode->m_pUser;
+		if(distance(pEntity->m_Pos, Pos) < Radius)
+			vResult.push_back(pEntity);
+	});
+	std::sort(vResult.begin(), vResult.end());
+	return vResult;
+}
+
+TEST(SpatialGrid, Empty)
+{
+	CSpatialGrid Grid;
+	int Num = 0;
+	Grid.QueryBox(vec2(-1000, -1000), vec2(1000, 1000), [&](CSpatialGrid::CNode *pNode) { Num++; });
+	EXPECT_EQ(Num, 0);
+}
+
+TEST(SpatialGrid, InsertRemove)
+{
+	CSpatialGrid Grid;
+	CGridEntity aEntities[3];
+	for(auto &Entity : aEntities)
+	{
+		Entity.m_Pos = vec2(100, 100);
+		Entity.m_Node.m_pUser = &Entity;
+		Grid.Insert(&Entity.m_Node, Entity.m_Pos);
+	}
+	Grid.Remove(&aEntities[1].m_Node);
+	EXPECT_EQ(aEntities[1].m_Node.m_Cell, -1);
+	// removing twice is fine
+	Grid.Remove(&aEntities[1].m_Node);
+
+	std::vector<CSpatialGrid::CNode *> vFound;
+	Grid.QueryBox(vec2(0, 0), vec2(200, 200), [&](CSpatialGrid::CNode *pNode) { vFound.push_back(pNode); });
+	ASSERT_EQ(vFound.size(), 2u);
+	EXPECT_TRUE(std::find(vFound.begin(), vFound.end(), &aEntities[0].m_Node) != vFound.end());
+	EXPECT_TRUE(std::find(vFound.begin(), vFound.end(), &aEntities[2].m_Node) != vFound.end());
+}
+
+TEST(SpatialGrid, Wraparound)
+{
+	// positions far apart share cells, but a query must visit each node once
+	CSpatialGrid Grid;
+	CGridEntity aEntities[2];
+	aEntities[0].m_Pos = vec2(10, 10);
+	aEntities[1].m_Pos = vec2(10 + CSpatialGrid::CELL_SIZE * CSpatialGrid::GRID_SIZE, 10);
+	for(auto &Entity : aEntities)
+	{
+		Entity.m_Node.m_pUser = &Entity;
+		Grid.Insert(&Entity.m_Node, Entity.m_Pos);
+	}
+	EXPECT_EQ(aEntities[0].m_Node.m_Cell, aEntities[1].m_Node.m_Cell);
+
+	int Num = 0;
+	Grid.QueryBox(vec2(-100000, -100000), vec2(100000, 100000), [&](CSpatialGrid::CNode *pNode) { Num++; });
+	EXPECT_EQ(Num, 2);
+}
+
+TEST(SpatialGrid, MatchesLinearScan)
+{
+	const float MapSize = 32 * 500;
+	unsigned Seed = 1;
+	std::vector<CGridEntity> vEntities(2000);
+	CSpatialGrid Grid;
+	for(auto &Entity : vEntities)
+	{
+		Entity.m_Pos = RandomPos(Seed, MapSize);
+		Entity.m_Node.m_pUser = &Entity;
+		Grid.Insert(&Entity.m_Node, Entity.m_Pos);
+	}
+
+	for(int Round = 0; Round < 10; Round++)
+	{
+		// move some of the entities around
+		for(unsigned i = 0; i < vEntities.size(); i += 3)
+		{
+			vEntities[i].m_Pos = RandomPos(Seed, MapSize);
+			Grid.Move(&vEntities[i].m_Node, vEntities[i].m_Pos);
+		}
+
+		for(int Query = 0; Query < 100; Query++)
+		{
+			vec2 Pos = RandomPos(Seed, MapSize);
+			float Radius = 20.0f + Query * 10.0f;
+			EXPECT_EQ(GridQuery(Grid, Pos, Radius), LinearQuery(vEntities, Pos, Radius));
+		}
+	}
+}
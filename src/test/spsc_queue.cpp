@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/spsc_queue.h>
+
+TEST(SpscQueue, Empty)
+{
+	CSpscQueue<int, 4> Queue;
+	EXPECT_TRUE(Queue.Empty());
+	EXPECT_EQ(Queue.Front(), nullptr);
+}
+
+TEST(SpscQueue, Full)
+{
+	CSpscQueue<int, 4> Queue;
+	for(int i = 0; i < 4; i++)
+	{
+		int *pItem = Queue.Back();
+		ASSERT_NE(pItem, nullptr);
+		*pItem = i;
+		Queue.Push();
+	}
+	EXPECT_EQ(Queue.Back(), nullptr);
+
+	ASSERT_NE(Queue.Front(), nullptr);
+	EXPECT_EQ(*Queue.Front(), 0);
+	Queue.Pop();
+	ASSERT_NE(Queue.Back(), nullptr);
+}
+
+struct CProducerData
+{
+	CSpscQueue<int, 64> *m_pQueue;
+	int m_Num;
+};
+
+static void Produce(void *pUser)
+{
+	CProducerData *pData = (CProducerData *)pUser;
+	for(int i = 0; i < pData->m_Num; i++)
+	{
+		int *pItem;
+		while(!(pItem = pData->m_pQueue->Back()))
+			thread_yield();
+		*pItem = i;
+		pData->m_pQueue->Push();
+	}
+}
+
+TEST(SpscQueue, Threads)
+{
+	CSpscQueue<int, 64> Queue;
+	CProducerData Data = {&Queue, 200000};
+	void *pThread = thread_init(Produce, &Data, "produce");
+	for(int i = 0; i < Data.m_Num; i++)
+	{
+		int *pItem;
+		while(!(pItem = Queue.Front()))
+			thread_yield();
+		ASSERT_EQ(*pItem, i);
+		Queue.Pop();
+	}
+	thread_wait(pThread);
+	EXPECT_TRUE(Queue.Empty());
+}
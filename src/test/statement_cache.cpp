@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/databases/statement_cache.h>
+
+#include <memory>
+#include <vector>
+
+static std::vector<int> s_vFreed;
+
+class CFreeStmt
+{
+public:
+	void operator()(int *pStmt) const
+	{
+		s_vFreed.push_back(*pStmt);
+		delete pStmt;
+	}
+};
+
+typedef CStatementCache<std::unique_ptr<int, CFreeStmt>> CCache;
+
+static int *Add(CCache &Cache, const char *pQuery, int Stmt, int Capacity)
+{
+	return Cache.Add(pQuery, std::unique_ptr<int, CFreeStmt>(new int(Stmt)), Capacity)->get();
+}
+
+TEST(StatementCache, HitsAndMisses)
+{
+	CCache Cache;
+	EXPECT_EQ(Cache.Find("SELECT 1"), nullptr);
+	int *pStmt = Add(Cache, "SELECT 1", 1, 4);
+	ASSERT_NE(Cache.Find("SELECT 1"), nullptr);
+	EXPECT_EQ(Cache.Find("SELECT 1")->get(), pStmt);
+	EXPECT_EQ(Cache.Find("SELECT 2"), nullptr);
+	EXPECT_EQ(Cache.Hits(), 2);
+	EXPECT_EQ(Cache.Misses(), 2);
+}
+
+TEST(StatementCache, SharedCounters)
+{
+	CCache Cache;
+	CCache Copy;
+	Copy.ShareCounters(Cache);
+	Add(Copy, "SELECT 1", 1, 4);
+	EXPECT_NE(Copy.Find("SELECT 1"), nullptr);
+	EXPECT_EQ(Cache.Find("SELECT 1"), nullptr);
+	EXPECT_EQ(Cache.Hits(), 1);
+	EXPECT_EQ(Cache.Misses(), 1);
+	EXPECT_EQ(Copy.Num(), 1);
+	EXPECT_EQ(Cache.Num(), 0);
+}
+
+TEST(StatementCache, EvictsLeastRecentlyUsed)
+{
+	s_vFreed.clear();
+	{
+		CCache Cache;
+		Add(Cache, "a", 1, 2);
+		Add(Cache, "b", 2, 2);
+		// a is used more recently than b now
+		EXPECT_NE(Cache.Find("a"), nullptr);
+		Add(Cache, "c", 3, 2);
+		EXPECT_EQ(Cache.Num(), 2);
+		EXPECT_EQ(s_vFreed, std::vector<int>({2}));
+		EXPECT_EQ(Cache.Find("b"), nullptr);
+		EXPECT_NE(Cache.Find("a"), nullptr);
+		EXPECT_NE(Cache.Find("c"), nullptr);
+
+		// a smaller capacity evicts down to it, but keeps the added statement
+		Add(Cache, "d", 4, 0);
+		EXPECT_EQ(Cache.Num(), 1);
+		EXPECT_EQ(s_vFreed, std::vector<int>({2, 1, 3}));
+		EXPECT_NE(Cache.Find("d"), nullptr);
+	}
+	EXPECT_EQ(s_vFreed, std::vector<int>({2, 1, 3, 4}));
+}
+
+TEST(StatementCache, Clear)
+{
+	s_vFreed.clear();
+	CCache Cache;
+	Add(Cache, "a", 1, 4);
+	Add(Cache, "b", 2, 4);
+	Cache.Clear();
+	EXPECT_EQ(Cache.Num(), 0);
+	EXPECT_EQ(s_vFreed.size(), 2u);
+	EXPECT_EQ(Cache.Find("a"), nullptr);
+}
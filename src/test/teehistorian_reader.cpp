@@ -0,0 +1,365 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/block_writer.h>
+#include <engine/shared/config.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/teehistorian_reader.h>
+#include <engine/storage.h>
+#include <game/gamecore.h>
+#include <game/server/teehistorian.h>
+
+#include <algorithm>
+#include <vector>
+
+void RegisterGameUuids(CUuidManager *pManager);
+
+struct CInputEvent
+{
+	int m_Tick;
+	int m_ClientID;
+	CNetObj_PlayerInput m_Input;
+
+	bool operator==(const CInputEvent &Other) const
+	{
+		return m_Tick == Other.m_Tick && m_ClientID == Other.m_ClientID && mem_comp(&m_Input, &Other.m_Input, sizeof(m_Input)) == 0;
+	}
+};
+
+struct CPlayerEvent
+{
+	int m_Tick;
+	int m_ClientID;
+	int m_X;
+	int m_Y;
+
+	bool operator==(const CPlayerEvent &Other) const
+	{
+		return m_Tick == Other.m_Tick && m_ClientID == Other.m_ClientID && m_X == Other.m_X && m_Y == Other.m_Y;
+	}
+};
+
+class CCollector : public CTeeHistorianReader::IListener
+{
+public:
+	const CTeeHistorianReader *m_pReader;
+	std::vector<CInputEvent> m_vInputs;
+	std::vector<CPlayerEvent> m_vPlayers;
+	int m_NumJoins = 0;
+	int m_NumDrops = 0;
+
+	void OnInput(int ClientID, const CNetObj_PlayerInput *pInput) override
+	{
+		m_vInputs.push_back({m_pReader->State()->m_Tick, ClientID, *pInput});
+	}
+	void OnPlayer(int ClientID, int X, int Y) override
+	{
+		m_vPlayers.push_back({m_pReader->State()->m_Tick, ClientID, X, Y});
+	}
+	void OnJoin(int ClientID) override { m_NumJoins++; }
+	void OnDrop(int ClientID, const char *pReason) override { m_NumDrops++; }
+};
+
+class TeeHistorianReader : public ::testing::Test
+{
+protected:
+	enum
+	{
+		NUM_TICKS = 3000,
+		CHECKPOINT_INTERVAL = SERVER_TICK_SPEED * 5,
+	};
+
+	struct CConnection
+	{
+		int m_ClientID;
+		int m_JoinTick;
+		int m_DropTick;
+		const char *m_pName;
+	};
+
+	CTestInfo m_Info;
+	IStorage *m_pStorage;
+	CConfig m_Config;
+	CTuningParams m_Tuning;
+	CUuidManager m_UuidManager;
+
+	// what the reader has to return
+	std::vector<CInputEvent> m_vInputs;
+	std::vector<CPlayerEvent> m_vPlayers;
+	std::vector<CConnection> m_vConnections;
+
+	TeeHistorianReader()
+	{
+		m_pStorage = m_Info.CreateTestStorage();
+
+		mem_zero(&m_Config, sizeof(m_Config));
+#define MACRO_CONFIG_INT(Name, ScriptName, Def, Min, Max, Save, Desc) \
+	m_Config.m_##Name = (Def);
+#define MACRO_CONFIG_COL(Name, ScriptName, Def, Save, Desc) MACRO_CONFIG_INT(Name, ScriptName, Def, 0, 0, Save, Desc)
+#define MACRO_CONFIG_STR(Name, ScriptName, Len, Def, Save, Desc) \
+	str_copy(m_Config.m_##Name, (Def), sizeof(m_Config.m_##Name));
+#include <engine/shared/config_variables.h>
+#undef MACRO_CONFIG_STR
+#undef MACRO_CONFIG_COL
+#undef MACRO_CONFIG_INT
+
+		RegisterUuids(&m_UuidManager);
+		RegisterTeehistorianUuids(&m_UuidManager);
+		RegisterGameUuids(&m_UuidManager);
+
+		// client 3 plays alone and idles from 700 to 800, which leaves
+		// ticks without any chunk
+		m_vConnections.push_back({0, 10, 600, "alpha"});
+		m_vConnections.push_back({3, 100, 1500, "beta"});
+		m_vConnections.push_back({5, 900, -1, "delta"});
+		m_vConnections.push_back({3, 2000, -1, "gamma"});
+	}
+
+	~TeeHistorianReader()
+	{
+		if(m_pStorage)
+		{
+			m_Info.DeleteTestStorageFilesOnSuccess();
+			delete m_pStorage;
+		}
+	}
+
+	const CConnection *Connection(int ClientID, int Tick) const
+	{
+		for(const auto &Connection : m_vConnections)
+		{
+			if(Connection.m_ClientID == ClientID && Connection.m_JoinTick <= Tick && (Connection.m_DropTick == -1 || Tick < Connection.m_DropTick))
+				return &Connection;
+		}
+		return nullptr;
+	}
+
+	static bool Idle(int ClientID, int Tick)
+	{
+		return ClientID == 3 && Tick >= 700 && Tick < 800;
+	}
+
+	static void WriteCallback(const void *pData, int DataSize, void *pUser)
+	{
+		((CBlockWriter *)pUser)->Write(pData, DataSize);
+	}
+
+	void Record(const char *pFilename, int Compression)
+	{
+		m_vInputs.clear();
+		m_vPlayers.clear();
+
+		CTeeHistorian::CGameInfo GameInfo;
+		mem_zero(&GameInfo, sizeof(GameInfo));
+		GameInfo.m_GameUuid = CalculateUuid("test@ddnet.tw");
+		GameInfo.m_pServerVersion = "DDNet test";
+		GameInfo.m_StartTime = time(0);
+		GameInfo.m_pPrngDescription = "test-prng:02468ace";
+		GameInfo.m_pServerName = "server name";
+		GameInfo.m_ServerPort = 8303;
+		GameInfo.m_pGameType = "game type";
+		GameInfo.m_pMapName = "Kobra 3 Solo";
+		GameInfo.m_MapSha256 = SHA256_ZEROED;
+		GameInfo.m_pConfig = &m_Config;
+		GameInfo.m_pTuning = &m_Tuning;
+		GameInfo.m_pUuids = &m_UuidManager;
+
+		IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		CBlockWriter Writer(File, Compression);
+		CTeeHistorian TeeHistorian;
+		TeeHistorian.Reset(&GameInfo, WriteCallback, &Writer);
+
+		bool aAlive[MAX_CLIENTS] = {false};
+		CPlayerEvent aLastPlayer[MAX_CLIENTS];
+		CNetObj_PlayerInput aLastInput[MAX_CLIENTS];
+		bool aInputExists[MAX_CLIENTS] = {false};
+		for(int Tick = 1; Tick <= NUM_TICKS; Tick++)
+		{
+			TeeHistorian.BeginTick(Tick);
+			TeeHistorian.BeginPlayers();
+			for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+			{
+				// dead for a while now and then
+				if(!Connection(ClientID, Tick) || Tick % 250 < 20)
+				{
+					TeeHistorian.RecordDeadPlayer(ClientID);
+					aAlive[ClientID] = false;
+					continue;
+				}
+				int Moving = Idle(ClientID, Tick) ? 700 : Tick;
+				CNetObj_CharacterCore Char;
+				mem_zero(&Char, sizeof(Char));
+				Char.m_X = Moving * 3 + ClientID;
+				Char.m_Y = ClientID * 100 - Moving;
+				TeeHistorian.RecordPlayer(ClientID, &Char);
+				if(!aAlive[ClientID] || aLastPlayer[ClientID].m_X != Char.m_X || aLastPlayer[ClientID].m_Y != Char.m_Y)
+					m_vPlayers.push_back({Tick, ClientID, Char.m_X, Char.m_Y});
+				aLastPlayer[ClientID] = {Tick, ClientID, Char.m_X, Char.m_Y};
+				aAlive[ClientID] = true;
+			}
+			TeeHistorian.EndPlayers();
+
+			TeeHistorian.BeginInputs();
+			for(const auto &Connection : m_vConnections)
+			{
+				if(Connection.m_DropTick == Tick)
+					TeeHistorian.RecordPlayerDrop(Connection.m_ClientID, "leave");
+				if(Connection.m_JoinTick == Tick)
+				{
+					TeeHistorian.RecordPlayerJoin(Connection.m_ClientID, CTeeHistorian::PROTOCOL_6);
+					CPacker Msg;
+					Msg.Reset();
+					Msg.AddInt(NETMSGTYPE_CL_STARTINFO << 1);
+					Msg.AddString(Connection.m_pName, -1);
+					Msg.AddString("clan", -1);
+					TeeHistorian.RecordPlayerMessage(Connection.m_ClientID, Msg.Data(), Msg.Size());
+				}
+			}
+			for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+			{
+				if(!Connection(ClientID, Tick))
+					continue;
+				int Moving = Idle(ClientID, Tick) ? 700 : Tick;
+				CNetObj_PlayerInput Input;
+				mem_zero(&Input, sizeof(Input));
+				Input.m_Direction = Moving % 3 - 1;
+				Input.m_TargetX = Moving * 7 + ClientID;
+				Input.m_TargetY = -Moving;
+				Input.m_Jump = Moving % 11 == 0;
+				Input.m_Fire = Moving / 13;
+				Input.m_WantedWeapon = ClientID % 5;
+				TeeHistorian.RecordPlayerInput(ClientID, &Input);
+				if(!aInputExists[ClientID] || mem_comp(&aLastInput[ClientID], &Input, sizeof(Input)) != 0)
+					m_vInputs.push_back({Tick, ClientID, Input});
+				aLastInput[ClientID] = Input;
+				aInputExists[ClientID] = true;
+			}
+			TeeHistorian.EndInputs();
+			TeeHistorian.EndTick();
+			Writer.Flush(Tick % 250 == 0);
+		}
+		TeeHistorian.Finish();
+		EXPECT_EQ(Writer.Close(), 0);
+	}
+
+	template<typename T>
+	static std::vector<T> Window(const std::vector<T> &vEvents, int BeginTick, int EndTick)
+	{
+		std::vector<T> vResult;
+		for(const auto &Event : vEvents)
+			if(Event.m_Tick >= BeginTick && Event.m_Tick <= EndTick)
+				vResult.push_back(Event);
+		return vResult;
+	}
+
+	void Check(const char *pFilename, bool Compressed)
+	{
+		CTeeHistorianReader Reader;
+		ASSERT_TRUE(Reader.Open(m_pStorage, pFilename, IStorage::TYPE_SAVE));
+		EXPECT_EQ(Reader.IsCompressed(), Compressed);
+		EXPECT_TRUE(str_startswith(Reader.Header(), "{\"comment\":\"teehistorian@ddnet.tw\""));
+
+		CCollector Collector;
+		Collector.m_pReader = &Reader;
+		ASSERT_TRUE(Reader.Read(&Collector));
+		EXPECT_TRUE(Reader.Finished());
+		EXPECT_EQ(Reader.State()->m_Tick, NUM_TICKS);
+		EXPECT_EQ(Collector.m_NumJoins, 4);
+		EXPECT_EQ(Collector.m_NumDrops, 2);
+		EXPECT_TRUE(Collector.m_vInputs == m_vInputs);
+		EXPECT_TRUE(Collector.m_vPlayers == m_vPlayers);
+
+		CTeeHistorianIndex Index;
+		ASSERT_TRUE(CTeeHistorianIndex::Open(m_pStorage, pFilename, IStorage::TYPE_SAVE, &Index, CHECKPOINT_INTERVAL));
+		EXPECT_EQ(Index.m_LastTick, NUM_TICKS);
+		EXPECT_TRUE(Index.m_Finished);
+		EXPECT_EQ((int)Index.m_vCheckpoints.size(), NUM_TICKS / CHECKPOINT_INTERVAL);
+		ASSERT_EQ(Index.m_vPlayers.size(), m_vConnections.size());
+		for(unsigned i = 0; i < m_vConnections.size(); i++)
+		{
+			EXPECT_EQ(Index.m_vPlayers[i].m_ClientID, m_vConnections[i].m_ClientID);
+			EXPECT_EQ(Index.m_vPlayers[i].m_JoinTick, m_vConnections[i].m_JoinTick);
+			EXPECT_EQ(Index.m_vPlayers[i].m_DropTick, m_vConnections[i].m_DropTick);
+			EXPECT_STREQ(Index.m_vPlayers[i].m_aName, m_vConnections[i].m_pName);
+		}
+
+		// windows read from the checkpoint before them match a full read,
+		// also across the idle ticks
+		const int aaWindows[][2] = {{1, 100}, {600, 900}, {1234, 1500}, {2500, NUM_TICKS}};
+		for(const auto &aWindow : aaWindows)
+		{
+			ASSERT_TRUE(Reader.Open(m_pStorage, pFilename, IStorage::TYPE_SAVE));
+			ASSERT_TRUE(Index.Seek(&Reader, aWindow[0]));
+			EXPECT_LT(Reader.State()->m_Tick, aWindow[0]);
+			CCollector Part;
+			Part.m_pReader = &Reader;
+			ASSERT_TRUE(Reader.Read(&Part, aWindow[1]));
+			EXPECT_TRUE(Window(Part.m_vInputs, aWindow[0], aWindow[1]) == Window(m_vInputs, aWindow[0], aWindow[1]));
+			EXPECT_TRUE(Window(Part.m_vPlayers, aWindow[0], aWindow[1]) == Window(m_vPlayers, aWindow[0], aWindow[1]));
+			ASSERT_FALSE(Part.m_vInputs.empty());
+			EXPECT_LE(Part.m_vInputs.back().m_Tick, aWindow[1]);
+		}
+
+		// the saved index is used as long as the file doesn't change
+		CTeeHistorianIndex Loaded;
+		char aIndexFilename[64];
+		str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", pFilename);
+		ASSERT_TRUE(Loaded.Load(m_pStorage, aIndexFilename, IStorage::TYPE_SAVE));
+		EXPECT_EQ(Loaded.m_FileSize, Index.m_FileSize);
+		ASSERT_EQ(Loaded.m_vCheckpoints.size(), Index.m_vCheckpoints.size());
+		for(unsigned i = 0; i < Loaded.m_vCheckpoints.size(); i++)
+			EXPECT_EQ(mem_comp(&Loaded.m_vCheckpoints[i], &Index.m_vCheckpoints[i], sizeof(Loaded.m_vCheckpoints[i])), 0);
+		ASSERT_EQ(Loaded.m_vPlayers.size(), Index.m_vPlayers.size());
+		EXPECT_STREQ(Loaded.m_vPlayers[3].m_aName, "gamma");
+	}
+};
+
+TEST_F(TeeHistorianReader, Uncompressed)
+{
+	ASSERT_TRUE(m_pStorage);
+	Record("plain.teehistorian", CBlockWriter::COMPRESSION_NONE);
+	Check("plain.teehistorian", false);
+}
+
+TEST_F(TeeHistorianReader, Compressed)
+{
+	ASSERT_TRUE(m_pStorage);
+	Record("compressed.teehistorian", CBlockWriter::COMPRESSION_ZLIB);
+	Check("compressed.teehistorian", true);
+}
+
+TEST_F(TeeHistorianReader, Unfinished)
+{
+	// the file of a running game ends anywhere, possibly inside a chunk
+	ASSERT_TRUE(m_pStorage);
+	Record("full.teehistorian", CBlockWriter::COMPRESSION_NONE);
+	IOHANDLE File = m_pStorage->OpenFile("full.teehistorian", IOFLAG_READ, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	std::vector<unsigned char> vData(io_length(File));
+	ASSERT_EQ(io_read(File, vData.data(), vData.size()), vData.size());
+	io_close(File);
+	m_pStorage->RemoveFile("full.teehistorian", IStorage::TYPE_SAVE);
+	File = m_pStorage->OpenFile("cut.teehistorian", IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, vData.data(), vData.size() / 2 + 1);
+	io_close(File);
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(m_pStorage, "cut.teehistorian", IStorage::TYPE_SAVE));
+	CCollector Collector;
+	Collector.m_pReader = &Reader;
+	EXPECT_TRUE(Reader.Read(&Collector));
+	EXPECT_FALSE(Reader.Finished());
+	ASSERT_FALSE(Collector.m_vInputs.empty());
+	EXPECT_GT(Collector.m_vInputs.back().m_Tick, 1);
+	EXPECT_LT(Collector.m_vInputs.back().m_Tick, NUM_TICKS);
+	ASSERT_LT(Collector.m_vInputs.size(), m_vInputs.size());
+	EXPECT_TRUE(std::equal(Collector.m_vInputs.begin(), Collector.m_vInputs.end(), m_vInputs.begin()));
+
+	CTeeHistorianIndex Index;
+	ASSERT_TRUE(CTeeHistorianIndex::Open(m_pStorage, "cut.teehistorian", IStorage::TYPE_SAVE, &Index, CHECKPOINT_INTERVAL));
+	EXPECT_FALSE(Index.m_Finished);
+	EXPECT_EQ(Index.m_LastTick, Reader.State()->m_Tick);
+}
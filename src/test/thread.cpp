@@ -49,6 +49,17 @@ TEST(Thread, SemaphoreSingleThreaded)
 	sphore_destroy(&Semaphore);
 }
 
+TEST(Thread, SemaphoreTimedWait)
+{
+	SEMAPHORE Semaphore;
+	sphore_init(&Semaphore);
+	EXPECT_FALSE(sphore_timedwait(&Semaphore, 1));
+	sphore_signal(&Semaphore);
+	EXPECT_TRUE(sphore_timedwait(&Semaphore, 1000));
+	EXPECT_FALSE(sphore_timedwait(&Semaphore, 0));
+	sphore_destroy(&Semaphore);
+}
+
 static void SemaphoreThread(void *pUser)
 {
 	SEMAPHORE *pSemaphore = (SEMAPHORE *)pUser;
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <memory>
+
+static NETSOCKET CreateLocalSocket(NETADDR *pAddr)
+{
+	// no way to get the port picked by the system, try a few
+	for(int Port = 17300; Port < 17400; Port++)
+	{
+		net_addr_from_str(pAddr, "127.0.0.1");
+		pAddr->port = Port;
+		NETSOCKET Socket = net_udp_create(*pAddr);
+		if(Socket.type)
+			return Socket;
+	}
+	return NETSOCKET();
+}
+
+TEST(Udp, SendQueued)
+{
+	NETADDR RecvAddr, SendAddr;
+	NETSOCKET RecvSocket = CreateLocalSocket(&RecvAddr);
+	ASSERT_TRUE(RecvSocket.type);
+	NETSOCKET SendSocket = CreateLocalSocket(&SendAddr);
+	ASSERT_TRUE(SendSocket.type);
+
+	std::unique_ptr<SEND_MMSGS> pSendMMSGS(new SEND_MMSGS);
+	net_udp_set_send_queue(&SendSocket, pSendMMSGS.get());
+
+	NETSTATS Before;
+	net_stats(&Before);
+	// more than fit into the queue, not more than the receive buffer holds
+	const int NUM_PACKETS = 200;
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		char aData[64];
+		int Size = str_format(aData, sizeof(aData), "packet %d", i) + 1;
+		EXPECT_EQ(net_udp_send(SendSocket, &RecvAddr, aData, Size), Size);
+	}
+	net_udp_flush(SendSocket);
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, NUM_PACKETS);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_LT(After.send_calls - Before.send_calls, NUM_PACKETS / 16);
+#endif
+
+	std::unique_ptr<MMSGS> pMMSGS(new MMSGS);
+	net_init_mmsgs(pMMSGS.get());
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		NETADDR Addr;
+		char aBuffer[1400];
+		unsigned char *pData;
+		int Size = net_udp_recv(RecvSocket, &Addr, aBuffer, sizeof(aBuffer), pMMSGS.get(), &pData);
+		if(Size <= 0)
+		{
+			ASSERT_TRUE(net_socket_read_wait(RecvSocket, 1000000)) << i;
+			Size = net_udp_recv(RecvSocket, &Addr, aBuffer, sizeof(aBuffer), pMMSGS.get(), &pData);
+		}
+		char aExpected[64];
+		str_format(aExpected, sizeof(aExpected), "packet %d", i);
+		ASSERT_EQ(Size, str_length(aExpected) + 1);
+		EXPECT_STREQ((char *)pData, aExpected);
+		EXPECT_EQ(net_addr_comp(&Addr, &SendAddr), 0);
+	}
+
+	net_udp_close(SendSocket);
+	net_udp_close(RecvSocket);
+}
@@ -0,0 +1,399 @@
+/* (c) DDNet developers. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.  */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+#include <game/generated/protocol.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "demo_tool";
+
+/*
+	Usage: demo_tool [options] slice <demo> <output>
+	       demo_tool [options] concat <output> <demo>...
+	       demo_tool [options] reencode <output directory> <demo>...
+
+	Options:
+	  -b <seconds>  begin of the slice, from the start of each demo
+	  -e <seconds>  end of the slice, from the start of each demo
+	  -s <msgs>     strip these game messages, names or ids like Sv_Chat,4
+	  -k <msgs>     keep only these game messages
+	  -j <jobs>     demos re-encoded at once, defaults to the number of cores
+*/
+
+struct COptions
+{
+	enum
+	{
+		MAX_MESSAGES = 256,
+	};
+
+	float m_SliceBegin = -1.0f;
+	float m_SliceEnd = -1.0f;
+	// system messages are always kept
+	bool m_aStripMessages[MAX_MESSAGES] = {};
+	bool m_StripUnknownMessages = false;
+	int m_NumJobs = 0;
+
+	bool Strip(int Msg) const
+	{
+		if(Msg < 0 || Msg >= MAX_MESSAGES)
+			return m_StripUnknownMessages;
+		return m_aStripMessages[Msg];
+	}
+};
+
+// replays one or more demos into one output demo, each job has its own
+// player, recorder and delta so jobs can run side by side
+class CDemoToolJob : public IJob, public CDemoPlayer::IListener
+{
+	IStorage *m_pStorage;
+	const COptions *m_pOptions;
+	std::vector<std::string> m_vInputs;
+	std::string m_Output;
+
+	std::unique_ptr<CSnapshotDelta> m_pSnapshotDelta;
+	std::unique_ptr<CDemoPlayer> m_pPlayer;
+	std::unique_ptr<CDemoRecorder> m_pRecorder;
+
+	int m_MapCrc;
+	int m_SliceFrom;
+	int m_SliceTo;
+	int m_TickOffset;
+	int m_LastTick;
+	bool m_Stop;
+
+	int m_NumSnapshots;
+	int m_NumMessages;
+	int m_NumStripped;
+	bool m_Success;
+
+	static bool FilterMessage(const void *pData, int DataSize, void *pUser)
+	{
+		CDemoToolJob *pSelf = (CDemoToolJob *)pUser;
+
+		CUnpacker Unpacker;
+		Unpacker.Reset(pData, DataSize);
+		int Msg = Unpacker.GetInt();
+		int Sys = Msg & 1;
+		Msg >>= 1;
+
+		if(Unpacker.Error() || Sys || !pSelf->m_pOptions->Strip(Msg))
+			return false;
+
+		pSelf->m_NumStripped++;
+		return true;
+	}
+
+	bool InSlice()
+	{
+		int Tick = m_pPlayer->Info()->m_Info.m_CurrentTick;
+		if(m_SliceTo != -1 && Tick > m_SliceTo)
+		{
+			m_Stop = true;
+			return false;
+		}
+		return m_SliceFrom == -1 || Tick >= m_SliceFrom;
+	}
+
+	void OnDemoPlayerSnapshot(void *pData, int Size) override
+	{
+		if(!InSlice())
+			return;
+		m_LastTick = m_pPlayer->Info()->m_Info.m_CurrentTick + m_TickOffset;
+		m_pRecorder->RecordSnapshot(m_LastTick, pData, Size);
+		m_NumSnapshots++;
+	}
+
+	void OnDemoPlayerMessage(void *pData, int Size) override
+	{
+		if(!InSlice())
+			return;
+		m_pRecorder->RecordMessage(pData, Size);
+		m_NumMessages++;
+	}
+
+	bool StartRecorder()
+	{
+		const CMapInfo *pMapInfo = m_pPlayer->GetMapInfo();
+		const CDemoPlayer::CPlaybackInfo *pInfo = m_pPlayer->Info();
+
+		unsigned char *pMapData = m_pPlayer->GetMapData();
+		SHA256_DIGEST Sha256 = pMapInfo->m_Sha256;
+		if(pMapData && Sha256 == SHA256_ZEROED)
+			Sha256 = sha256(pMapData, pMapInfo->m_Size);
+
+		char aType[sizeof(pInfo->m_Header.m_aType) + 1];
+		str_copy(aType, pInfo->m_Header.m_aType, sizeof(aType));
+
+		// demos without map data stay without
+		m_pRecorder.reset(new CDemoRecorder(m_pSnapshotDelta.get(), !pMapData));
+		int Result = m_pRecorder->Start(m_pStorage, 0, m_Output.c_str(), pInfo->m_Header.m_aNetversion, pMapInfo->m_aName, &Sha256, pMapInfo->m_Crc, aType, pMapInfo->m_Size, pMapData, 0, FilterMessage, this, IStorage::TYPE_ABSOLUTE);
+		free(pMapData);
+		if(Result == -1)
+		{
+			dbg_msg(TOOL_NAME, "failed to open '%s' for writing", m_Output.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool Append(const char *pInput)
+	{
+		if(m_pPlayer->Load(m_pStorage, 0, pInput, IStorage::TYPE_ABSOLUTE) == -1)
+		{
+			dbg_msg(TOOL_NAME, "failed to load '%s'", pInput);
+			return false;
+		}
+
+		if(!m_pRecorder)
+		{
+			if(!StartRecorder())
+				return false;
+			m_MapCrc = m_pPlayer->GetMapInfo()->m_Crc;
+		}
+		else if(m_pPlayer->GetMapInfo()->m_Crc != m_MapCrc)
+		{
+			dbg_msg(TOOL_NAME, "'%s' was recorded on a different map", pInput);
+			return false;
+		}
+
+		const CDemoPlayer::CPlaybackInfo *pInfo = m_pPlayer->Info();
+		int FirstTick = pInfo->m_Info.m_FirstTick;
+		m_SliceFrom = m_pOptions->m_SliceBegin < 0.0f ? -1 : FirstTick + round_to_int(m_pOptions->m_SliceBegin * SERVER_TICK_SPEED);
+		m_SliceTo = m_pOptions->m_SliceEnd < 0.0f ? -1 : FirstTick + round_to_int(m_pOptions->m_SliceEnd * SERVER_TICK_SPEED);
+		m_Stop = false;
+
+		// ticks have to grow, move demos that don't follow the previous
+		// one behind it
+		int StartTick = maximum(m_SliceFrom, FirstTick);
+		m_TickOffset = m_LastTick != -1 && StartTick <= m_LastTick ? m_LastTick + 1 - StartTick : 0;
+
+		// start at the keyframe before the slice, the cut takes as long as
+		// the slice and not as long as the demo
+		if(m_SliceFrom != -1)
+		{
+			if(m_pPlayer->SetPos(m_SliceFrom) == -1)
+			{
+				dbg_msg(TOOL_NAME, "failed to seek in '%s'", pInput);
+				m_pPlayer->Stop();
+				return false;
+			}
+		}
+		else
+			m_pPlayer->Play();
+
+		while(m_pPlayer->IsPlaying() && !m_Stop && !pInfo->m_Info.m_Paused)
+			m_pPlayer->NextFrame();
+
+		m_pPlayer->Stop();
+		return true;
+	}
+
+	void Run() override
+	{
+		int64_t Start = time_get();
+		m_pSnapshotDelta.reset(new CSnapshotDelta());
+		CNetObjHandler NetObjHandler;
+		for(int i = 0; i < NUM_NETOBJTYPES; i++)
+			m_pSnapshotDelta->SetStaticsize(i, NetObjHandler.GetObjSize(i));
+		m_pPlayer.reset(new CDemoPlayer(m_pSnapshotDelta.get()));
+		m_pPlayer->SetListener(this);
+
+		m_Success = true;
+		for(const auto &Input : m_vInputs)
+		{
+			if(!Append(Input.c_str()))
+			{
+				m_Success = false;
+				break;
+			}
+		}
+
+		if(m_pRecorder)
+			m_pRecorder->Stop();
+		if(!m_Success && m_pRecorder)
+			m_pStorage->RemoveFile(m_Output.c_str(), IStorage::TYPE_ABSOLUTE);
+
+		if(m_Success)
+		{
+			dbg_msg(TOOL_NAME, "wrote '%s': %d snapshots, %d messages, %d stripped, %.1f ms",
+				m_Output.c_str(), m_NumSnapshots, m_NumMessages - m_NumStripped, m_NumStripped,
+				(time_get() - Start) * 1000.0 / time_freq());
+		}
+
+		// free the buffers while other jobs still run
+		m_pRecorder.reset();
+		m_pPlayer.reset();
+		m_pSnapshotDelta.reset();
+	}
+
+public:
+	CDemoToolJob(IStorage *pStorage, const COptions *pOptions, const std::vector<std::string> &vInputs, const char *pOutput) :
+		m_pStorage(pStorage),
+		m_pOptions(pOptions),
+		m_vInputs(vInputs),
+		m_Output(pOutput)
+	{
+		m_MapCrc = 0;
+		m_SliceFrom = -1;
+		m_SliceTo = -1;
+		m_TickOffset = 0;
+		m_LastTick = -1;
+		m_Stop = false;
+		m_NumSnapshots = 0;
+		m_NumMessages = 0;
+		m_NumStripped = 0;
+		m_Success = false;
+	}
+
+	bool Success() const { return m_Success; }
+};
+
+static bool ParseMessages(const char *pList, bool Keep, COptions *pOptions)
+{
+	for(int i = 0; i < COptions::MAX_MESSAGES; i++)
+		pOptions->m_aStripMessages[i] = Keep;
+	pOptions->m_StripUnknownMessages = Keep;
+
+	CNetObjHandler NetObjHandler;
+	char aToken[64];
+	for(const char *pTok = pList; (pTok = str_next_token(pTok, ",", aToken, sizeof(aToken)));)
+	{
+		int Msg = -1;
+		if(str_isallnum(aToken))
+			Msg = str_toint(aToken);
+		else
+		{
+			for(int i = 0; i < NUM_NETMSGTYPES; i++)
+				if(str_comp_nocase(NetObjHandler.GetMsgName(i), aToken) == 0)
+					Msg = i;
+		}
+
+		if(Msg < 0 || Msg >= COptions::MAX_MESSAGES)
+		{
+			dbg_msg(TOOL_NAME, "unknown message '%s'", aToken);
+			return false;
+		}
+		pOptions->m_aStripMessages[Msg] = !Keep;
+	}
+	return true;
+}
+
+static int Usage()
+{
+	dbg_msg(TOOL_NAME, "usage: %s [options] slice <demo> <output>", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "       %s [options] concat <output> <demo>...", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "       %s [options] reencode <output directory> <demo>...", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "options:");
+	dbg_msg(TOOL_NAME, "  -b <seconds>  begin of the slice, from the start of each demo");
+	dbg_msg(TOOL_NAME, "  -e <seconds>  end of the slice, from the start of each demo");
+	dbg_msg(TOOL_NAME, "  -s <msgs>     strip these game messages, names or ids like Sv_Chat,4");
+	dbg_msg(TOOL_NAME, "  -k <msgs>     keep only these game messages");
+	dbg_msg(TOOL_NAME, "  -j <jobs>     demos re-encoded at once, defaults to the number of cores");
+	return -1;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	COptions Options;
+	int Arg = 1;
+	for(; Arg < argc && argv[Arg][0] == '-'; Arg += 2)
+	{
+		if(Arg + 1 >= argc)
+			return Usage();
+		const char *pValue = argv[Arg + 1];
+		if(str_comp(argv[Arg], "-b") == 0)
+			Options.m_SliceBegin = str_tofloat(pValue);
+		else if(str_comp(argv[Arg], "-e") == 0)
+			Options.m_SliceEnd = str_tofloat(pValue);
+		else if(str_comp(argv[Arg], "-s") == 0 || str_comp(argv[Arg], "-k") == 0)
+		{
+			if(!ParseMessages(pValue, argv[Arg][1] == 'k', &Options))
+				return -1;
+		}
+		else if(str_comp(argv[Arg], "-j") == 0)
+			Options.m_NumJobs = str_toint(pValue);
+		else
+			return Usage();
+	}
+
+	if(argc - Arg < 3)
+		return Usage();
+
+	const char *pCommand = argv[Arg];
+	const char **ppArgs = argv + Arg + 1;
+	int NumArgs = argc - Arg - 1;
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+		return -1;
+
+	// the chunks are huffman compressed
+	CNetBase::Init();
+
+	if(str_comp(pCommand, "slice") == 0 && NumArgs == 2)
+	{
+		CDemoToolJob Job(pStorage, &Options, {ppArgs[0]}, ppArgs[1]);
+		CJobPool::RunBlocking(&Job);
+		return Job.Success() ? 0 : -1;
+	}
+	else if(str_comp(pCommand, "concat") == 0)
+	{
+		std::vector<std::string> vInputs(ppArgs + 1, ppArgs + NumArgs);
+		CDemoToolJob Job(pStorage, &Options, vInputs, ppArgs[0]);
+		CJobPool::RunBlocking(&Job);
+		return Job.Success() ? 0 : -1;
+	}
+	else if(str_comp(pCommand, "reencode") == 0)
+	{
+		const char *pOutputDir = ppArgs[0];
+		if(fs_makedir(pOutputDir) != 0)
+		{
+			dbg_msg(TOOL_NAME, "failed to create '%s'", pOutputDir);
+			return -1;
+		}
+
+		int NumJobs = Options.m_NumJobs > 0 ? Options.m_NumJobs : std::thread::hardware_concurrency();
+		CJobPool JobPool;
+		JobPool.Init(clamp(NumJobs, 1, (int)CJobPool::MAX_THREADS));
+
+		int64_t Start = time_get();
+		CJobGroup Group;
+		std::vector<std::shared_ptr<CDemoToolJob>> vpJobs;
+		for(int i = 1; i < NumArgs; i++)
+		{
+			const char *pName = ppArgs[i];
+			for(const char *pSep = ppArgs[i]; *pSep; pSep++)
+				if(*pSep == '/' || *pSep == '\\')
+					pName = pSep + 1;
+
+			char aOutput[512];
+			str_format(aOutput, sizeof(aOutput), "%s/%s", pOutputDir, pName);
+			vpJobs.push_back(std::make_shared<CDemoToolJob>(pStorage, &Options, std::vector<std::string>{ppArgs[i]}, aOutput));
+			JobPool.Add(vpJobs.back(), CJobPool::PRIORITY_NORMAL, &Group);
+		}
+		Group.Wait();
+
+		int NumFailed = 0;
+		for(const auto &pJob : vpJobs)
+			if(!pJob->Success())
+				NumFailed++;
+		dbg_msg(TOOL_NAME, "re-encoded %d of %d demos on %d jobs in %.1f s", (int)vpJobs.size() - NumFailed, (int)vpJobs.size(),
+			clamp(NumJobs, 1, (int)CJobPool::MAX_THREADS), (time_get() - Start) / (double)time_freq());
+		return NumFailed ? -1 : 0;
+	}
+
+	return Usage();
+}
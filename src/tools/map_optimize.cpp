@@ -6,6 +6,7 @@
 #include <engine/storage.h>
 #include <game/mapitems.h>
 #include <stdint.h>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -85,6 +86,8 @@ int main(int argc, const char **argv)
 	void *pPtr;
 	char aFileName[1024];
 	CDataFileReader DataFile;
+	// outlives the writer that waits for its jobs
+	CJobPool JobPool;
 	CDataFileWriter df;
 
 	if(!pStorage || argc <= 1 || argc > 3)
@@ -108,7 +111,7 @@ int main(int argc, const char **argv)
 		str_format(aFileName, sizeof(aFileName), "out/%s.map", aBuff);
 	}
 
-	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ABSOLUTE))
+	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ABSOLUTE, true))
 	{
 		dbg_msg("map_optimize", "Failed to open source file.");
 		return -1;
@@ -120,6 +123,9 @@ int main(int argc, const char **argv)
 		return -1;
 	}
 
+	JobPool.Init(clamp((int)std::thread::hardware_concurrency(), 1, (int)CJobPool::MAX_THREADS));
+	df.SetJobPool(&JobPool);
+
 	int aImageFlags[64] = {
 		0,
 	};
@@ -1,9 +1,12 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
+#include <thread>
+
 int main(int argc, const char **argv)
 {
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
@@ -11,14 +14,19 @@ int main(int argc, const char **argv)
 	void *pPtr;
 	char aFileName[1024];
 	CDataFileReader DataFile;
+	// outlives the writer that waits for its jobs
+	CJobPool JobPool;
 	CDataFileWriter df;
 
 	if(!pStorage || argc != 3)
 		return -1;
 
+	JobPool.Init(clamp((int)std::thread::hardware_concurrency(), 1, (int)CJobPool::MAX_THREADS));
+	df.SetJobPool(&JobPool);
+
 	str_format(aFileName, sizeof(aFileName), "%s", argv[2]);
 
-	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ABSOLUTE))
+	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ABSOLUTE, true))
 		return -1;
 	if(!df.Open(pStorage, aFileName))
 		return -1;
@@ -0,0 +1,264 @@
+/* (c) DDNet developers. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.  */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/teehistorian_reader.h>
+#include <engine/storage.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "teehistorian_tool";
+
+/*
+	Usage: teehistorian_tool [options] index <teehistorian>...
+	       teehistorian_tool [options] players <teehistorian>...
+	       teehistorian_tool [options] inputs <teehistorian>...
+
+	Options:
+	  -b <tick>     first tick of the window
+	  -e <tick>     last tick of the window
+	  -p <player>   only this client id or player name
+	  -j <jobs>     files read at once, defaults to the number of cores
+
+	The index is kept next to each file as <teehistorian>.index and
+	rebuilt when the file changes. Players and inputs are printed as tab
+	separated lines:
+	  <file> <client id> <join tick> <drop tick> <name>
+	  <file> <tick> <client id> <direction> <target x> <target y> <jump>
+	    <fire> <hook> <player flags> <wanted weapon> <next weapon> <prev weapon>
+*/
+
+enum
+{
+	COMMAND_INDEX,
+	COMMAND_PLAYERS,
+	COMMAND_INPUTS,
+};
+
+struct COptions
+{
+	int m_Command = COMMAND_INDEX;
+	int m_BeginTick = 0;
+	int m_EndTick = -1;
+	int m_ClientID = -1;
+	const char *m_pName = nullptr;
+	int m_NumJobs = 0;
+};
+
+// reads one file, the output is kept until all jobs are done so the files
+// are printed in order
+class CTeeHistorianToolJob : public IJob, public CTeeHistorianReader::IListener
+{
+	IStorage *m_pStorage;
+	const COptions *m_pOptions;
+	std::string m_Filename;
+	std::string m_Output;
+
+	CTeeHistorianReader m_Reader;
+	CTeeHistorianIndex m_Index;
+	// the ranges of the selected players
+	std::vector<CTeeHistorianIndex::CPlayerRange> m_vRanges;
+	int m_NumInputs;
+	bool m_Success;
+
+	bool Selected(int ClientID, int Tick) const
+	{
+		if(Tick < m_pOptions->m_BeginTick)
+			return false;
+		for(const auto &Range : m_vRanges)
+		{
+			if(Range.m_ClientID == ClientID && Range.m_JoinTick <= Tick && (Range.m_DropTick == -1 || Tick <= Range.m_DropTick))
+				return true;
+		}
+		return false;
+	}
+
+	void OnInput(int ClientID, const CNetObj_PlayerInput *pInput) override
+	{
+		int Tick = m_Reader.State()->m_Tick;
+		if(!Selected(ClientID, Tick))
+			return;
+
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+			m_Filename.c_str(), Tick, ClientID, pInput->m_Direction, pInput->m_TargetX, pInput->m_TargetY,
+			pInput->m_Jump, pInput->m_Fire, pInput->m_Hook, pInput->m_PlayerFlags,
+			pInput->m_WantedWeapon, pInput->m_NextWeapon, pInput->m_PrevWeapon);
+		m_Output += aBuf;
+		m_NumInputs++;
+	}
+
+	void SelectPlayers()
+	{
+		for(const auto &Range : m_Index.m_vPlayers)
+		{
+			if(m_pOptions->m_ClientID != -1 && Range.m_ClientID != m_pOptions->m_ClientID)
+				continue;
+			if(m_pOptions->m_pName && str_comp(Range.m_aName, m_pOptions->m_pName) != 0)
+				continue;
+			if(m_pOptions->m_EndTick != -1 && Range.m_JoinTick > m_pOptions->m_EndTick)
+				continue;
+			if(Range.m_DropTick != -1 && Range.m_DropTick < m_pOptions->m_BeginTick)
+				continue;
+			m_vRanges.push_back(Range);
+		}
+	}
+
+	bool ReadInputs()
+	{
+		if(m_vRanges.empty())
+			return true;
+
+		// nothing before the first selected player joined is needed
+		int BeginTick = m_vRanges[0].m_JoinTick;
+		for(const auto &Range : m_vRanges)
+			BeginTick = minimum(BeginTick, Range.m_JoinTick);
+		BeginTick = maximum(BeginTick, m_pOptions->m_BeginTick);
+
+		if(!m_Reader.Open(m_pStorage, m_Filename.c_str(), IStorage::TYPE_ABSOLUTE) || !m_Index.Seek(&m_Reader, BeginTick))
+			return false;
+		return m_Reader.Read(this, m_pOptions->m_EndTick);
+	}
+
+	void Run() override
+	{
+		int64_t Start = time_get();
+		if(!CTeeHistorianIndex::Open(m_pStorage, m_Filename.c_str(), IStorage::TYPE_ABSOLUTE, &m_Index))
+		{
+			dbg_msg(TOOL_NAME, "failed to index '%s'", m_Filename.c_str());
+			return;
+		}
+		int64_t IndexTime = time_get() - Start;
+
+		char aBuf[256];
+		switch(m_pOptions->m_Command)
+		{
+		case COMMAND_INDEX:
+			str_format(aBuf, sizeof(aBuf), "%s: %d ticks, %d checkpoints, %d players, %s, %.1f ms\n",
+				m_Filename.c_str(), m_Index.m_LastTick, (int)m_Index.m_vCheckpoints.size(), (int)m_Index.m_vPlayers.size(),
+				m_Index.m_Finished ? "finished" : "not finished", IndexTime * 1000.0 / time_freq());
+			m_Output += aBuf;
+			break;
+		case COMMAND_PLAYERS:
+			SelectPlayers();
+			for(const auto &Range : m_vRanges)
+			{
+				str_format(aBuf, sizeof(aBuf), "%s\t%d\t%d\t%d\t%s\n",
+					m_Filename.c_str(), Range.m_ClientID, Range.m_JoinTick, Range.m_DropTick, Range.m_aName);
+				m_Output += aBuf;
+			}
+			break;
+		case COMMAND_INPUTS:
+			SelectPlayers();
+			if(!ReadInputs())
+			{
+				dbg_msg(TOOL_NAME, "failed to read '%s'", m_Filename.c_str());
+				m_Reader.Close();
+				return;
+			}
+			m_Reader.Close();
+			dbg_msg(TOOL_NAME, "read %d inputs from '%s' in %.1f ms", m_NumInputs, m_Filename.c_str(), (time_get() - Start) * 1000.0 / time_freq());
+			break;
+		}
+		m_Success = true;
+	}
+
+public:
+	CTeeHistorianToolJob(IStorage *pStorage, const COptions *pOptions, const char *pFilename) :
+		m_pStorage(pStorage),
+		m_pOptions(pOptions),
+		m_Filename(pFilename)
+	{
+		m_NumInputs = 0;
+		m_Success = false;
+	}
+
+	bool Success() const { return m_Success; }
+	const std::string &Output() const { return m_Output; }
+};
+
+static int Usage()
+{
+	dbg_msg(TOOL_NAME, "usage: %s [options] index <teehistorian>...", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "       %s [options] players <teehistorian>...", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "       %s [options] inputs <teehistorian>...", TOOL_NAME);
+	dbg_msg(TOOL_NAME, "options:");
+	dbg_msg(TOOL_NAME, "  -b <tick>     first tick of the window");
+	dbg_msg(TOOL_NAME, "  -e <tick>     last tick of the window");
+	dbg_msg(TOOL_NAME, "  -p <player>   only this client id or player name");
+	dbg_msg(TOOL_NAME, "  -j <jobs>     files read at once, defaults to the number of cores");
+	return -1;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	COptions Options;
+	int Arg = 1;
+	for(; Arg < argc && argv[Arg][0] == '-'; Arg += 2)
+	{
+		if(Arg + 1 >= argc)
+			return Usage();
+		const char *pValue = argv[Arg + 1];
+		if(str_comp(argv[Arg], "-b") == 0)
+			Options.m_BeginTick = str_toint(pValue);
+		else if(str_comp(argv[Arg], "-e") == 0)
+			Options.m_EndTick = str_toint(pValue);
+		else if(str_comp(argv[Arg], "-p") == 0)
+		{
+			if(str_isallnum(pValue))
+				Options.m_ClientID = str_toint(pValue);
+			else
+				Options.m_pName = pValue;
+		}
+		else if(str_comp(argv[Arg], "-j") == 0)
+			Options.m_NumJobs = str_toint(pValue);
+		else
+			return Usage();
+	}
+
+	if(argc - Arg < 2)
+		return Usage();
+
+	const char *pCommand = argv[Arg];
+	if(str_comp(pCommand, "index") == 0)
+		Options.m_Command = COMMAND_INDEX;
+	else if(str_comp(pCommand, "players") == 0)
+		Options.m_Command = COMMAND_PLAYERS;
+	else if(str_comp(pCommand, "inputs") == 0)
+		Options.m_Command = COMMAND_INPUTS;
+	else
+		return Usage();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+		return -1;
+
+	int NumJobs = Options.m_NumJobs > 0 ? Options.m_NumJobs : std::thread::hardware_concurrency();
+	CJobPool JobPool;
+	JobPool.Init(clamp(NumJobs, 1, (int)CJobPool::MAX_THREADS));
+
+	CJobGroup Group;
+	std::vector<std::shared_ptr<CTeeHistorianToolJob>> vpJobs;
+	for(int i = Arg + 1; i < argc; i++)
+	{
+		vpJobs.push_back(std::make_shared<CTeeHistorianToolJob>(pStorage, &Options, argv[i]));
+		JobPool.Add(vpJobs.back(), CJobPool::PRIORITY_NORMAL, &Group);
+	}
+	Group.Wait();
+
+	int NumFailed = 0;
+	for(const auto &pJob : vpJobs)
+	{
+		io_write(io_stdout(), pJob->Output().c_str(), pJob->Output().size());
+		if(!pJob->Success())
+			NumFailed++;
+	}
+	io_flush(io_stdout());
+	return NumFailed ? -1 : 0;
+}